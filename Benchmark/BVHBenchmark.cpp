@@ -0,0 +1,155 @@
+#include "PCH.h"
+#include "../Core/BVH/BVHBuilder.h"
+#include "../Core/Scene/Scene.h"
+#include "../Core/Scene/Object/SceneObject_Sphere.h"
+#include "../Core/Math/Geometry.h"
+#include "../Core/Math/Random.h"
+
+#include <benchmark/benchmark.h>
+
+using namespace rt;
+using namespace math;
+
+namespace {
+
+// nodes per memory page (4KB)
+const Uint32 NodesPerPage = 4096 / sizeof(BVH::Node);
+
+void BuildRandomBVH(BVHBuilder::NodesLayout layout, BVH& outBVH)
+{
+    Random random;
+
+    const Uint32 numLeaves = 256 * 1024;
+    std::vector<Box, AlignmentAllocator<Box>> boxes;
+    for (Uint32 i = 0; i < numLeaves; ++i)
+    {
+        const Vector4 center = random.GetVector4Bipolar() * 100.0f;
+        const Vector4 size = random.GetVector4();
+        boxes.push_back(Box(center - size, center + size));
+    }
+
+    BVHBuilder::BuildingParams params;
+    params.nodesLayout = layout;
+
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder builder(outBVH);
+    builder.Build(boxes.data(), numLeaves, params, leavesOrder);
+}
+
+} // namespace
+
+// closest-hit-like traversal of random rays, counts the cache lines and pages touched
+static void Benchmark_BVH_Traversal(benchmark::State& state)
+{
+    const BVHBuilder::NodesLayout layout = static_cast<BVHBuilder::NodesLayout>(state.range(0));
+
+    BVH bvh;
+    BuildRandomBVH(layout, bvh);
+    const BVH::Node* nodes = bvh.GetNodes();
+
+    Random random;
+    const Uint32 numRays = 1024;
+    std::vector<Ray> rays;
+    for (Uint32 i = 0; i < numRays; ++i)
+    {
+        rays.push_back(Ray(random.GetVector4Bipolar() * 100.0f, random.GetVector4Bipolar()));
+    }
+
+    Uint64 numVisitedNodes = 0;
+    Uint64 numTouchedLines = 0;
+    Uint64 numTouchedPages = 0;
+    Uint64 numTracedRays = 0;
+    Uint32 rayIndex = 0;
+
+    for (auto _ : state)
+    {
+        const Ray& ray = rays[rayIndex++ % numRays];
+
+        Uint32 stack[BVH::MaxDepth];
+        Uint32 stackSize = 0;
+        Uint32 nodeIndex = 0;
+        Uint32 lastLine = UINT32_MAX;
+        Uint32 lastPage = UINT32_MAX;
+
+        for (;;)
+        {
+            const BVH::Node& node = nodes[nodeIndex];
+            numVisitedNodes++;
+
+            // children pairs are aligned to cache lines
+            numTouchedLines += (nodeIndex / 2 != lastLine) ? 1 : 0;
+            numTouchedPages += (nodeIndex / NodesPerPage != lastPage) ? 1 : 0;
+            lastLine = nodeIndex / 2;
+            lastPage = nodeIndex / NodesPerPage;
+
+            if (!node.IsLeaf())
+            {
+                float distanceA, distanceB;
+                const bool hitA = Intersect_BoxRay(ray, nodes[node.childIndex].GetBox(), distanceA);
+                const bool hitB = Intersect_BoxRay(ray, nodes[node.childIndex + 1].GetBox(), distanceB);
+
+                if (hitA && hitB)
+                {
+                    const bool swap = distanceB < distanceA;
+                    stack[stackSize++] = node.childIndex + (swap ? 0 : 1);
+                    nodeIndex = node.childIndex + (swap ? 1 : 0);
+                    continue;
+                }
+                if (hitA || hitB)
+                {
+                    nodeIndex = node.childIndex + (hitA ? 0 : 1);
+                    continue;
+                }
+            }
+
+            if (stackSize == 0)
+            {
+                break;
+            }
+            nodeIndex = stack[--stackSize];
+        }
+
+        numTracedRays++;
+    }
+
+    const Double invNumRays = 1.0 / static_cast<Double>(numTracedRays);
+    state.counters["nodes/ray"] = static_cast<Double>(numVisitedNodes) * invNumRays;
+    state.counters["lines/ray"] = static_cast<Double>(numTouchedLines) * invNumRays;
+    state.counters["pages/ray"] = static_cast<Double>(numTouchedPages) * invNumRays;
+}
+BENCHMARK(Benchmark_BVH_Traversal)
+    ->Arg(static_cast<int>(BVHBuilder::NodesLayout::DepthFirst))
+    ->Arg(static_cast<int>(BVHBuilder::NodesLayout::VanEmdeBoas));
+
+// moving a single object of a big scene (incremental update of the scene BVH and the trees derived from it)
+static void Benchmark_Scene_UpdateObject(benchmark::State& state)
+{
+    const Uint32 numObjects = static_cast<Uint32>(state.range(0));
+
+    Random random;
+    std::unique_ptr<Scene> scene(new Scene);
+    for (Uint32 i = 0; i < numObjects; ++i)
+    {
+        std::unique_ptr<ISceneObject> object(new SphereSceneObject(0.5f));
+        object->mTransform.SetTranslation((random.GetVector4Bipolar() * 1000.0f) & Vector4::MakeMask<1, 1, 1, 0>());
+        scene->AddObject(std::move(object));
+    }
+    scene->BuildBVH();
+
+    for (auto _ : state)
+    {
+        // small movement, so the tree quality doesn't degrade much during the benchmark
+        const Uint32 objectID = random.GetInt() % numObjects;
+        ISceneObject* object = scene->GetObjects()[objectID].get();
+        const Vector4 offset = (random.GetVector4Bipolar() * 2.0f) & Vector4::MakeMask<1, 1, 1, 0>();
+        object->mTransform.SetTranslation(object->mTransform.GetTranslation() + offset);
+
+        benchmark::DoNotOptimize(scene->UpdateObject(objectID));
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(Benchmark_Scene_UpdateObject)
+    ->Arg(100 * 1000)
+    ->Arg(1000 * 1000)
+    ->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,273 @@
+#include "PCH.h"
+#include "../Core/Mesh/Mesh.h"
+#include "../Core/Scene/Scene.h"
+#include "../Core/Scene/Object/SceneObject_Mesh.h"
+#include "../Core/Rendering/Context.h"
+#include "../Core/Traversal/TraversalContext.h"
+#include "../Core/Math/Random.h"
+#include "../Core/Utils/CpuFeatures.h"
+
+#include <benchmark/benchmark.h>
+
+using namespace rt;
+using namespace math;
+
+namespace {
+
+const Uint32 TileSize = 32;
+
+// cloud of small, randomly oriented triangles
+std::unique_ptr<Scene> CreateTrianglesScene()
+{
+    Random random;
+
+    const Uint32 numTriangles = 100000;
+    std::vector<Float3> positions, normals, tangents;
+    std::vector<Uint32> indices, materialIndices;
+    for (Uint32 i = 0; i < numTriangles; ++i)
+    {
+        const Vector4 center = random.GetVector4Bipolar() * 10.0f;
+        for (Uint32 j = 0; j < 3; ++j)
+        {
+            indices.push_back(static_cast<Uint32>(positions.size()));
+            positions.push_back((center + random.GetVector4Bipolar() * 0.2f).ToFloat3());
+            normals.push_back(Float3(0.0f, 0.0f, 1.0f));
+            tangents.push_back(Float3(1.0f, 0.0f, 0.0f));
+        }
+        materialIndices.push_back(UINT32_MAX);
+    }
+
+    MeshDesc meshDesc;
+    meshDesc.vertexBufferDesc.numTriangles = numTriangles;
+    meshDesc.vertexBufferDesc.numVertices = static_cast<Uint32>(positions.size());
+    meshDesc.vertexBufferDesc.vertexIndexBuffer = indices.data();
+    meshDesc.vertexBufferDesc.materialIndexBuffer = materialIndices.data();
+    meshDesc.vertexBufferDesc.positions = &positions.front().x;
+    meshDesc.vertexBufferDesc.normals = &normals.front().x;
+    meshDesc.vertexBufferDesc.tangents = &tangents.front().x;
+
+    const MeshPtr mesh(new Mesh);
+    mesh->Initialize(meshDesc);
+
+    std::unique_ptr<Scene> scene(new Scene);
+    scene->AddObject(SceneObjectPtr(new MeshSceneObject(mesh)));
+    scene->BuildBVH();
+    return scene;
+}
+
+// a tile of primary rays (coherent) or random rays starting inside the cloud (incoherent, like secondary rays)
+std::vector<Ray> GenerateRays(bool coherent)
+{
+    Random random;
+
+    std::vector<Ray> rays;
+    for (Uint32 y = 0; y < TileSize; ++y)
+    {
+        for (Uint32 x = 0; x < TileSize; ++x)
+        {
+            if (coherent)
+            {
+                const Vector4 dir(static_cast<Float>(x) / TileSize - 0.5f, static_cast<Float>(y) / TileSize - 0.5f, 1.0f, 0.0f);
+                rays.push_back(Ray(Vector4(0.0f, 0.0f, -20.0f, 0.0f), dir.Normalized3()));
+            }
+            else
+            {
+                const Vector4 origin = random.GetVector4Bipolar() * 10.0f;
+                const Vector4 dir = random.GetVector4Bipolar();
+                rays.push_back(Ray(origin & Vector4::MakeMask<1, 1, 1, 0>(), (dir & Vector4::MakeMask<1, 1, 1, 0>()).Normalized3()));
+            }
+        }
+    }
+
+    return rays;
+}
+
+} // namespace
+
+// closest hit packet traversal with different packet-to-SIMD8 switch thresholds
+static void Benchmark_Traversal_PacketSimdFallback(benchmark::State& state)
+{
+    RenderingParams params;
+    params.simdTraversalMaxGroups = static_cast<Uint32>(state.range(0));
+    params.rayReorderingThreshold = 0.0f;
+    const bool coherent = state.range(1) != 0;
+
+    const std::unique_ptr<Scene> scene = CreateTrianglesScene();
+    const std::vector<Ray> rays = GenerateRays(coherent);
+
+    std::unique_ptr<RenderingContext> context(new RenderingContext);
+    context->params = &params;
+    RayPacket& packet = context->rayPacket;
+
+    for (auto _ : state)
+    {
+        packet.Clear();
+        for (const Ray& ray : rays)
+        {
+            packet.PushRay(ray, Vector4::Zero(), ImageLocationInfo());
+        }
+
+        scene->Traverse_Packet({ packet, *context });
+        benchmark::DoNotOptimize(context->hitPoints[0].distance);
+    }
+
+    state.SetItemsProcessed(state.iterations() * rays.size());
+}
+
+static void PacketSimdFallbackArguments(benchmark::internal::Benchmark* benchmark)
+{
+    benchmark->ArgNames({ "maxGroups", "coherent" });
+    for (int coherent = 0; coherent < 2; ++coherent)
+    {
+        for (const int maxGroups : { 0, 1, 2, 4, 8, 16 })
+        {
+            benchmark->Args({ maxGroups, coherent });
+        }
+    }
+}
+BENCHMARK(Benchmark_Traversal_PacketSimdFallback)->Apply(PacketSimdFallbackArguments);
+
+// closest hit packet traversal with different ray reordering thresholds
+static void Benchmark_Traversal_PacketReordering(benchmark::State& state)
+{
+    RenderingParams params;
+    params.rayReorderingThreshold = static_cast<Float>(state.range(0)) / 100.0f;
+    const bool coherent = state.range(1) != 0;
+
+    const std::unique_ptr<Scene> scene = CreateTrianglesScene();
+    const std::vector<Ray> rays = GenerateRays(coherent);
+
+    std::unique_ptr<RenderingContext> context(new RenderingContext);
+    context->params = &params;
+    RayPacket& packet = context->rayPacket;
+
+    for (auto _ : state)
+    {
+        packet.Clear();
+        for (const Ray& ray : rays)
+        {
+            packet.PushRay(ray, Vector4::Zero(), ImageLocationInfo());
+        }
+
+        scene->Traverse_Packet({ packet, *context });
+        benchmark::DoNotOptimize(context->hitPoints[0].distance);
+    }
+
+    state.SetItemsProcessed(state.iterations() * rays.size());
+}
+
+static void PacketReorderingArguments(benchmark::internal::Benchmark* benchmark)
+{
+    benchmark->ArgNames({ "thresholdPercent", "coherent" });
+    for (int coherent = 0; coherent < 2; ++coherent)
+    {
+        for (const int thresholdPercent : { 0, 25, 50, 75, 100 })
+        {
+            benchmark->Args({ thresholdPercent, coherent });
+        }
+    }
+}
+BENCHMARK(Benchmark_Traversal_PacketReordering)->Apply(PacketReorderingArguments);
+
+// closest hit packet traversal with baseline (AVX2) and AVX-512 kernels
+static void Benchmark_Traversal_PacketKernels(benchmark::State& state)
+{
+    const InstructionSet instructionSet = static_cast<InstructionSet>(state.range(0));
+    const bool coherent = state.range(1) != 0;
+
+    const InstructionSet kernelInstructionSet = GetKernelInstructionSet();
+    if (!SetKernelInstructionSet(instructionSet))
+    {
+        state.SkipWithError("Instruction set not supported");
+        return;
+    }
+
+    const std::unique_ptr<Scene> scene = CreateTrianglesScene();
+    const std::vector<Ray> rays = GenerateRays(coherent);
+
+    std::unique_ptr<RenderingContext> context(new RenderingContext);
+    RayPacket& packet = context->rayPacket;
+
+    for (auto _ : state)
+    {
+        packet.Clear();
+        for (const Ray& ray : rays)
+        {
+            packet.PushRay(ray, Vector4::Zero(), ImageLocationInfo());
+        }
+
+        scene->Traverse_Packet({ packet, *context });
+        benchmark::DoNotOptimize(context->hitPoints[0].distance);
+    }
+
+    state.SetItemsProcessed(state.iterations() * rays.size());
+    SetKernelInstructionSet(kernelInstructionSet);
+}
+
+static void PacketKernelsArguments(benchmark::internal::Benchmark* benchmark)
+{
+    benchmark->ArgNames({ "instructionSet", "coherent" });
+    for (int coherent = 0; coherent < 2; ++coherent)
+    {
+        for (const InstructionSet instructionSet : { InstructionSet::AVX2, InstructionSet::AVX512 })
+        {
+            benchmark->Args({ static_cast<int>(instructionSet), coherent });
+        }
+    }
+}
+BENCHMARK(Benchmark_Traversal_PacketKernels)->Apply(PacketKernelsArguments);
+
+// closest hit single ray and packet traversal with the selected kernels
+// run with the default (nehalem) and the haswell build to compare the baselines, the label shows which one is running
+static void Benchmark_Traversal_Baseline(benchmark::State& state)
+{
+    const bool usePackets = state.range(0) != 0;
+    const bool coherent = state.range(1) != 0;
+
+    const std::unique_ptr<Scene> scene = CreateTrianglesScene();
+    const std::vector<Ray> rays = GenerateRays(coherent);
+
+    std::unique_ptr<RenderingContext> context(new RenderingContext);
+    RayPacket& packet = context->rayPacket;
+
+    for (auto _ : state)
+    {
+        if (usePackets)
+        {
+            packet.Clear();
+            for (const Ray& ray : rays)
+            {
+                packet.PushRay(ray, Vector4::Zero(), ImageLocationInfo());
+            }
+
+            scene->Traverse_Packet({ packet, *context });
+            benchmark::DoNotOptimize(context->hitPoints[0].distance);
+        }
+        else
+        {
+            for (const Ray& ray : rays)
+            {
+                HitPoint hitPoint;
+                scene->Traverse_Single({ ray, hitPoint, *context });
+                benchmark::DoNotOptimize(hitPoint.distance);
+            }
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * rays.size());
+    state.SetLabel(std::string("baseline: ") + GetInstructionSetName(GetBaselineInstructionSet()) +
+                   ", kernels: " + GetInstructionSetName(GetKernelInstructionSet()));
+}
+
+static void BaselineArguments(benchmark::internal::Benchmark* benchmark)
+{
+    benchmark->ArgNames({ "packet", "coherent" });
+    for (int coherent = 0; coherent < 2; ++coherent)
+    {
+        for (int packet = 0; packet < 2; ++packet)
+        {
+            benchmark->Args({ packet, coherent });
+        }
+    }
+}
+BENCHMARK(Benchmark_Traversal_Baseline)->Apply(BaselineArguments);
@@ -1,35 +1,122 @@
 #include "PCH.h"
 #include "BVH.h"
 #include "Utils/Logger.h"
+#include "Utils/ThreadPool.h"
+
+#include "../External/rapidjson/prettywriter.h"
+#include "../External/rapidjson/stringbuffer.h"
 
 
 namespace rt {
 
-static const Uint32 BvhFileVersion = 0;
+static const Uint32 BvhFileVersion = 1;
 static const Uint32 BvhMagic = 'bvhc';
 
+// nodes are placed at cache line boundary, so they can be used directly from memory-mapped file
+static const Uint32 BvhFileDataAlignment = RT_CACHE_LINE_SIZE;
+
 struct BVHFileHeader
 {
     Uint32 magic;
     Uint32 version;
+    Uint64 contentHash;
+    Uint32 nodeSize;
     Uint32 numNodes;
-    // TODO checksum, mesh/scene name, etc.
+    Uint32 numLeaves;       // number of entries in the leaves order
+    Uint32 nodesOffset;     // offset of the nodes data from the file beginning
+    Uint64 leavesOffset;    // offset of the leaves order from the file beginning
 };
 
+// stats are calculated in parallel for fixed node ranges
+static const Uint32 NodesPerStatsTask = 4096;
+
 static_assert(sizeof(BVH::Node) == 32, "Invalid node size");
+static_assert(sizeof(BVHFileHeader) <= BvhFileDataAlignment, "BVH file header is too big");
+
+// check that the nodes reachable from the root form a tree within the arrays' bounds (no deeper than MaxDepth),
+// so nodes loaded from a corrupted file can't make the traversal access memory out of bounds
+// leaf ranges are checked only if the leaves order size is known (non-zero)
+static bool ValidateNodes(const BVH::Node* nodes, Uint32 numNodes, Uint32 numLeaves)
+{
+    if (numNodes == 0)
+    {
+        return true;
+    }
+
+    std::vector<bool> visited(numNodes, false);
+
+    Uint32 stack[2 * BVH::MaxDepth];
+    Uint32 depthStack[2 * BVH::MaxDepth];
+    Uint32 stackSize = 0;
+    stack[stackSize] = 0;
+    depthStack[stackSize++] = 1;
+
+    while (stackSize > 0)
+    {
+        const Uint32 nodeIndex = stack[--stackSize];
+        const Uint32 depth = depthStack[stackSize];
+
+        // each node must be referenced once (this also rejects cycles)
+        if (visited[nodeIndex])
+        {
+            return false;
+        }
+        visited[nodeIndex] = true;
+
+        const BVH::Node& node = nodes[nodeIndex];
+        if (node.IsLeaf())
+        {
+            if (numLeaves > 0 && static_cast<Uint64>(node.childIndex) + node.numLeaves > numLeaves)
+            {
+                return false;
+            }
+            continue;
+        }
+
+        if (depth >= BVH::MaxDepth || static_cast<Uint64>(node.childIndex) + 1 >= numNodes)
+        {
+            return false;
+        }
+
+        for (Uint32 i = 0; i < 2; ++i)
+        {
+            stack[stackSize] = node.childIndex + i;
+            depthStack[stackSize++] = depth + 1;
+        }
+    }
+
+    return true;
+}
 
 BVH::BVH()
     : mNumNodes(0)
+    , mMappedNodes(nullptr)
+    , mUnoptimizedSahCost(0.0)
 { }
 
 bool BVH::AllocateNodes(Uint32 numNodes)
 {
+    mFileMapping.reset();
+    mMappedNodes = nullptr;
+    mUnoptimizedSahCost = 0.0;
+
     mNodes.resize(numNodes);
     mNumNodes = numNodes;
     return true;
 }
 
-bool BVH::SaveToFile(const std::string& filePath) const
+void BVH::UnmapNodes()
+{
+    // memory-mapped nodes are read-only
+    if (mMappedNodes)
+    {
+        mNodes.assign(mMappedNodes, mMappedNodes + mNumNodes);
+        mFileMapping.reset();
+        mMappedNodes = nullptr;
+    }
+}
+
+bool BVH::SaveToFile(const std::string& filePath, Uint64 contentHash, const std::vector<Uint32>& leavesOrder) const
 {
     FILE* file = fopen(filePath.c_str(), "wb");
     if (!file)
@@ -38,108 +125,545 @@ bool BVH::SaveToFile(const std::string& filePath) const
         return false;
     }
 
+    const size_t nodesDataSize = sizeof(Node) * mNumNodes;
+
     BVHFileHeader header;
+    memset(&header, 0, sizeof(header));
     header.magic = BvhMagic;
     header.version = BvhFileVersion;
+    header.contentHash = contentHash;
+    header.nodeSize = sizeof(Node);
     header.numNodes = mNumNodes;
+    header.numLeaves = static_cast<Uint32>(leavesOrder.size());
+    header.nodesOffset = BvhFileDataAlignment;
+    header.leavesOffset = header.nodesOffset + nodesDataSize;
 
-    if (fwrite(&header, sizeof(BVHFileHeader), 1, file) != 1)
+    // header is padded to the nodes alignment
+    Uint8 headerData[BvhFileDataAlignment];
+    memset(headerData, 0, sizeof(headerData));
+    memcpy(headerData, &header, sizeof(header));
+
+    if (fwrite(headerData, sizeof(headerData), 1, file) != 1)
     {
         fclose(file);
         RT_LOG_ERROR("Failed to write BVH file header");
         return false;
     }
 
-    if (fwrite(mNodes.data(), sizeof(Node), mNumNodes, file) != mNumNodes)
+    if (fwrite(GetNodes(), sizeof(Node), mNumNodes, file) != mNumNodes)
     {
         fclose(file);
         RT_LOG_ERROR("Failed to write BVH nodes");
         return false;
     }
 
+    if (fwrite(leavesOrder.data(), sizeof(Uint32), leavesOrder.size(), file) != leavesOrder.size())
+    {
+        fclose(file);
+        RT_LOG_ERROR("Failed to write BVH leaves order");
+        return false;
+    }
+
     fclose(file);
     return true;
 }
 
-bool BVH::LoadFromFile(const std::string& filePath)
+bool BVH::LoadFromFile(const std::string& filePath, Uint64 expectedContentHash, std::vector<Uint32>* outLeavesOrder)
 {
-    FILE* file = fopen(filePath.c_str(), "rb");
-    if (!file)
+    std::unique_ptr<FileMapping> fileMapping(new FileMapping);
+    if (!fileMapping->Open(filePath))
     {
-        RT_LOG_ERROR("Failed to open BVH file '%s' for reading. Error code: %i", filePath.c_str(), errno);
+        RT_LOG_ERROR("Failed to open BVH file '%s' for reading", filePath.c_str());
         return false;
     }
 
+    const Uint8* fileData = static_cast<const Uint8*>(fileMapping->GetData());
+    const size_t fileSize = fileMapping->GetSize();
+
     BVHFileHeader header;
-    if (fread(&header, sizeof(BVHFileHeader), 1, file) != 1)
+    if (fileSize < sizeof(BVHFileHeader))
     {
-        fclose(file);
         RT_LOG_ERROR("Failed to read BVH file header");
         return false;
     }
+    memcpy(&header, fileData, sizeof(BVHFileHeader));
 
     if (header.magic != BvhMagic)
     {
-        fclose(file);
         RT_LOG_ERROR("Corrupted BVH file (invalid magic value)");
         return false;
     }
 
     if (header.version != BvhFileVersion)
     {
-        fclose(file);
         RT_LOG_ERROR("Unsupported BVH file version %u (expected %u)", header.version, BvhFileVersion);
         return false;
     }
 
-    if (!AllocateNodes(header.numNodes))
+    if (header.nodeSize != sizeof(Node))
     {
-        fclose(file);
+        RT_LOG_ERROR("Unsupported BVH node size %u (expected %u)", header.nodeSize, (Uint32)sizeof(Node));
         return false;
     }
 
-    if (fread(mNodes.data(), sizeof(Node), header.numNodes, file) != header.numNodes)
+    if (expectedContentHash != 0 && header.contentHash != expectedContentHash)
     {
-        fclose(file);
-        RT_LOG_ERROR("Failed to read BVH nodes");
+        RT_LOG_ERROR("BVH file '%s' is out of date (content hash mismatch)", filePath.c_str());
         return false;
     }
 
-    fclose(file);
+    const Uint64 nodesDataSize = sizeof(Node) * static_cast<Uint64>(header.numNodes);
+    const Uint64 leavesDataSize = sizeof(Uint32) * static_cast<Uint64>(header.numLeaves);
+    if (header.nodesOffset % BvhFileDataAlignment != 0 ||
+        header.nodesOffset + nodesDataSize > header.leavesOffset ||
+        header.leavesOffset + leavesDataSize != fileSize)
+    {
+        RT_LOG_ERROR("Corrupted BVH file (invalid data layout)");
+        return false;
+    }
+
+    const Node* nodes = reinterpret_cast<const Node*>(fileData + header.nodesOffset);
+    if (!ValidateNodes(nodes, header.numNodes, header.numLeaves))
+    {
+        RT_LOG_ERROR("Corrupted BVH file (invalid node or leaf ranges)");
+        return false;
+    }
+
+    if (outLeavesOrder)
+    {
+        const Uint32* leavesData = reinterpret_cast<const Uint32*>(fileData + header.leavesOffset);
+        outLeavesOrder->assign(leavesData, leavesData + header.numLeaves);
+    }
+
+    mNodes.clear();
+    mNodes.shrink_to_fit();
+    mNumNodes = header.numNodes;
+    mMappedNodes = nodes;
+    mFileMapping = std::move(fileMapping);
+    mUnoptimizedSahCost = 0.0;
     return true;
 }
 
-void BVH::CalculateStats(Stats& outStats) const
+void BVH::CalculateNodeCosts(std::vector<Float>& outCosts) const
+{
+    const Node* nodes = GetNodes();
+    outCosts.assign(mNumNodes, 0.0f);
+
+    if (mNumNodes == 0)
+    {
+        return;
+    }
+
+    // walk the tree from the root (unused nodes are skipped and keep zero cost),
+    // children are visited after their parent, so iterating the visit order backwards visits them first
+    std::vector<Uint32> visitOrder;
+    visitOrder.reserve(mNumNodes);
+
+    Uint32 stack[2 * MaxDepth];
+    Uint32 stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const Uint32 nodeIndex = stack[--stackSize];
+        visitOrder.push_back(nodeIndex);
+
+        const Node& node = nodes[nodeIndex];
+        if (!node.IsLeaf())
+        {
+            RT_ASSERT(stackSize + 2 <= 2 * MaxDepth);
+            stack[stackSize++] = node.childIndex;
+            stack[stackSize++] = node.childIndex + 1;
+        }
+    }
+
+    for (auto it = visitOrder.rbegin(); it != visitOrder.rend(); ++it)
+    {
+        const Node& node = nodes[*it];
+        if (node.IsLeaf())
+        {
+            outCosts[*it] = static_cast<Float>(node.numLeaves);
+            continue;
+        }
+
+        const Float area = node.GetBox().SurfaceArea();
+        if (area <= 0.0f)
+        {
+            outCosts[*it] = 1.0f;
+            continue;
+        }
+
+        // same unit costs as in CalculateStats
+        Float cost = area;
+        for (Uint32 j = 0; j < 2; ++j)
+        {
+            const Uint32 childIndex = node.childIndex + j;
+            cost += outCosts[childIndex] * nodes[childIndex].GetBox().SurfaceArea();
+        }
+        outCosts[*it] = cost / area;
+    }
+}
+
+Double BVH::CalculateSahCost(const CostParams& costParams) const
+{
+    if (mNumNodes == 0)
+    {
+        return 0.0;
+    }
+
+    const Node* nodes = GetNodes();
+
+    // walk the tree from the root, so unused nodes (the padding one and pairs freed by BVHUpdater) are skipped
+    Double cost = 0.0;
+
+    Uint32 stack[2 * MaxDepth];
+    Uint32 stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const Node& node = nodes[stack[--stackSize]];
+        if (node.IsLeaf())
+        {
+            cost += node.GetBox().SurfaceArea() * (Double)costParams.intersectionCost * (Double)node.numLeaves;
+        }
+        else
+        {
+            cost += node.GetBox().SurfaceArea() * (Double)costParams.traversalCost;
+
+            RT_ASSERT(stackSize + 2 <= 2 * MaxDepth);
+            stack[stackSize++] = node.childIndex;
+            stack[stackSize++] = node.childIndex + 1;
+        }
+    }
+
+    const Float rootArea = nodes[0].GetBox().SurfaceArea();
+    return rootArea > 0.0f ? cost / rootArea : cost;
+}
+
+void BVH::Refit(const math::Box* leafBoxes, ThreadPool* threadPool)
 {
     if (mNumNodes == 0)
     {
-        outStats = Stats();
         return;
     }
 
-    CalculateStatsForNode(0, outStats, 1);
+    mUnoptimizedSahCost = 0.0;
+
+    UnmapNodes();
+
+    const Uint32 numThreads = threadPool ? threadPool->GetNumThreads() : 1;
+    if (numThreads <= 1)
+    {
+        RefitSubtree(0, leafBoxes);
+        return;
+    }
+
+    // split the tree into independent subtrees (a few per thread for better load balancing)
+    const Uint32 targetNumSubtrees = 4 * numThreads;
+    std::vector<Uint32> topNodes;
+    std::vector<Uint32> subtrees = { 0 };
+    while (subtrees.size() < targetNumSubtrees)
+    {
+        std::vector<Uint32> nextSubtrees;
+        for (const Uint32 nodeIndex : subtrees)
+        {
+            const Node& node = mNodes[nodeIndex];
+            if (node.IsLeaf())
+            {
+                nextSubtrees.push_back(nodeIndex);
+            }
+            else
+            {
+                topNodes.push_back(nodeIndex);
+                nextSubtrees.push_back(node.childIndex);
+                nextSubtrees.push_back(node.childIndex + 1);
+            }
+        }
+
+        if (nextSubtrees.size() == subtrees.size())
+        {
+            break;
+        }
+        subtrees = std::move(nextSubtrees);
+    }
+
+    const auto taskCallback = [&](Uint32 taskID, Uint32)
+    {
+        RefitSubtree(subtrees[taskID], leafBoxes);
+    };
+    threadPool->RunParallelTask(taskCallback, static_cast<Uint32>(subtrees.size()));
+
+    // top nodes were collected level by level, so children are visited first when iterating backwards
+    for (auto it = topNodes.rbegin(); it != topNodes.rend(); ++it)
+    {
+        Node& node = mNodes[*it];
+        const math::Box box(mNodes[node.childIndex].GetBox(), mNodes[node.childIndex + 1].GetBox());
+        node.min = box.min.ToFloat3();
+        node.max = box.max.ToFloat3();
+    }
+}
+
+void BVH::RefitSubtree(Uint32 nodeIndex, const math::Box* leafBoxes)
+{
+    Node& node = mNodes[nodeIndex];
+
+    math::Box box = math::Box::Empty();
+    if (node.IsLeaf())
+    {
+        for (Uint32 i = 0; i < node.numLeaves; ++i)
+        {
+            box = math::Box(box, leafBoxes[node.childIndex + i]);
+        }
+    }
+    else
+    {
+        RefitSubtree(node.childIndex, leafBoxes);
+        RefitSubtree(node.childIndex + 1, leafBoxes);
+        box = math::Box(mNodes[node.childIndex].GetBox(), mNodes[node.childIndex + 1].GetBox());
+    }
+
+    node.min = box.min.ToFloat3();
+    node.max = box.max.ToFloat3();
+}
+
+void BVH::CalculateStats(Stats& outStats, const CostParams& costParams, ThreadPool* threadPool) const
+{
+    outStats = Stats();
+
+    if (mNumNodes == 0)
+    {
+        return;
+    }
+
+    const Node* nodes = GetNodes();
+
+    // walk the tree from the root, unused nodes (the padding one and pairs freed by BVHUpdater) keep zero depth
+    std::vector<Uint32> nodeDepths(mNumNodes, 0);
+    nodeDepths[0] = 1;
+
+    Uint32 stack[2 * MaxDepth];
+    Uint32 stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const Uint32 nodeIndex = stack[--stackSize];
+        const Node& node = nodes[nodeIndex];
+        if (!node.IsLeaf())
+        {
+            nodeDepths[node.childIndex] = nodeDepths[nodeIndex] + 1;
+            nodeDepths[node.childIndex + 1] = nodeDepths[nodeIndex] + 1;
+
+            RT_ASSERT(stackSize + 2 <= 2 * MaxDepth);
+            stack[stackSize++] = node.childIndex;
+            stack[stackSize++] = node.childIndex + 1;
+        }
+    }
+
+    // node ranges are fixed, so the results do not depend on the number of threads
+    const Uint32 numTasks = (mNumNodes + NodesPerStatsTask - 1) / NodesPerStatsTask;
+    std::vector<Stats> taskStats(numTasks);
+    std::vector<Double> taskInnerNodesAreas(numTasks, 0.0);
+
+    const auto taskCallback = [&](Uint32 taskID, Uint32)
+    {
+        const Uint32 firstNode = taskID * NodesPerStatsTask;
+        const Uint32 numNodes = std::min(NodesPerStatsTask, mNumNodes - firstNode);
+        CalculateStatsForNodes(firstNode, numNodes, nodeDepths.data(), costParams, taskStats[taskID], taskInnerNodesAreas[taskID]);
+    };
+
+    if (threadPool && numTasks > 1)
+    {
+        threadPool->RunParallelTask(taskCallback, numTasks);
+    }
+    else
+    {
+        for (Uint32 i = 0; i < numTasks; ++i)
+        {
+            taskCallback(i, 0);
+        }
+    }
+
+    Double totalInnerNodesArea = 0.0;
+    for (Uint32 taskID = 0; taskID < numTasks; ++taskID)
+    {
+        const Stats& stats = taskStats[taskID];
+        outStats.maxDepth = std::max(outStats.maxDepth, stats.maxDepth);
+        outStats.numNodes += stats.numNodes;
+        outStats.numLeafNodes += stats.numLeafNodes;
+        outStats.totalNodesArea += stats.totalNodesArea;
+        outStats.totalNodesVolume += stats.totalNodesVolume;
+        outStats.sahCost += stats.sahCost;
+        outStats.epo += stats.epo;
+        outStats.siblingOverlap += stats.siblingOverlap;
+        totalInnerNodesArea += taskInnerNodesAreas[taskID];
+
+        if (stats.leavesCountHistogram.size() > outStats.leavesCountHistogram.size())
+        {
+            outStats.leavesCountHistogram.resize(stats.leavesCountHistogram.size(), 0);
+        }
+        for (size_t i = 0; i < stats.leavesCountHistogram.size(); ++i)
+        {
+            outStats.leavesCountHistogram[i] += stats.leavesCountHistogram[i];
+        }
+    }
+
+    outStats.nodesMemorySize = static_cast<Uint64>(mNumNodes) * sizeof(Node);
+
+    const Float rootArea = nodes[0].GetBox().SurfaceArea();
+    if (rootArea > 0.0f)
+    {
+        outStats.sahCost /= rootArea;
+        outStats.epo /= rootArea;
+    }
+
+    if (totalInnerNodesArea > 0.0)
+    {
+        outStats.siblingOverlap /= totalInnerNodesArea;
+    }
+
+    outStats.sahCostBeforeOptimization = mUnoptimizedSahCost > 0.0 ? mUnoptimizedSahCost : outStats.sahCost;
 }
 
-void BVH::CalculateStatsForNode(Uint32 nodeIndex, Stats& outStats, Uint32 depth) const
+void BVH::CalculateStatsForNodes(Uint32 firstNode, Uint32 numNodes, const Uint32* nodeDepths, const CostParams& costParams, Stats& outStats, Double& outInnerNodesArea) const
 {
-    const Node& node = mNodes[nodeIndex];
-    const math::Box box = node.GetBox();
+    const Node* nodes = GetNodes();
+
+    for (Uint32 i = firstNode; i < firstNode + numNodes; ++i)
+    {
+        // skip unused nodes
+        const Uint32 depth = nodeDepths[i];
+        if (depth == 0)
+        {
+            continue;
+        }
 
-    outStats.totalNodesArea += box.SurfaceArea();
-    outStats.totalNodesVolume += box.Volume();
-    outStats.maxDepth = std::max(outStats.maxDepth, depth);
+        const Node& node = nodes[i];
+        const math::Box box = node.GetBox();
+        const Float area = box.SurfaceArea();
 
-    if (node.numLeaves + 1u > (Uint32)outStats.leavesCountHistogram.size())
+        outStats.numNodes++;
+        outStats.totalNodesArea += area;
+        outStats.totalNodesVolume += box.Volume();
+        outStats.maxDepth = std::max(outStats.maxDepth, depth);
+
+        if (node.numLeaves + 1u > (Uint32)outStats.leavesCountHistogram.size())
+        {
+            outStats.leavesCountHistogram.resize(node.numLeaves + 1, 0);
+        }
+        outStats.leavesCountHistogram[node.numLeaves]++;
+
+        const Double nodeCost = node.IsLeaf() ?
+            (Double)costParams.intersectionCost * (Double)node.numLeaves :
+            (Double)costParams.traversalCost;
+
+        outStats.sahCost += area * nodeCost;
+
+        // the root node's subtree contains all the leaves
+        if (costParams.calculateEPO && i > 0)
+        {
+            outStats.epo += CalculateNodeOverlap(i) * nodeCost;
+        }
+
+        if (node.IsLeaf())
+        {
+            outStats.numLeafNodes++;
+        }
+        else
+        {
+            const math::Box overlap = math::Box::Intersection(nodes[node.childIndex].GetBox(), nodes[node.childIndex + 1].GetBox());
+            if (!overlap.IsEmpty())
+            {
+                outStats.siblingOverlap += overlap.SurfaceArea();
+            }
+            outInnerNodesArea += area;
+        }
+    }
+}
+
+Float BVH::CalculateNodeOverlap(Uint32 nodeIndex) const
+{
+    // Leaf node boxes are used instead of the actual geometry, so it's an upper bound of the exact EPO.
+    // Overlapping areas are summed up, not merged, hence the result is clamped to the node's area.
+    const Node* nodes = GetNodes();
+    const math::Box box = nodes[nodeIndex].GetBox();
+    const Float area = box.SurfaceArea();
+
+    Float overlap = 0.0f;
+
+    Uint32 stack[2 * MaxDepth];
+    Uint32 stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
     {
-        outStats.leavesCountHistogram.resize(node.numLeaves + 1, 0);
+        const Uint32 currentIndex = stack[--stackSize];
+
+        // skip the node's own subtree
+        if (currentIndex == nodeIndex)
+        {
+            continue;
+        }
+
+        const Node& node = nodes[currentIndex];
+        const math::Box intersection = math::Box::Intersection(box, node.GetBox());
+        if (intersection.IsEmpty())
+        {
+            continue;
+        }
+
+        if (node.IsLeaf())
+        {
+            overlap += intersection.SurfaceArea();
+        }
+        else
+        {
+            RT_ASSERT(stackSize + 2 <= 2 * MaxDepth);
+            stack[stackSize++] = node.childIndex;
+            stack[stackSize++] = node.childIndex + 1;
+        }
     }
-    outStats.leavesCountHistogram[node.numLeaves]++;
 
-    if (node.numLeaves == 0u)
+    return std::min(overlap, area);
+}
+
+std::string BVH::Stats::ToJSON() const
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+
+    writer.StartObject();
+    writer.Key("maxDepth");
+    writer.Uint(maxDepth);
+    writer.Key("numNodes");
+    writer.Uint(numNodes);
+    writer.Key("numLeafNodes");
+    writer.Uint(numLeafNodes);
+    writer.Key("nodesMemorySize");
+    writer.Uint64(nodesMemorySize);
+    writer.Key("totalNodesArea");
+    writer.Double(totalNodesArea);
+    writer.Key("totalNodesVolume");
+    writer.Double(totalNodesVolume);
+    writer.Key("sahCost");
+    writer.Double(sahCost);
+    writer.Key("sahCostBeforeOptimization");
+    writer.Double(sahCostBeforeOptimization);
+    writer.Key("epo");
+    writer.Double(epo);
+    writer.Key("siblingOverlap");
+    writer.Double(siblingOverlap);
+    writer.Key("leavesCountHistogram");
+    writer.StartArray();
+    for (const Uint32 count : leavesCountHistogram)
     {
-        CalculateStatsForNode(node.childIndex, outStats, depth + 1);
-        CalculateStatsForNode(node.childIndex + 1, outStats, depth + 1);
+        writer.Uint(count);
     }
+    writer.EndArray();
+    writer.EndObject();
+
+    return buffer.GetString();
 }
 
 } // namespace rt
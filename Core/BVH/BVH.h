@@ -7,14 +7,17 @@
 #include "../Math/Box.h"
 #include "../Math/Simd8Box.h"
 #include "../Utils/AlignmentAllocator.h"
+#include "../Utils/FileMapping.h"
 
 #include <string>
 
 
 namespace rt {
 
+class ThreadPool;
+
 // binary Bounding Volume Hierarchy
-class BVH
+class RAYLIB_API BVH
 {
 public:
     static constexpr Uint32 MaxDepth = 128;
@@ -40,13 +43,13 @@ public:
         {
             math::Box_Simd8 ret;
 
-            ret.min.x = _mm256_broadcast_ss(&min.x);
-            ret.min.y = _mm256_broadcast_ss(&min.y);
-            ret.min.z = _mm256_broadcast_ss(&min.z);
+            ret.min.x = math::Vector8(min.x);
+            ret.min.y = math::Vector8(min.y);
+            ret.min.z = math::Vector8(min.z);
 
-            ret.max.x = _mm256_broadcast_ss(&max.x);
-            ret.max.y = _mm256_broadcast_ss(&max.y);
-            ret.max.z = _mm256_broadcast_ss(&max.z);
+            ret.max.x = math::Vector8(max.x);
+            ret.max.y = math::Vector8(max.y);
+            ret.max.z = math::Vector8(max.z);
 
             return ret;
         }
@@ -62,20 +65,49 @@ public:
         }
     };
 
+    // constants of the SAH cost model
+    struct CostParams
+    {
+        Float traversalCost;    // cost of a node box test
+        Float intersectionCost; // cost of a single leaf object intersection
+        bool calculateEPO;      // EPO is expensive to calculate (it requires a tree walk per node)
+
+        CostParams()
+            : traversalCost(1.0f)
+            , intersectionCost(1.0f)
+            , calculateEPO(false)
+        { }
+    };
+
     struct Stats
     {
         Uint32 maxDepth;    // max leaf depth
+        Uint32 numNodes;    // number of reachable nodes
+        Uint32 numLeafNodes;
+        Uint64 nodesMemorySize; // in bytes
         Double totalNodesArea;
         Double totalNodesVolume;
+        Double sahCost;     // expected cost of a random ray traversal (relative to root node area)
+        Double sahCostBeforeOptimization; // SAH cost before treelet restructuring (the same as sahCost if not optimized)
+        Double epo;         // end-point overlap: cost of visiting nodes overlapped by leaves outside them (relative to root node area, calculated only if requested)
+        Double siblingOverlap; // surface area of sibling boxes' intersections relative to the parents' surface area
         std::vector<Uint32> leavesCountHistogram;
 
-        // TODO overlap factor, etc.
-
         Stats()
             : maxDepth(0)
+            , numNodes(0)
+            , numLeafNodes(0)
+            , nodesMemorySize(0)
             , totalNodesArea(0.0)
             , totalNodesVolume(0.0)
+            , sahCost(0.0)
+            , sahCostBeforeOptimization(0.0)
+            , epo(0.0)
+            , siblingOverlap(0.0)
         { }
+
+        // write stats as JSON object
+        std::string ToJSON() const;
     };
 
     BVH();
@@ -83,22 +115,60 @@ public:
     BVH& operator = (BVH&& rhs) = default;
 
     // calculate whole BVH stats
-    void CalculateStats(Stats& outStats) const;
-
-    bool SaveToFile(const std::string& filePath) const;
-    bool LoadFromFile(const std::string& filePath);
-
-    RT_FORCE_INLINE const Node* GetNodes() const { return mNodes.data(); }
+    // nodes are processed in parallel if the thread pool is provided
+    // note: sahCostBeforeOptimization of an optimized tree is calculated with unit costs
+    // note: EPO is calculated only if enabled in the cost params
+    void CalculateStats(Stats& outStats, const CostParams& costParams = CostParams(), ThreadPool* threadPool = nullptr) const;
+
+    // calculate only the SAH cost of the whole BVH (single pass over the reachable nodes, much cheaper than CalculateStats)
+    Double CalculateSahCost(const CostParams& costParams = CostParams()) const;
+
+    // calculate SAH cost of each node's subtree, relative to the node's surface area
+    // (comparing it with the cost calculated earlier tells how much refitting degraded the subtree, unused nodes get zero cost)
+    void CalculateNodeCosts(std::vector<Float>& outCosts) const;
+
+    // recalculate node bounds bottom-up for new leaf boxes, keeping the tree topology
+    // leaf boxes must be given in the BVH leaves order
+    // subtrees are refitted in parallel if the thread pool is provided
+    void Refit(const math::Box* leafBoxes, ThreadPool* threadPool = nullptr);
+
+    // save nodes along with (optional) leaves order
+    // content hash identifies the data the BVH was built from, so stale files can be detected
+    bool SaveToFile(const std::string& filePath, Uint64 contentHash = 0, const std::vector<Uint32>& leavesOrder = {}) const;
+
+    // load BVH saved with SaveToFile
+    // nodes are memory-mapped, not copied, so the file stays open until the BVH is rebuilt or destroyed
+    // fails if the content hash is non-zero and it does not match the file's one,
+    // or if the nodes don't form a valid tree (node and leaf ranges are checked)
+    bool LoadFromFile(const std::string& filePath, Uint64 expectedContentHash = 0, std::vector<Uint32>* outLeavesOrder = nullptr);
+
+    RT_FORCE_INLINE const Node* GetNodes() const { return mMappedNodes ? mMappedNodes : mNodes.data(); }
     RT_FORCE_INLINE Uint32 GetNumNodes() const { return mNumNodes; }
 
 private:
-    void CalculateStatsForNode(Uint32 node, Stats& outStats, Uint32 depth) const;
+    // accumulate stats of nodes in given range (node depths are calculated upfront, zero marks unused node)
+    void CalculateStatsForNodes(Uint32 firstNode, Uint32 numNodes, const Uint32* nodeDepths, const CostParams& costParams, Stats& outStats, Double& outInnerNodesArea) const;
+
+    // surface area of the node's box intersections with leaf nodes outside of its subtree
+    Float CalculateNodeOverlap(Uint32 nodeIndex) const;
+    void RefitSubtree(Uint32 nodeIndex, const math::Box* leafBoxes);
     bool AllocateNodes(Uint32 numNodes);
 
+    // copy memory-mapped nodes, so they can be modified
+    void UnmapNodes();
+
     std::vector<Node, AlignmentAllocator<Node, RT_CACHE_LINE_SIZE>> mNodes;
     Uint32 mNumNodes;
 
+    // nodes loaded from a file
+    std::unique_ptr<FileMapping> mFileMapping;
+    const Node* mMappedNodes;
+
+    // SAH cost before treelet restructuring (zero if the tree was not optimized)
+    Double mUnoptimizedSahCost;
+
     friend class BVHBuilder;
+    friend class BVHUpdater;
 };
 
 
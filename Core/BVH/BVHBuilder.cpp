@@ -2,30 +2,87 @@
 #include "BVHBuilder.h"
 #include "Utils/Logger.h"
 #include "Utils/Timer.h"
+#include "Utils/ThreadPool.h"
+#include "Utils/RadixSort.h"
+#include "Math/Morton.h"
 
 #include <algorithm>
+#include <queue>
 
 namespace rt {
 
 using namespace math;
 
-BVHBuilder::Context::Context(Uint32 numLeaves)
+namespace {
+
+const char* GetSplitAlgorithmName(BVHBuilder::SplitAlgorithm algorithm)
+{
+    switch (algorithm)
+    {
+    case BVHBuilder::SplitAlgorithm::Sweep: return "sweep";
+    case BVHBuilder::SplitAlgorithm::Binned: return "binned";
+    case BVHBuilder::SplitAlgorithm::Spatial: return "spatial";
+    case BVHBuilder::SplitAlgorithm::Linear: return "linear";
+    }
+    return "unknown";
+}
+
+// split axis is used for ordering children during traversal
+RT_FORCE_INLINE Uint32 CalculateSplitAxis(const Box& leftBox, const Box& rightBox)
 {
-    mLeftBoxesCache.resize(numLeaves);
-    mRightBoxesCache.resize(numLeaves);
+    const Vector4 centersDistance = Vector4::Abs((leftBox.min + leftBox.max) - (rightBox.min + rightBox.max));
+
+    Uint32 axis = 0;
+    for (Uint32 i = 1; i < 3; ++i)
+    {
+        if (centersDistance[i] > centersDistance[axis])
+        {
+            axis = i;
+        }
+    }
+    return axis;
+}
+
+// max number of treelet leaves in treelet restructuring
+const Uint32 MaxTreeletLeaves = 7;
+
+// Morton codes are calculated in parallel for chunks of this size
+const Uint32 MortonCodesPerTask = 16 * 1024;
+
+// agglomerative clustering: number of neighbors (in Morton order) searched on each side of a cluster
+const Uint32 AgglomerativeSearchRadius = 8;
+
+} // namespace
 
-    for (Uint32 i = 0; i < NumAxes; ++i)
+template<typename Buffer>
+void BVHBuilder::ReserveBuffer(Buffer& buffer, size_t capacity)
+{
+    const size_t oldCapacity = buffer.capacity();
+    if (oldCapacity < capacity)
     {
-        mSortedLeavesIndicesCache[i].resize(numLeaves);
+        buffer.reserve(capacity);
+        mAllocatedBytes += (buffer.capacity() - oldCapacity) * sizeof(typename Buffer::value_type);
+        mNumAllocations++;
     }
 }
 
-//////////////////////////////////////////////////////////////////////////
+template<typename Buffer>
+void BVHBuilder::ResizeBuffer(Buffer& buffer, size_t size)
+{
+    ReserveBuffer(buffer, size);
+    buffer.resize(size);
+}
 
 BVHBuilder::BVHBuilder(BVH& targetBVH)
     : mLeafBoxes(nullptr)
+    , mLeafTriangles(nullptr)
     , mNumLeaves(0)
-    , mNumGeneratedNodes(0)
+    , mNumReferences(0)
+    , mNumTempNodes(0)
+    , mRootArea(0.0f)
+    , mNumGeneratedLeaves(0)
+    , mAllocatedBytes(0)
+    , mNumAllocations(0)
     , mTarget(targetBVH)
 {
 }
@@ -35,6 +92,11 @@ BVHBuilder::~BVHBuilder()
 
 }
 
+void BVHBuilder::SetLeafTriangles(const Triangle* triangles)
+{
+    mLeafTriangles = triangles;
+}
+
 bool BVHBuilder::Build(const Box* data, const Uint32 numLeaves,
                        const BuildingParams& params,
                        std::vector<Uint32>& outLeavesOrder)
@@ -42,15 +104,42 @@ bool BVHBuilder::Build(const Box* data, const Uint32 numLeaves,
     mLeafBoxes = data;
     mNumLeaves = numLeaves;
     mParams = params;
-    mTarget.AllocateNodes(2 * mNumLeaves); // TODO this is too big, reallocate at the end
 
-    mNumGeneratedNodes = 0;
+    mAllocatedBytes = 0;
+    mNumAllocations = 0;
+    mBuildStats = BuildStats();
+
+    const bool spatialSplits = mParams.splitAlgorithm == SplitAlgorithm::Spatial;
+    const bool linear = mParams.splitAlgorithm == SplitAlgorithm::Linear;
+    if (spatialSplits && mNumLeaves > 0 && !mLeafTriangles)
+    {
+        RT_LOG_ERROR("Leaf triangles must be provided to build BVH with spatial splits");
+        return false;
+    }
+
+    if (mParams.earlySplitBudget > 0.0f && mNumLeaves > 0)
+    {
+        if (!mLeafTriangles)
+        {
+            RT_LOG_ERROR("Leaf triangles must be provided to build BVH with early splits");
+            return false;
+        }
+        return BuildWithEarlySplits(outLeavesOrder);
+    }
+
+    // memory cap for duplicated references
+    const Uint32 maxDuplicatedReferences = spatialSplits ?
+        static_cast<Uint32>(std::max(0.0f, mParams.maxDuplicatedReferences) * static_cast<Float>(mNumLeaves)) : 0;
+    const Uint32 maxReferences = mNumLeaves + maxDuplicatedReferences;
+
     mNumGeneratedLeaves = 0;
+    mNumReferences = mNumLeaves;
     mLeavesOrder.clear();
-    mLeavesOrder.reserve(mNumLeaves);
+    ResizeBuffer(mLeavesOrder, maxReferences);
 
     if (mNumLeaves == 0)
     {
+        mTarget.AllocateNodes(0);
         RT_LOG_INFO("Skipped empty BVH generation");
         return true;
     }
@@ -70,196 +159,1907 @@ bool BVHBuilder::Build(const Box* data, const Uint32 numLeaves,
     WorkSet rootWorkSet;
     rootWorkSet.box = overallBox;
     rootWorkSet.numLeaves = mNumLeaves;
-    rootWorkSet.leafIndices.reserve(mNumLeaves);
-    for (Uint32 i = 0; i < mNumLeaves; ++i)
+    rootWorkSet.nodeSlot = 0;
+    rootWorkSet.descendantsSlot = 1;
+    rootWorkSet.leavesOffset = 0;
+    rootWorkSet.duplicationBudget = maxDuplicatedReferences;
+
+    if (mParams.splitAlgorithm == SplitAlgorithm::Binned || linear)
+    {
+        for (Uint32 i = 0; i < mNumLeaves; ++i)
+        {
+            mLeavesOrder[i] = i;
+        }
+    }
+    else if (mParams.splitAlgorithm == SplitAlgorithm::Sweep)
+    {
+        SortLeaves();
+    }
+
+    if (spatialSplits)
+    {
+        // each leaf starts with a single reference
+        ResizeBuffer(mReferenceBoxes, maxReferences);
+        ResizeBuffer(mReferenceLeaves, maxReferences);
+        ResizeBuffer(mReferenceIndices, maxReferences);
+        for (Uint32 i = 0; i < mNumLeaves; ++i)
+        {
+            mReferenceBoxes[i] = mLeafBoxes[i];
+            mReferenceLeaves[i] = i;
+            mReferenceIndices[i] = i;
+        }
+    }
+
+    mRootArea = overallBox.SurfaceArea();
+
+    Uint32 numThreads = mParams.numThreads;
+    if (numThreads == 0)
+    {
+        numThreads = std::thread::hardware_concurrency();
+    }
+
+    std::unique_ptr<ThreadPool> threadPool;
+    if (numThreads > 1 && mNumLeaves > mParams.minLeavesPerTask)
     {
-        rootWorkSet.leafIndices.push_back(i);
+        threadPool.reset(new ThreadPool);
+        threadPool->SetNumThreads(numThreads);
     }
 
     Timer timer;
     timer.Start();
 
+    if (linear)
     {
-        Context context(mNumLeaves);
+        SortLeaves_Morton(threadPool.get());
+    }
+
+    // a tree with N leaves (references) has at most 2*N-1 nodes
+    ResizeBuffer(mTempNodes, 2 * maxReferences - 1);
+    mNumTempNodes = 1;
 
-        BVH::Node& rootNode = mTarget.mNodes.front();
-        mNumGeneratedNodes += 2;
-        BuildNode(rootWorkSet, context, rootNode);
+    if (threadPool)
+    {
+        BuildParallel(rootWorkSet, *threadPool);
+    }
+    else
+    {
+        Context context;
+        BuildSubtree(rootWorkSet, context);
     }
 
-    RT_ASSERT(mNumGeneratedLeaves == mNumLeaves); // Number of generated leaves is invalid
-    RT_ASSERT(mNumGeneratedNodes <= 2 * mNumLeaves); // Number of generated nodes is invalid
+    RT_ASSERT(mNumGeneratedLeaves == mNumReferences); // Number of generated leaves is invalid
 
-    // shrink BVH nodes array
-    mTarget.mNumNodes = mNumGeneratedNodes;
-    mTarget.mNodes.resize(mNumGeneratedNodes);
-    mTarget.mNodes.shrink_to_fit();
+    const Uint32 numGeneratedNodes = CompactNodes();
+    RT_ASSERT(numGeneratedNodes <= 2 * mNumGeneratedLeaves); // Number of generated nodes is invalid
+
+    mTempNodes.clear();
+    mTempNodes.shrink_to_fit();
+    mReferenceBoxes.clear();
+    mReferenceBoxes.shrink_to_fit();
+    mReferenceLeaves.clear();
+    mReferenceLeaves.shrink_to_fit();
+    mReferenceIndices.clear();
+    mReferenceIndices.shrink_to_fit();
+    for (Indices& sortedLeaves : mSortedLeaves)
+    {
+        sortedLeaves.clear();
+        sortedLeaves.shrink_to_fit();
+    }
+    mPartitionScratch.clear();
+    mPartitionScratch.shrink_to_fit();
+    mLeafSides.clear();
+    mLeafSides.shrink_to_fit();
+    mMortonCodes.clear();
+    mMortonCodes.shrink_to_fit();
+
+    mBuildStats.peakMemory = mAllocatedBytes;
+    mBuildStats.numAllocations = mNumAllocations;
+
+    if (linear)
+    {
+        // node boxes are not calculated during linear build
+        std::vector<Box, AlignmentAllocator<Box>> sortedLeafBoxes(mNumLeaves);
+        for (Uint32 i = 0; i < mNumLeaves; ++i)
+        {
+            sortedLeafBoxes[i] = mLeafBoxes[mLeavesOrder[i]];
+        }
+        mTarget.Refit(sortedLeafBoxes.data(), threadPool.get());
+    }
+
+    if (mParams.optimizationPasses > 0)
+    {
+        OptimizeTreelets(threadPool.get());
+    }
+
+    const Double sahCost = mTarget.CalculateSahCost();
 
     const Float millisecondsElapsed = (Float)(1000.0 * timer.Stop());
-    RT_LOG_INFO("Finished BVH generation in %.9g ms (num nodes = %u)", millisecondsElapsed, mNumGeneratedNodes);
 
-    outLeavesOrder = mLeavesOrder;
+    RT_LOG_INFO("Finished BVH generation in %.9g ms (algorithm = %s, num nodes = %u, num references = %u, num threads = %u, SAH cost = %f, builder memory = %.1f KB in %u allocations)",
+                millisecondsElapsed,
+                GetSplitAlgorithmName(mParams.splitAlgorithm),
+                numGeneratedNodes, static_cast<Uint32>(mLeavesOrder.size()), numThreads, sahCost,
+                static_cast<Double>(mBuildStats.peakMemory) / 1024.0, mBuildStats.numAllocations);
+
+    outLeavesOrder = std::move(mLeavesOrder);
     return true;
 }
 
-void BVHBuilder::GenerateLeaf(const WorkSet& workSet, BVH::Node& targetNode)
+void BVHBuilder::SplitOversizedLeaves(std::vector<Box, AlignmentAllocator<Box>>& outBoxes, Indices& outLeaves)
 {
-    targetNode.numLeaves = workSet.numLeaves;
-    targetNode.childIndex = mNumGeneratedLeaves;
+    const Uint32 maxReferences = mNumLeaves + static_cast<Uint32>(mParams.earlySplitBudget * static_cast<Float>(mNumLeaves));
 
-    for (Uint32 i = 0; i < workSet.numLeaves; ++i)
+    outBoxes.clear();
+    ReserveBuffer(outBoxes, maxReferences);
+    outLeaves.clear();
+    ReserveBuffer(outLeaves, maxReferences);
+
+    // (box surface area, reference index) of references that can be split
+    // each split adds one candidate, so there is never more of them than references
+    using Candidate = std::pair<Float, Uint32>;
+    std::vector<Candidate> candidatesStorage;
+    ReserveBuffer(candidatesStorage, maxReferences);
+    std::priority_queue<Candidate> candidates(std::less<Candidate>(), std::move(candidatesStorage));
+
+    for (Uint32 i = 0; i < mNumLeaves; ++i)
     {
-        mLeavesOrder.push_back(workSet.leafIndices[i]);
+        outBoxes.push_back(mLeafBoxes[i]);
+        outLeaves.push_back(i);
+
+        const Triangle& triangle = mLeafTriangles[i];
+        const Float triangleArea = 0.5f * Vector4::Cross3(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0).Length3();
+        const Float boxArea = mLeafBoxes[i].SurfaceArea();
+        if (boxArea > mParams.earlySplitThreshold * triangleArea)
+        {
+            candidates.push(Candidate(boxArea, i));
+        }
     }
 
-    mNumGeneratedLeaves += workSet.numLeaves;
+    while (!candidates.empty() && outBoxes.size() < maxReferences)
+    {
+        const Float area = candidates.top().first;
+        const Uint32 referenceIndex = candidates.top().second;
+        candidates.pop();
+
+        // split in the middle of the longest axis
+        const Box box = outBoxes[referenceIndex];
+        const Vector4 size = box.max - box.min;
+        const Uint32 axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+        const Float position = 0.5f * (box.min[axis] + box.max[axis]);
+
+        Box leftBox, rightBox;
+        SplitReference(outLeaves[referenceIndex], box, axis, position, leftBox, rightBox);
+
+        if (leftBox.IsEmpty() || rightBox.IsEmpty())
+        {
+            // the triangle only touches the plane, but the box may be still tightened
+            const Box& clippedBox = leftBox.IsEmpty() ? rightBox : leftBox;
+            if (!clippedBox.IsEmpty() && clippedBox.SurfaceArea() < area)
+            {
+                outBoxes[referenceIndex] = clippedBox;
+                candidates.push(Candidate(clippedBox.SurfaceArea(), referenceIndex));
+            }
+            continue;
+        }
+
+        const Uint32 newReferenceIndex = static_cast<Uint32>(outBoxes.size());
+        outBoxes[referenceIndex] = leftBox;
+        outBoxes.push_back(rightBox);
+        outLeaves.push_back(outLeaves[referenceIndex]);
+
+        candidates.push(Candidate(leftBox.SurfaceArea(), referenceIndex));
+        candidates.push(Candidate(rightBox.SurfaceArea(), newReferenceIndex));
+    }
 }
 
-void BVHBuilder::BuildNode(const WorkSet& workSet, Context& context, BVH::Node& targetNode)
+bool BVHBuilder::BuildWithEarlySplits(Indices& outLeavesOrder)
 {
-    RT_ASSERT(workSet.numLeaves <= mNumLeaves);
-    RT_ASSERT(workSet.numLeaves > 0);
-    RT_ASSERT(workSet.depth < mNumLeaves);
-    RT_ASSERT(workSet.depth <= BVH::MaxDepth);
+    Timer timer;
+    timer.Start();
 
-    targetNode.min = workSet.box.min.ToFloat3();
-    targetNode.max = workSet.box.max.ToFloat3();
+    std::vector<Box, AlignmentAllocator<Box>> referenceBoxes;
+    Indices referenceLeaves;
+    SplitOversizedLeaves(referenceBoxes, referenceLeaves);
+    const Uint32 numReferences = static_cast<Uint32>(referenceBoxes.size());
+
+    RT_LOG_INFO("Early split of %u leaves generated %u references in %.3f ms",
+                mNumLeaves, numReferences, 1000.0 * timer.Stop());
+
+    // references are built as separate leaves
+    BuildingParams params = mParams;
+    params.earlySplitBudget = 0.0f;
 
-    if (workSet.numLeaves <= mParams.maxLeafNodeSize)
+    BVHBuilder builder(mTarget);
+
+    std::vector<Triangle, AlignmentAllocator<Triangle>> referenceTriangles;
+    if (params.splitAlgorithm == SplitAlgorithm::Spatial)
     {
-        GenerateLeaf(workSet, targetNode);
-        return;
+        ReserveBuffer(referenceTriangles, numReferences);
+        for (const Uint32 leafIndex : referenceLeaves)
+        {
+            referenceTriangles.push_back(mLeafTriangles[leafIndex]);
+        }
+        builder.SetLeafTriangles(referenceTriangles.data());
+
+        // keep the duplication cap relative to the original leaves
+        params.maxDuplicatedReferences *= static_cast<Float>(mNumLeaves) / static_cast<Float>(numReferences);
     }
 
-    Uint32 bestAxis = 0;
-    Uint32 bestSplitPos = 0;
-    Float bestCost = FLT_MAX;
-    Box bestLeftBox = Box::Empty();
-    Box bestRightBox = Box::Empty();
+    if (!builder.Build(referenceBoxes.data(), numReferences, params, outLeavesOrder))
+    {
+        return false;
+    }
 
-    SortLeaves(workSet, context);
+    mBuildStats.peakMemory = mAllocatedBytes + builder.GetBuildStats().peakMemory;
+    mBuildStats.numAllocations = mNumAllocations + builder.GetBuildStats().numAllocations;
 
-    for (Uint32 axis = 0; axis < NumAxes; ++axis)
+    for (Uint32& index : outLeavesOrder)
+    {
+        index = referenceLeaves[index];
+    }
+
+    return true;
+}
+
+bool BVHBuilder::RebuildSubtrees(const std::vector<Uint32>& subtreeRoots, const Box* leafBoxes, Uint32 numLeaves,
+                                 const BuildingParams& params, Indices& outLeavesOrder)
+{
+    const BVH::Node* nodes = mTarget.GetNodes();
+    const Uint32 numNodes = mTarget.GetNumNodes();
+
+    // nodes layout is applied by the compaction
+    mParams = params;
+
+    Timer timer;
+    timer.Start();
+
+    // The new subtrees are appended to a copy of the current nodes and their roots replace the old ones.
+    // Compaction emits only the reachable nodes, so the old subtrees are dropped.
+    mTempNodes.assign(nodes, nodes + numNodes);
+    mLeavesOrder.resize(numLeaves);
+    for (Uint32 i = 0; i < numLeaves; ++i)
+    {
+        mLeavesOrder[i] = i;
+    }
+
+    BuildingParams subtreeParams = params;
+    if (subtreeParams.splitAlgorithm == SplitAlgorithm::Spatial)
+    {
+        subtreeParams.splitAlgorithm = SplitAlgorithm::Binned;
+    }
+
+    for (const Uint32 rootIndex : subtreeRoots)
     {
-        const Indices& sortedIndices = context.mSortedLeavesIndicesCache[axis];
+        if (rootIndex >= numNodes)
+        {
+            RT_LOG_ERROR("Invalid BVH subtree root: %u", rootIndex);
+            return false;
+        }
 
-        // calculate left child node AABB for each possible split position
+        // subtree leaves are contiguous in the depth-first order
+        Uint32 firstLeaf = UINT32_MAX;
+        Uint32 numSubtreeLeaves = 0;
+        std::vector<Uint32> stack = { rootIndex };
+        while (!stack.empty())
         {
-            Box accumulatedBox = Box::Empty();
-            for (Uint32 i = 0; i < workSet.numLeaves; ++i)
+            const BVH::Node& node = nodes[stack.back()];
+            stack.pop_back();
+
+            if (node.IsLeaf())
             {
-                accumulatedBox = Box(accumulatedBox, mLeafBoxes[sortedIndices[i]]);
-                context.mLeftBoxesCache[i] = accumulatedBox;
+                firstLeaf = std::min(firstLeaf, static_cast<Uint32>(node.childIndex));
+                numSubtreeLeaves += node.numLeaves;
+            }
+            else
+            {
+                stack.push_back(node.childIndex);
+                stack.push_back(node.childIndex + 1);
             }
         }
 
-        // calculate right child node AABB for each possible split position
+        RT_ASSERT(firstLeaf + numSubtreeLeaves <= numLeaves);
+
+        BVH subtree;
+        Indices subtreeLeavesOrder;
+        BVHBuilder subtreeBuilder(subtree);
+        if (!subtreeBuilder.Build(leafBoxes + firstLeaf, numSubtreeLeaves, subtreeParams, subtreeLeavesOrder))
         {
-            Box accumulatedBox = Box::Empty();
-            for (Uint32 i = workSet.numLeaves; i-- > 0; )
-            {
-                accumulatedBox = Box(accumulatedBox, mLeafBoxes[sortedIndices[i]]);
-                context.mRightBoxesCache[i] = accumulatedBox;
-            }
+            return false;
         }
 
-        // find optimal split position (surface area heuristics)
-        for (Uint32 splitPos = 0; splitPos < workSet.numLeaves - 1; ++splitPos)
+        // leaves of the new subtree are referenced past the original leaves
+        const Uint32 nodesOffset = static_cast<Uint32>(mTempNodes.size());
+        const Uint32 leavesOffset = static_cast<Uint32>(mLeavesOrder.size());
+        for (Uint32 i = 0; i < subtree.GetNumNodes(); ++i)
         {
-            const Box& leftBox = context.mLeftBoxesCache[splitPos];
-            const Box& rightBox = context.mRightBoxesCache[splitPos + 1];
+            BVH::Node node = subtree.GetNodes()[i];
+            node.childIndex += node.IsLeaf() ? leavesOffset : nodesOffset;
+            mTempNodes.push_back(node);
+        }
+        mTempNodes[rootIndex] = mTempNodes[nodesOffset];
 
-            const Float leftArea = leftBox.SurfaceArea();
-            const Float rightArea = rightBox.SurfaceArea();
-            const Uint32 leftCount = splitPos + 1;
-            const Uint32 rightCount = workSet.numLeaves - leftCount;
+        for (const Uint32 index : subtreeLeavesOrder)
+        {
+            mLeavesOrder.push_back(firstLeaf + index);
+        }
+    }
 
-            const Float totalCost =
-                leftArea * static_cast<Float>(leftCount) +
-                rightArea * static_cast<Float>(rightCount);
+    mNumGeneratedLeaves = numLeaves;
+    const Uint32 numGeneratedNodes = CompactNodes();
 
-            if (totalCost < bestCost)
-            {
-                bestCost = totalCost;
-                bestAxis = axis;
-                bestSplitPos = splitPos;
-                bestLeftBox = leftBox;
-                bestRightBox = rightBox;
-            }
+    mTempNodes.clear();
+    mTempNodes.shrink_to_fit();
+
+    RT_LOG_INFO("Rebuilt %u BVH subtrees in %.9g ms (num nodes = %u)",
+                static_cast<Uint32>(subtreeRoots.size()), (Float)(1000.0 * timer.Stop()), numGeneratedNodes);
+
+    outLeavesOrder = std::move(mLeavesOrder);
+    return true;
+}
+
+void BVHBuilder::GenerateLeaf(const WorkSet& workSet, BVH::Node& targetNode)
+{
+    targetNode.numLeaves = workSet.numLeaves;
+
+    if (mParams.splitAlgorithm == SplitAlgorithm::Spatial)
+    {
+        // number of references in a subtree is not known up front, so the leaves are appended
+        // (they are moved to depth-first order in CompactNodes)
+        const Uint32 leavesOffset = mNumGeneratedLeaves.fetch_add(workSet.numLeaves);
+        for (Uint32 i = 0; i < workSet.numLeaves; ++i)
+        {
+            mLeavesOrder[leavesOffset + i] = mReferenceLeaves[mReferenceIndices[workSet.leavesOffset + i]];
         }
+        targetNode.childIndex = leavesOffset;
+        return;
     }
 
-    const Uint32 leftCount = bestSplitPos + 1;
-    const Uint32 rightCount = workSet.numLeaves - leftCount;
+    targetNode.childIndex = workSet.leavesOffset;
 
-    const Uint32 leftNodeIndex = mNumGeneratedNodes;
-    mNumGeneratedNodes += 2;
+    // binned algorithm keeps the leaves in the target location already
+    if (mParams.splitAlgorithm == SplitAlgorithm::Sweep)
+    {
+        const Uint32* sortedLeaves = mSortedLeaves[0].data() + workSet.leavesOffset;
+        std::copy(sortedLeaves, sortedLeaves + workSet.numLeaves, mLeavesOrder.begin() + workSet.leavesOffset);
+    }
 
-    targetNode.childIndex = leftNodeIndex;
-    targetNode.numLeaves = 0;
-    targetNode.splitAxis = bestAxis;
+    mNumGeneratedLeaves += workSet.numLeaves;
+}
+
+void BVHBuilder::SortLeaves_Morton(ThreadPool* threadPool)
+{
+    // quantize leaf centers within the centers' bounding box
+    Box centerBox = Box::Empty();
+    for (Uint32 i = 0; i < mNumLeaves; ++i)
+    {
+        const Vector4 center = mLeafBoxes[i].min + mLeafBoxes[i].max;
+        centerBox = Box(centerBox, Box(center, center));
+    }
+
+    // 30-bit codes are precise enough for small sets and need half the sorting passes
+    const Uint32 bitsPerAxis = mNumLeaves <= (1u << 16) ? 10 : 21;
+    const Uint32 maxCoord = (1u << bitsPerAxis) - 1;
+    const Float gridSize = static_cast<Float>(maxCoord);
+    const Vector4 extent = centerBox.max - centerBox.min;
+    const Vector4 scale(
+        extent.x > 0.0f ? gridSize / extent.x : 0.0f,
+        extent.y > 0.0f ? gridSize / extent.y : 0.0f,
+        extent.z > 0.0f ? gridSize / extent.z : 0.0f,
+        0.0f);
+
+    ResizeBuffer(mMortonCodes, mNumLeaves);
+
+    const auto taskCallback = [&](Uint32 taskID, Uint32)
+    {
+        const Uint32 end = std::min(mNumLeaves, (taskID + 1) * MortonCodesPerTask);
+        for (Uint32 i = taskID * MortonCodesPerTask; i < end; ++i)
+        {
+            const Vector4 center = mLeafBoxes[i].min + mLeafBoxes[i].max;
+            const Vector4 coords = (center - centerBox.min) * scale;
+            const Uint32 x = std::min(static_cast<Uint32>(coords.x), maxCoord);
+            const Uint32 y = std::min(static_cast<Uint32>(coords.y), maxCoord);
+            const Uint32 z = std::min(static_cast<Uint32>(coords.z), maxCoord);
+            mMortonCodes[i] = bitsPerAxis == 10 ? EncodeMorton30(x, y, z) : EncodeMorton63(x, y, z);
+        }
+    };
+
+    const Uint32 numTasks = (mNumLeaves + MortonCodesPerTask - 1) / MortonCodesPerTask;
+    if (threadPool && numTasks > 1)
+    {
+        threadPool->RunParallelTask(taskCallback, numTasks);
+    }
+    else
+    {
+        for (Uint32 i = 0; i < numTasks; ++i)
+        {
+            taskCallback(i, 0);
+        }
+    }
+
+    // leaves order is initialized with identity
+    RadixSort(mMortonCodes, mLeavesOrder, 3 * bitsPerAxis, threadPool);
+}
 
-    WorkSet childWorkSet;
-    childWorkSet.sortedBy = bestAxis;
-    childWorkSet.depth = workSet.depth + 1;
+bool BVHBuilder::FindSplit_Linear(const WorkSet& workSet, Split& outSplit) const
+{
+    const Uint64* codes = mMortonCodes.data() + workSet.leavesOffset;
+    const Uint32 numLeaves = workSet.numLeaves;
+    const Uint64 firstCode = codes[0];
+    const Uint64 lastCode = codes[numLeaves - 1];
 
-    const Indices& sortedIndices = context.mSortedLeavesIndicesCache[bestAxis];
-    Indices leftIndices = Indices(sortedIndices.begin(), sortedIndices.begin() + leftCount);
-    Indices rightIndices = Indices(sortedIndices.begin() + leftCount, sortedIndices.end());
+    // leaves with identical codes are split in the middle
+    outSplit.axis = 0;
+    outSplit.leftCount = numLeaves / 2;
 
-    // generate left node
+    if (firstCode != lastCode)
     {
-        BVH::Node& childNode = mTarget.mNodes[leftNodeIndex];
+        // codes share all the bits above the highest differing one, so the leaves with the bit set form a suffix
+        const Uint32 bit = HighestBitIndex(firstCode ^ lastCode);
+        const Uint64 mask = 1ull << bit;
+        const Uint64* firstRight = std::partition_point(codes, codes + numLeaves, [mask](Uint64 code)
+        {
+            return (code & mask) == 0;
+        });
 
-        childWorkSet.box = bestLeftBox;
-        childWorkSet.numLeaves = leftCount;
-        childWorkSet.leafIndices = std::move(leftIndices);
-        BuildNode(childWorkSet, context, childNode);
+        outSplit.axis = 2 - bit % 3;
+        outSplit.leftCount = static_cast<Uint32>(firstRight - codes);
     }
 
-    // generate right node
+    outSplit.rightCount = numLeaves - outSplit.leftCount;
+
+    // node boxes are calculated after the build
+    outSplit.leftBox = Box::Empty();
+    outSplit.rightBox = Box::Empty();
+
+    // ...except for small nodes, which may become leaves
+    if (numLeaves <= mParams.maxLeafNodeSize)
     {
-        BVH::Node& childNode = mTarget.mNodes[leftNodeIndex + 1];
+        const Uint32* indices = mLeavesOrder.data() + workSet.leavesOffset;
+        for (Uint32 i = 0; i < numLeaves; ++i)
+        {
+            Box& targetBox = i < outSplit.leftCount ? outSplit.leftBox : outSplit.rightBox;
+            targetBox = Box(targetBox, mLeafBoxes[indices[i]]);
+        }
 
-        childWorkSet.box = bestRightBox;
-        childWorkSet.numLeaves = rightCount;
-        childWorkSet.leafIndices = std::move(rightIndices);
-        BuildNode(childWorkSet, context, childNode);
+        const Float childrenCost =
+            outSplit.leftBox.SurfaceArea() * static_cast<Float>(outSplit.leftCount) +
+            outSplit.rightBox.SurfaceArea() * static_cast<Float>(outSplit.rightCount);
+        if (IsLeafCheaper(workSet, Box(outSplit.leftBox, outSplit.rightBox), childrenCost))
+        {
+            return false;
+        }
     }
+
+    return true;
 }
 
-void BVHBuilder::SortLeaves(const WorkSet& workSet, Context& context) const
+bool BVHBuilder::BuildTreelet_Agglomerative(const WorkSet& workSet, Context& context)
 {
-    for (Uint32 axis = 0; axis < NumAxes; ++axis)
+    const Uint32 numLeaves = workSet.numLeaves;
+
+    // buffers are sized for the biggest treelet, so they are allocated once per thread
+    const Uint32 maxLeaves = std::max(numLeaves, mParams.agglomerativeTreeletSize);
+
+    std::vector<Cluster, AlignmentAllocator<Cluster>>& clusters = context.mClusters;
+    clusters.clear();
+    ReserveBuffer(clusters, 2 * maxLeaves - 1);
+
+    // active clusters in Morton order
+    Indices& activeClusters = context.mActiveClusters;
+    ReserveBuffer(activeClusters, maxLeaves);
+    activeClusters.resize(numLeaves);
+    for (Uint32 i = 0; i < numLeaves; ++i)
+    {
+        const Uint32 leafIndex = mLeavesOrder[workSet.leavesOffset + i];
+        const Box& box = mLeafBoxes[leafIndex];
+        clusters.push_back({ box, { leafIndex, 0 }, 1, 0, mParams.intersectionCost * box.SurfaceArea(), true });
+        activeClusters[i] = i;
+    }
+
+    Indices& nearestNeighbors = context.mNearestNeighbors;
+    ReserveBuffer(nearestNeighbors, maxLeaves);
+    nearestNeighbors.resize(numLeaves);
+    Indices& nextActiveClusters = context.mNextActiveClusters;
+    ReserveBuffer(nextActiveClusters, maxLeaves);
+
+    while (activeClusters.size() > 1)
     {
-        Indices& indicesToSort = context.mSortedLeavesIndicesCache[axis];
+        const Uint32 numActive = static_cast<Uint32>(activeClusters.size());
 
-        if (workSet.sortedBy != axis) // sort only what needs to be sorted
+        // nearest neighbor is the one making the smallest merged box (ties are resolved to the lower index,
+        // so the closest pair is always mutual and each iteration merges at least one pair)
+        for (Uint32 i = 0; i < numActive; ++i)
         {
-            indicesToSort = workSet.leafIndices;
+            const Box& box = clusters[activeClusters[i]].box;
+            const Uint32 first = i > AgglomerativeSearchRadius ? i - AgglomerativeSearchRadius : 0;
+            const Uint32 last = std::min(numActive - 1, i + AgglomerativeSearchRadius);
+
+            Float bestArea = FLT_MAX;
+            for (Uint32 j = first; j <= last; ++j)
+            {
+                const Float area = Box(box, clusters[activeClusters[j]].box).SurfaceArea();
+                if (j != i && area < bestArea)
+                {
+                    bestArea = area;
+                    nearestNeighbors[i] = j;
+                }
+            }
+        }
 
-            const auto comparator = [this, axis](const Uint32 a, const Uint32 b)
+        // merge mutual nearest neighbors, the new cluster takes place of the first one
+        nextActiveClusters.clear();
+        for (Uint32 i = 0; i < numActive; ++i)
+        {
+            const Uint32 neighbor = nearestNeighbors[i];
+            if (nearestNeighbors[neighbor] != i)
             {
-                RT_ASSERT(a < mNumLeaves);
-                RT_ASSERT(b < mNumLeaves);
+                nextActiveClusters.push_back(activeClusters[i]);
+            }
+            else if (i < neighbor)
+            {
+                const Cluster& left = clusters[activeClusters[i]];
+                const Cluster& right = clusters[activeClusters[neighbor]];
 
-                const Box& leafA = mLeafBoxes[a];
-                const Box& leafB = mLeafBoxes[b];
+                Cluster merged;
+                merged.box = Box(left.box, right.box);
+                merged.children[0] = activeClusters[i];
+                merged.children[1] = activeClusters[neighbor];
+                merged.numLeaves = left.numLeaves + right.numLeaves;
+                merged.depth = std::max(left.depth, right.depth) + 1;
 
-                // TODO use precalculated triangle center (experiment)
-                const Vector4 centerA = leafA.max + leafA.min;
-                const Vector4 centerB = leafB.max + leafB.min;
-                return centerA[axis] < centerB[axis];
-            };
+                // collapse the cluster into a leaf if it's cheaper
+                const Float area = merged.box.SurfaceArea();
+                const Float leafCost = mParams.intersectionCost * area * static_cast<Float>(merged.numLeaves);
+                const Float innerCost = mParams.traversalCost * area + left.cost + right.cost;
+                merged.isLeaf = merged.numLeaves <= mParams.maxLeafNodeSize && leafCost <= innerCost;
+                merged.cost = merged.isLeaf ? leafCost : innerCost;
+
+                nextActiveClusters.push_back(static_cast<Uint32>(clusters.size()));
+                clusters.push_back(merged);
+            }
+        }
+
+        activeClusters.swap(nextActiveClusters);
+    }
 
-            std::sort(indicesToSort.begin(), indicesToSort.end(), comparator);
+    const Uint32 rootCluster = activeClusters.front();
+    if (workSet.depth + clusters[rootCluster].depth > BVH::MaxDepth)
+    {
+        return false;
+    }
+
+    // write the clusters hierarchy using the same slots assignment as BuildNode
+    std::vector<ClusterStackFrame>& stack = context.mClusterStack;
+    stack.clear();
+    ReserveBuffer(stack, maxLeaves);
+    stack.push_back({ rootCluster, workSet.nodeSlot, workSet.descendantsSlot, workSet.leavesOffset });
+
+    Indices& pending = context.mPendingClusters;
+    ReserveBuffer(pending, maxLeaves);
+
+    while (!stack.empty())
+    {
+        const ClusterStackFrame frame = stack.back();
+        stack.pop_back();
+
+        const Cluster& cluster = clusters[frame.cluster];
+        BVH::Node& targetNode = mTempNodes[frame.nodeSlot];
+        targetNode.min = cluster.box.min.ToFloat3();
+        targetNode.max = cluster.box.max.ToFloat3();
+
+        if (cluster.isLeaf)
+        {
+            // gather leaves of the cluster's subtree
+            Uint32 numSubtreeLeaves = 0;
+            pending.clear();
+            pending.push_back(frame.cluster);
+            while (!pending.empty())
+            {
+                const Cluster& current = clusters[pending.back()];
+                pending.pop_back();
+
+                if (current.numLeaves == 1)
+                {
+                    mLeavesOrder[frame.leavesOffset + numSubtreeLeaves++] = current.children[0];
+                }
+                else
+                {
+                    pending.push_back(current.children[1]);
+                    pending.push_back(current.children[0]);
+                }
+            }
+
+            targetNode.childIndex = frame.leavesOffset;
+            targetNode.numLeaves = cluster.numLeaves;
+            mNumGeneratedLeaves += cluster.numLeaves;
+            continue;
         }
+
+        const Cluster& left = clusters[cluster.children[0]];
+        const Cluster& right = clusters[cluster.children[1]];
+
+        targetNode.childIndex = frame.descendantsSlot;
+        targetNode.numLeaves = 0;
+        targetNode.splitAxis = CalculateSplitAxis(left.box, right.box);
+
+        stack.push_back({ cluster.children[1], frame.descendantsSlot + 1, frame.descendantsSlot + 2 * left.numLeaves, frame.leavesOffset + left.numLeaves });
+        stack.push_back({ cluster.children[0], frame.descendantsSlot, frame.descendantsSlot + 2, frame.leavesOffset });
     }
 
-    if (workSet.sortedBy < NumAxes)
+    return true;
+}
+
+bool BVHBuilder::FindSplit_Sweep(const WorkSet& workSet, Context& context, Split& outSplit)
+{
+    const Uint32 numLeaves = workSet.numLeaves;
+
+    Uint32 bestSplitPos = 0;
+    Float bestCost = FLT_MAX;
+
+    if (context.mRightAreasCache.size() < numLeaves)
     {
-        context.mSortedLeavesIndicesCache[workSet.sortedBy] = std::move(workSet.leafIndices);
+        ResizeBuffer(context.mRightAreasCache, numLeaves);
     }
+
+    outSplit.axis = 0;
+
+    for (Uint32 axis = 0; axis < NumAxes; ++axis)
+    {
+        const Uint32* sortedIndices = mSortedLeaves[axis].data() + workSet.leavesOffset;
+
+        // calculate right child node area for each possible split position
+        {
+            Box accumulatedBox = Box::Empty();
+            for (Uint32 i = numLeaves; i-- > 1; )
+            {
+                accumulatedBox = Box(accumulatedBox, mLeafBoxes[sortedIndices[i]]);
+                context.mRightAreasCache[i] = accumulatedBox.SurfaceArea();
+            }
+        }
+
+        // find optimal split position (surface area heuristics), left child node box is accumulated on the fly
+        Box leftBox = Box::Empty();
+        for (Uint32 splitPos = 0; splitPos < numLeaves - 1; ++splitPos)
+        {
+            leftBox = Box(leftBox, mLeafBoxes[sortedIndices[splitPos]]);
+
+            const Float leftArea = leftBox.SurfaceArea();
+            const Float rightArea = context.mRightAreasCache[splitPos + 1];
+            const Uint32 leftCount = splitPos + 1;
+            const Uint32 rightCount = numLeaves - leftCount;
+
+            const Float totalCost =
+                leftArea * static_cast<Float>(leftCount) +
+                rightArea * static_cast<Float>(rightCount);
+
+            if (totalCost < bestCost)
+            {
+                bestCost = totalCost;
+                bestSplitPos = splitPos;
+                outSplit.axis = axis;
+                outSplit.leftBox = leftBox;
+            }
+        }
+    }
+
+    if (IsLeafCheaper(workSet, workSet.box, bestCost))
+    {
+        return false;
+    }
+
+    outSplit.leftCount = bestSplitPos + 1;
+    outSplit.rightCount = numLeaves - outSplit.leftCount;
+
+    // only areas are cached, so the right box is calculated for the best split only
+    const Uint32* sortedIndices = mSortedLeaves[outSplit.axis].data() + workSet.leavesOffset;
+    outSplit.rightBox = Box::Empty();
+    for (Uint32 i = outSplit.leftCount; i < numLeaves; ++i)
+    {
+        outSplit.rightBox = Box(outSplit.rightBox, mLeafBoxes[sortedIndices[i]]);
+    }
+
+    PartitionSortedLeaves(workSet, outSplit);
+    return true;
+}
+
+void BVHBuilder::PartitionSortedLeaves(const WorkSet& workSet, const Split& split)
+{
+    const Uint32* splitAxisIndices = mSortedLeaves[split.axis].data() + workSet.leavesOffset;
+    for (Uint32 i = 0; i < workSet.numLeaves; ++i)
+    {
+        mLeafSides[splitAxisIndices[i]] = i < split.leftCount ? 1 : 0;
+    }
+
+    // work sets cover disjoint ranges of the arrays, so they can be partitioned concurrently
+    Uint32* rightIndices = mPartitionScratch.data() + workSet.leavesOffset;
+    for (Uint32 axis = 0; axis < NumAxes; ++axis)
+    {
+        if (axis == split.axis)
+        {
+            continue;
+        }
+
+        Uint32* indices = mSortedLeaves[axis].data() + workSet.leavesOffset;
+        Uint32 numLeft = 0;
+        Uint32 numRight = 0;
+        for (Uint32 i = 0; i < workSet.numLeaves; ++i)
+        {
+            const Uint32 leafIndex = indices[i];
+            if (mLeafSides[leafIndex])
+            {
+                indices[numLeft++] = leafIndex;
+            }
+            else
+            {
+                rightIndices[numRight++] = leafIndex;
+            }
+        }
+
+        RT_ASSERT(numLeft == split.leftCount);
+        std::copy(rightIndices, rightIndices + numRight, indices + numLeft);
+    }
+}
+
+bool BVHBuilder::FindObjectSplit_Binned(const Uint32* indices, Uint32 numIndices, const Box* boxes, BinnedSplit& outSplit) const
+{
+    struct Bin
+    {
+        Box box;
+        Uint32 count;
+    };
+
+    const Uint32 numBins = std::min(std::max(mParams.numBins, 2u), MaxNumBins);
+
+    // calculate bounds of leaf centers (doubled, to avoid multiplication)
+    Box centerBox = Box::Empty();
+    for (Uint32 i = 0; i < numIndices; ++i)
+    {
+        const Box& leafBox = boxes[indices[i]];
+        centerBox.AddPoint(leafBox.min + leafBox.max);
+    }
+
+    // scale factor mapping a center to the bin index
+    Float binScale[NumAxes];
+    for (Uint32 axis = 0; axis < NumAxes; ++axis)
+    {
+        const Float extent = centerBox.max[axis] - centerBox.min[axis];
+        binScale[axis] = extent > 0.0f ? (static_cast<Float>(numBins) * 0.99999f / extent) : 0.0f;
+    }
+
+    const auto calculateBinIndex = [&](const Box& leafBox, Uint32 axis) -> Uint32
+    {
+        const Float center = leafBox.min[axis] + leafBox.max[axis];
+        const Uint32 binIndex = static_cast<Uint32>((center - centerBox.min[axis]) * binScale[axis]);
+        return std::min(binIndex, numBins - 1);
+    };
+
+    // distribute leaves into bins
+    Bin bins[NumAxes][MaxNumBins];
+    for (Uint32 axis = 0; axis < NumAxes; ++axis)
+    {
+        for (Uint32 i = 0; i < numBins; ++i)
+        {
+            bins[axis][i].box = Box::Empty();
+            bins[axis][i].count = 0;
+        }
+    }
+
+    for (Uint32 i = 0; i < numIndices; ++i)
+    {
+        const Box& leafBox = boxes[indices[i]];
+        for (Uint32 axis = 0; axis < NumAxes; ++axis)
+        {
+            Bin& bin = bins[axis][calculateBinIndex(leafBox, axis)];
+            bin.box = Box(bin.box, leafBox);
+            bin.count++;
+        }
+    }
+
+    // find optimal split position (surface area heuristics)
+    outSplit.cost = FLT_MAX;
+
+    for (Uint32 axis = 0; axis < NumAxes; ++axis)
+    {
+        if (binScale[axis] == 0.0f)
+        {
+            continue;
+        }
+
+        // accumulate right side boxes (split after bin i-1)
+        Box rightBoxes[MaxNumBins];
+        Uint32 rightCounts[MaxNumBins];
+        {
+            Box accumulatedBox = Box::Empty();
+            Uint32 accumulatedCount = 0;
+            for (Uint32 i = numBins; i-- > 1; )
+            {
+                accumulatedBox = Box(accumulatedBox, bins[axis][i].box);
+                accumulatedCount += bins[axis][i].count;
+                rightBoxes[i] = accumulatedBox;
+                rightCounts[i] = accumulatedCount;
+            }
+        }
+
+        Box leftBox = Box::Empty();
+        Uint32 leftCount = 0;
+        for (Uint32 i = 0; i < numBins - 1; ++i)
+        {
+            leftBox = Box(leftBox, bins[axis][i].box);
+            leftCount += bins[axis][i].count;
+
+            const Uint32 rightCount = rightCounts[i + 1];
+            if (leftCount == 0 || rightCount == 0)
+            {
+                continue;
+            }
+
+            const Float totalCost =
+                leftBox.SurfaceArea() * static_cast<Float>(leftCount) +
+                rightBoxes[i + 1].SurfaceArea() * static_cast<Float>(rightCount);
+
+            if (totalCost < outSplit.cost)
+            {
+                outSplit.cost = totalCost;
+                outSplit.lastLeftBin = i;
+                outSplit.axis = axis;
+                outSplit.leftCount = leftCount;
+                outSplit.rightCount = rightCount;
+                outSplit.leftBox = leftBox;
+                outSplit.rightBox = rightBoxes[i + 1];
+            }
+        }
+    }
+
+    if (outSplit.cost == FLT_MAX)
+    {
+        return false;
+    }
+
+    outSplit.centerBox = centerBox;
+    outSplit.binScale = binScale[outSplit.axis];
+    outSplit.numBins = numBins;
+    return true;
+}
+
+bool BVHBuilder::FindSplit_Binned(const WorkSet& workSet, Split& outSplit)
+{
+    Uint32* indices = mLeavesOrder.data() + workSet.leavesOffset;
+
+    BinnedSplit split;
+    const bool splitFound = FindObjectSplit_Binned(indices, workSet.numLeaves, mLeafBoxes, split);
+
+    // objects that can't be separated are put into a leaf if possible
+    if (IsLeafCheaper(workSet, workSet.box, splitFound ? split.cost : FLT_MAX))
+    {
+        return false;
+    }
+
+    if (splitFound)
+    {
+        // partition leaves in-place
+        Uint32* middle = std::partition(indices, indices + workSet.numLeaves, [&](const Uint32 leafIndex)
+        {
+            return split.IsOnLeftSide(mLeafBoxes[leafIndex]);
+        });
+
+        RT_UNUSED(middle);
+        RT_ASSERT(static_cast<Uint32>(middle - indices) == split.leftCount);
+        outSplit = split;
+        return true;
+    }
+
+    // all the leaf centers fall into a single bin - split in the middle
+    outSplit.axis = 0;
+    outSplit.leftCount = workSet.numLeaves / 2;
+    outSplit.rightCount = workSet.numLeaves - outSplit.leftCount;
+    outSplit.leftBox = Box::Empty();
+    outSplit.rightBox = Box::Empty();
+    for (Uint32 i = 0; i < workSet.numLeaves; ++i)
+    {
+        Box& targetBox = i < outSplit.leftCount ? outSplit.leftBox : outSplit.rightBox;
+        targetBox = Box(targetBox, mLeafBoxes[indices[i]]);
+    }
+    return true;
+}
+
+void BVHBuilder::SplitReference(Uint32 leafIndex, const Box& box, Uint32 axis, Float position,
+                                Box& outLeftBox, Box& outRightBox) const
+{
+    const Triangle& triangle = mLeafTriangles[leafIndex];
+    const Vector4 vertices[3] = { triangle.v0, triangle.v1, triangle.v2 };
+
+    outLeftBox = Box::Empty();
+    outRightBox = Box::Empty();
+
+    for (Uint32 i = 0; i < 3; ++i)
+    {
+        const Vector4& v = vertices[i];
+        const Vector4& w = vertices[(i + 1) % 3];
+        const Float vPos = v[axis];
+        const Float wPos = w[axis];
+
+        if (vPos <= position)
+        {
+            outLeftBox.AddPoint(v);
+        }
+        if (vPos >= position)
+        {
+            outRightBox.AddPoint(v);
+        }
+
+        // edge crosses the plane
+        if ((vPos < position && wPos > position) || (vPos > position && wPos < position))
+        {
+            const Float t = (position - vPos) / (wPos - vPos);
+            const Vector4 point = Vector4::MulAndAdd(w - v, t, v);
+            outLeftBox.AddPoint(point);
+            outRightBox.AddPoint(point);
+        }
+    }
+
+    // the reference may be already clipped by previous splits
+    outLeftBox.max.f[axis] = std::min(outLeftBox.max[axis], position);
+    outRightBox.min.f[axis] = std::max(outRightBox.min[axis], position);
+    outLeftBox = Box::Intersection(outLeftBox, box);
+    outRightBox = Box::Intersection(outRightBox, box);
+}
+
+bool BVHBuilder::FindSpatialSplit(const WorkSet& workSet, SpatialSplit& outSplit) const
+{
+    struct Bin
+    {
+        Box box;
+        Uint32 numEntries; // number of references starting in the bin
+        Uint32 numExits;   // number of references ending in the bin
+    };
+
+    const Uint32 numBins = std::min(std::max(mParams.numBins, 2u), MaxNumBins);
+
+    outSplit.cost = FLT_MAX;
+
+    for (Uint32 axis = 0; axis < NumAxes; ++axis)
+    {
+        const Float extent = workSet.box.max[axis] - workSet.box.min[axis];
+        if (extent <= 0.0f)
+        {
+            continue;
+        }
+
+        SpatialSplit split;
+        split.axis = axis;
+        split.numBins = numBins;
+        split.binsOrigin = workSet.box.min[axis];
+        split.binSize = extent / static_cast<Float>(numBins);
+        split.invBinSize = static_cast<Float>(numBins) / extent;
+
+        Bin bins[MaxNumBins];
+        for (Uint32 i = 0; i < numBins; ++i)
+        {
+            bins[i].box = Box::Empty();
+            bins[i].numEntries = 0;
+            bins[i].numExits = 0;
+        }
+
+        // chop references into the bins they overlap
+        const Uint32* indices = mReferenceIndices.data() + workSet.leavesOffset;
+        for (Uint32 j = 0; j < workSet.numLeaves; ++j)
+        {
+            const Uint32 referenceIndex = indices[j];
+            const Box& referenceBox = mReferenceBoxes[referenceIndex];
+            const Uint32 firstBin = split.GetBinIndex(referenceBox.min[axis]);
+            const Uint32 lastBin = split.GetBinIndex(referenceBox.max[axis]);
+
+            Box remainingBox = referenceBox;
+            for (Uint32 i = firstBin; i < lastBin; ++i)
+            {
+                Box leftBox, rightBox;
+                const Float position = split.binsOrigin + split.binSize * static_cast<Float>(i + 1);
+                SplitReference(mReferenceLeaves[referenceIndex], remainingBox, axis, position, leftBox, rightBox);
+
+                bins[i].box = Box(bins[i].box, leftBox);
+                remainingBox = rightBox;
+            }
+
+            bins[lastBin].box = Box(bins[lastBin].box, remainingBox);
+            bins[firstBin].numEntries++;
+            bins[lastBin].numExits++;
+        }
+
+        // accumulate right side boxes (split after bin i-1)
+        Box rightBoxes[MaxNumBins];
+        Uint32 rightCounts[MaxNumBins];
+        {
+            Box accumulatedBox = Box::Empty();
+            Uint32 accumulatedCount = 0;
+            for (Uint32 i = numBins; i-- > 1; )
+            {
+                accumulatedBox = Box(accumulatedBox, bins[i].box);
+                accumulatedCount += bins[i].numExits;
+                rightBoxes[i] = accumulatedBox;
+                rightCounts[i] = accumulatedCount;
+            }
+        }
+
+        Box leftBox = Box::Empty();
+        Uint32 leftCount = 0;
+        for (Uint32 i = 0; i < numBins - 1; ++i)
+        {
+            leftBox = Box(leftBox, bins[i].box);
+            leftCount += bins[i].numEntries;
+
+            const Uint32 rightCount = rightCounts[i + 1];
+            if (leftCount == 0 || rightCount == 0)
+            {
+                continue;
+            }
+
+            // respect the memory cap
+            const Uint32 numDuplicates = leftCount + rightCount - workSet.numLeaves;
+            if (numDuplicates > workSet.duplicationBudget)
+            {
+                continue;
+            }
+
+            const Float totalCost =
+                leftBox.SurfaceArea() * static_cast<Float>(leftCount) +
+                rightBoxes[i + 1].SurfaceArea() * static_cast<Float>(rightCount);
+
+            if (totalCost < outSplit.cost)
+            {
+                outSplit = split;
+                outSplit.lastLeftBin = i;
+                outSplit.cost = totalCost;
+            }
+        }
+    }
+
+    return outSplit.cost < FLT_MAX;
+}
+
+bool BVHBuilder::FindSplit_Spatial(const WorkSet& workSet, Context& context, Split& outSplit)
+{
+    Uint32* indices = mReferenceIndices.data() + workSet.leavesOffset;
+    const Uint32 numReferences = workSet.numLeaves;
+
+    // duplicates never exceed the work set's budget
+    Indices& rightIndices = context.mRightReferencesCache;
+    if (rightIndices.size() < numReferences + workSet.duplicationBudget)
+    {
+        ResizeBuffer(rightIndices, numReferences + workSet.duplicationBudget);
+    }
+
+    BinnedSplit objectSplit;
+    const bool objectSplitFound = FindObjectSplit_Binned(indices, numReferences, mReferenceBoxes.data(), objectSplit);
+
+    // spatial split is worth trying only when children of the object split overlap significantly
+    bool trySpatialSplit = !objectSplitFound;
+    if (objectSplitFound)
+    {
+        const Box overlap = Box::Intersection(objectSplit.leftBox, objectSplit.rightBox);
+        trySpatialSplit = !overlap.IsEmpty() && overlap.SurfaceArea() > mParams.spatialSplitOverlapThreshold * mRootArea;
+    }
+
+    // left references are compacted in-place (never past the one being read)
+    Uint32 numLeft = 0;
+    Uint32 numRight = 0;
+
+    SpatialSplit spatialSplit;
+    bool useSpatialSplit = false;
+    if (trySpatialSplit && FindSpatialSplit(workSet, spatialSplit) &&
+        (!objectSplitFound || spatialSplit.cost < objectSplit.cost))
+    {
+        const Uint32 axis = spatialSplit.axis;
+        const Float position = spatialSplit.GetPlanePosition();
+
+        // straddling references are clipped into the cache first, because clipping can make all the references
+        // end up on one side - the reference boxes must stay untouched for the object split fallback then
+        auto& clippedBoxes = context.mClippedBoxesCache;
+        if (clippedBoxes.size() < 2 * numReferences)
+        {
+            ResizeBuffer(clippedBoxes, 2 * numReferences);
+        }
+
+        for (Uint32 i = 0; i < numReferences; ++i)
+        {
+            const Box& referenceBox = mReferenceBoxes[indices[i]];
+            const Uint32 firstBin = spatialSplit.GetBinIndex(referenceBox.min[axis]);
+            const Uint32 lastBin = spatialSplit.GetBinIndex(referenceBox.max[axis]);
+
+            if (lastBin <= spatialSplit.lastLeftBin)
+            {
+                numLeft++;
+            }
+            else if (firstBin > spatialSplit.lastLeftBin)
+            {
+                numRight++;
+            }
+            else
+            {
+                Box& leftBox = clippedBoxes[2 * i];
+                Box& rightBox = clippedBoxes[2 * i + 1];
+                SplitReference(mReferenceLeaves[indices[i]], referenceBox, axis, position, leftBox, rightBox);
+
+                if (!leftBox.IsEmpty())
+                {
+                    numLeft++;
+                }
+                if (leftBox.IsEmpty() || !rightBox.IsEmpty())
+                {
+                    numRight++;
+                }
+            }
+        }
+
+        useSpatialSplit = numLeft > 0 && numRight > 0;
+        numLeft = 0;
+        numRight = 0;
+    }
+
+    // objects that can't be separated are put into a leaf if possible
+    const Float childrenCost = useSpatialSplit ? spatialSplit.cost : (objectSplitFound ? objectSplit.cost : FLT_MAX);
+    if (IsLeafCheaper(workSet, workSet.box, childrenCost))
+    {
+        return false;
+    }
+
+    if (useSpatialSplit)
+    {
+        const Uint32 axis = spatialSplit.axis;
+        const auto& clippedBoxes = context.mClippedBoxesCache;
+
+        outSplit.axis = axis;
+        outSplit.leftBox = Box::Empty();
+        outSplit.rightBox = Box::Empty();
+
+        const auto addToLeft = [&](Uint32 referenceIndex)
+        {
+            indices[numLeft++] = referenceIndex;
+            outSplit.leftBox = Box(outSplit.leftBox, mReferenceBoxes[referenceIndex]);
+        };
+
+        const auto addToRight = [&](Uint32 referenceIndex)
+        {
+            rightIndices[numRight++] = referenceIndex;
+            outSplit.rightBox = Box(outSplit.rightBox, mReferenceBoxes[referenceIndex]);
+        };
+
+        for (Uint32 i = 0; i < numReferences; ++i)
+        {
+            const Uint32 referenceIndex = indices[i];
+            const Box referenceBox = mReferenceBoxes[referenceIndex];
+            const Uint32 firstBin = spatialSplit.GetBinIndex(referenceBox.min[axis]);
+            const Uint32 lastBin = spatialSplit.GetBinIndex(referenceBox.max[axis]);
+
+            if (lastBin <= spatialSplit.lastLeftBin)
+            {
+                addToLeft(referenceIndex);
+            }
+            else if (firstBin > spatialSplit.lastLeftBin)
+            {
+                addToRight(referenceIndex);
+            }
+            else
+            {
+                // reference straddles the plane - duplicate it
+                const Uint32 leafIndex = mReferenceLeaves[referenceIndex];
+                const Box& leftBox = clippedBoxes[2 * i];
+                const Box& rightBox = clippedBoxes[2 * i + 1];
+
+                if (leftBox.IsEmpty())
+                {
+                    mReferenceBoxes[referenceIndex] = rightBox;
+                    addToRight(referenceIndex);
+                }
+                else if (rightBox.IsEmpty())
+                {
+                    mReferenceBoxes[referenceIndex] = leftBox;
+                    addToLeft(referenceIndex);
+                }
+                else
+                {
+                    const Uint32 newReferenceIndex = mNumReferences++;
+                    RT_ASSERT(newReferenceIndex < mReferenceBoxes.size()); // Duplication budget exceeded
+
+                    mReferenceBoxes[referenceIndex] = leftBox;
+                    mReferenceBoxes[newReferenceIndex] = rightBox;
+                    mReferenceLeaves[newReferenceIndex] = leafIndex;
+                    addToLeft(referenceIndex);
+                    addToRight(newReferenceIndex);
+                }
+            }
+        }
+
+        RT_ASSERT(numLeft > 0 && numRight > 0);
+        outSplit.leftCount = numLeft;
+        outSplit.rightCount = numRight;
+        return true;
+    }
+
+    if (objectSplitFound)
+    {
+        for (Uint32 i = 0; i < numReferences; ++i)
+        {
+            const Uint32 referenceIndex = indices[i];
+            if (objectSplit.IsOnLeftSide(mReferenceBoxes[referenceIndex]))
+            {
+                indices[numLeft++] = referenceIndex;
+            }
+            else
+            {
+                rightIndices[numRight++] = referenceIndex;
+            }
+        }
+
+        RT_ASSERT(numLeft == objectSplit.leftCount);
+        outSplit = objectSplit;
+        return true;
+    }
+
+    // all the reference centers fall into a single bin - split in the middle
+    outSplit.axis = 0;
+    outSplit.leftCount = numReferences / 2;
+    outSplit.rightCount = numReferences - outSplit.leftCount;
+    outSplit.leftBox = Box::Empty();
+    outSplit.rightBox = Box::Empty();
+    for (Uint32 i = 0; i < numReferences; ++i)
+    {
+        const bool left = i < outSplit.leftCount;
+        Box& targetBox = left ? outSplit.leftBox : outSplit.rightBox;
+        targetBox = Box(targetBox, mReferenceBoxes[indices[i]]);
+        if (!left)
+        {
+            rightIndices[numRight++] = indices[i];
+        }
+    }
+    return true;
+}
+
+bool BVHBuilder::IsLeafCheaper(const WorkSet& workSet, const Box& nodeBox, Float childrenCost) const
+{
+    if (workSet.numLeaves > mParams.maxLeafNodeSize)
+    {
+        return false;
+    }
+
+    const Float nodeArea = nodeBox.SurfaceArea();
+    const Float leafCost = mParams.intersectionCost * nodeArea * static_cast<Float>(workSet.numLeaves);
+    const Float splitCost = mParams.traversalCost * nodeArea + mParams.intersectionCost * childrenCost;
+    return leafCost <= splitCost;
+}
+
+bool BVHBuilder::BuildNode(const WorkSet& workSet, Context& context, WorkSet& outLeft, WorkSet& outRight)
+{
+    RT_ASSERT(workSet.numLeaves <= mLeavesOrder.size());
+    RT_ASSERT(workSet.numLeaves > 0);
+    RT_ASSERT(workSet.depth < mLeavesOrder.size());
+    RT_ASSERT(workSet.depth <= BVH::MaxDepth);
+
+    BVH::Node& targetNode = mTempNodes[workSet.nodeSlot];
+    targetNode.min = workSet.box.min.ToFloat3();
+    targetNode.max = workSet.box.max.ToFloat3();
+
+    if (workSet.numLeaves == 1)
+    {
+        GenerateLeaf(workSet, targetNode);
+        return false;
+    }
+
+    if (mParams.splitAlgorithm == SplitAlgorithm::Linear && workSet.numLeaves <= mParams.agglomerativeTreeletSize)
+    {
+        if (BuildTreelet_Agglomerative(workSet, context))
+        {
+            return false;
+        }
+    }
+
+    // the best split is compared with a leaf before the work set's leaves are partitioned
+    Split split;
+    bool splitFound = false;
+    if (mParams.splitAlgorithm == SplitAlgorithm::Sweep)
+    {
+        splitFound = FindSplit_Sweep(workSet, context, split);
+    }
+    else if (mParams.splitAlgorithm == SplitAlgorithm::Binned)
+    {
+        splitFound = FindSplit_Binned(workSet, split);
+    }
+    else if (mParams.splitAlgorithm == SplitAlgorithm::Linear)
+    {
+        splitFound = FindSplit_Linear(workSet, split);
+    }
+    else
+    {
+        splitFound = FindSplit_Spatial(workSet, context, split);
+    }
+
+    if (!splitFound)
+    {
+        GenerateLeaf(workSet, targetNode);
+        return false;
+    }
+
+    RT_ASSERT(split.leftCount > 0 && split.rightCount > 0);
+    RT_ASSERT(split.leftCount + split.rightCount >= workSet.numLeaves);
+    const Uint32 leftCount = split.leftCount;
+    const Uint32 rightCount = split.rightCount;
+
+    // with spatial splits the subtree size is not known up front, so the children slots are allocated dynamically
+    const Uint32 descendantsSlot = mParams.splitAlgorithm == SplitAlgorithm::Spatial ?
+        mNumTempNodes.fetch_add(2) : workSet.descendantsSlot;
+
+    // Note: child index refers to the temporary nodes array here, it's remapped in CompactNodes()
+    targetNode.childIndex = descendantsSlot;
+    targetNode.numLeaves = 0;
+    targetNode.splitAxis = split.axis;
+
+    outLeft.box = split.leftBox;
+    outLeft.numLeaves = leftCount;
+    outLeft.depth = workSet.depth + 1;
+    outLeft.nodeSlot = descendantsSlot;
+    outLeft.descendantsSlot = descendantsSlot + 2;
+    outLeft.leavesOffset = workSet.leavesOffset;
+
+    outRight.box = split.rightBox;
+    outRight.numLeaves = rightCount;
+    outRight.depth = workSet.depth + 1;
+    outRight.nodeSlot = descendantsSlot + 1;
+    outRight.descendantsSlot = descendantsSlot + 2 * leftCount; // left subtree takes up to 2*leftCount-2 slots
+    outRight.leavesOffset = workSet.leavesOffset + leftCount;
+
+    if (mParams.splitAlgorithm == SplitAlgorithm::Spatial)
+    {
+        // split the remaining budget proportionally to the children sizes
+        const Uint32 numDuplicates = leftCount + rightCount - workSet.numLeaves;
+        RT_ASSERT(numDuplicates <= workSet.duplicationBudget);
+        const Uint32 remainingBudget = workSet.duplicationBudget - numDuplicates;
+        outLeft.duplicationBudget = static_cast<Uint32>(static_cast<Uint64>(remainingBudget) * leftCount / (leftCount + rightCount));
+        outRight.duplicationBudget = remainingBudget - outLeft.duplicationBudget;
+
+        // the right child's references are placed after space for the left child's duplicates
+        outRight.leavesOffset = outLeft.leavesOffset + leftCount + outLeft.duplicationBudget;
+        const Uint32* rightIndices = context.mRightReferencesCache.data();
+        std::copy(rightIndices, rightIndices + rightCount, mReferenceIndices.begin() + outRight.leavesOffset);
+    }
+
+    return true;
+}
+
+void BVHBuilder::BuildSubtree(WorkSet& workSet, Context& context)
+{
+    WorkSet leftWorkSet, rightWorkSet;
+    if (BuildNode(workSet, context, leftWorkSet, rightWorkSet))
+    {
+        BuildSubtree(leftWorkSet, context);
+        BuildSubtree(rightWorkSet, context);
+    }
+}
+
+void BVHBuilder::BuildParallel(WorkSet& rootWorkSet, ThreadPool& threadPool)
+{
+    std::mutex mutex;
+    std::condition_variable newWorkCV;
+    std::vector<WorkSet> pendingWorkSets;
+    Uint32 numUnfinishedWorkSets = 1;
+
+    pendingWorkSets.push_back(std::move(rootWorkSet));
+
+    const auto workerCallback = [&](Uint32, Uint32)
+    {
+        Context context;
+
+        for (;;)
+        {
+            WorkSet workSet;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (pendingWorkSets.empty() && numUnfinishedWorkSets > 0)
+                {
+                    newWorkCV.wait(lock);
+                }
+
+                if (pendingWorkSets.empty())
+                {
+                    // everything has been built
+                    break;
+                }
+
+                workSet = std::move(pendingWorkSets.back());
+                pendingWorkSets.pop_back();
+            }
+
+            WorkSet children[2];
+
+            if (BuildNode(workSet, context, children[0], children[1]))
+            {
+                for (WorkSet& child : children)
+                {
+                    if (child.numLeaves >= mParams.minLeavesPerTask)
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        pendingWorkSets.push_back(std::move(child));
+                        numUnfinishedWorkSets++;
+                        newWorkCV.notify_one();
+                    }
+                    else
+                    {
+                        BuildSubtree(child, context);
+                    }
+                }
+            }
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (--numUnfinishedWorkSets == 0)
+                {
+                    newWorkCV.notify_all();
+                }
+            }
+        }
+    };
+
+    threadPool.RunParallelTask(workerCallback, threadPool.GetNumThreads());
+}
+
+void BVHBuilder::OptimizeTreelets(ThreadPool* threadPool)
+{
+    Timer timer;
+    timer.Start();
+
+    const Double initialSahCost = mTarget.CalculateSahCost();
+
+    const Uint32 numNodes = mTarget.GetNumNodes();
+    mTempNodes.assign(mTarget.GetNodes(), mTarget.GetNodes() + numNodes);
+    mNodeCosts.resize(numNodes);
+    mNodeHeights.resize(numNodes);
+
+    for (Uint32 pass = 0; pass < mParams.optimizationPasses; ++pass)
+    {
+        // split the tree into independent subtrees, the top nodes are optimized after them
+        std::vector<Uint32> topNodes;
+        std::vector<Uint32> topNodesDepths;
+        std::vector<Uint32> subtrees = { 0 };
+        Uint32 subtreesDepth = 0;
+
+        const Uint32 numThreads = threadPool ? threadPool->GetNumThreads() : 1;
+        while (numThreads > 1 && subtrees.size() < 4 * numThreads)
+        {
+            // leaves are kept in the frontier (depth of a leaf does not matter)
+            std::vector<Uint32> nextSubtrees;
+            bool expanded = false;
+            for (const Uint32 nodeIndex : subtrees)
+            {
+                const BVH::Node& node = mTempNodes[nodeIndex];
+                if (node.IsLeaf())
+                {
+                    nextSubtrees.push_back(nodeIndex);
+                    continue;
+                }
+
+                topNodes.push_back(nodeIndex);
+                topNodesDepths.push_back(subtreesDepth);
+                nextSubtrees.push_back(node.childIndex);
+                nextSubtrees.push_back(node.childIndex + 1);
+                expanded = true;
+            }
+
+            if (!expanded)
+            {
+                break;
+            }
+
+            subtrees = std::move(nextSubtrees);
+            subtreesDepth++;
+        }
+
+        if (subtrees.size() > 1)
+        {
+            const auto taskCallback = [&](Uint32 taskID, Uint32)
+            {
+                OptimizeSubtree(subtrees[taskID], subtreesDepth);
+            };
+            threadPool->RunParallelTask(taskCallback, static_cast<Uint32>(subtrees.size()));
+        }
+        else
+        {
+            OptimizeSubtree(subtrees.front(), subtreesDepth);
+        }
+
+        // top nodes were collected level by level, so children are processed first when iterating backwards
+        for (size_t i = topNodes.size(); i-- > 0; )
+        {
+            RestructureTreelet(topNodes[i], topNodesDepths[i]);
+        }
+    }
+
+    mNumGeneratedLeaves = static_cast<Uint32>(mLeavesOrder.size());
+    CompactNodes();
+
+    mTempNodes.clear();
+    mTempNodes.shrink_to_fit();
+    mNodeCosts.clear();
+    mNodeCosts.shrink_to_fit();
+    mNodeHeights.clear();
+    mNodeHeights.shrink_to_fit();
+
+    mTarget.mUnoptimizedSahCost = initialSahCost;
+
+    RT_LOG_INFO("Optimized BVH in %.9g ms (passes = %u, SAH cost = %f -> %f)",
+                (Float)(1000.0 * timer.Stop()), mParams.optimizationPasses, initialSahCost, mTarget.CalculateSahCost());
+}
+
+void BVHBuilder::OptimizeSubtree(Uint32 nodeIndex, Uint32 depth)
+{
+    const BVH::Node& node = mTempNodes[nodeIndex];
+    if (node.IsLeaf())
+    {
+        mNodeCosts[nodeIndex] = mParams.intersectionCost * node.GetBox().SurfaceArea() * static_cast<Float>(node.numLeaves);
+        mNodeHeights[nodeIndex] = 0;
+        return;
+    }
+
+    OptimizeSubtree(node.childIndex, depth + 1);
+    OptimizeSubtree(node.childIndex + 1, depth + 1);
+    RestructureTreelet(nodeIndex, depth);
+}
+
+void BVHBuilder::RestructureTreelet(Uint32 nodeIndex, Uint32 depth)
+{
+    BVH::Node& root = mTempNodes[nodeIndex];
+    RT_ASSERT(!root.IsLeaf());
+
+    // grow the treelet by opening the leaf with the biggest surface area
+    Uint32 leaves[MaxTreeletLeaves] = { root.childIndex, root.childIndex + 1 };
+    Uint32 innerNodes[MaxTreeletLeaves - 1] = { nodeIndex };
+    Uint32 numLeaves = 2;
+    Uint32 numInnerNodes = 1;
+
+    while (numLeaves < MaxTreeletLeaves)
+    {
+        Uint32 bestLeaf = UINT32_MAX;
+        Float bestArea = -1.0f;
+        for (Uint32 i = 0; i < numLeaves; ++i)
+        {
+            const BVH::Node& node = mTempNodes[leaves[i]];
+            const Float area = node.GetBox().SurfaceArea();
+            if (!node.IsLeaf() && area > bestArea)
+            {
+                bestArea = area;
+                bestLeaf = i;
+            }
+        }
+
+        if (bestLeaf == UINT32_MAX)
+        {
+            break;
+        }
+
+        const Uint32 openedNode = leaves[bestLeaf];
+        innerNodes[numInnerNodes++] = openedNode;
+        leaves[bestLeaf] = mTempNodes[openedNode].childIndex;
+        leaves[numLeaves++] = mTempNodes[openedNode].childIndex + 1;
+    }
+
+    const Uint32 leftChild = root.childIndex;
+    const Float currentCost = mParams.traversalCost * root.GetBox().SurfaceArea() + mNodeCosts[leftChild] + mNodeCosts[leftChild + 1];
+    const Uint32 currentHeight = 1 + std::max(mNodeHeights[leftChild], mNodeHeights[leftChild + 1]);
+
+    mNodeCosts[nodeIndex] = currentCost;
+    mNodeHeights[nodeIndex] = currentHeight;
+
+    // two leaves can be arranged only in one way
+    if (numLeaves < 3)
+    {
+        return;
+    }
+
+    // find the optimal topology for every subset of the treelet leaves (dynamic programming over subsets)
+    constexpr Uint32 MaxSubsets = 1u << MaxTreeletLeaves;
+    Box subsetBoxes[MaxSubsets];
+    Float subsetCosts[MaxSubsets];
+    Uint32 subsetHeights[MaxSubsets];
+    Uint8 subsetSplits[MaxSubsets];
+
+    for (Uint32 i = 0; i < numLeaves; ++i)
+    {
+        subsetBoxes[1u << i] = mTempNodes[leaves[i]].GetBox();
+        subsetCosts[1u << i] = mNodeCosts[leaves[i]];
+        subsetHeights[1u << i] = mNodeHeights[leaves[i]];
+    }
+
+    const Uint32 fullSet = (1u << numLeaves) - 1;
+    for (Uint32 subset = 3; subset <= fullSet; ++subset)
+    {
+        const Uint32 lowestBit = subset & (~subset + 1);
+        if (subset == lowestBit)
+        {
+            continue;
+        }
+
+        subsetBoxes[subset] = Box(subsetBoxes[subset ^ lowestBit], subsetBoxes[lowestBit]);
+
+        // each partition is evaluated once (the part with the lowest bit is the left one)
+        Float bestCost = FLT_MAX;
+        Uint32 bestPartition = 0;
+        for (Uint32 part = (subset - 1) & subset; part != 0; part = (part - 1) & subset)
+        {
+            if ((part & lowestBit) == 0)
+            {
+                continue;
+            }
+
+            const Float cost = subsetCosts[part] + subsetCosts[subset ^ part];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestPartition = part;
+            }
+        }
+
+        subsetCosts[subset] = mParams.traversalCost * subsetBoxes[subset].SurfaceArea() + bestCost;
+        subsetHeights[subset] = 1 + std::max(subsetHeights[bestPartition], subsetHeights[subset ^ bestPartition]);
+        subsetSplits[subset] = static_cast<Uint8>(bestPartition);
+    }
+
+    // ignore tiny improvements (caused by rounding) and keep the tree depth within traversal stack limits
+    if (subsetCosts[fullSet] >= currentCost * 0.9999f || depth + subsetHeights[fullSet] >= BVH::MaxDepth)
+    {
+        return;
+    }
+
+    // the new topology reuses the treelet's children pairs slots
+    BVH::Node leafNodes[MaxTreeletLeaves];
+    Float leafCosts[MaxTreeletLeaves];
+    Uint32 leafHeights[MaxTreeletLeaves];
+    for (Uint32 i = 0; i < numLeaves; ++i)
+    {
+        leafNodes[i] = mTempNodes[leaves[i]];
+        leafCosts[i] = mNodeCosts[leaves[i]];
+        leafHeights[i] = mNodeHeights[leaves[i]];
+    }
+
+    Uint32 freePairs[MaxTreeletLeaves - 1];
+    for (Uint32 i = 0; i < numInnerNodes; ++i)
+    {
+        freePairs[i] = mTempNodes[innerNodes[i]].childIndex;
+    }
+
+    struct StackFrame
+    {
+        Uint32 subset;
+        Uint32 slot;
+    };
+
+    StackFrame stack[MaxTreeletLeaves];
+    Uint32 stackSize = 0;
+    Uint32 numUsedPairs = 0;
+    stack[stackSize++] = { fullSet, nodeIndex };
+
+    while (stackSize > 0)
+    {
+        const StackFrame frame = stack[--stackSize];
+        BVH::Node& node = mTempNodes[frame.slot];
+
+        // single treelet leaf
+        if ((frame.subset & (frame.subset - 1)) == 0)
+        {
+            const Uint32 leafIndex = HighestBitIndex(frame.subset);
+            node = leafNodes[leafIndex];
+            mNodeCosts[frame.slot] = leafCosts[leafIndex];
+            mNodeHeights[frame.slot] = leafHeights[leafIndex];
+            continue;
+        }
+
+        const Uint32 left = subsetSplits[frame.subset];
+        const Uint32 right = frame.subset ^ left;
+        const Uint32 pair = freePairs[numUsedPairs++];
+
+        node.min = subsetBoxes[frame.subset].min.ToFloat3();
+        node.max = subsetBoxes[frame.subset].max.ToFloat3();
+        node.childIndex = pair;
+        node.numLeaves = 0;
+        node.splitAxis = CalculateSplitAxis(subsetBoxes[left], subsetBoxes[right]);
+        mNodeCosts[frame.slot] = subsetCosts[frame.subset];
+        mNodeHeights[frame.slot] = subsetHeights[frame.subset];
+
+        stack[stackSize++] = { right, pair + 1 };
+        stack[stackSize++] = { left, pair };
+    }
+
+    RT_ASSERT(numUsedPairs == numInnerNodes);
+}
+
+Uint32 BVHBuilder::CompactNodes()
+{
+    // Nodes are emitted in the same order as they would be generated by recursive, depth-first builder:
+    // root at index 0, then child pairs starting at index 2 (so each pair is placed in a single cache line).
+    // Leaves are reordered the same way.
+    const Uint32 numLeaves = mNumGeneratedLeaves;
+    mTarget.AllocateNodes(2 * numLeaves);
+
+    Indices compactedLeavesOrder(numLeaves);
+    Uint32 numCompactedLeaves = 0;
+
+    struct StackFrame
+    {
+        Uint32 sourceIndex;
+        Uint32 targetIndex;
+    };
+
+    StackFrame stack[BVH::MaxDepth + 1];
+    Uint32 stackSize = 0;
+    Uint32 numNodes = 2;
+
+    stack[stackSize++] = { 0, 0 };
+
+    while (stackSize > 0)
+    {
+        const StackFrame frame = stack[--stackSize];
+
+        const BVH::Node& sourceNode = mTempNodes[frame.sourceIndex];
+        BVH::Node& targetNode = mTarget.mNodes[frame.targetIndex];
+        targetNode = sourceNode;
+
+        if (sourceNode.IsLeaf())
+        {
+            std::copy_n(mLeavesOrder.begin() + sourceNode.childIndex, sourceNode.numLeaves, compactedLeavesOrder.begin() + numCompactedLeaves);
+            targetNode.childIndex = numCompactedLeaves;
+            numCompactedLeaves += sourceNode.numLeaves;
+        }
+        else
+        {
+            targetNode.childIndex = numNodes;
+            numNodes += 2;
+
+            // right child is pushed first, so the left subtree is processed first
+            RT_ASSERT(stackSize + 2 <= BVH::MaxDepth + 1);
+            stack[stackSize++] = { sourceNode.childIndex + 1, targetNode.childIndex + 1 };
+            stack[stackSize++] = { sourceNode.childIndex, targetNode.childIndex };
+        }
+    }
+
+    RT_ASSERT(numCompactedLeaves == numLeaves);
+    mLeavesOrder = std::move(compactedLeavesOrder);
+
+    // shrink BVH nodes array
+    mTarget.mNumNodes = numNodes;
+    mTarget.mNodes.resize(numNodes);
+    mTarget.mNodes.shrink_to_fit();
+
+    if (mParams.nodesLayout == NodesLayout::VanEmdeBoas)
+    {
+        ReorderNodes_VanEmdeBoas();
+    }
+
+    return numNodes;
+}
+
+void BVHBuilder::ReorderNodes_VanEmdeBoas()
+{
+    // Children pairs are reordered as whole units. Root node with the padding node forms the first unit.
+    // Pair index is the index of its first node divided by two.
+    const Uint32 numPairs = mTarget.mNumNodes / 2;
+    BVH::Node* nodes = mTarget.mNodes.data();
+
+    // height of each pair's subtree (children pairs are always placed after their parent's pair)
+    std::vector<Uint32> heights(numPairs, 1);
+    for (Uint32 pair = numPairs; pair-- > 0; )
+    {
+        // the padding node is never used
+        const Uint32 numPairNodes = pair == 0 ? 1 : 2;
+        for (Uint32 i = 0; i < numPairNodes; ++i)
+        {
+            const BVH::Node& node = nodes[2 * pair + i];
+            if (!node.IsLeaf())
+            {
+                heights[pair] = std::max(heights[pair], heights[node.childIndex / 2] + 1);
+            }
+        }
+    }
+
+    const auto appendChildrenPairs = [nodes](Uint32 pair, Indices& outPairs)
+    {
+        const Uint32 numPairNodes = pair == 0 ? 1 : 2;
+        for (Uint32 i = 0; i < numPairNodes; ++i)
+        {
+            const BVH::Node& node = nodes[2 * pair + i];
+            if (!node.IsLeaf())
+            {
+                outPairs.push_back(node.childIndex / 2);
+            }
+        }
+    };
+
+    Indices order;
+    order.reserve(numPairs);
+
+    // lay out subtree of given pair truncated to given height
+    std::function<void(Uint32, Uint32)> layoutSubtree = [&](Uint32 rootPair, Uint32 height)
+    {
+        height = std::min(height, heights[rootPair]);
+        if (height == 1)
+        {
+            order.push_back(rootPair);
+            return;
+        }
+
+        const Uint32 topHeight = height / 2;
+        layoutSubtree(rootPair, topHeight);
+
+        // find roots of the bottom subtrees
+        Indices bottomRoots = { rootPair };
+        for (Uint32 level = 0; level < topHeight; ++level)
+        {
+            Indices nextLevel;
+            for (const Uint32 pair : bottomRoots)
+            {
+                appendChildrenPairs(pair, nextLevel);
+            }
+            bottomRoots = std::move(nextLevel);
+        }
+
+        for (const Uint32 pair : bottomRoots)
+        {
+            layoutSubtree(pair, height - topHeight);
+        }
+    };
+
+    layoutSubtree(0, heights[0]);
+    RT_ASSERT(order.size() == numPairs);
+    RT_ASSERT(order[0] == 0);
+
+    Indices newPairIndices(numPairs);
+    for (Uint32 i = 0; i < numPairs; ++i)
+    {
+        newPairIndices[order[i]] = i;
+    }
+
+    std::vector<BVH::Node, AlignmentAllocator<BVH::Node, RT_CACHE_LINE_SIZE>> newNodes(mTarget.mNumNodes);
+    for (Uint32 i = 0; i < numPairs; ++i)
+    {
+        for (Uint32 j = 0; j < 2; ++j)
+        {
+            BVH::Node& node = newNodes[2 * i + j];
+            node = nodes[2 * order[i] + j];
+
+            if (!node.IsLeaf() && !(order[i] == 0 && j == 1))
+            {
+                node.childIndex = 2 * newPairIndices[node.childIndex / 2];
+            }
+        }
+    }
+
+    mTarget.mNodes = std::move(newNodes);
+}
+
+void BVHBuilder::SortLeaves()
+{
+    for (Uint32 axis = 0; axis < NumAxes; ++axis)
+    {
+        Indices& indices = mSortedLeaves[axis];
+        ResizeBuffer(indices, mNumLeaves);
+        for (Uint32 i = 0; i < mNumLeaves; ++i)
+        {
+            indices[i] = i;
+        }
+
+        // ties are resolved by leaf index, so the order is deterministic
+        const auto comparator = [this, axis](const Uint32 a, const Uint32 b)
+        {
+            const Box& leafA = mLeafBoxes[a];
+            const Box& leafB = mLeafBoxes[b];
+
+            // TODO use precalculated triangle center (experiment)
+            const Float centerA = leafA.max[axis] + leafA.min[axis];
+            const Float centerB = leafB.max[axis] + leafB.min[axis];
+            return centerA < centerB || (centerA == centerB && a < b);
+        };
+
+        std::sort(indices.begin(), indices.end(), comparator);
+    }
+
+    ResizeBuffer(mPartitionScratch, mNumLeaves);
+    ResizeBuffer(mLeafSides, mNumLeaves);
 }
 
 } // namespace rt
@@ -2,79 +2,396 @@
 
 #include "RayLib.h"
 #include "BVH.h"
+#include "../Math/Triangle.h"
 #include "../Utils/AlignmentAllocator.h"
 
+#include <atomic>
 
-namespace rt {
 
+namespace rt {
 
 // helper class for constructing BVH using SAH algorithm
-class BVHBuilder
+class RAYLIB_API BVHBuilder
 {
 public:
 
+    // algorithm used to find the best split of a node
+    enum class SplitAlgorithm : Uint8
+    {
+        // evaluate every possible split position (leaves are fully sorted in each node)
+        // slow, but produces the highest quality trees
+        Sweep = 0,
+
+        // evaluate split positions only on bin boundaries, leaves are partitioned in-place
+        Binned,
+
+        // binned object splits combined with binned spatial splits (SBVH)
+        // a triangle straddling spatial split plane is referenced by both children, which greatly reduces
+        // nodes overlap for meshes with long, thin triangles
+        // NOTE: requires leaf triangles (see SetLeafTriangles), output leaves order may contain duplicates
+        Spatial,
+
+        // leaves are sorted along Morton curve and nodes are split at the highest differing bit of the codes (LBVH)
+        // very fast, but produces low quality trees (see agglomerativeTreeletSize)
+        Linear,
+    };
+
+    // order of child node pairs in the target BVH (a pair fills a single cache line)
+    enum class NodesLayout : Uint8
+    {
+        // left subtree directly follows its parent's children pair
+        DepthFirst = 0,
+
+        // cache-oblivious layout: the tree is recursively split at half of its height and the top subtree
+        // is placed before the bottom ones, so a root-to-leaf path touches fewer cache lines and pages
+        VanEmdeBoas,
+    };
+
+    static constexpr Uint32 MaxNumBins = 64;
+
     struct BuildingParams
     {
-        Uint32 maxLeafNodeSize; // max number of objects in leaf nodes
+        // max number of objects in leaf nodes (smaller nodes become leaves only if it's cheaper than splitting them)
+        Uint32 maxLeafNodeSize;
+
+        // SAH cost of a node box test and a single leaf object intersection
+        Float traversalCost;
+        Float intersectionCost;
+
+        SplitAlgorithm splitAlgorithm;
+        Uint32 numBins; // number of bins per axis (binned algorithm only), clamped to [2, MaxNumBins]
+
+        // number of threads used for building (0 means "use all available CPU cores")
+        // NOTE: the resulting tree does not depend on this value
+        Uint32 numThreads;
+
+        // subtrees with less objects than this are built serially within a single task
+        Uint32 minLeavesPerTask;
+
+        // spatial splits only: max number of duplicated references (relative to the number of leaves)
+        Float maxDuplicatedReferences;
+
+        // spatial splits only: spatial split is considered only when children of the best object split
+        // overlap by more than this (surface area relative to the root node)
+        Float spatialSplitOverlapThreshold;
+
+        // linear algorithm only: subtrees with up to this number of leaves are built by agglomerative clustering
+        // of nearby leaves on Morton curve (PLOC), which recovers most of the lost quality (0 disables it)
+        Uint32 agglomerativeTreeletSize;
+
+        NodesLayout nodesLayout;
+
+        // number of treelet restructuring passes done after the build (0 disables it)
+        // each pass replaces topology of small treelets with the SAH-optimal one, which takes a few times longer
+        // than a binned build and improves the tree quality by several percent
+        Uint32 optimizationPasses;
+
+        // number of extra references created by splitting oversized triangles before the build
+        // (relative to the number of leaves, 0 disables it), requires leaf triangles
+        // unlike spatial splits, this works with any split algorithm
+        Float earlySplitBudget;
+
+        // triangle is split early only if its box surface area exceeds its own area this many times
+        Float earlySplitThreshold;
 
         BuildingParams()
-            : maxLeafNodeSize(2)
+            : maxLeafNodeSize(8)
+            , traversalCost(1.0f)
+            , intersectionCost(1.0f)
+            , splitAlgorithm(SplitAlgorithm::Binned)
+            , numBins(32)
+            , numThreads(0)
+            , minLeavesPerTask(4096)
+            , maxDuplicatedReferences(0.3f)
+            , spatialSplitOverlapThreshold(1.0e-5f)
+            , agglomerativeTreeletSize(0)
+            , nodesLayout(NodesLayout::DepthFirst)
+            , optimizationPasses(0)
+            , earlySplitBudget(0.0f)
+            , earlySplitThreshold(8.0f)
         { }
     };
 
     using Indices = std::vector<Uint32>;
 
+    // memory usage of the last build
+    // all the temporary data lives in a few buffers allocated up front (and per-thread caches, which only grow),
+    // so the number of allocations does not depend on the number of leaves
+    struct BuildStats
+    {
+        Uint64 peakMemory;          // bytes allocated for temporary buffers (nodes, leaf indices, per-thread caches)
+        Uint32 numAllocations;      // number of temporary buffer (re)allocations
+
+        BuildStats()
+            : peakMemory(0)
+            , numAllocations(0)
+        { }
+    };
+
     BVHBuilder(BVH& targetBVH);
     ~BVHBuilder();
 
-    void SetLeafData();
+    // set triangles used for spatial and early splits (must match the leaf boxes passed to Build)
+    void SetLeafTriangles(const math::Triangle* triangles);
 
     // construct the BVH and return new leaves order
     bool Build(const math::Box* data, const Uint32 numLeaves, const BuildingParams& params,
                Indices& outLeavesOrder);
 
+    // rebuild given (disjoint) subtrees of the target BVH, keeping the rest of the tree
+    // leaf boxes must be given in the current leaves order, leaves are reordered only within the subtrees' ranges
+    // spatial splits are not supported here (existing references are treated as separate leaves)
+    bool RebuildSubtrees(const std::vector<Uint32>& subtreeRoots, const math::Box* leafBoxes, Uint32 numLeaves,
+                         const BuildingParams& params, Indices& outLeavesOrder);
+
+    RT_FORCE_INLINE const BuildStats& GetBuildStats() const { return mBuildStats; }
+
 private:
 
     constexpr static Uint32 NumAxes = 3;
 
+    // agglomerative clustering only
+    struct Cluster
+    {
+        math::Box box;
+        Uint32 children[2];     // child clusters or leaf index (first child) for leaf clusters
+        Uint32 numLeaves;
+        Uint32 depth;
+        Float cost;             // SAH cost of the cluster's subtree (not normalized)
+        bool isLeaf;            // the cluster's leaves are intersected directly
+    };
+
+    struct ClusterStackFrame
+    {
+        Uint32 cluster;
+        Uint32 nodeSlot;
+        Uint32 descendantsSlot;
+        Uint32 leavesOffset;
+    };
+
+    // per-thread buffers reused by all the nodes built on a thread (they only grow)
     struct Context
     {
-        std::vector<math::Box, AlignmentAllocator<math::Box>> mLeftBoxesCache;
-        std::vector<math::Box, AlignmentAllocator<math::Box>> mRightBoxesCache;
-        Indices mSortedLeavesIndicesCache[3];
+        // sweep algorithm only: right child node area for each split position
+        std::vector<Float> mRightAreasCache;
+
+        // spatial splits only: references of the right child, before they are moved to their final location
+        Indices mRightReferencesCache;
+
+        // spatial splits only: clipped (left, right) boxes of references straddling the split plane
+        std::vector<math::Box, AlignmentAllocator<math::Box>> mClippedBoxesCache;
+
+        // agglomerative clustering only
+        std::vector<Cluster, AlignmentAllocator<Cluster>> mClusters;
+        Indices mActiveClusters;
+        Indices mNextActiveClusters;
+        Indices mNearestNeighbors;
+        Indices mPendingClusters;
+        std::vector<ClusterStackFrame> mClusterStack;
+    };
+
+    struct RT_ALIGN(16) Split
+    {
+        math::Box leftBox;
+        math::Box rightBox;
+        Uint32 axis;
+        Uint32 leftCount;
+        Uint32 rightCount;
+    };
 
-        Context(Uint32 numLeaves);
+    // object split found on bin boundaries
+    struct RT_ALIGN(16) BinnedSplit : public Split
+    {
+        math::Box centerBox; // bounds of (doubled) leaf centers
+        Float binScale;
+        Uint32 numBins;
+        Uint32 lastLeftBin;
+        Float cost;
+
+        RT_FORCE_INLINE bool IsOnLeftSide(const math::Box& box) const
+        {
+            const Float center = box.min[axis] + box.max[axis];
+            const Uint32 binIndex = static_cast<Uint32>((center - centerBox.min[axis]) * binScale);
+            return std::min(binIndex, numBins - 1) <= lastLeftBin;
+        }
     };
 
+    // spatial split placed on bin boundary
+    struct SpatialSplit
+    {
+        Uint32 axis;
+        Uint32 numBins;
+        Uint32 lastLeftBin;
+        Float binsOrigin;
+        Float binSize;
+        Float invBinSize;
+        Float cost;
+
+        RT_FORCE_INLINE Uint32 GetBinIndex(Float position) const
+        {
+            const Int32 binIndex = static_cast<Int32>((position - binsOrigin) * invBinSize);
+            return static_cast<Uint32>(std::min(std::max(binIndex, 0), static_cast<Int32>(numBins) - 1));
+        }
+
+        RT_FORCE_INLINE Float GetPlanePosition() const
+        {
+            return binsOrigin + binSize * static_cast<Float>(lastLeftBin + 1);
+        }
+    };
+
+    // Work sets do not own any memory, their leaves are partitioned in-place within the shared arrays:
+    // mLeavesOrder (binned and linear), mSortedLeaves (sweep) or mReferenceIndices (spatial).
     struct RT_ALIGN(16) WorkSet
     {
         math::Box box;
-        Indices leafIndices;
         Uint32 numLeaves;
-        Uint32 sortedBy;
         Uint32 depth;
 
+        // Location of the node in the temporary (uncompacted) nodes array and the first slot of its descendants.
+        // A subtree with N leaves never generates more than 2*N-1 nodes, so the slots can be assigned up front
+        // and subtrees can be built independently, without any shared counters.
+        Uint32 nodeSlot;
+        Uint32 descendantsSlot;
+
+        // first position of the set's leaves in the output leaves order
+        // spatial splits: first position in mReferenceIndices, followed by space for duplicationBudget new references
+        Uint32 leavesOffset;
+
+        // spatial splits only: number of references the subtree is still allowed to duplicate
+        Uint32 duplicationBudget;
+
         WorkSet()
             : numLeaves(0)
-            , sortedBy(std::numeric_limits<Uint32>::max())
             , depth(0)
+            , nodeSlot(0)
+            , descendantsSlot(0)
+            , leavesOffset(0)
+            , duplicationBudget(0)
         { }
     };
 
-    // sort leaf indices in each axis
-    void SortLeaves(const WorkSet& workSet, Context& context) const;
-    void BuildNode(const WorkSet& workSet, Context& context, BVH::Node& targetNode);
+    // sort leaf indices along each axis (sweep algorithm only)
+    void SortLeaves();
+
+    // stable partition of the sorted leaf indices according to given sweep split, so they remain sorted
+    void PartitionSortedLeaves(const WorkSet& workSet, const Split& split);
+
+    // sort leaves along Morton curve of their centers (linear algorithm only)
+    void SortLeaves_Morton(ThreadPool* threadPool);
+
+    // split Morton-sorted leaves at the highest differing bit of their codes
+    // returns false if creating a leaf is cheaper than the split
+    bool FindSplit_Linear(const WorkSet& workSet, Split& outSplit) const;
+
+    // build whole subtree by agglomerative clustering of Morton-sorted leaves
+    // returns false if the resulting subtree would be too deep
+    bool BuildTreelet_Agglomerative(const WorkSet& workSet, Context& context);
+
+    // find the best split by sweeping over sorted leaves and partition the work set's leaves in-place
+    // returns false (and leaves the work set untouched) if creating a leaf is cheaper than the best split
+    bool FindSplit_Sweep(const WorkSet& workSet, Context& context, Split& outSplit);
+
+    // find the best split on bin boundaries and partition the work set's leaves in-place
+    // returns false (and leaves the work set untouched) if creating a leaf is cheaper than the best split
+    bool FindSplit_Binned(const WorkSet& workSet, Split& outSplit);
+
+    // find the best object split of given leaves (or references) on bin boundaries
+    // returns false if all the leaf centers fall into a single bin
+    bool FindObjectSplit_Binned(const Uint32* indices, Uint32 numIndices, const math::Box* boxes, BinnedSplit& outSplit) const;
+
+    // find the best object or spatial split and distribute the work set's references into the children
+    // left child's references are compacted in-place, right child's ones are written to the context
+    // returns false (and leaves the work set untouched) if creating a leaf is cheaper than the best split
+    bool FindSplit_Spatial(const WorkSet& workSet, Context& context, Split& outSplit);
+
+    // find the best spatial split plane on bin boundaries (within the work set's duplication budget)
+    // returns false if no valid split was found
+    bool FindSpatialSplit(const WorkSet& workSet, SpatialSplit& outSplit) const;
+
+    // calculate bounding boxes of a triangle part (clipped to a box) on both sides of a plane
+    void SplitReference(Uint32 leafIndex, const math::Box& box, Uint32 axis, Float position,
+                        math::Box& outLeftBox, math::Box& outRightBox) const;
+
+    // split oversized leaves into multiple references (biggest boxes first) until the budget is used up
+    // returns reference boxes and their leaf indices
+    void SplitOversizedLeaves(std::vector<math::Box, AlignmentAllocator<math::Box>>& outBoxes, Indices& outLeaves);
+
+    // build the tree from early split references and map the leaves order back to the original leaves
+    bool BuildWithEarlySplits(Indices& outLeavesOrder);
+
+    // find the best split of a work set and write the node
+    // returns false if a leaf was generated
+    bool BuildNode(const WorkSet& workSet, Context& context, WorkSet& outLeft, WorkSet& outRight);
     void GenerateLeaf(const WorkSet& workSet, BVH::Node& targetNode);
 
+    // check if intersecting all objects of a (small) work set is cheaper than splitting it
+    // children cost is the sum of the children's areas multiplied by their object counts
+    bool IsLeafCheaper(const WorkSet& workSet, const math::Box& nodeBox, Float childrenCost) const;
+
+    // build whole subtree on the calling thread
+    void BuildSubtree(WorkSet& workSet, Context& context);
+
+    // build the tree using a pool of threads, subtrees are processed as independent tasks
+    void BuildParallel(WorkSet& rootWorkSet, ThreadPool& threadPool);
+
+    // restructure treelets of the target BVH to minimize its SAH cost (TRBVH)
+    void OptimizeTreelets(ThreadPool* threadPool);
+
+    // optimize treelets of a subtree in bottom-up order
+    void OptimizeSubtree(Uint32 nodeIndex, Uint32 depth);
+
+    // replace topology of a treelet rooted at given node with the optimal one (children must be optimized first)
+    void RestructureTreelet(Uint32 nodeIndex, Uint32 depth);
+
+    // move nodes from the temporary array to the target BVH in depth-first order
+    // (and reorder them if different layout was requested)
+    // returns number of nodes written
+    Uint32 CompactNodes();
+
+    // reorder children pairs of the target BVH into van Emde Boas layout
+    void ReorderNodes_VanEmdeBoas();
+
+    // grow a temporary buffer, keeping track of the memory usage
+    template<typename Buffer>
+    void ReserveBuffer(Buffer& buffer, size_t capacity);
+    template<typename Buffer>
+    void ResizeBuffer(Buffer& buffer, size_t size);
+
     // input data
     BuildingParams mParams;
     const math::Box* mLeafBoxes;
+    const math::Triangle* mLeafTriangles;
     Uint32 mNumLeaves;
 
-    Uint32 mNumGeneratedNodes;
-    Uint32 mNumGeneratedLeaves;
+    // sweep algorithm only: leaf indices sorted along each axis, and temporary data for partitioning them
+    Indices mSortedLeaves[NumAxes];
+    Indices mPartitionScratch;
+    std::vector<Uint8> mLeafSides;
+
+    // spatial splits only: leaf references (possibly clipped leaf boxes)
+    std::vector<math::Box, AlignmentAllocator<math::Box>> mReferenceBoxes;
+    Indices mReferenceLeaves;
+    Indices mReferenceIndices;
+    std::atomic<Uint32> mNumReferences;
+    std::atomic<Uint32> mNumTempNodes;
+    Float mRootArea;
+
+    // linear algorithm only: Morton codes of the leaves (in mLeavesOrder order)
+    std::vector<Uint64> mMortonCodes;
+
+    // treelet optimization only: SAH cost (not normalized) and height of each temporary node's subtree
+    std::vector<Float> mNodeCosts;
+    std::vector<Uint32> mNodeHeights;
+
+    std::vector<BVH::Node, AlignmentAllocator<BVH::Node, RT_CACHE_LINE_SIZE>> mTempNodes;
+    std::atomic<Uint32> mNumGeneratedLeaves;
     Indices mLeavesOrder;
 
+    // memory usage tracking
+    std::atomic<Uint64> mAllocatedBytes;
+    std::atomic<Uint32> mNumAllocations;
+    BuildStats mBuildStats;
+
     // target BVH
     BVH& mTarget;
 };
@@ -0,0 +1,449 @@
+#include "PCH.h"
+#include "BVHUpdater.h"
+#include "Utils/Logger.h"
+
+
+namespace rt {
+
+using namespace math;
+
+namespace {
+
+// pick the axis with the biggest distance between children centers (the same way as the builder)
+Uint32 CalculateSplitAxis(const Box& leftBox, const Box& rightBox)
+{
+    const Vector4 centersDistance = Vector4::Abs((leftBox.min + leftBox.max) - (rightBox.min + rightBox.max));
+
+    Uint32 axis = 0;
+    for (Uint32 i = 1; i < 3; ++i)
+    {
+        if (centersDistance[i] > centersDistance[axis])
+        {
+            axis = i;
+        }
+    }
+    return axis;
+}
+
+// leaf node referencing a single leaves order entry
+BVH::Node MakeLeafNode(const Box& box, Uint32 slot)
+{
+    BVH::Node leafNode;
+    leafNode.min = box.min.ToFloat3();
+    leafNode.max = box.max.ToFloat3();
+    leafNode.childIndex = slot;
+    leafNode.numLeaves = 1;
+    leafNode.splitAxis = 0;
+    return leafNode;
+}
+
+} // namespace
+
+constexpr Uint32 BVHUpdater::InvalidIndex;
+
+BVHUpdater::BVHUpdater() = default;
+
+void BVHUpdater::Clear()
+{
+    mLeavesOrder.clear();
+    mLeafSlots.clear();
+    mSlotNodes.clear();
+    mLeafBoxes.clear();
+    mParents.clear();
+    mFreeSlots.clear();
+    mFreePairs.clear();
+    mModifiedNodes.clear();
+}
+
+void BVHUpdater::Initialize(const BVH& bvh, const std::vector<Uint32>& leavesOrder, const Box* leafBoxes)
+{
+    Clear();
+
+    const Uint32 numSlots = static_cast<Uint32>(leavesOrder.size());
+    mLeavesOrder = leavesOrder;
+    mLeafBoxes.assign(leafBoxes, leafBoxes + numSlots);
+    mSlotNodes.resize(numSlots, InvalidIndex);
+
+    for (Uint32 slot = 0; slot < numSlots; ++slot)
+    {
+        const Uint32 leafID = mLeavesOrder[slot];
+        if (leafID >= mLeafSlots.size())
+        {
+            mLeafSlots.resize(leafID + 1, InvalidIndex);
+        }
+        RT_ASSERT(mLeafSlots[leafID] == InvalidIndex, "Leaf is referenced multiple times");
+        mLeafSlots[leafID] = slot;
+    }
+
+    mParents.resize(bvh.GetNumNodes(), InvalidIndex);
+    if (bvh.GetNumNodes() == 0)
+    {
+        return;
+    }
+
+    const BVH::Node* nodes = bvh.GetNodes();
+    std::vector<Uint32> stack = { 0 };
+    while (!stack.empty())
+    {
+        const Uint32 nodeIndex = stack.back();
+        stack.pop_back();
+
+        const BVH::Node& node = nodes[nodeIndex];
+        if (node.IsLeaf())
+        {
+            for (Uint32 i = 0; i < node.numLeaves; ++i)
+            {
+                mSlotNodes[node.childIndex + i] = nodeIndex;
+            }
+            continue;
+        }
+
+        mParents[node.childIndex] = nodeIndex;
+        mParents[node.childIndex + 1] = nodeIndex;
+        stack.push_back(node.childIndex);
+        stack.push_back(node.childIndex + 1);
+    }
+}
+
+bool BVHUpdater::ContainsLeaf(Uint32 leafID) const
+{
+    return leafID < mLeafSlots.size() && mLeafSlots[leafID] != InvalidIndex;
+}
+
+bool BVHUpdater::InsertLeaf(BVH& bvh, Uint32 leafID, const Box& box)
+{
+    RT_ASSERT(!ContainsLeaf(leafID), "Leaf is already in the tree");
+
+    if (leafID >= mLeafSlots.size())
+    {
+        mLeafSlots.resize(leafID + 1, InvalidIndex);
+    }
+
+    // reuse entries of removed leaves, so the leaves order doesn't grow when leaves are removed and inserted repeatedly
+    Uint32 slot;
+    if (!mFreeSlots.empty())
+    {
+        slot = mFreeSlots.back();
+        mFreeSlots.pop_back();
+        mLeavesOrder[slot] = leafID;
+        mLeafBoxes[slot] = box;
+    }
+    else
+    {
+        slot = static_cast<Uint32>(mLeavesOrder.size());
+        mLeavesOrder.push_back(leafID);
+        mLeafBoxes.push_back(box);
+        mSlotNodes.push_back(InvalidIndex);
+    }
+    mLeafSlots[leafID] = slot;
+
+    if (!AttachSlot(bvh, slot))
+    {
+        // the leaf is not in the tree
+        mLeavesOrder[slot] = InvalidIndex;
+        mLeafBoxes[slot] = Box::Empty();
+        mLeafSlots[leafID] = InvalidIndex;
+        mFreeSlots.push_back(slot);
+        return false;
+    }
+
+    return true;
+}
+
+void BVHUpdater::RemoveLeaf(BVH& bvh, Uint32 leafID)
+{
+    RT_ASSERT(ContainsLeaf(leafID), "Leaf is not in the tree");
+
+    const Uint32 slot = DetachSlot(bvh, mLeafSlots[leafID]);
+    mLeavesOrder[slot] = InvalidIndex;
+    mLeafBoxes[slot] = Box::Empty();
+    mLeafSlots[leafID] = InvalidIndex;
+    mFreeSlots.push_back(slot);
+}
+
+bool BVHUpdater::UpdateLeaf(BVH& bvh, Uint32 leafID, const Box& box)
+{
+    RT_ASSERT(ContainsLeaf(leafID), "Leaf is not in the tree");
+
+    // remember the leaf's place, so it can be put back there if the new one is too deep
+    const Uint32 nodeIndex = mSlotNodes[mLeafSlots[leafID]];
+    const bool isSharedNode = bvh.mNodes[nodeIndex].numLeaves > 1;
+    const Uint32 parentIndex = mParents[nodeIndex];
+    const Uint32 pairIndex = nodeIndex & ~1u;
+
+    const Uint32 slot = DetachSlot(bvh, mLeafSlots[leafID]);
+    mLeafBoxes[slot] = box;
+    if (AttachSlot(bvh, slot))
+    {
+        return true;
+    }
+
+    if (isSharedNode)
+    {
+        // the entry was moved right after the node's range
+        BVH::Node& node = bvh.mNodes[nodeIndex];
+        RT_ASSERT(node.childIndex + node.numLeaves == slot);
+        node.numLeaves++;
+        mSlotNodes[slot] = nodeIndex;
+        RefitUpward(bvh, nodeIndex);
+    }
+    else
+    {
+        // the sibling replaced the parent, so attaching next to it restores the old depth
+        // (a root leaf can't fail, the tree is empty after detaching it)
+        // the released pair is placed before the sibling's children (if any), so it keeps children after parents
+        RT_ASSERT(parentIndex != InvalidIndex);
+        AttachSlotToSibling(bvh, slot, parentIndex, ReclaimPair(bvh, pairIndex));
+    }
+
+    return false;
+}
+
+bool BVHUpdater::AttachSlot(BVH& bvh, Uint32 slot)
+{
+    bvh.UnmapNodes();
+    bvh.mUnoptimizedSahCost = 0.0;
+
+    const Box& box = mLeafBoxes[slot];
+    const BVH::Node leafNode = MakeLeafNode(box, slot);
+
+    if (bvh.mNumNodes == 0)
+    {
+        // the leaf becomes the root
+        bvh.mNodes.assign(1, leafNode);
+        bvh.mNumNodes = 1;
+        mParents.assign(1, InvalidIndex);
+        mFreePairs.clear();
+        mSlotNodes[slot] = 0;
+        mModifiedNodes.push_back(0);
+        return true;
+    }
+
+    // descend to the leaf node, which enlarges the least when merged with the new leaf
+    Uint32 siblingIndex = 0;
+    Uint32 depth = 1;
+    while (!bvh.mNodes[siblingIndex].IsLeaf())
+    {
+        const Uint32 childIndex = bvh.mNodes[siblingIndex].childIndex;
+
+        Float bestCost = FLT_MAX;
+        for (Uint32 i = 0; i < 2; ++i)
+        {
+            const Box childBox = bvh.mNodes[childIndex + i].GetBox();
+            const Float cost = Box(childBox, box).SurfaceArea() - childBox.SurfaceArea();
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                siblingIndex = childIndex + i;
+            }
+        }
+
+        depth++;
+    }
+
+    if (depth + 1 >= BVH::MaxDepth)
+    {
+        RT_LOG_ERROR("BVH is too deep to insert a leaf");
+        return false;
+    }
+
+    AttachSlotToSibling(bvh, slot, siblingIndex, AllocatePair(bvh, siblingIndex));
+    return true;
+}
+
+void BVHUpdater::AttachSlotToSibling(BVH& bvh, Uint32 slot, Uint32 siblingIndex, Uint32 pairIndex)
+{
+    const Box& box = mLeafBoxes[slot];
+    const BVH::Node leafNode = MakeLeafNode(box, slot);
+
+    // the sibling is moved down, next to the new leaf node
+    BVH::Node& sibling = bvh.mNodes[siblingIndex];
+    RT_ASSERT(pairIndex > siblingIndex);
+    RT_ASSERT(sibling.IsLeaf() || pairIndex < sibling.childIndex, "Children must be placed after their parent");
+
+    bvh.mNodes[pairIndex] = sibling;
+    bvh.mNodes[pairIndex + 1] = leafNode;
+    mParents[pairIndex] = siblingIndex;
+    mParents[pairIndex + 1] = siblingIndex;
+    mModifiedNodes.push_back(pairIndex);
+    mModifiedNodes.push_back(pairIndex + 1);
+
+    if (sibling.IsLeaf())
+    {
+        for (Uint32 i = 0; i < sibling.numLeaves; ++i)
+        {
+            mSlotNodes[sibling.childIndex + i] = pairIndex;
+        }
+    }
+    else
+    {
+        mParents[sibling.childIndex] = pairIndex;
+        mParents[sibling.childIndex + 1] = pairIndex;
+    }
+    mSlotNodes[slot] = pairIndex + 1;
+
+    sibling.splitAxis = CalculateSplitAxis(sibling.GetBox(), box);
+    sibling.childIndex = pairIndex;
+    sibling.numLeaves = 0;
+
+    RefitUpward(bvh, siblingIndex);
+}
+
+Uint32 BVHUpdater::DetachSlot(BVH& bvh, Uint32 slot)
+{
+    bvh.UnmapNodes();
+    bvh.mUnoptimizedSahCost = 0.0;
+
+    const Uint32 nodeIndex = mSlotNodes[slot];
+    BVH::Node& node = bvh.mNodes[nodeIndex];
+    RT_ASSERT(node.IsLeaf());
+
+    if (node.numLeaves > 1)
+    {
+        // move the entry to the end of the node's range, so the node can be shrunk
+        const Uint32 lastSlot = node.childIndex + node.numLeaves - 1;
+        SwapSlots(slot, lastSlot);
+        mSlotNodes[lastSlot] = InvalidIndex;
+        node.numLeaves--;
+
+        RefitUpward(bvh, nodeIndex);
+        return lastSlot;
+    }
+
+    mSlotNodes[slot] = InvalidIndex;
+
+    if (nodeIndex == 0)
+    {
+        // the tree is empty now
+        bvh.mNodes.clear();
+        bvh.mNumNodes = 0;
+        mParents.clear();
+        mFreePairs.clear();
+        return slot;
+    }
+
+    // replace the parent with the sibling (moving a subtree up keeps children after their parents)
+    const Uint32 parentIndex = mParents[nodeIndex];
+    const Uint32 siblingIndex = nodeIndex ^ 1u;
+    const BVH::Node& sibling = bvh.mNodes[siblingIndex];
+    bvh.mNodes[parentIndex] = sibling;
+    mModifiedNodes.push_back(parentIndex);
+
+    if (sibling.IsLeaf())
+    {
+        for (Uint32 i = 0; i < sibling.numLeaves; ++i)
+        {
+            mSlotNodes[sibling.childIndex + i] = parentIndex;
+        }
+    }
+    else
+    {
+        mParents[sibling.childIndex] = parentIndex;
+        mParents[sibling.childIndex + 1] = parentIndex;
+    }
+
+    ReleasePair(bvh, nodeIndex & ~1u);
+
+    if (mParents[parentIndex] != InvalidIndex)
+    {
+        RefitUpward(bvh, mParents[parentIndex]);
+    }
+
+    return slot;
+}
+
+void BVHUpdater::SwapSlots(Uint32 slotA, Uint32 slotB)
+{
+    std::swap(mLeavesOrder[slotA], mLeavesOrder[slotB]);
+    std::swap(mLeafBoxes[slotA], mLeafBoxes[slotB]);
+    mLeafSlots[mLeavesOrder[slotA]] = slotA;
+    mLeafSlots[mLeavesOrder[slotB]] = slotB;
+}
+
+void BVHUpdater::RefitUpward(BVH& bvh, Uint32 nodeIndex)
+{
+    for (; nodeIndex != InvalidIndex; nodeIndex = mParents[nodeIndex])
+    {
+        BVH::Node& node = bvh.mNodes[nodeIndex];
+        mModifiedNodes.push_back(nodeIndex);
+
+        Box box = Box::Empty();
+        if (node.IsLeaf())
+        {
+            for (Uint32 i = 0; i < node.numLeaves; ++i)
+            {
+                box = Box(box, mLeafBoxes[node.childIndex + i]);
+            }
+        }
+        else
+        {
+            box = Box(bvh.mNodes[node.childIndex].GetBox(), bvh.mNodes[node.childIndex + 1].GetBox());
+        }
+
+        node.min = box.min.ToFloat3();
+        node.max = box.max.ToFloat3();
+    }
+}
+
+void BVHUpdater::ReleasePair(BVH& bvh, Uint32 pairIndex)
+{
+    // unused nodes look like the padding node
+    bvh.mNodes[pairIndex] = BVH::Node();
+    bvh.mNodes[pairIndex + 1] = BVH::Node();
+    mParents[pairIndex] = InvalidIndex;
+    mParents[pairIndex + 1] = InvalidIndex;
+    mFreePairs.insert(pairIndex);
+    mModifiedNodes.push_back(pairIndex);
+    mModifiedNodes.push_back(pairIndex + 1);
+
+    // shrink the nodes array if unused pairs are at its end
+    while (!mFreePairs.empty() && *mFreePairs.rbegin() + 2 == bvh.mNumNodes)
+    {
+        mFreePairs.erase(std::prev(mFreePairs.end()));
+        bvh.mNumNodes -= 2;
+    }
+    bvh.mNodes.resize(bvh.mNumNodes);
+    mParents.resize(bvh.mNumNodes);
+}
+
+Uint32 BVHUpdater::ReclaimPair(BVH& bvh, Uint32 pairIndex)
+{
+    if (mFreePairs.erase(pairIndex) > 0)
+    {
+        return pairIndex;
+    }
+
+    // the pair was removed from the end of the nodes array, pairs in between become unused ones
+    RT_ASSERT(pairIndex >= bvh.mNumNodes);
+    for (Uint32 i = std::max(2u, bvh.mNumNodes); i < pairIndex; i += 2)
+    {
+        mFreePairs.insert(i);
+    }
+
+    bvh.mNodes.resize(pairIndex + 2);
+    bvh.mNumNodes = pairIndex + 2;
+    mParents.resize(pairIndex + 2, InvalidIndex);
+    return pairIndex;
+}
+
+Uint32 BVHUpdater::AllocatePair(BVH& bvh, Uint32 parentIndex)
+{
+    const auto it = mFreePairs.upper_bound(parentIndex);
+    if (it != mFreePairs.end())
+    {
+        const Uint32 pairIndex = *it;
+        mFreePairs.erase(it);
+        return pairIndex;
+    }
+
+    // children pairs start at even indices (node 1 is unused)
+    const Uint32 pairIndex = std::max(2u, bvh.mNumNodes);
+    RT_ASSERT(pairIndex % 2 == 0);
+
+    bvh.mNodes.resize(pairIndex + 2);
+    bvh.mNumNodes = pairIndex + 2;
+    mParents.resize(pairIndex + 2, InvalidIndex);
+    return pairIndex;
+}
+
+} // namespace rt
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "BVH.h"
+
+#include <set>
+
+
+namespace rt {
+
+// Incremental modifications of a built BVH, meant for interactive editing of big scenes.
+// Keeps parent links and leaf boxes of the tree, so a single leaf can be inserted, removed or moved in O(depth) time.
+// Leaves are identified with IDs (indices passed to the builder), which stay valid, while their positions
+// in the leaves order may change (see GetLeavesOrder).
+// An inserted (or moved) leaf gets its own leaf node, placed next to the leaf node which requires the smallest
+// enlargement of the tree. Tree quality degrades with each modification, so it should be rebuilt from time to time.
+// NOTE: the BVH is passed to each call and must not be modified by other means in between.
+class RAYLIB_API BVHUpdater
+{
+public:
+    static constexpr Uint32 InvalidIndex = 0xFFFFFFFF;
+
+    BVHUpdater();
+
+    // must be called after the BVH is (re)built
+    // leaf boxes must be given in the BVH leaves order
+    void Initialize(const BVH& bvh, const std::vector<Uint32>& leavesOrder, const math::Box* leafBoxes);
+
+    void Clear();
+
+    // add a leaf with unused ID
+    // fails if the tree would be too deep (the leaf is not added then and the BVH must be rebuilt)
+    bool InsertLeaf(BVH& bvh, Uint32 leafID, const math::Box& box);
+
+    // remove a leaf from the tree (its ID can be inserted again later)
+    void RemoveLeaf(BVH& bvh, Uint32 leafID);
+
+    // change leaf's box, the leaf is reinserted at the best place for the new box
+    // fails if the tree would be too deep (the leaf stays at its old place with the new box then and the BVH should be rebuilt)
+    bool UpdateLeaf(BVH& bvh, Uint32 leafID, const math::Box& box);
+
+    bool ContainsLeaf(Uint32 leafID) const;
+
+    // leaf IDs referenced by leaf nodes (removed leaves leave unused entries, which are reused by inserted leaves)
+    RT_FORCE_INLINE const std::vector<Uint32>& GetLeavesOrder() const { return mLeavesOrder; }
+
+    // nodes written since the last ClearModifiedNodes call (unordered, may contain duplicates)
+    // allows for updating trees derived from the BVH without visiting all of its nodes
+    RT_FORCE_INLINE const std::vector<Uint32>& GetModifiedNodes() const { return mModifiedNodes; }
+    RT_FORCE_INLINE void ClearModifiedNodes() { mModifiedNodes.clear(); }
+
+private:
+    // create a new leaf node for given leaves order entry
+    bool AttachSlot(BVH& bvh, Uint32 slot);
+
+    // create a new leaf node next to given node (without checking the depth)
+    // the sibling is moved to the first node of given pair, which must be placed between the sibling and its children
+    void AttachSlotToSibling(BVH& bvh, Uint32 slot, Uint32 siblingIndex, Uint32 pairIndex);
+
+    // remove leaves order entry from its leaf node (the node is removed when it becomes empty)
+    // returns the entry's new position (entries of a leaf node must be contiguous)
+    Uint32 DetachSlot(BVH& bvh, Uint32 slot);
+
+    void SwapSlots(Uint32 slotA, Uint32 slotB);
+
+    // recalculate node boxes from given node up to the root
+    void RefitUpward(BVH& bvh, Uint32 nodeIndex);
+
+    // find space for a pair of children nodes, which must be placed after their parent
+    Uint32 AllocatePair(BVH& bvh, Uint32 parentIndex);
+
+    // take back given pair released earlier (restoring the nodes array if the pair was removed from its end)
+    Uint32 ReclaimPair(BVH& bvh, Uint32 pairIndex);
+
+    // mark pair of nodes as unused (trailing unused pairs are removed from the nodes array)
+    void ReleasePair(BVH& bvh, Uint32 pairIndex);
+
+    std::vector<Uint32> mLeavesOrder;   // leaves order entry -> leaf ID
+    std::vector<Uint32> mLeafSlots;     // leaf ID -> leaves order entry
+    std::vector<Uint32> mSlotNodes;     // leaves order entry -> leaf node
+    std::vector<math::Box, AlignmentAllocator<math::Box>> mLeafBoxes; // per leaves order entry
+    std::vector<Uint32> mParents;       // per node
+    std::vector<Uint32> mModifiedNodes;
+
+    // unused leaves order entries
+    std::vector<Uint32> mFreeSlots;
+
+    // first nodes of unused children pairs
+    std::set<Uint32> mFreePairs;
+};
+
+} // namespace rt
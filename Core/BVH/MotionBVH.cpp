@@ -0,0 +1,122 @@
+#include "PCH.h"
+#include "MotionBVH.h"
+#include "Utils/Logger.h"
+
+
+namespace rt {
+
+using namespace math;
+
+static_assert(sizeof(MotionBVH::Node) == 64, "Invalid node size");
+
+MotionBVH::MotionBVH()
+    : mNumNodes(0)
+{ }
+
+void MotionBVH::Clear()
+{
+    mNodes.clear();
+    mNumNodes = 0;
+}
+
+template<typename LeafBoxesGetter>
+void MotionBVH::UpdateNode(const BVH& topology, Uint32 nodeIndex, const LeafBoxesGetter& getLeafBoxes)
+{
+    Node& node = mNodes[nodeIndex];
+    node.start = topology.GetNodes()[nodeIndex];
+    node.padding[0] = node.padding[1] = 0;
+
+    Box box0 = Box::Empty();
+    Box box1 = Box::Empty();
+
+    if (nodeIndex == 1)
+    {
+        // unused padding node
+    }
+    else if (node.IsLeaf())
+    {
+        for (Uint32 j = 0; j < node.start.numLeaves; ++j)
+        {
+            Box leafBox0, leafBox1;
+            getLeafBoxes(node.start.childIndex + j, leafBox0, leafBox1);
+            box0 = Box(box0, leafBox0);
+            box1 = Box(box1, leafBox1);
+        }
+    }
+    else if (node.start.childIndex > nodeIndex)
+    {
+        const Node& childA = mNodes[node.start.childIndex];
+        const Node& childB = mNodes[node.start.childIndex + 1];
+        box0 = Box(childA.start.GetBox(), childB.start.GetBox());
+        box1 = Box(childA.GetEndBox(), childB.GetEndBox());
+    }
+    // else: unused node (freed by BVHUpdater)
+
+    node.start.min = box0.min.ToFloat3();
+    node.start.max = box0.max.ToFloat3();
+    node.endMin = box1.min.ToFloat3();
+    node.endMax = box1.max.ToFloat3();
+}
+
+bool MotionBVH::Build(const BVH& topology, const Box* startBoxes, const Box* endBoxes)
+{
+    Clear();
+
+    const Uint32 numNodes = topology.GetNumNodes();
+    if (numNodes == 0)
+    {
+        return true;
+    }
+
+    if (!startBoxes || !endBoxes)
+    {
+        RT_LOG_ERROR("Missing leaf boxes for motion BVH");
+        return false;
+    }
+
+    mNodes.resize(numNodes);
+
+    const auto getLeafBoxes = [startBoxes, endBoxes](Uint32 leafIndex, Box& outStartBox, Box& outEndBox)
+    {
+        outStartBox = startBoxes[leafIndex];
+        outEndBox = endBoxes[leafIndex];
+    };
+
+    // children always follow their parent, so iterating backwards visits them first
+    for (Uint32 i = numNodes; i-- > 0; )
+    {
+        UpdateNode(topology, i, getLeafBoxes);
+    }
+
+    mNumNodes = numNodes;
+    return true;
+}
+
+void MotionBVH::Refit(const BVH& topology, const std::vector<Uint32>& modifiedNodes, const LeafBoxesCallback& leafBoxesCallback)
+{
+    const Uint32 numNodes = topology.GetNumNodes();
+    if (numNodes == 0)
+    {
+        Clear();
+        return;
+    }
+
+    // new nodes are only appended
+    mNodes.resize(numNodes);
+    mNumNodes = numNodes;
+
+    // children always follow their parent, so processing the nodes backwards visits them first
+    std::vector<Uint32> nodes(modifiedNodes);
+    std::sort(nodes.begin(), nodes.end());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+
+    for (auto it = nodes.rbegin(); it != nodes.rend(); ++it)
+    {
+        if (*it < numNodes)
+        {
+            UpdateNode(topology, *it, leafBoxesCallback);
+        }
+    }
+}
+
+} // namespace rt
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "BVH.h"
+
+#include <functional>
+
+
+namespace rt {
+
+// Bounding Volume Hierarchy of moving objects.
+// Uses topology of a regular (binary) BVH, but each node stores bounds at time=0.0 and time=1.0.
+// Bounds for a given time are linearly interpolated, which is conservative as long as the leaf boxes
+// themselves are (e.g. for translating objects), so the nodes are much tighter than a static BVH built
+// from the bounding boxes of the whole motion.
+class RAYLIB_API MotionBVH
+{
+public:
+    struct RT_ALIGN(32) Node
+    {
+        // bounds at time=0.0 along with child index and leaves count (passed to leaf callbacks)
+        BVH::Node start;
+
+        // bounds at time=1.0
+        math::Float3 endMin;
+        math::Float3 endMax;
+        Uint32 padding[2];
+
+        RT_FORCE_INLINE math::Box GetEndBox() const
+        {
+            return math::Box(
+                math::Vector4(&endMin.x) & math::Vector4::MakeMask<1,1,1,0>(),
+                math::Vector4(&endMax.x) & math::Vector4::MakeMask<1,1,1,0>()
+            );
+        }
+
+        // bounds interpolated for given time
+        RT_FORCE_INLINE math::Box GetBox(const float time) const
+        {
+            const math::Box box0 = start.GetBox();
+            const math::Box box1 = GetEndBox();
+            const math::Vector4 weight(time);
+            return math::Box(
+                math::Vector4::Lerp(box0.min, box1.min, weight),
+                math::Vector4::Lerp(box0.max, box1.max, weight)
+            );
+        }
+
+        RT_FORCE_INLINE math::Box_Simd8 GetBox_Simd8(const float time) const
+        {
+            return math::Box_Simd8(GetBox(time));
+        }
+
+        RT_FORCE_INLINE bool IsLeaf() const
+        {
+            return start.IsLeaf();
+        }
+
+        RT_FORCE_INLINE Uint32 GetSplitAxis() const
+        {
+            return start.GetSplitAxis();
+        }
+    };
+
+    // returns bounds of a leaf (given by its position in the BVH leaves order) at time=0.0 and time=1.0
+    using LeafBoxesCallback = std::function<void(Uint32 leafIndex, math::Box& outStartBox, math::Box& outEndBox)>;
+
+    MotionBVH();
+    MotionBVH(MotionBVH&& rhs) = default;
+    MotionBVH& operator = (MotionBVH&& rhs) = default;
+
+    // build from given tree topology and leaf boxes at time=0.0 and time=1.0
+    // leaf boxes must be given in the BVH leaves order
+    bool Build(const BVH& topology, const math::Box* startBoxes, const math::Box* endBoxes);
+
+    // update given nodes after incremental changes of the topology (see BVHUpdater::GetModifiedNodes)
+    // all the other nodes must be unchanged since the last update, parents of the modified nodes must be listed too
+    void Refit(const BVH& topology, const std::vector<Uint32>& modifiedNodes, const LeafBoxesCallback& leafBoxesCallback);
+
+    void Clear();
+
+    RT_FORCE_INLINE const Node* GetNodes() const { return mNodes.data(); }
+    RT_FORCE_INLINE Uint32 GetNumNodes() const { return mNumNodes; }
+
+private:
+    // calculate node bounds from its leaves or (already calculated) children
+    template<typename LeafBoxesGetter>
+    void UpdateNode(const BVH& topology, Uint32 nodeIndex, const LeafBoxesGetter& getLeafBoxes);
+
+    std::vector<Node, AlignmentAllocator<Node, RT_CACHE_LINE_SIZE>> mNodes;
+    Uint32 mNumNodes;
+};
+
+
+} // namespace rt
@@ -0,0 +1,689 @@
+#include "PCH.h"
+#include "WideBVH.h"
+#include "Utils/Logger.h"
+
+
+namespace rt {
+
+using namespace math;
+
+static_assert(sizeof(BVH4::Node) == 128, "Invalid node size");
+static_assert(sizeof(BVH8::Node) == 256, "Invalid node size");
+static_assert(sizeof(QuantizedBVH4::Node) == 96, "Invalid node size");
+static_assert(sizeof(QuantizedBVH8::Node) == 128, "Invalid node size");
+
+namespace {
+
+const Uint32 WideBvhFileVersion = 1;
+const Uint32 WideBvhMagic = 'wbvh';
+
+// nodes are placed at cache line boundary (the same way as in binary BVH files)
+const Uint32 WideBvhFileDataAlignment = RT_CACHE_LINE_SIZE;
+
+struct WideBVHFileHeader
+{
+    Uint32 magic;
+    Uint32 version;
+    Uint64 contentHash;
+    Uint32 nodeSize;
+    Uint32 width;
+    Uint32 quantized;
+    Uint32 numNodes;
+    Uint64 nodesOffset;     // offset of the nodes data from the file beginning
+};
+
+static_assert(sizeof(WideBVHFileHeader) <= WideBvhFileDataAlignment, "Wide BVH file header is too big");
+
+// smallest power of two not less than given value
+Float RoundUpToPowerOfTwo(Float value)
+{
+    int exponent;
+    const Float mantissa = std::frexp(value, &exponent);
+    return std::ldexp(mantissa == 0.5f ? 0.5f : 1.0f, exponent);
+}
+
+} // namespace
+
+template <Uint32 Width, bool Quantized>
+void WideBVH<Width, Quantized>::FullPrecisionNode::Set(const ChildrenDesc& children)
+{
+    for (Uint32 i = 0; i < Width; ++i)
+    {
+        if (i < children.numChildren)
+        {
+            const Box& box = children.boxes[i];
+            childMinX[i] = box.min.x;
+            childMinY[i] = box.min.y;
+            childMinZ[i] = box.min.z;
+            childMaxX[i] = box.max.x;
+            childMaxY[i] = box.max.y;
+            childMaxZ[i] = box.max.z;
+            childIndex[i] = children.indices[i];
+            childNumLeaves[i] = children.numLeaves[i];
+        }
+        else
+        {
+            childMinX[i] = childMinY[i] = childMinZ[i] = FLT_MAX;
+            childMaxX[i] = childMaxY[i] = childMaxZ[i] = -FLT_MAX;
+            childIndex[i] = InvalidIndex;
+            childNumLeaves[i] = 0;
+        }
+    }
+}
+
+template <Uint32 Width, bool Quantized>
+void WideBVH<Width, Quantized>::QuantizedNode::Set(const ChildrenDesc& children)
+{
+    Box nodeBox = Box::Empty();
+    for (Uint32 i = 0; i < children.numChildren; ++i)
+    {
+        nodeBox = Box(nodeBox, children.boxes[i]);
+    }
+
+    for (Uint32 axis = 0; axis < 3; ++axis)
+    {
+        // enlarge the extent slightly, so the last quantization step reaches the node's max for sure
+        const Float extent = nodeBox.max[axis] - nodeBox.min[axis];
+        origin[axis] = nodeBox.min[axis];
+        scale[axis] = extent > 0.0f ? RoundUpToPowerOfTwo(extent * (1.0f + 1.0e-5f) / 255.0f) : 0.0f;
+    }
+
+    Uint8* childMin[3] = { childMinX, childMinY, childMinZ };
+    Uint8* childMax[3] = { childMaxX, childMaxY, childMaxZ };
+
+    for (Uint32 i = 0; i < Width; ++i)
+    {
+        if (i >= children.numChildren)
+        {
+            for (Uint32 axis = 0; axis < 3; ++axis)
+            {
+                childMin[axis][i] = 255;
+                childMax[axis][i] = 0;
+            }
+            childIndex[i] = InvalidIndex;
+            childNumLeaves[i] = 0;
+            continue;
+        }
+
+        const Box& box = children.boxes[i];
+        for (Uint32 axis = 0; axis < 3; ++axis)
+        {
+            Int32 qMin = 0;
+            Int32 qMax = 0;
+            if (scale[axis] > 0.0f)
+            {
+                qMin = static_cast<Int32>(std::floor((box.min[axis] - origin[axis]) / scale[axis]));
+                qMax = static_cast<Int32>(std::ceil((box.max[axis] - origin[axis]) / scale[axis]));
+                qMin = std::min(std::max(qMin, 0), 255);
+                qMax = std::min(std::max(qMax, 0), 255);
+
+                // make sure the decoded box is conservative despite rounding
+                while (qMin > 0 && Decode(static_cast<Uint8>(qMin), axis) > box.min[axis])
+                {
+                    qMin--;
+                }
+                while (qMax < 255 && Decode(static_cast<Uint8>(qMax), axis) < box.max[axis])
+                {
+                    qMax++;
+                }
+            }
+
+            childMin[axis][i] = static_cast<Uint8>(qMin);
+            childMax[axis][i] = static_cast<Uint8>(qMax);
+            RT_ASSERT(Decode(childMin[axis][i], axis) <= box.min[axis]);
+            RT_ASSERT(Decode(childMax[axis][i], axis) >= box.max[axis]);
+        }
+
+        RT_ASSERT(children.numLeaves[i] <= 255); // Too many leaves for quantized node
+        childIndex[i] = children.indices[i];
+        childNumLeaves[i] = static_cast<Uint8>(children.numLeaves[i]);
+    }
+}
+
+template <Uint32 Width, bool Quantized>
+constexpr Uint32 WideBVH<Width, Quantized>::InvalidIndex;
+
+template <Uint32 Width, bool Quantized>
+WideBVH<Width, Quantized>::WideBVH()
+    : mNumNodes(0)
+    , mAllowUpdates(false)
+{ }
+
+template <Uint32 Width, bool Quantized>
+void WideBVH<Width, Quantized>::Clear()
+{
+    mNodes.clear();
+    mNumNodes = 0;
+
+    mAllowUpdates = false;
+    mSourceNodes.clear();
+    mParents.clear();
+    mTargetNodes.clear();
+    mOwners.clear();
+    mFreeNodes.clear();
+}
+
+template <Uint32 Width, bool Quantized>
+bool WideBVH<Width, Quantized>::Build(const BVH& source, bool allowUpdates)
+{
+    Clear();
+
+    mAllowUpdates = allowUpdates;
+
+    if (source.GetNumNodes() == 0)
+    {
+        return true;
+    }
+
+    if (Quantized)
+    {
+        // leaf counts are stored in 8 bits
+        for (Uint32 i = 0; i < source.GetNumNodes(); ++i)
+        {
+            if (source.GetNodes()[i].numLeaves > 255)
+            {
+                RT_LOG_ERROR("BVH leaf node is too big to be quantized (%u leaves)", (Uint32)source.GetNodes()[i].numLeaves);
+                return false;
+            }
+        }
+    }
+
+    if (mAllowUpdates)
+    {
+        mTargetNodes.resize(source.GetNumNodes(), InvalidIndex);
+        mOwners.resize(source.GetNumNodes(), InvalidIndex);
+    }
+
+    // each wide node replaces at least two binary nodes
+    mNodes.reserve(source.GetNumNodes() / 2 + 1);
+    AllocateNode(0, InvalidIndex);
+
+    CollapseNode(source, 0, 0);
+
+    mNodes.shrink_to_fit();
+    mNumNodes = static_cast<Uint32>(mNodes.size());
+    return true;
+}
+
+template <Uint32 Width, bool Quantized>
+bool WideBVH<Width, Quantized>::Update(const BVH& source, const std::vector<Uint32>& modifiedNodes)
+{
+    RT_ASSERT(mAllowUpdates, "Wide BVH was built without updates allowed");
+
+    const Uint32 numSourceNodes = source.GetNumNodes();
+    if (numSourceNodes == 0)
+    {
+        Clear();
+        mAllowUpdates = true;
+        return true;
+    }
+
+    if (mNumNodes == 0)
+    {
+        return Build(source, true);
+    }
+
+    // source nodes may be appended (removed nodes keep their entries, so the mapping never shrinks)
+    if (mTargetNodes.size() < numSourceNodes)
+    {
+        mTargetNodes.resize(numSourceNodes, InvalidIndex);
+        mOwners.resize(numSourceNodes, InvalidIndex);
+    }
+
+    // find wide nodes reading any of the modified nodes
+    std::vector<Uint32> dirtyNodes;
+    for (const Uint32 sourceIndex : modifiedNodes)
+    {
+        if (sourceIndex >= mTargetNodes.size())
+        {
+            continue;
+        }
+
+        if (Quantized && sourceIndex < numSourceNodes && source.GetNodes()[sourceIndex].numLeaves > 255)
+        {
+            RT_LOG_ERROR("BVH leaf node is too big to be quantized (%u leaves)", (Uint32)source.GetNodes()[sourceIndex].numLeaves);
+            return false;
+        }
+
+        if (mOwners[sourceIndex] != InvalidIndex)
+        {
+            dirtyNodes.push_back(mOwners[sourceIndex]);
+        }
+        if (mTargetNodes[sourceIndex] != InvalidIndex)
+        {
+            dirtyNodes.push_back(mTargetNodes[sourceIndex]);
+        }
+    }
+
+    // process parents first (their children always follow them in the source BVH), so a node detached
+    // by its parent is released instead of being collapsed from a removed source node
+    std::sort(dirtyNodes.begin(), dirtyNodes.end(), [this](Uint32 a, Uint32 b)
+    {
+        return mSourceNodes[a] < mSourceNodes[b];
+    });
+    dirtyNodes.erase(std::unique(dirtyNodes.begin(), dirtyNodes.end()), dirtyNodes.end());
+
+    std::vector<Uint32> detachedNodes;
+    for (const Uint32 nodeIndex : dirtyNodes)
+    {
+        // skip nodes released earlier (their owner entries may be stale)
+        if (mSourceNodes[nodeIndex] == InvalidIndex || !IsAttached(nodeIndex))
+        {
+            continue;
+        }
+
+        Uint32 oldChildren[Width];
+        Uint32 numOldChildren = 0;
+        for (Uint32 i = 0; i < Width; ++i)
+        {
+            if (mNodes[nodeIndex].IsChildValid(i) && !mNodes[nodeIndex].IsChildLeaf(i))
+            {
+                oldChildren[numOldChildren++] = mNodes[nodeIndex].childIndex[i];
+            }
+        }
+
+        CollapseNode(source, mSourceNodes[nodeIndex], nodeIndex);
+
+        // reused children were assigned to this node again
+        for (Uint32 i = 0; i < numOldChildren; ++i)
+        {
+            const Uint32 childIndex = oldChildren[i];
+            if (mParents[childIndex] != nodeIndex)
+            {
+                continue;
+            }
+
+            bool isReused = false;
+            for (Uint32 j = 0; j < Width; ++j)
+            {
+                isReused |= mNodes[nodeIndex].IsChildValid(j) && !mNodes[nodeIndex].IsChildLeaf(j) && mNodes[nodeIndex].childIndex[j] == childIndex;
+            }
+
+            if (!isReused)
+            {
+                mParents[childIndex] = InvalidIndex;
+                detachedNodes.push_back(childIndex);
+            }
+        }
+    }
+
+    // detached subtrees can be reused by any of the collapsed nodes, so they are released at the end
+    ReleaseNodes(detachedNodes);
+
+    mNumNodes = static_cast<Uint32>(mNodes.size());
+    return true;
+}
+
+template <Uint32 Width, bool Quantized>
+Uint32 WideBVH<Width, Quantized>::GatherChildren(const BVH& source, Uint32 sourceIndex, Uint32 targetIndex, Uint32* outChildren)
+{
+    const BVH::Node* sourceNodes = source.GetNodes();
+
+    // start with the source node itself and greedily open the child with the biggest surface area
+    Uint32 numChildren = 1;
+    outChildren[0] = sourceIndex;
+
+    while (numChildren < Width)
+    {
+        Uint32 bestSlot = InvalidIndex;
+        Float bestArea = -1.0f;
+        for (Uint32 i = 0; i < numChildren; ++i)
+        {
+            const BVH::Node& child = sourceNodes[outChildren[i]];
+            if (!child.IsLeaf())
+            {
+                const Float area = child.GetBox().SurfaceArea();
+                if (area > bestArea)
+                {
+                    bestArea = area;
+                    bestSlot = i;
+                }
+            }
+        }
+
+        if (bestSlot == InvalidIndex)
+        {
+            break;
+        }
+
+        if (mAllowUpdates && outChildren[bestSlot] != sourceIndex)
+        {
+            mOwners[outChildren[bestSlot]] = targetIndex;
+        }
+
+        // replace the node with its children, keeping the original (left-to-right) order
+        const Uint32 firstGrandChild = sourceNodes[outChildren[bestSlot]].childIndex;
+        for (Uint32 i = numChildren; i > bestSlot + 1; --i)
+        {
+            outChildren[i] = outChildren[i - 1];
+        }
+        outChildren[bestSlot] = firstGrandChild;
+        outChildren[bestSlot + 1] = firstGrandChild + 1;
+        numChildren++;
+    }
+
+    if (mAllowUpdates)
+    {
+        for (Uint32 i = 0; i < numChildren; ++i)
+        {
+            mOwners[outChildren[i]] = targetIndex;
+        }
+    }
+
+    return numChildren;
+}
+
+template <Uint32 Width, bool Quantized>
+void WideBVH<Width, Quantized>::CollapseNode(const BVH& source, Uint32 sourceIndex, Uint32 targetIndex)
+{
+    const BVH::Node* sourceNodes = source.GetNodes();
+
+    Uint32 children[Width];
+    const Uint32 numChildren = GatherChildren(source, sourceIndex, targetIndex, children);
+
+    // allocate all the inner children next to each other
+    Uint32 innerChildrenIndices[Width];
+    bool isNewChild[Width];
+    for (Uint32 i = 0; i < numChildren; ++i)
+    {
+        isNewChild[i] = false;
+        if (sourceNodes[children[i]].IsLeaf())
+        {
+            continue;
+        }
+
+        // the subtree is unchanged or its changed nodes will be updated separately
+        const Uint32 existingIndex = mAllowUpdates ? mTargetNodes[children[i]] : InvalidIndex;
+        if (existingIndex != InvalidIndex && mSourceNodes[existingIndex] == children[i])
+        {
+            innerChildrenIndices[i] = existingIndex;
+            mParents[existingIndex] = targetIndex;
+        }
+        else
+        {
+            innerChildrenIndices[i] = AllocateNode(children[i], targetIndex);
+            isNewChild[i] = true;
+        }
+    }
+
+    {
+        ChildrenDesc childrenDesc;
+        childrenDesc.numChildren = numChildren;
+        for (Uint32 i = 0; i < numChildren; ++i)
+        {
+            const BVH::Node& child = sourceNodes[children[i]];
+            childrenDesc.boxes[i] = child.GetBox();
+            childrenDesc.indices[i] = child.IsLeaf() ? child.childIndex : innerChildrenIndices[i];
+            childrenDesc.numLeaves[i] = child.numLeaves;
+        }
+
+        mNodes[targetIndex].Set(childrenDesc);
+    }
+
+    for (Uint32 i = 0; i < numChildren; ++i)
+    {
+        if (isNewChild[i])
+        {
+            CollapseNode(source, children[i], innerChildrenIndices[i]);
+        }
+    }
+}
+
+template <Uint32 Width, bool Quantized>
+Uint32 WideBVH<Width, Quantized>::AllocateNode(Uint32 sourceIndex, Uint32 parentIndex)
+{
+    if (!mAllowUpdates)
+    {
+        mNodes.emplace_back();
+        return static_cast<Uint32>(mNodes.size() - 1);
+    }
+
+    Uint32 nodeIndex;
+    if (!mFreeNodes.empty())
+    {
+        nodeIndex = mFreeNodes.back();
+        mFreeNodes.pop_back();
+    }
+    else
+    {
+        nodeIndex = static_cast<Uint32>(mNodes.size());
+        mNodes.emplace_back();
+        mSourceNodes.push_back(InvalidIndex);
+        mParents.push_back(InvalidIndex);
+    }
+
+    mSourceNodes[nodeIndex] = sourceIndex;
+    mParents[nodeIndex] = parentIndex;
+    mTargetNodes[sourceIndex] = nodeIndex;
+    return nodeIndex;
+}
+
+template <Uint32 Width, bool Quantized>
+void WideBVH<Width, Quantized>::ReleaseNodes(std::vector<Uint32>& nodes)
+{
+    while (!nodes.empty())
+    {
+        const Uint32 nodeIndex = nodes.back();
+        nodes.pop_back();
+
+        // reused or already released
+        if (mParents[nodeIndex] != InvalidIndex || mSourceNodes[nodeIndex] == InvalidIndex)
+        {
+            continue;
+        }
+
+        Node& node = mNodes[nodeIndex];
+        for (Uint32 i = 0; i < Width; ++i)
+        {
+            if (node.IsChildValid(i) && !node.IsChildLeaf(i) && mParents[node.childIndex[i]] == nodeIndex)
+            {
+                mParents[node.childIndex[i]] = InvalidIndex;
+                nodes.push_back(node.childIndex[i]);
+            }
+        }
+
+        const Uint32 sourceIndex = mSourceNodes[nodeIndex];
+        if (mTargetNodes[sourceIndex] == nodeIndex)
+        {
+            mTargetNodes[sourceIndex] = InvalidIndex;
+        }
+
+        ChildrenDesc emptyDesc;
+        emptyDesc.numChildren = 0;
+        node.Set(emptyDesc);
+
+        mSourceNodes[nodeIndex] = InvalidIndex;
+        mFreeNodes.push_back(nodeIndex);
+    }
+}
+
+template <Uint32 Width, bool Quantized>
+bool WideBVH<Width, Quantized>::IsAttached(Uint32 nodeIndex) const
+{
+    for (; nodeIndex != 0; nodeIndex = mParents[nodeIndex])
+    {
+        if (mParents[nodeIndex] == InvalidIndex)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <Uint32 Width, bool Quantized>
+bool WideBVH<Width, Quantized>::SaveToFile(const std::string& filePath, Uint64 contentHash) const
+{
+    FILE* file = fopen(filePath.c_str(), "wb");
+    if (!file)
+    {
+        RT_LOG_ERROR("Failed to open output wide BVH file '%s' for writing. Error code: %i", filePath.c_str(), errno);
+        return false;
+    }
+
+    WideBVHFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = WideBvhMagic;
+    header.version = WideBvhFileVersion;
+    header.contentHash = contentHash;
+    header.nodeSize = sizeof(Node);
+    header.width = Width;
+    header.quantized = Quantized ? 1 : 0;
+    header.numNodes = mNumNodes;
+    header.nodesOffset = WideBvhFileDataAlignment;
+
+    // header is padded to the nodes alignment
+    Uint8 headerData[WideBvhFileDataAlignment];
+    memset(headerData, 0, sizeof(headerData));
+    memcpy(headerData, &header, sizeof(header));
+
+    if (fwrite(headerData, sizeof(headerData), 1, file) != 1)
+    {
+        fclose(file);
+        RT_LOG_ERROR("Failed to write wide BVH file header");
+        return false;
+    }
+
+    if (fwrite(mNodes.data(), sizeof(Node), mNumNodes, file) != mNumNodes)
+    {
+        fclose(file);
+        RT_LOG_ERROR("Failed to write wide BVH nodes");
+        return false;
+    }
+
+    fclose(file);
+    return true;
+}
+
+template <Uint32 Width, bool Quantized>
+bool WideBVH<Width, Quantized>::LoadFromFile(const std::string& filePath, Uint64 expectedContentHash, Uint32 numLeaves)
+{
+    FileMapping fileMapping;
+    if (!fileMapping.Open(filePath))
+    {
+        RT_LOG_ERROR("Failed to open wide BVH file '%s' for reading", filePath.c_str());
+        return false;
+    }
+
+    const Uint8* fileData = static_cast<const Uint8*>(fileMapping.GetData());
+    const size_t fileSize = fileMapping.GetSize();
+
+    WideBVHFileHeader header;
+    if (fileSize < sizeof(WideBVHFileHeader))
+    {
+        RT_LOG_ERROR("Failed to read wide BVH file header");
+        return false;
+    }
+    memcpy(&header, fileData, sizeof(WideBVHFileHeader));
+
+    if (header.magic != WideBvhMagic)
+    {
+        RT_LOG_ERROR("Corrupted wide BVH file (invalid magic value)");
+        return false;
+    }
+
+    if (header.version != WideBvhFileVersion)
+    {
+        RT_LOG_ERROR("Unsupported wide BVH file version %u (expected %u)", header.version, WideBvhFileVersion);
+        return false;
+    }
+
+    if (header.nodeSize != sizeof(Node) || header.width != Width || header.quantized != (Quantized ? 1u : 0u))
+    {
+        RT_LOG_ERROR("Unsupported wide BVH node format (expected %u-wide%s nodes)", Width, Quantized ? " quantized" : "");
+        return false;
+    }
+
+    if (expectedContentHash != 0 && header.contentHash != expectedContentHash)
+    {
+        RT_LOG_ERROR("Wide BVH file '%s' is out of date (content hash mismatch)", filePath.c_str());
+        return false;
+    }
+
+    const Uint64 nodesDataSize = sizeof(Node) * static_cast<Uint64>(header.numNodes);
+    if (header.nodesOffset % WideBvhFileDataAlignment != 0 || header.nodesOffset + nodesDataSize != fileSize)
+    {
+        RT_LOG_ERROR("Corrupted wide BVH file (invalid data layout)");
+        return false;
+    }
+
+    Clear();
+
+    const Node* nodes = reinterpret_cast<const Node*>(fileData + header.nodesOffset);
+    mNodes.assign(nodes, nodes + header.numNodes);
+    mNumNodes = header.numNodes;
+
+    if (!ValidateNodes(numLeaves))
+    {
+        Clear();
+        RT_LOG_ERROR("Corrupted wide BVH file (invalid node or leaf ranges)");
+        return false;
+    }
+
+    return true;
+}
+
+template <Uint32 Width, bool Quantized>
+bool WideBVH<Width, Quantized>::ValidateNodes(Uint32 numLeaves) const
+{
+    if (mNumNodes == 0)
+    {
+        return true;
+    }
+
+    std::vector<bool> visited(mNumNodes, false);
+
+    // each level pushes at most Width nodes
+    Uint32 stack[BVH::MaxDepth * Width];
+    Uint32 depthStack[BVH::MaxDepth * Width];
+    Uint32 stackSize = 0;
+    stack[stackSize] = 0;
+    depthStack[stackSize++] = 1;
+
+    while (stackSize > 0)
+    {
+        const Uint32 nodeIndex = stack[--stackSize];
+        const Uint32 depth = depthStack[stackSize];
+
+        // each node must be referenced once (this also rejects cycles)
+        if (visited[nodeIndex])
+        {
+            return false;
+        }
+        visited[nodeIndex] = true;
+
+        const Node& node = mNodes[nodeIndex];
+        for (Uint32 i = 0; i < Width; ++i)
+        {
+            if (!node.IsChildValid(i))
+            {
+                continue;
+            }
+
+            if (node.IsChildLeaf(i))
+            {
+                if (static_cast<Uint64>(node.childIndex[i]) + node.childNumLeaves[i] > numLeaves)
+                {
+                    return false;
+                }
+                continue;
+            }
+
+            if (depth >= BVH::MaxDepth || node.childIndex[i] >= mNumNodes)
+            {
+                return false;
+            }
+
+            stack[stackSize] = node.childIndex[i];
+            depthStack[stackSize++] = depth + 1;
+        }
+    }
+
+    return true;
+}
+
+template class WideBVH<4, false>;
+template class WideBVH<8, false>;
+template class WideBVH<4, true>;
+template class WideBVH<8, true>;
+
+} // namespace rt
@@ -0,0 +1,333 @@
+#pragma once
+
+#include "BVH.h"
+#include "../Config.h"
+
+
+namespace rt {
+
+// Bounding Volume Hierarchy with 4 or 8 children per node, collapsed from the binary one.
+// Child boxes are stored in SoA layout, so all children of a node are tested at once with a single AVX box test.
+// Quantized variant stores child boxes as 8-bit offsets relative to the node's frame (conservatively rounded),
+// which halves the node size (it's selected with RT_BVH_QUANTIZED_NODES for meshes and scenes).
+template <Uint32 Width, bool Quantized = false>
+class RAYLIB_API WideBVH
+{
+public:
+    static_assert(Width == 4 || Width == 8, "Unsupported BVH width");
+
+    static constexpr Uint32 NumChildren = Width;
+    static constexpr Uint32 ChildrenMask = (1u << Width) - 1u;
+
+    // marks unused child slot
+    static constexpr Uint32 InvalidIndex = 0xFFFFFFFF;
+
+    // child data shared by both node formats
+    struct ChildrenDesc
+    {
+        math::Box boxes[Width];
+        Uint32 indices[Width];
+        Uint32 numLeaves[Width];
+        Uint32 numChildren;
+    };
+
+    struct RT_ALIGN(32) FullPrecisionNode
+    {
+        // child bounding boxes (unused slots have inverted boxes)
+        float childMinX[Width];
+        float childMinY[Width];
+        float childMinZ[Width];
+        float childMaxX[Width];
+        float childMaxY[Width];
+        float childMaxZ[Width];
+
+        // child node index or first leaf index
+        Uint32 childIndex[Width];
+
+        // number of leaves in a child (0 if the child is an inner node)
+        Uint32 childNumLeaves[Width];
+
+        void Set(const ChildrenDesc& children);
+
+        RT_FORCE_INLINE bool IsChildValid(Uint32 slot) const
+        {
+            return childIndex[slot] != InvalidIndex;
+        }
+
+        // bit mask of used child slots
+        RT_FORCE_INLINE Uint32 GetValidChildrenMask() const
+        {
+            return CalculateValidChildrenMask(childIndex);
+        }
+
+        RT_FORCE_INLINE bool IsChildLeaf(Uint32 slot) const
+        {
+            return childNumLeaves[slot] != 0;
+        }
+
+        RT_FORCE_INLINE math::Box GetChildBox(Uint32 slot) const
+        {
+            return math::Box(
+                math::Vector4(childMinX[slot], childMinY[slot], childMinZ[slot], 0.0f),
+                math::Vector4(childMaxX[slot], childMaxY[slot], childMaxZ[slot], 0.0f));
+        }
+
+        // load all the child boxes (4-wide nodes are duplicated in high lanes)
+        RT_FORCE_INLINE math::Box_Simd8 GetChildBoxes_Simd8() const
+        {
+            math::Box_Simd8 ret;
+            ret.min.x = LoadLanes(childMinX);
+            ret.min.y = LoadLanes(childMinY);
+            ret.min.z = LoadLanes(childMinZ);
+            ret.max.x = LoadLanes(childMaxX);
+            ret.max.y = LoadLanes(childMaxY);
+            ret.max.z = LoadLanes(childMaxZ);
+            return ret;
+        }
+
+        // splat single child box
+        RT_FORCE_INLINE math::Box_Simd8 GetChildBox_Simd8(Uint32 slot) const
+        {
+            math::Box_Simd8 ret;
+            ret.min.x = math::Vector8(childMinX[slot]);
+            ret.min.y = math::Vector8(childMinY[slot]);
+            ret.min.z = math::Vector8(childMinZ[slot]);
+            ret.max.x = math::Vector8(childMaxX[slot]);
+            ret.max.y = math::Vector8(childMaxY[slot]);
+            ret.max.z = math::Vector8(childMaxZ[slot]);
+            return ret;
+        }
+
+    private:
+        RT_FORCE_INLINE static math::Vector8 LoadLanes(const float* values)
+        {
+            return Width == 8 ?
+                math::Vector8(values) :
+                math::Vector8(math::Vector4(values), math::Vector4(values));
+        }
+    };
+
+    struct RT_ALIGN(32) QuantizedNode
+    {
+        // child node index or first leaf index
+        Uint32 childIndex[Width];
+
+        // node frame: child box coordinate is decoded as "origin + q * scale" (scale is a power of two, so the
+        // multiplication is exact and the decoded value is the same for scalar, SIMD and FMA code)
+        float origin[3];
+        float scale[3];
+
+        // quantized child bounding boxes (unused slots have inverted boxes)
+        Uint8 childMinX[Width];
+        Uint8 childMinY[Width];
+        Uint8 childMinZ[Width];
+        Uint8 childMaxX[Width];
+        Uint8 childMaxY[Width];
+        Uint8 childMaxZ[Width];
+
+        // number of leaves in a child (0 if the child is an inner node)
+        Uint8 childNumLeaves[Width];
+
+        void Set(const ChildrenDesc& children);
+
+        RT_FORCE_INLINE bool IsChildValid(Uint32 slot) const
+        {
+            return childIndex[slot] != InvalidIndex;
+        }
+
+        // bit mask of used child slots
+        RT_FORCE_INLINE Uint32 GetValidChildrenMask() const
+        {
+            return CalculateValidChildrenMask(childIndex);
+        }
+
+        RT_FORCE_INLINE bool IsChildLeaf(Uint32 slot) const
+        {
+            return childNumLeaves[slot] != 0;
+        }
+
+        RT_FORCE_INLINE float Decode(Uint8 value, Uint32 axis) const
+        {
+            return origin[axis] + static_cast<float>(value) * scale[axis];
+        }
+
+        RT_FORCE_INLINE math::Box GetChildBox(Uint32 slot) const
+        {
+            return math::Box(
+                math::Vector4(Decode(childMinX[slot], 0), Decode(childMinY[slot], 1), Decode(childMinZ[slot], 2), 0.0f),
+                math::Vector4(Decode(childMaxX[slot], 0), Decode(childMaxY[slot], 1), Decode(childMaxZ[slot], 2), 0.0f));
+        }
+
+        // decode all the child boxes (4-wide nodes are duplicated in high lanes)
+        RT_FORCE_INLINE math::Box_Simd8 GetChildBoxes_Simd8() const
+        {
+            math::Box_Simd8 ret;
+            ret.min.x = DecodeLanes(childMinX, 0);
+            ret.min.y = DecodeLanes(childMinY, 1);
+            ret.min.z = DecodeLanes(childMinZ, 2);
+            ret.max.x = DecodeLanes(childMaxX, 0);
+            ret.max.y = DecodeLanes(childMaxY, 1);
+            ret.max.z = DecodeLanes(childMaxZ, 2);
+            return ret;
+        }
+
+        // splat single child box
+        RT_FORCE_INLINE math::Box_Simd8 GetChildBox_Simd8(Uint32 slot) const
+        {
+            math::Box_Simd8 ret;
+            ret.min.x = math::Vector8(Decode(childMinX[slot], 0));
+            ret.min.y = math::Vector8(Decode(childMinY[slot], 1));
+            ret.min.z = math::Vector8(Decode(childMinZ[slot], 2));
+            ret.max.x = math::Vector8(Decode(childMaxX[slot], 0));
+            ret.max.y = math::Vector8(Decode(childMaxY[slot], 1));
+            ret.max.z = math::Vector8(Decode(childMaxZ[slot], 2));
+            return ret;
+        }
+
+    private:
+        RT_FORCE_INLINE math::Vector8 DecodeLanes(const Uint8* values, Uint32 axis) const
+        {
+            Int32 packed;
+            memcpy(&packed, values, sizeof(packed));
+            const __m128i lo = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed));
+
+#ifdef RT_USE_AVX
+            __m256i integers;
+            if (Width == 8)
+            {
+                integers = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(values)));
+            }
+            else
+            {
+                integers = _mm256_insertf128_si256(_mm256_castsi128_si256(lo), lo, 1);
+            }
+
+            const math::Vector8 q(_mm256_cvtepi32_ps(integers));
+#else
+            __m128i hi = lo;
+            if (Width == 8)
+            {
+                memcpy(&packed, values + 4, sizeof(packed));
+                hi = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed));
+            }
+
+            const math::Vector8 q(math::Vector4(_mm_cvtepi32_ps(lo)), math::Vector4(_mm_cvtepi32_ps(hi)));
+#endif // RT_USE_AVX
+            return math::Vector8::MulAndAdd(q, math::Vector8(scale[axis]), math::Vector8(origin[axis]));
+        }
+    };
+
+    using Node = typename std::conditional<Quantized, QuantizedNode, FullPrecisionNode>::type;
+
+    WideBVH();
+    WideBVH(WideBVH&& rhs) = default;
+    WideBVH& operator = (WideBVH&& rhs) = default;
+
+    // collapse binary BVH into the wide one
+    // if updates are allowed, mapping between nodes of both trees is kept for the Update function
+    bool Build(const BVH& source, bool allowUpdates = false);
+
+    // collapse again only the nodes affected by incremental changes of the source (see BVHUpdater::GetModifiedNodes)
+    // all the other source nodes must be unchanged since the last update, parents of the modified nodes must be listed too
+    // NOTE: children must be placed after their parent in the source BVH
+    bool Update(const BVH& source, const std::vector<Uint32>& modifiedNodes);
+
+    void Clear();
+
+    // save nodes of a built tree (mapping used by the Update function is not saved)
+    // content hash identifies the data the tree was collapsed from, so stale files can be detected
+    bool SaveToFile(const std::string& filePath, Uint64 contentHash = 0) const;
+
+    // load tree saved with SaveToFile (nodes are copied, the file is closed afterwards)
+    // fails if the content hash is non-zero and it does not match the file's one, if the file was saved
+    // for different node format, or if the nodes don't form a valid tree referencing less than numLeaves leaves
+    bool LoadFromFile(const std::string& filePath, Uint64 expectedContentHash, Uint32 numLeaves);
+
+    // make leaf descriptor accepted by the Traverse_Leaf_* callbacks
+    RT_FORCE_INLINE static BVH::Node MakeLeaf(Uint32 firstLeaf, Uint32 numLeaves)
+    {
+        BVH::Node leaf;
+        leaf.childIndex = firstLeaf;
+        leaf.numLeaves = numLeaves;
+        leaf.splitAxis = 0;
+        return leaf;
+    }
+
+    RT_FORCE_INLINE const Node* GetNodes() const { return mNodes.data(); }
+    RT_FORCE_INLINE Uint32 GetNumNodes() const { return mNumNodes; }
+
+private:
+    RT_FORCE_INLINE static Uint32 CalculateValidChildrenMask(const Uint32* childIndices)
+    {
+        Uint32 invalidMask;
+        if (Width == 8)
+        {
+#ifdef RT_USE_AVX
+            const __m256i indices = _mm256_load_si256(reinterpret_cast<const __m256i*>(childIndices));
+            invalidMask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(indices, _mm256_set1_epi32(-1))));
+#else
+            const __m128i lo = _mm_load_si128(reinterpret_cast<const __m128i*>(childIndices));
+            const __m128i hi = _mm_load_si128(reinterpret_cast<const __m128i*>(childIndices + 4));
+            invalidMask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(lo, _mm_set1_epi32(-1)))) |
+                          (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(hi, _mm_set1_epi32(-1)))) << 4);
+#endif // RT_USE_AVX
+        }
+        else
+        {
+            const __m128i indices = _mm_load_si128(reinterpret_cast<const __m128i*>(childIndices));
+            invalidMask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(indices, _mm_set1_epi32(-1))));
+        }
+        return ~invalidMask & ChildrenMask;
+    }
+
+    // find children of a wide node by greedily opening the binary node's subtree
+    Uint32 GatherChildren(const BVH& source, Uint32 sourceIndex, Uint32 targetIndex, Uint32* outChildren);
+
+    // fill wide node with children found by opening the binary node's subtree
+    // when updating, existing nodes collapsed from the inner children are reused instead of collapsing them again
+    void CollapseNode(const BVH& source, Uint32 sourceIndex, Uint32 targetIndex);
+
+    Uint32 AllocateNode(Uint32 sourceIndex, Uint32 parentIndex);
+
+    // free nodes which are no longer referenced, along with their subtrees (except reused nodes)
+    void ReleaseNodes(std::vector<Uint32>& nodes);
+
+    // check if a node is reachable from the root
+    bool IsAttached(Uint32 nodeIndex) const;
+
+    // check that the nodes reachable from the root form a tree within the arrays' bounds
+    bool ValidateNodes(Uint32 numLeaves) const;
+
+    std::vector<Node, AlignmentAllocator<Node, RT_CACHE_LINE_SIZE>> mNodes;
+    Uint32 mNumNodes;
+
+    // mapping between the trees, used only if updates are allowed
+    bool mAllowUpdates;
+    std::vector<Uint32> mSourceNodes;   // per wide node: binary node it was collapsed from
+    std::vector<Uint32> mParents;       // per wide node
+    std::vector<Uint32> mTargetNodes;   // per binary node: wide node collapsed from it
+    std::vector<Uint32> mOwners;        // per binary node: wide node, which opened it or references it as a child
+    std::vector<Uint32> mFreeNodes;
+};
+
+using BVH4 = WideBVH<4>;
+using BVH8 = WideBVH<8>;
+using QuantizedBVH4 = WideBVH<4, true>;
+using QuantizedBVH8 = WideBVH<8, true>;
+
+extern template class WideBVH<4, false>;
+extern template class WideBVH<8, false>;
+extern template class WideBVH<4, true>;
+extern template class WideBVH<8, true>;
+
+#if RT_BVH_WIDTH > 2
+// wide BVH used for traversal of meshes and scenes
+#ifdef RT_BVH_QUANTIZED_NODES
+using DefaultWideBVH = WideBVH<RT_BVH_WIDTH, true>;
+#else
+using DefaultWideBVH = WideBVH<RT_BVH_WIDTH, false>;
+#endif // RT_BVH_QUANTIZED_NODES
+#endif // RT_BVH_WIDTH > 2
+
+
+} // namespace rt
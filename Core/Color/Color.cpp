@@ -169,8 +169,13 @@ Color SampleSpectrum(const Float* data, const Uint32 numValues, const Wavelength
     const VectorInt8 indices = VectorInt8::Convert(scaledWavelengths);
     const Vector8 weights = scaledWavelengths - indices.ConvertToFloat();
 
+#ifdef RT_USE_AVX2
     const Vector8 a = _mm256_i32gather_ps(data, indices, 4);
     const Vector8 b = _mm256_i32gather_ps(data + 1, indices, 4);
+#else
+    const Vector8 a(data[indices[0]], data[indices[1]], data[indices[2]], data[indices[3]], data[indices[4]], data[indices[5]], data[indices[6]], data[indices[7]]);
+    const Vector8 b(data[indices[0] + 1], data[indices[1] + 1], data[indices[2] + 1], data[indices[3] + 1], data[indices[4] + 1], data[indices[5] + 1], data[indices[6] + 1], data[indices[7] + 1]);
+#endif // RT_USE_AVX2
 
     Color result;
     result.value = Vector8::Lerp(a, b, weights);
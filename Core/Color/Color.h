@@ -60,9 +60,9 @@ struct Color
     RT_FORCE_INLINE static const Color One()
     {
 #ifdef RT_ENABLE_SPECTRAL_RENDERING
-        return Color{ math::VECTOR8_ONE };
+        return Color{ math::Vector8(1.0f) };
 #else
-        return Color{ math::VECTOR_ONE };
+        return Color{ math::Vector4(1.0f) };
 #endif
     }
 
@@ -71,7 +71,7 @@ struct Color
 #ifdef RT_ENABLE_SPECTRAL_RENDERING
         return Color{ math::Vector8(8.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f) };
 #else
-        return Color{ math::VECTOR_ONE };
+        return Color{ math::Vector4(1.0f) };
 #endif
     }
 
@@ -6,13 +6,13 @@
 
 namespace rt {
 
-RT_GLOBAL_CONST math::Vector4 XYZtoRGB_r = {  3.240479f, -1.537150f, -0.498535f, 0.0f };
-RT_GLOBAL_CONST math::Vector4 XYZtoRGB_g = { -0.969256f,  1.875991f,  0.041556f, 0.0f };
-RT_GLOBAL_CONST math::Vector4 XYZtoRGB_b = {  0.055648f, -0.204043f,  1.057311f, 0.0f };
-
 // Convert CIE XYZ to linear RGB (Rec. BT.709)
 RT_FORCE_INLINE math::Vector4 ConvertXYZtoRGB(const math::Vector4 xyzColor)
 {
+    const math::Vector4 XYZtoRGB_r = {  3.240479f, -1.537150f, -0.498535f, 0.0f };
+    const math::Vector4 XYZtoRGB_g = { -0.969256f,  1.875991f,  0.041556f, 0.0f };
+    const math::Vector4 XYZtoRGB_b = {  0.055648f, -0.204043f,  1.057311f, 0.0f };
+
     math::Vector4 r = XYZtoRGB_r * xyzColor;
     math::Vector4 g = XYZtoRGB_g * xyzColor;
     math::Vector4 b = XYZtoRGB_b * xyzColor;
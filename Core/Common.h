@@ -25,12 +25,39 @@
 // TODO assertions should be disabled in "Final" build
 #define RT_ENABLE_ASSERTS
 
-// TODO #define RT_USE_SSE
-
+// instruction sets enabled by the compiler flags (see RT_TARGET_ARCH in CMakeLists.txt)
+// SSE4.2 is the minimum, without AVX2 the 8-wide vectors are emulated with pairs of SSE registers
+// note: MSVC does not define __SSE4_2__ and __F16C__, but SSE4.2 intrinsics are always available and F16C is implied by /arch:AVX2
+#if !defined(_MSC_VER) && !defined(__SSE4_2__)
+#error "SSE4.2 instruction set must be enabled"
+#endif
+
+#if defined(__AVX2__)
 #define RT_USE_AVX
-#define RT_USE_FMA
 #define RT_USE_AVX2
+#endif // defined(__AVX2__)
+
+// FMA changes rounding, so it's used only if the baseline enables it (kernels compiled for higher instruction sets
+// never enable it on their own, results don't depend on the kernels selected at runtime)
+#if defined(__FMA__)
+#define RT_USE_FMA
+#endif // defined(__FMA__)
+
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
 #define RT_USE_FP16C
+#endif // defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+
+// additional kernel variants selected at runtime (see Utils/CpuFeatures.h)
+// AVX2 kernels are always compiled, AVX-512 kernels are compiled only on Linux (see *_AVX2.cpp and *_AVX512.cpp files)
+#if defined(__LINUX__) | defined(__linux__)
+#define RT_ENABLE_AVX512_KERNELS
+#define RT_TARGET_AVX512 __attribute__((target("avx2,f16c,avx512f,avx512dq,avx512bw,avx512vl")))
+#define RT_FORCE_INLINE_AVX512 RT_FORCE_INLINE RT_TARGET_AVX512
+#endif // defined(__LINUX__) | defined(__linux__)
+
+// RT_KERNEL_TRANSLATION_UNIT is defined in kernel source files compiled for a higher instruction set.
+// Global vector constants are not available there, because their load-time initialization would execute
+// the kernels' instructions on any CPU.
 
 
 #define RT_UNUSED(x) (void)(x)
@@ -3,6 +3,13 @@
 // enables runtime counting of ray-triangle and ray-box intersection tests
 //#define RT_ENABLE_INTERSECTION_COUNTERS
 
+// number of children per BVH node used for ray traversal (2, 4 or 8)
+// 4 and 8-wide trees are collapsed from the binary one, all the node's children are tested at once
+#define RT_BVH_WIDTH 8
+
+// store wide BVH child boxes quantized to 8 bits relative to the parent node (halves the nodes memory footprint)
+//#define RT_BVH_QUANTIZED_NODES
+
 // enables code for collecting path tracing debug data
 #define RT_ENABLE_PATH_DEBUGGING
 
@@ -34,12 +34,12 @@ public:
 
     RT_FORCE_INLINE static const Box Empty()
     {
-        return { VECTOR_MAX, -VECTOR_MAX };
+        return { Vector4(FLT_MAX), Vector4(-FLT_MAX) };
     }
 
     RT_FORCE_INLINE static const Box Full()
     {
-        return { -VECTOR_MAX, VECTOR_MAX };
+        return { Vector4(-FLT_MAX), Vector4(FLT_MAX) };
     }
 
     // create box from center point and radius (e.g. bounding box of a sphere)
@@ -54,6 +54,18 @@ public:
         , max(Vector4::Max(a.max, b.max))
     {}
 
+    // common part of two boxes (see IsEmpty if the boxes do not overlap)
+    RT_FORCE_INLINE static const Box Intersection(const Box& a, const Box& b)
+    {
+        return { Vector4::Max(a.min, b.min), Vector4::Min(a.max, b.max) };
+    }
+
+    // check if the box is inverted in any of XYZ axes (e.g. intersection of disjoint boxes)
+    RT_FORCE_INLINE bool IsEmpty() const
+    {
+        return ((max < min).GetMask() & 0x7) != 0;
+    }
+
     RT_FORCE_INLINE const Box operator + (const Vector4& offset) const
     {
         return Box{ min + offset, max + offset };
@@ -199,5 +199,17 @@ RT_FORCE_INLINE Uint32 PopCount(Uint32 x)
 #endif // defined(WIN32)
 }
 
+// index of the highest set bit (the value must be non-zero)
+RT_FORCE_INLINE Uint32 HighestBitIndex(Uint64 x)
+{
+#if defined(WIN32)
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return static_cast<Uint32>(index);
+#elif defined(__LINUX__) | defined(__linux__)
+    return 63u - static_cast<Uint32>(__builtin_clzll(x));
+#endif // defined(WIN32)
+}
+
 } // namespace math
 } // namespace rt
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "../RayLib.h"
+
+
+namespace rt {
+namespace math {
+
+// insert two zero bits between each of the lower 10 bits
+RT_FORCE_INLINE Uint32 SpreadBits3_10(Uint32 x)
+{
+    x &= 0x3FF;
+    x = (x | (x << 16)) & 0x030000FF;
+    x = (x | (x << 8)) & 0x0300F00F;
+    x = (x | (x << 4)) & 0x030C30C3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+// insert two zero bits between each of the lower 21 bits
+RT_FORCE_INLINE Uint64 SpreadBits3_21(Uint64 x)
+{
+    x &= 0x1FFFFF;
+    x = (x | (x << 32)) & 0x001F00000000FFFFull;
+    x = (x | (x << 16)) & 0x001F0000FF0000FFull;
+    x = (x | (x << 8)) & 0x100F00F00F00F00Full;
+    x = (x | (x << 4)) & 0x10C30C30C30C30C3ull;
+    x = (x | (x << 2)) & 0x1249249249249249ull;
+    return x;
+}
+
+// 30-bit Morton code of a point with 10-bit coordinates
+// X axis occupies the highest bit of each triple (bit index % 3 == 2), Z axis the lowest one
+RT_FORCE_INLINE Uint32 EncodeMorton30(Uint32 x, Uint32 y, Uint32 z)
+{
+    return (SpreadBits3_10(x) << 2) | (SpreadBits3_10(y) << 1) | SpreadBits3_10(z);
+}
+
+// 63-bit Morton code of a point with 21-bit coordinates (bits layout is the same as in EncodeMorton30)
+RT_FORCE_INLINE Uint64 EncodeMorton63(Uint32 x, Uint32 y, Uint32 z)
+{
+    return (SpreadBits3_21(x) << 2) | (SpreadBits3_21(y) << 1) | SpreadBits3_21(z);
+}
+
+} // namespace math
+} // namespace rt
@@ -3,6 +3,8 @@
 #include "Math.h"
 #include "Transcendental.h"
 
+#include <random>
+
 namespace rt {
 namespace math {
 
@@ -22,17 +24,15 @@ void Random::Reset()
     {
         mSeed[i] = ((Uint64)GetEntropy() << 32) | (Uint64)GetEntropy();
         mSeedSimd4[i] = VectorInt4(GetEntropy(), GetEntropy(), GetEntropy(), GetEntropy());
-#ifdef RT_USE_AVX2
         mSeedSimd8[i] = VectorInt8(GetEntropy(), GetEntropy(), GetEntropy(), GetEntropy(), GetEntropy(), GetEntropy(), GetEntropy(), GetEntropy());
-#endif // RT_USE_AVX2
     }
 }
 
 Uint32 Random::GetEntropy()
 {
-    Uint32 val = 0;
-    while (_rdrand32_step(&val) == 0) {}
-    return val;
+    // RDRAND is not a part of the baseline instruction set, std::random_device uses it when available
+    thread_local std::random_device device;
+    return device();
 }
 
 Uint64 Random::GetLong()
@@ -119,8 +119,6 @@ const Vector4 Random::GetVector4Bipolar()
     return v.CastToFloat() - Vector4(3.0f);
 }
 
-#ifdef RT_USE_AVX2
-
 VectorInt8 Random::GetIntVector8()
 {
     // NOTE: xoroshiro128+ is faster when using general purpose registers, because there's
@@ -129,25 +127,23 @@ VectorInt8 Random::GetIntVector8()
     // xorshift128+ algorithm
     const VectorInt8 s0 = mSeedSimd8[1];
     VectorInt8 s1 = mSeedSimd8[0];
+#ifdef RT_USE_AVX2
     VectorInt8 v = _mm256_add_epi64(s0, s1);
     s1 = _mm256_slli_epi64(s1, 23);
     const VectorInt8 t0 = _mm256_srli_epi64(s0, 5);
     const VectorInt8 t1 = _mm256_srli_epi64(s1, 18);
+#else
+    VectorInt8 v(_mm_add_epi64(s0.Low(), s1.Low()), _mm_add_epi64(s0.High(), s1.High()));
+    s1 = VectorInt8(_mm_slli_epi64(s1.Low(), 23), _mm_slli_epi64(s1.High(), 23));
+    const VectorInt8 t0(_mm_srli_epi64(s0.Low(), 5), _mm_srli_epi64(s0.High(), 5));
+    const VectorInt8 t1(_mm_srli_epi64(s1.Low(), 18), _mm_srli_epi64(s1.High(), 18));
+#endif // RT_USE_AVX2
     mSeedSimd8[0] = s0;
     mSeedSimd8[1] = (s0 ^ s1) ^ (t0 ^ t1);
 
     return v;
 }
 
-#else
-
-VectorInt8 Random::GetIntVector8()
-{
-    return VectorInt8{ GetIntVector4(), GetIntVector4() };
-}
-
-#endif // RT_USE_AVX2
-
 const Vector8 Random::GetVector8()
 {
     VectorInt8 v = GetIntVector8();
@@ -235,8 +231,14 @@ const Vector2x8 Random::GetHexagon_Simd8()
 
     const Vector8 hexVectorsX(-1.0f, 0.5f, 0.5f, -1.0f, -1.0f, 0.5f, 0.5f, -1.0f);
     const Vector8 hexVectorsY(0.0f, 0.8660254f, -0.8660254f, 0.0f, 0.0f, 0.8660254f, -0.8660254f, 0.0f);
+#ifdef RT_USE_AVX
     const Vector2x8 x{ _mm256_permutevar_ps(hexVectorsX, i), _mm256_permutevar_ps(hexVectorsX, j) };
     const Vector2x8 y{ _mm256_permutevar_ps(hexVectorsY, i), _mm256_permutevar_ps(hexVectorsY, j) };
+#else
+    // indices are in [0, 3] range, so permuting across all 8 elements gives the same result
+    const Vector2x8 x{ VectorInt8::Permute(hexVectorsX, i), VectorInt8::Permute(hexVectorsX, j) };
+    const Vector2x8 y{ VectorInt8::Permute(hexVectorsY, i), VectorInt8::Permute(hexVectorsY, j) };
+#endif // RT_USE_AVX
 
     return { Vector2x8::Dot(u, x), Vector2x8::Dot(u, y) };
 }
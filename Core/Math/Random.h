@@ -79,9 +79,7 @@ private:
     RT_FORCE_INLINE VectorInt8 GetIntVector8();
     RT_FORCE_INLINE VectorInt4 GetIntVector4();
 
-#ifdef RT_USE_AVX2
     VectorInt8 mSeedSimd8[2];
-#endif // RT_USE_AVX2
 
     VectorInt4 mSeedSimd4[2];
 
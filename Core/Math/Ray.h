@@ -32,6 +32,12 @@ public:
     {
         return Vector4::MulAndAdd(dir, t, origin);
     }
+
+    // direction octant, bits are set for negative direction components (including negative zeros)
+    RT_FORCE_INLINE Uint32 GetOctant() const
+    {
+        return static_cast<Uint32>(dir.GetSignMask()) & 0x7u;
+    }
 };
 
 class RayBoxSegment
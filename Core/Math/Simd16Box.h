@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Vector3x16.h"
+#include "Simd8Box.h"
+
+#ifdef RT_ENABLE_AVX512_KERNELS
+
+namespace rt {
+namespace math {
+
+/**
+ * Sixteen boxes (SIMD version, AVX-512).
+ */
+class RT_ALIGN(64) Box_Simd16
+{
+public:
+    Vector3x16 min;
+    Vector3x16 max;
+
+    Box_Simd16() = default;
+
+    // build SIMD box from two sets of 8 boxes
+    RT_FORCE_INLINE_AVX512 Box_Simd16(const Box_Simd8& lo, const Box_Simd8& hi)
+        : min(lo.min, hi.min)
+        , max(lo.max, hi.max)
+    { }
+
+    // splat 8 boxes to both halves
+    RT_FORCE_INLINE_AVX512 explicit Box_Simd16(const Box_Simd8& box)
+        : min(box.min)
+        , max(box.max)
+    { }
+};
+
+} // namespace math
+} // namespace rt
+
+#endif // RT_ENABLE_AVX512_KERNELS
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "Simd16Ray.h"
+#include "Simd16Box.h"
+#include "Simd16Triangle.h"
+
+#ifdef RT_ENABLE_AVX512_KERNELS
+
+namespace rt {
+namespace math {
+
+// NOTE: results are bit-exact with 8-wide versions (see Simd8Geometry.h)
+
+template<Uint32 Octant>
+RT_FORCE_INLINE_AVX512 const VectorBool16 Intersect_BoxRay_Simd16_Octant(
+    const Vector3x16& rayInvDir,
+    const Vector3x16& rayOriginDivDir,
+    const Box_Simd16& box,
+    const Vector16& maxDistance,
+    Vector16& outDistance)
+{
+    static_assert(Octant < 8, "Invalid octant");
+
+    const Vector3x16 tmp1 = Vector3x16::MulAndSub(box.min, rayInvDir, rayOriginDivDir);
+    const Vector3x16 tmp2 = Vector3x16::MulAndSub(box.max, rayInvDir, rayOriginDivDir);
+
+    Vector3x16 lmin, lmax;
+    lmax.x = Octant & 1 ? tmp1.x : tmp2.x;
+    lmax.y = Octant & 2 ? tmp1.y : tmp2.y;
+    lmax.z = Octant & 4 ? tmp1.z : tmp2.z;
+    lmin.x = Octant & 1 ? tmp2.x : tmp1.x;
+    lmin.y = Octant & 2 ? tmp2.y : tmp1.y;
+    lmin.z = Octant & 4 ? tmp2.z : tmp1.z;
+
+    // calculate minimum and maximum plane distances by taking min and max of all 3 components
+    const Vector16 maxT = Vector16::Min(lmax.z, Vector16::Min(lmax.x, lmax.y));
+    const Vector16 minT = Vector16::Max(lmin.z, Vector16::Max(lmin.x, lmin.y));
+
+    outDistance = minT;
+
+    // return (maxT > 0 && minT <= maxT && maxT <= maxDistance)
+    // positive zero passes the test, like the sign bit trick in 8-wide version
+    const VectorBool16 cond = Vector16::Min(maxDistance, maxT) >= minT;
+    return _kandn_mask16(maxT.GetSignMask(), cond);
+}
+
+RT_FORCE_INLINE_AVX512 const VectorBool16 Intersect_BoxRay_Simd16(
+    const Vector3x16& rayInvDir,
+    const Vector3x16& rayOriginDivDir,
+    const Box_Simd16& box,
+    const Vector16& maxDistance,
+    Vector16& outDistance)
+{
+    const Vector3x16 tmp1 = Vector3x16::MulAndSub(box.min, rayInvDir, rayOriginDivDir);
+    const Vector3x16 tmp2 = Vector3x16::MulAndSub(box.max, rayInvDir, rayOriginDivDir);
+
+    const Vector3x16 lmax = Vector3x16::Max(tmp1, tmp2);
+    const Vector3x16 lmin = Vector3x16::Min(tmp1, tmp2);
+
+    // calculate minimum and maximum plane distances by taking min and max of all 3 components
+    const Vector16 maxT = Vector16::Min(lmax.z, Vector16::Min(lmax.x, lmax.y));
+    const Vector16 minT = Vector16::Max(lmin.z, Vector16::Max(lmin.x, lmin.y));
+
+    outDistance = minT;
+
+    // return (maxT > 0 && minT <= maxT && maxT <= maxDistance)
+    const VectorBool16 cond = Vector16::Min(maxDistance, maxT) >= minT;
+    return _kandn_mask16(maxT.GetSignMask(), cond);
+}
+
+RT_FORCE_INLINE_AVX512 const VectorBool16 Intersect_TriangleRay_Simd16(
+    const Vector3x16& rayDir,
+    const Vector3x16& rayOrigin,
+    const Triangle_Simd16& tri,
+    const Vector16& maxDistance,
+    Vector16& outU,
+    Vector16& outV,
+    Vector16& outDist)
+{
+    // Moller-Trumbore algorithm
+
+    const Vector16 one(1.0f);
+
+    // begin calculating determinant - also used to calculate U parameter
+    const Vector3x16 pvec = Vector3x16::Cross(rayDir, tri.edge2);
+
+    // if determinant is near zero, ray lies in plane of triangle
+    const Vector16 det = Vector3x16::Dot(tri.edge1, pvec);
+    const Vector16 invDet = one / det;
+
+    // calculate distance from vert0 to ray origin
+    const Vector3x16 tvec = rayOrigin - tri.v0;
+
+    // prepare to test V parameter
+    const Vector3x16 qvec = Vector3x16::Cross(tvec, tri.edge1);
+
+    const Vector16 u = invDet * Vector3x16::Dot(tvec, pvec);
+    const Vector16 v = invDet * Vector3x16::Dot(rayDir, qvec);
+    const Vector16 t = invDet * Vector3x16::Dot(tri.edge2, qvec);
+
+    outU = u;
+    outV = v;
+    outDist = t;
+
+    // u > 0 && v > 0 && t > 0 && u + v < 1 && t < maxDist
+    // (sign bits are tested, like in 8-wide version)
+    const VectorBool16 cond = (t < maxDistance) & (u + v <= one);
+    const VectorBool16 negative = (u | v | t).GetSignMask();
+    return _kandn_mask16(negative, cond);
+}
+
+} // namespace math
+} // namespace rt
+
+#endif // RT_ENABLE_AVX512_KERNELS
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Vector3x16.h"
+#include "Simd8Ray.h"
+
+#ifdef RT_ENABLE_AVX512_KERNELS
+
+namespace rt {
+namespace math {
+
+/**
+ * 16 rays (SIMD version, AVX-512).
+ */
+class RT_ALIGN(64) Ray_Simd16
+{
+public:
+    Vector3x16 dir;
+    Vector3x16 origin;
+    Vector3x16 invDir;
+
+    Ray_Simd16() = default;
+
+    // build SIMD ray from two sets of 8 rays
+    RT_FORCE_INLINE_AVX512 Ray_Simd16(const Ray_Simd8& lo, const Ray_Simd8& hi)
+        : dir(lo.dir, hi.dir)
+        , origin(lo.origin, hi.origin)
+        , invDir(lo.invDir, hi.invDir)
+    {
+    }
+};
+
+} // namespace math
+} // namespace rt
+
+#endif // RT_ENABLE_AVX512_KERNELS
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Vector3x16.h"
+#include "Simd8Triangle.h"
+
+#ifdef RT_ENABLE_AVX512_KERNELS
+
+namespace rt {
+namespace math {
+
+/**
+ * 16 triangles (SIMD version, AVX-512).
+ */
+class RT_ALIGN(64) Triangle_Simd16
+{
+public:
+    Vector3x16 v0;
+    Vector3x16 edge1;
+    Vector3x16 edge2;
+
+    Triangle_Simd16() = default;
+
+    // splat 8 triangles to both halves
+    RT_FORCE_INLINE_AVX512 explicit Triangle_Simd16(const Triangle_Simd8& tri)
+        : v0(tri.v0)
+        , edge1(tri.edge1)
+        , edge2(tri.edge2)
+    { }
+};
+
+} // namespace math
+} // namespace rt
+
+#endif // RT_ENABLE_AVX512_KERNELS
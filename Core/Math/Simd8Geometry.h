@@ -25,17 +25,13 @@ RT_FORCE_INLINE const Vector8 Intersect_BoxRay_Simd8_Octant(
     const Vector3x8 tmp1 = Vector3x8::MulAndSub(box.min, rayInvDir, rayOriginDivDir);
     const Vector3x8 tmp2 = Vector3x8::MulAndSub(box.max, rayInvDir, rayOriginDivDir);
 
-    constexpr Uint32 maskX = Octatnt & 1 ? 0xFF : 0;
-    constexpr Uint32 maskY = Octatnt & 2 ? 0xFF : 0;
-    constexpr Uint32 maskZ = Octatnt & 4 ? 0xFF : 0;
-
     Vector3x8 lmin, lmax;
-    lmax.x = _mm256_blend_ps(tmp2.x, tmp1.x, maskX);
-    lmax.y = _mm256_blend_ps(tmp2.y, tmp1.y, maskY);
-    lmax.z = _mm256_blend_ps(tmp2.z, tmp1.z, maskZ);
-    lmin.x = _mm256_blend_ps(tmp1.x, tmp2.x, maskX);
-    lmin.y = _mm256_blend_ps(tmp1.y, tmp2.y, maskY);
-    lmin.z = _mm256_blend_ps(tmp1.z, tmp2.z, maskZ);
+    lmax.x = Octatnt & 1 ? tmp1.x : tmp2.x;
+    lmax.y = Octatnt & 2 ? tmp1.y : tmp2.y;
+    lmax.z = Octatnt & 4 ? tmp1.z : tmp2.z;
+    lmin.x = Octatnt & 1 ? tmp2.x : tmp1.x;
+    lmin.y = Octatnt & 2 ? tmp2.y : tmp1.y;
+    lmin.z = Octatnt & 4 ? tmp2.z : tmp1.z;
 
     // calculate minimum and maximum plane distances by taking min and max of all 3 components
     const Vector8 maxT = Vector8::Min(lmax.z, Vector8::Min(lmax.x, lmax.y));
@@ -44,8 +40,8 @@ RT_FORCE_INLINE const Vector8 Intersect_BoxRay_Simd8_Octant(
     outDistance = minT;
 
     // return (maxT > 0 && minT < maxT && maxT < maxDistance)
-    const Vector8 cond = _mm256_cmp_ps(Vector8::Min(maxDistance, maxT), minT, _CMP_GE_OQ);
-    return _mm256_andnot_ps(maxT, cond); // trick: replace greater-than-zero compare with and-not
+    const Vector8 cond(Vector8::Min(maxDistance, maxT) >= minT);
+    return Vector8::AndNot(maxT, cond); // trick: replace greater-than-zero compare with and-not
 }
 
 RT_FORCE_INLINE const Vector8 Intersect_BoxRay_Simd8(
@@ -65,12 +61,12 @@ RT_FORCE_INLINE const Vector8 Intersect_BoxRay_Simd8(
     const Vector3x8 lmin = Vector3x8::Min(tmp1, tmp2);
 #else // RT_ARCH_SLOW_BLENDV
     Vector3x8 lmin, lmax;
-    lmax.x = _mm256_blendv_ps(tmp2.x, tmp1.x, rayInvDir.x);
-    lmax.y = _mm256_blendv_ps(tmp2.y, tmp1.y, rayInvDir.y);
-    lmax.z = _mm256_blendv_ps(tmp2.z, tmp1.z, rayInvDir.z);
-    lmin.x = _mm256_blendv_ps(tmp1.x, tmp2.x, rayInvDir.x);
-    lmin.y = _mm256_blendv_ps(tmp1.y, tmp2.y, rayInvDir.y);
-    lmin.z = _mm256_blendv_ps(tmp1.z, tmp2.z, rayInvDir.z);
+    lmax.x = Vector8::Select(tmp2.x, tmp1.x, VectorBool8(rayInvDir.x));
+    lmax.y = Vector8::Select(tmp2.y, tmp1.y, VectorBool8(rayInvDir.y));
+    lmax.z = Vector8::Select(tmp2.z, tmp1.z, VectorBool8(rayInvDir.z));
+    lmin.x = Vector8::Select(tmp1.x, tmp2.x, VectorBool8(rayInvDir.x));
+    lmin.y = Vector8::Select(tmp1.y, tmp2.y, VectorBool8(rayInvDir.y));
+    lmin.z = Vector8::Select(tmp1.z, tmp2.z, VectorBool8(rayInvDir.z));
 #endif // RT_ARCH_SLOW_BLENDV
 
     // calculate minimum and maximum plane distances by taking min and max of all 3 components
@@ -80,8 +76,8 @@ RT_FORCE_INLINE const Vector8 Intersect_BoxRay_Simd8(
     outDistance = minT;
 
     // return (maxT > 0 && minT <= maxT && maxT <= maxDistance)
-    const Vector8 cond = _mm256_cmp_ps(Vector8::Min(maxDistance, maxT), minT, _CMP_GE_OQ);
-    return _mm256_andnot_ps(maxT, cond); // trick: replace greater-than-zero compare with and-not
+    const Vector8 cond(Vector8::Min(maxDistance, maxT) >= minT);
+    return Vector8::AndNot(maxT, cond); // trick: replace greater-than-zero compare with and-not
 }
 
 RT_FORCE_INLINE const VectorBool8 Intersect_BoxRay_TwoSided_Simd8(
@@ -100,12 +96,12 @@ RT_FORCE_INLINE const VectorBool8 Intersect_BoxRay_TwoSided_Simd8(
     const Vector3x8 lmin = Vector3x8::Min(tmp1, tmp2);
 #else // RT_ARCH_SLOW_BLENDV
     Vector3x8 lmin, lmax;
-    lmax.x = _mm256_blendv_ps(tmp2.x, tmp1.x, rayInvDir.x);
-    lmax.y = _mm256_blendv_ps(tmp2.y, tmp1.y, rayInvDir.y);
-    lmax.z = _mm256_blendv_ps(tmp2.z, tmp1.z, rayInvDir.z);
-    lmin.x = _mm256_blendv_ps(tmp1.x, tmp2.x, rayInvDir.x);
-    lmin.y = _mm256_blendv_ps(tmp1.y, tmp2.y, rayInvDir.y);
-    lmin.z = _mm256_blendv_ps(tmp1.z, tmp2.z, rayInvDir.z);
+    lmax.x = Vector8::Select(tmp2.x, tmp1.x, VectorBool8(rayInvDir.x));
+    lmax.y = Vector8::Select(tmp2.y, tmp1.y, VectorBool8(rayInvDir.y));
+    lmax.z = Vector8::Select(tmp2.z, tmp1.z, VectorBool8(rayInvDir.z));
+    lmin.x = Vector8::Select(tmp1.x, tmp2.x, VectorBool8(rayInvDir.x));
+    lmin.y = Vector8::Select(tmp1.y, tmp2.y, VectorBool8(rayInvDir.y));
+    lmin.z = Vector8::Select(tmp1.z, tmp2.z, VectorBool8(rayInvDir.z));
 #endif // RT_ARCH_SLOW_BLENDV
 
     // calculate minimum and maximum plane distances by taking min and max of all 3 components
@@ -116,11 +112,11 @@ RT_FORCE_INLINE const VectorBool8 Intersect_BoxRay_TwoSided_Simd8(
     outFarDist = maxT;
 
     // return (maxT > 0 && minT <= maxT && maxT <= maxDistance)
-    const Vector8 cond = _mm256_cmp_ps(Vector8::Min(maxDistance, maxT), minT, _CMP_GE_OQ);
-    return VectorBool8(_mm256_andnot_ps(maxT, cond)); // trick: replace greater-than-zero compare with and-not
+    const Vector8 cond(Vector8::Min(maxDistance, maxT) >= minT);
+    return VectorBool8(Vector8::AndNot(maxT, cond)); // trick: replace greater-than-zero compare with and-not
 }
 
-RT_INLINE const VectorBool8 Intersect_TriangleRay_Simd8(
+RT_FORCE_INLINE const VectorBool8 Intersect_TriangleRay_Simd8(
     const Vector3x8& rayDir,
     const Vector3x8& rayOrigin,
     const Triangle_Simd8& tri,
@@ -131,7 +127,7 @@ RT_INLINE const VectorBool8 Intersect_TriangleRay_Simd8(
 {
     // MllerTrumbore algorithm
 
-    const Vector8 one = VECTOR8_ONE;
+    const Vector8 one(1.0f);
 
     // begin calculating determinant - also used to calculate U parameter
     const Vector3x8 pvec = Vector3x8::Cross(rayDir, tri.edge2);
@@ -155,9 +151,9 @@ RT_INLINE const VectorBool8 Intersect_TriangleRay_Simd8(
     outDist = t;
 
     // u > 0 && v > 0 && t > 0 && u + v < 1 && t < maxDist
-    const Vector8 condA = _mm256_andnot_ps(u, _mm256_cmp_ps(t, maxDistance, _CMP_LT_OQ));
-    const Vector8 condB = _mm256_andnot_ps(t, _mm256_cmp_ps(u + v, one, _CMP_LE_OQ));
-    return _mm256_andnot_ps(v, _mm256_and_ps(condA, condB));
+    const Vector8 condA = Vector8::AndNot(u, Vector8(t < maxDistance));
+    const Vector8 condB = Vector8::AndNot(t, Vector8(u + v <= one));
+    return VectorBool8(Vector8::AndNot(v, condA & condB));
 }
 
 
@@ -81,7 +81,6 @@ const Vector4 Sin(Vector4 x)
 
 const Vector8 Sin(Vector8 x)
 {
-#ifdef RT_USE_AVX2
     // based on:
     // https://www.gamedev.net/forums/topic/681723-faster-sin-and-cos/
 
@@ -107,9 +106,6 @@ const Vector8 Sin(Vector8 x)
 
     // equivalent of: (i & 1) ? -y : y;
     return y ^ (i << 31).CastToFloat();
-#else
-    return Vector8{sinf(x[0]), sinf(x[1]), sinf(x[2]), sinf(x[3]), sinf(x[4]), sinf(x[5]), sinf(x[6]), sinf(x[7])};
-#endif // RT_USE_AVX2
 }
 
 float Cos(float x)
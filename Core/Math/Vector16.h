@@ -0,0 +1,165 @@
+#pragma once
+
+#include "Math.h"
+#include "Vector8.h"
+#include "VectorBool16.h"
+
+#ifdef RT_ENABLE_AVX512_KERNELS
+
+// GCC 12 reports false "uninitialized" warnings for AVX-512 intrinsics using _mm512_undefined_*()
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+namespace rt {
+namespace math {
+
+/**
+ * 16-element SIMD vector (AVX-512).
+ * NOTE: can be used only in functions compiled for AVX-512 (see RT_TARGET_AVX512)
+ */
+struct RT_ALIGN(64) Vector16
+{
+    // constructors
+    Vector16() = default;
+    RT_FORCE_INLINE_AVX512 Vector16(const Vector16& other) : v(other.v) { }
+    RT_FORCE_INLINE_AVX512 Vector16(const __m512& m) : v(m) { }
+    RT_FORCE_INLINE_AVX512 explicit Vector16(const Float scalar) : v(_mm512_set1_ps(scalar)) { }
+    RT_FORCE_INLINE_AVX512 explicit Vector16(const Float* src) : v(_mm512_loadu_ps(src)) { }
+    RT_FORCE_INLINE_AVX512 Vector16& operator = (const Vector16& other) { v = other.v; return *this; }
+
+    // build from two 8-element vectors
+    RT_FORCE_INLINE_AVX512 Vector16(const Vector8& lo, const Vector8& hi)
+        : v(_mm512_insertf32x8(_mm512_zextps256_ps512(ToM256(lo)), ToM256(hi), 1))
+    { }
+
+    // splat 8-element vector to both halves
+    RT_FORCE_INLINE_AVX512 explicit Vector16(const Vector8& value)
+        : v(_mm512_insertf32x8(_mm512_zextps256_ps512(ToM256(value)), ToM256(value), 1))
+    { }
+
+    RT_FORCE_INLINE_AVX512 static const Vector16 Zero()
+    {
+        return _mm512_setzero_ps();
+    }
+
+    RT_FORCE_INLINE_AVX512 operator __m512() const { return v; }
+    RT_FORCE_INLINE_AVX512 Float operator[] (Uint32 index) const { return f[index]; }
+    RT_FORCE_INLINE_AVX512 Float& operator[] (Uint32 index) { return f[index]; }
+
+    // extract lower 8 elements
+    RT_FORCE_INLINE_AVX512 const Vector8 Low() const
+    {
+        return FromM256(_mm512_castps512_ps256(v));
+    }
+
+    // extract higher 8 elements
+    RT_FORCE_INLINE_AVX512 const Vector8 High() const
+    {
+        return FromM256(_mm512_extractf32x8_ps(v, 1));
+    }
+
+    // simple arithmetics
+    RT_FORCE_INLINE_AVX512 const Vector16 operator - () const { return _mm512_xor_ps(v, _mm512_set1_ps(-0.0f)); }
+    RT_FORCE_INLINE_AVX512 const Vector16 operator + (const Vector16& b) const { return _mm512_add_ps(v, b.v); }
+    RT_FORCE_INLINE_AVX512 const Vector16 operator - (const Vector16& b) const { return _mm512_sub_ps(v, b.v); }
+    RT_FORCE_INLINE_AVX512 const Vector16 operator * (const Vector16& b) const { return _mm512_mul_ps(v, b.v); }
+    RT_FORCE_INLINE_AVX512 const Vector16 operator / (const Vector16& b) const { return _mm512_div_ps(v, b.v); }
+    RT_FORCE_INLINE_AVX512 const Vector16 operator * (Float b) const { return _mm512_mul_ps(v, _mm512_set1_ps(b)); }
+    RT_FORCE_INLINE_AVX512 const Vector16 operator / (Float b) const { return _mm512_div_ps(v, _mm512_set1_ps(b)); }
+    RT_FORCE_INLINE_AVX512 Vector16& operator += (const Vector16& b) { v = _mm512_add_ps(v, b.v); return *this; }
+    RT_FORCE_INLINE_AVX512 Vector16& operator -= (const Vector16& b) { v = _mm512_sub_ps(v, b.v); return *this; }
+    RT_FORCE_INLINE_AVX512 Vector16& operator *= (const Vector16& b) { v = _mm512_mul_ps(v, b.v); return *this; }
+    RT_FORCE_INLINE_AVX512 Vector16& operator /= (const Vector16& b) { v = _mm512_div_ps(v, b.v); return *this; }
+
+    // comparison operators (result is stored in a mask register)
+    RT_FORCE_INLINE_AVX512 const VectorBool16 operator == (const Vector16& b) const { return _mm512_cmp_ps_mask(v, b.v, _CMP_EQ_OQ); }
+    RT_FORCE_INLINE_AVX512 const VectorBool16 operator < (const Vector16& b) const { return _mm512_cmp_ps_mask(v, b.v, _CMP_LT_OQ); }
+    RT_FORCE_INLINE_AVX512 const VectorBool16 operator <= (const Vector16& b) const { return _mm512_cmp_ps_mask(v, b.v, _CMP_LE_OQ); }
+    RT_FORCE_INLINE_AVX512 const VectorBool16 operator > (const Vector16& b) const { return _mm512_cmp_ps_mask(v, b.v, _CMP_GT_OQ); }
+    RT_FORCE_INLINE_AVX512 const VectorBool16 operator >= (const Vector16& b) const { return _mm512_cmp_ps_mask(v, b.v, _CMP_GE_OQ); }
+    RT_FORCE_INLINE_AVX512 const VectorBool16 operator != (const Vector16& b) const { return _mm512_cmp_ps_mask(v, b.v, _CMP_NEQ_OQ); }
+
+    // bitwise logic operations
+    RT_FORCE_INLINE_AVX512 const Vector16 operator & (const Vector16& b) const { return _mm512_and_ps(v, b.v); }
+    RT_FORCE_INLINE_AVX512 const Vector16 operator | (const Vector16& b) const { return _mm512_or_ps(v, b.v); }
+    RT_FORCE_INLINE_AVX512 const Vector16 operator ^ (const Vector16& b) const { return _mm512_xor_ps(v, b.v); }
+
+    RT_FORCE_INLINE_AVX512 static const Vector16 Sqrt(const Vector16& v) { return _mm512_sqrt_ps(v); }
+    RT_FORCE_INLINE_AVX512 static const Vector16 Reciprocal(const Vector16& v) { return _mm512_div_ps(_mm512_set1_ps(1.0f), v); }
+    RT_FORCE_INLINE_AVX512 static const Vector16 Min(const Vector16& a, const Vector16& b) { return _mm512_min_ps(a, b); }
+    RT_FORCE_INLINE_AVX512 static const Vector16 Max(const Vector16& a, const Vector16& b) { return _mm512_max_ps(a, b); }
+    RT_FORCE_INLINE_AVX512 static const Vector16 Abs(const Vector16& v) { return _mm512_abs_ps(v); }
+
+    // Build mask of sign bits.
+    RT_FORCE_INLINE_AVX512 const VectorBool16 GetSignMask() const
+    {
+        return _mm512_movepi32_mask(_mm512_castps_si512(v));
+    }
+
+    // For each vector component, copy value from "b" if "sel" is set, or from "a" otherwise.
+    RT_FORCE_INLINE_AVX512 static const Vector16 Select(const Vector16& a, const Vector16& b, const VectorBool16& sel)
+    {
+        return _mm512_mask_blend_ps(sel, a, b);
+    }
+
+    // fused only if the baseline uses FMA, so the results match 8-wide versions (see RT_USE_FMA)
+#ifdef RT_USE_FMA
+    // Fused multiply and add (a * b + c)
+    RT_FORCE_INLINE_AVX512 static const Vector16 MulAndAdd(const Vector16& a, const Vector16& b, const Vector16& c) { return _mm512_fmadd_ps(a, b, c); }
+
+    // Fused multiply and subtract (a * b - c)
+    RT_FORCE_INLINE_AVX512 static const Vector16 MulAndSub(const Vector16& a, const Vector16& b, const Vector16& c) { return _mm512_fmsub_ps(a, b, c); }
+
+    // Fused multiply (negated) and add (-a * b + c)
+    RT_FORCE_INLINE_AVX512 static const Vector16 NegMulAndAdd(const Vector16& a, const Vector16& b, const Vector16& c) { return _mm512_fnmadd_ps(a, b, c); }
+
+    // Fused multiply (negated) and subtract (-a * b - c)
+    RT_FORCE_INLINE_AVX512 static const Vector16 NegMulAndSub(const Vector16& a, const Vector16& b, const Vector16& c) { return _mm512_fnmsub_ps(a, b, c); }
+#else
+    RT_FORCE_INLINE_AVX512 static const Vector16 MulAndAdd(const Vector16& a, const Vector16& b, const Vector16& c) { return a * b + c; }
+    RT_FORCE_INLINE_AVX512 static const Vector16 MulAndSub(const Vector16& a, const Vector16& b, const Vector16& c) { return a * b - c; }
+    RT_FORCE_INLINE_AVX512 static const Vector16 NegMulAndAdd(const Vector16& a, const Vector16& b, const Vector16& c) { return c - a * b; }
+    RT_FORCE_INLINE_AVX512 static const Vector16 NegMulAndSub(const Vector16& a, const Vector16& b, const Vector16& c) { return -(a * b) - c; }
+#endif // RT_USE_FMA
+
+private:
+
+    // Vector8 is emulated with two SSE registers if AVX is not enabled for the whole translation unit
+    RT_FORCE_INLINE_AVX512 static __m256 ToM256(const Vector8& v)
+    {
+#ifdef RT_USE_AVX
+        return v;
+#else
+        return _mm256_set_m128(v.High(), v.Low());
+#endif // RT_USE_AVX
+    }
+
+    RT_FORCE_INLINE_AVX512 static const Vector8 FromM256(const __m256 v)
+    {
+#ifdef RT_USE_AVX
+        return Vector8(v);
+#else
+        return Vector8(Vector4(_mm256_castps256_ps128(v)), Vector4(_mm256_extractf128_ps(v, 1)));
+#endif // RT_USE_AVX
+    }
+
+    union
+    {
+        Float f[16];
+        Int32 i[16];
+        Uint32 u[16];
+        __m512 v;
+    };
+};
+
+} // namespace math
+} // namespace rt
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // RT_ENABLE_AVX512_KERNELS
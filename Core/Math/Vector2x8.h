@@ -38,8 +38,8 @@ public:
     RT_FORCE_INLINE explicit Vector2x8(const Vector4& v)
     {
         const Vector8 temp(v, v); // copy "v" onto both AVX lanes
-        x = _mm256_shuffle_ps(temp, temp, _MM_SHUFFLE(0, 0, 0, 0));
-        y = _mm256_shuffle_ps(temp, temp, _MM_SHUFFLE(1, 1, 1, 1));
+        x = temp.Swizzle<0, 0, 0, 0>();
+        y = temp.Swizzle<1, 1, 1, 1>();
     }
 
     // build from eight 3D vectors
@@ -73,6 +73,7 @@ public:
         //
         // note that "z" and "w" component are dropped
 
+#ifdef RT_USE_AVX
         const __m256 t0 = _mm256_unpacklo_ps(Vector8(v0), Vector8(v1));
         const __m256 t2 = _mm256_unpacklo_ps(Vector8(v2), Vector8(v3));
         const __m256 t4 = _mm256_unpacklo_ps(Vector8(v4), Vector8(v5));
@@ -83,6 +84,14 @@ public:
         const __m256 tt5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
         x = _mm256_permute2f128_ps(tt0, tt4, 0x20);
         y = _mm256_permute2f128_ps(tt1, tt5, 0x20);
+#else
+        __m128 lo0 = v0, lo1 = v1, lo2 = v2, lo3 = v3;
+        __m128 hi0 = v4, hi1 = v5, hi2 = v6, hi3 = v7;
+        _MM_TRANSPOSE4_PS(lo0, lo1, lo2, lo3);
+        _MM_TRANSPOSE4_PS(hi0, hi1, hi2, hi3);
+        x = Vector8(lo0, hi0);
+        y = Vector8(lo1, hi1);
+#endif // RT_USE_AVX
     }
 
     //////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "Math.h"
+#include "Vector16.h"
+#include "Vector3x8.h"
+
+#ifdef RT_ENABLE_AVX512_KERNELS
+
+namespace rt {
+namespace math {
+
+/**
+ * Sixteen 3D vectors (SIMD version, AVX-512 accelerated).
+ * NOTE: can be used only in functions compiled for AVX-512 (see RT_TARGET_AVX512)
+ */
+class RT_ALIGN(64) Vector3x16
+{
+public:
+    Vector16 x;
+    Vector16 y;
+    Vector16 z;
+
+    Vector3x16() = default;
+
+    RT_FORCE_INLINE_AVX512 Vector3x16(const Vector16& x, const Vector16& y, const Vector16& z)
+        : x(x), y(y), z(z)
+    {}
+
+    // splat value to all the components
+    RT_FORCE_INLINE_AVX512 explicit Vector3x16(const Vector16& s)
+        : x(s), y(s), z(s)
+    {}
+
+    // build from two sets of eight 3D vectors
+    RT_FORCE_INLINE_AVX512 Vector3x16(const Vector3x8& lo, const Vector3x8& hi)
+        : x(lo.x, hi.x), y(lo.y, hi.y), z(lo.z, hi.z)
+    {}
+
+    // splat eight 3D vectors to both halves
+    RT_FORCE_INLINE_AVX512 explicit Vector3x16(const Vector3x8& v)
+        : x(v.x), y(v.y), z(v.z)
+    {}
+
+    // extract lower 8 vectors
+    RT_FORCE_INLINE_AVX512 const Vector3x8 Low() const
+    {
+        return { x.Low(), y.Low(), z.Low() };
+    }
+
+    // extract higher 8 vectors
+    RT_FORCE_INLINE_AVX512 const Vector3x8 High() const
+    {
+        return { x.High(), y.High(), z.High() };
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+
+    RT_FORCE_INLINE_AVX512 const Vector3x16 operator - () const
+    {
+        return { -x, -y, -z };
+    }
+
+    RT_FORCE_INLINE_AVX512 const Vector3x16 operator + (const Vector3x16& rhs) const
+    {
+        return { x + rhs.x, y + rhs.y, z + rhs.z };
+    }
+
+    RT_FORCE_INLINE_AVX512 const Vector3x16 operator - (const Vector3x16& rhs) const
+    {
+        return { x - rhs.x, y - rhs.y, z - rhs.z };
+    }
+
+    RT_FORCE_INLINE_AVX512 const Vector3x16 operator * (const Vector3x16& rhs) const
+    {
+        return { x * rhs.x, y * rhs.y, z * rhs.z };
+    }
+
+    RT_FORCE_INLINE_AVX512 const Vector3x16 operator * (const Vector16& rhs) const
+    {
+        return { x * rhs, y * rhs, z * rhs };
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+
+    RT_FORCE_INLINE_AVX512 static const Vector3x16 Min(const Vector3x16& a, const Vector3x16& b)
+    {
+        return { Vector16::Min(a.x, b.x), Vector16::Min(a.y, b.y), Vector16::Min(a.z, b.z) };
+    }
+
+    RT_FORCE_INLINE_AVX512 static const Vector3x16 Max(const Vector3x16& a, const Vector3x16& b)
+    {
+        return { Vector16::Max(a.x, b.x), Vector16::Max(a.y, b.y), Vector16::Max(a.z, b.z) };
+    }
+
+    RT_FORCE_INLINE_AVX512 static const Vector3x16 MulAndAdd(const Vector3x16& a, const Vector3x16& b, const Vector3x16& c)
+    {
+        return { Vector16::MulAndAdd(a.x, b.x, c.x), Vector16::MulAndAdd(a.y, b.y, c.y), Vector16::MulAndAdd(a.z, b.z, c.z) };
+    }
+
+    RT_FORCE_INLINE_AVX512 static const Vector3x16 MulAndSub(const Vector3x16& a, const Vector3x16& b, const Vector3x16& c)
+    {
+        return { Vector16::MulAndSub(a.x, b.x, c.x), Vector16::MulAndSub(a.y, b.y, c.y), Vector16::MulAndSub(a.z, b.z, c.z) };
+    }
+
+    // 3D dot product
+    RT_FORCE_INLINE_AVX512 static const Vector16 Dot(const Vector3x16& a, const Vector3x16& b)
+    {
+        // return a.x * b.x + a.y * b.y + a.z * b.z;
+        return Vector16::MulAndAdd(a.x, b.x, Vector16::MulAndAdd(a.y, b.y, a.z * b.z));
+    }
+
+    // 3D cross product
+    RT_FORCE_INLINE_AVX512 static const Vector3x16 Cross(const Vector3x16& a, const Vector3x16& b)
+    {
+        return {
+            Vector16::NegMulAndAdd(a.z, b.y, a.y * b.z),
+            Vector16::NegMulAndAdd(a.x, b.z, a.z * b.x),
+            Vector16::NegMulAndAdd(a.y, b.x, a.x * b.y)
+        };
+    }
+};
+
+} // namespace math
+} // namespace rt
+
+#endif // RT_ENABLE_AVX512_KERNELS
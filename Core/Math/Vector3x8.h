@@ -43,9 +43,9 @@ public:
     RT_FORCE_INLINE explicit Vector3x8(const Vector4& v)
     {
         const Vector8 temp(v, v); // copy "v" onto both AVX lanes
-        x = _mm256_shuffle_ps(temp, temp, _MM_SHUFFLE(0, 0, 0, 0));
-        y = _mm256_shuffle_ps(temp, temp, _MM_SHUFFLE(1, 1, 1, 1));
-        z = _mm256_shuffle_ps(temp, temp, _MM_SHUFFLE(2, 2, 2, 2));
+        x = temp.Swizzle<0, 0, 0, 0>();
+        y = temp.Swizzle<1, 1, 1, 1>();
+        z = temp.Swizzle<2, 2, 2, 2>();
     }
 
     // splat single scalar to all components an elements
@@ -83,6 +83,7 @@ public:
         //
         // note that "w" component is dropped
 
+#ifdef RT_USE_AVX
         const __m256 t0 = _mm256_unpacklo_ps(Vector8(v0), Vector8(v1));
         const __m256 t1 = _mm256_unpackhi_ps(Vector8(v0), Vector8(v1));
         const __m256 t2 = _mm256_unpacklo_ps(Vector8(v2), Vector8(v3));
@@ -100,11 +101,21 @@ public:
         x = _mm256_permute2f128_ps(tt0, tt4, 0x20);
         y = _mm256_permute2f128_ps(tt1, tt5, 0x20);
         z = _mm256_permute2f128_ps(tt2, tt6, 0x20);
+#else
+        __m128 lo0 = v0, lo1 = v1, lo2 = v2, lo3 = v3;
+        __m128 hi0 = v4, hi1 = v5, hi2 = v6, hi3 = v7;
+        _MM_TRANSPOSE4_PS(lo0, lo1, lo2, lo3);
+        _MM_TRANSPOSE4_PS(hi0, hi1, hi2, hi3);
+        x = Vector8(lo0, hi0);
+        y = Vector8(lo1, hi1);
+        z = Vector8(lo2, hi2);
+#endif // RT_USE_AVX
     }
 
     // unpack to 8x Vector4
     RT_FORCE_INLINE void Unpack(Vector4 output[8]) const
     {
+#ifdef RT_USE_AVX
         __m256 row0 = x;
         __m256 row1 = y;
         __m256 row2 = z;
@@ -128,6 +139,20 @@ public:
         output[5] = _mm256_extractf128_ps(row1, 1);
         output[6] = _mm256_extractf128_ps(row2, 1);
         output[7] = _mm256_extractf128_ps(row3, 1);
+#else
+        __m128 lo0 = x.Low(), lo1 = y.Low(), lo2 = z.Low(), lo3 = _mm_setzero_ps();
+        __m128 hi0 = x.High(), hi1 = y.High(), hi2 = z.High(), hi3 = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(lo0, lo1, lo2, lo3);
+        _MM_TRANSPOSE4_PS(hi0, hi1, hi2, hi3);
+        output[0] = lo0;
+        output[1] = lo1;
+        output[2] = lo2;
+        output[3] = lo3;
+        output[4] = hi0;
+        output[5] = hi1;
+        output[6] = hi2;
+        output[7] = hi3;
+#endif // RT_USE_AVX
     }
 
     //////////////////////////////////////////////////////////////////////////
@@ -246,6 +246,8 @@ struct RT_ALIGN(16) Vector4
 RT_FORCE_INLINE const Vector4 operator*(Float a, const Vector4& b);
 
 
+#ifndef RT_KERNEL_TRANSLATION_UNIT
+
 // some commonly used constants
 
 RT_GLOBAL_CONST Vector4 VECTOR_EPSILON = { RT_EPSILON, RT_EPSILON, RT_EPSILON, RT_EPSILON };
@@ -268,6 +270,8 @@ RT_GLOBAL_CONST Vector4 VECTOR_Y = { 0.0f, 1.0f, 0.0f, 0.0f };
 RT_GLOBAL_CONST Vector4 VECTOR_Z = { 0.0f, 0.0f, 1.0f, 0.0f };
 RT_GLOBAL_CONST Vector4 VECTOR_W = { 0.0f, 0.0f, 0.0f, 1.0f };
 
+#endif // RT_KERNEL_TRANSLATION_UNIT
+
 } // namespace math
 } // namespace rt
 
@@ -101,10 +101,11 @@ const Vector4 Vector4::Load4(const Uint8* src)
     const Vector4 mask = { 0xFFu, 0xFF00u, 0xFF0000u, 0xFF000000u };
     const Vector4 LoadUByte4Mul = {1.0f, 1.0f / 256.0f, 1.0f / 65536.0f, 1.0f / (65536.0f * 256.0f)};
     const Vector4 unsignedOffset = { 0.0f, 0.0f, 0.0f, 32768.0f * 65536.0f };
+    const Vector4 signMask = { 0u, 0u, 0u, 0x80000000u };
 
     __m128 vTemp = _mm_load_ps1((const Float*)src);
     vTemp = _mm_and_ps(vTemp, mask.v);
-    vTemp = _mm_xor_ps(vTemp, VECTOR_MASK_SIGN_W);
+    vTemp = _mm_xor_ps(vTemp, signMask.v);
 
     // convert to Float
     vTemp = _mm_cvtepi32_ps(_mm_castps_si128(vTemp));
@@ -127,7 +128,7 @@ const Vector4 Vector4::LoadBGR_UNorm(const Uint8* src)
 
 void Vector4::StoreBGR_NonTemporal(Uint8* dest) const
 {
-    const Vector4 scale = VECTOR_255;
+    const Vector4 scale(255.0f);
     const Vector4 scaled = (*this) * scale;
     const Vector4 fixed = scaled.Clamped(Vector4::Zero(), scale);
 
@@ -400,7 +401,7 @@ const Vector4 Vector4::NegMulAndSub(const Vector4& a, const Vector4& b, const Ve
 #ifdef RT_USE_FMA
     return _mm_fnmsub_ps(a, b, c);
 #else
-    return c - a * b;
+    return -(a * b) - c;
 #endif
 }
 
@@ -436,7 +437,7 @@ const Vector4 Vector4::Sqrt4(const Vector4& V)
 
 const Vector4 Vector4::Reciprocal(const Vector4& V)
 {
-    return _mm_div_ps(VECTOR_ONE, V);
+    return _mm_div_ps(_mm_set1_ps(1.0f), V);
 }
 
 const Vector4 Vector4::FastReciprocal(const Vector4& v)
@@ -469,7 +470,7 @@ const Vector4 Vector4::Max(const Vector4& a, const Vector4& b)
 
 const Vector4 Vector4::Abs(const Vector4& v)
 {
-    return _mm_and_ps(v, VECTOR_MASK_ABS);
+    return _mm_and_ps(v, _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF)));
 }
 
 const Vector4 Vector4::Clamped(const Vector4& min, const Vector4& max) const
@@ -682,9 +683,9 @@ const VectorBool4 Vector4::IsNaN() const
 const VectorBool4 Vector4::IsInfinite() const
 {
     // Mask off the sign bit
-    __m128 temp = _mm_and_ps(v, VECTOR_MASK_ABS);
+    const Vector4 temp = Abs(*this);
     // Compare to infinity
-    return _mm_cmpeq_ps(temp, VECTOR_INF);
+    return _mm_cmpeq_ps(temp, _mm_set1_ps(std::numeric_limits<float>::infinity()));
 }
 
 bool Vector4::IsValid() const
@@ -9,6 +9,7 @@ namespace math {
 
 /**
  * 8-element SIMD vector.
+ * NOTE: when AVX2 is not enabled, the vector is emulated with two SSE registers (see Vector8ImplSSE.h)
  */
 struct RT_ALIGN(32) Vector8
 {
@@ -16,7 +17,9 @@ struct RT_ALIGN(32) Vector8
     RT_FORCE_INLINE Vector8() = default;
     RT_FORCE_INLINE Vector8(const Vector8& other);
     RT_FORCE_INLINE static const Vector8 Zero();
+#ifdef RT_USE_AVX
     RT_FORCE_INLINE Vector8(const __m256& m);
+#endif // RT_USE_AVX
     RT_FORCE_INLINE explicit Vector8(const Vector4& lo);
     RT_FORCE_INLINE Vector8(const Vector4& lo, const Vector4& hi);
     RT_FORCE_INLINE explicit Vector8(const Float scalar);
@@ -26,6 +29,7 @@ struct RT_ALIGN(32) Vector8
     RT_FORCE_INLINE Vector8(Int32 e0, Int32 e1, Int32 e2, Int32 e3, Int32 e4, Int32 e5, Int32 e6, Int32 e7);
     RT_FORCE_INLINE Vector8(Uint32 e0, Uint32 e1, Uint32 e2, Uint32 e3, Uint32 e4, Uint32 e5, Uint32 e6, Uint32 e7);
     RT_FORCE_INLINE Vector8(const Float* src);
+    RT_FORCE_INLINE explicit Vector8(const VectorBool8& mask);
     RT_FORCE_INLINE Vector8& operator = (const Vector8& other);
     RT_FORCE_INLINE static const Vector8 FromInteger(Int32 x);
 
@@ -33,22 +37,18 @@ struct RT_ALIGN(32) Vector8
     template<Uint32 ix = 0, Uint32 iy = 1, Uint32 iz = 2, Uint32 iw = 3>
     RT_FORCE_INLINE const Vector8 Swizzle() const;
 
+#ifdef RT_USE_AVX
     RT_FORCE_INLINE operator __m256() const { return v; }
     RT_FORCE_INLINE operator __m256i() const { return reinterpret_cast<const __m256i*>(&v)[0]; }
+#endif // RT_USE_AVX
     RT_FORCE_INLINE Float operator[] (Uint32 index) const { return f[index]; }
     RT_FORCE_INLINE Float& operator[] (Uint32 index) { return f[index]; }
 
     // extract lower lanes
-    RT_FORCE_INLINE const Vector4 Low() const
-    {
-        return Vector4(_mm256_extractf128_ps(v, 0));
-    }
+    RT_FORCE_INLINE const Vector4 Low() const;
 
     // extract higher lanes
-    RT_FORCE_INLINE const Vector4 High() const
-    {
-        return Vector4(_mm256_extractf128_ps(v, 1));
-    }
+    RT_FORCE_INLINE const Vector4 High() const;
 
     // simple arithmetics
     RT_FORCE_INLINE const Vector8 operator - () const;
@@ -81,6 +81,9 @@ struct RT_ALIGN(32) Vector8
     RT_FORCE_INLINE Vector8& operator |= (const Vector8& b);
     RT_FORCE_INLINE Vector8& operator ^= (const Vector8& b);
 
+    // bitwise "and not" (~a & b)
+    RT_FORCE_INLINE static const Vector8 AndNot(const Vector8& a, const Vector8& b);
+
     RT_FORCE_INLINE static const Vector8 Floor(const Vector8& v);
     RT_FORCE_INLINE static const Vector8 Sqrt(const Vector8& v);
     RT_FORCE_INLINE static const Vector8 Reciprocal(const Vector8& v);
@@ -121,7 +124,6 @@ struct RT_ALIGN(32) Vector8
     RT_FORCE_INLINE static const Vector8 MulAndSub(const Vector8& a, const Vector8& b, const Vector8& c);
     RT_FORCE_INLINE static const Vector8 MulAndSub(const Vector8& a, const Float b, const Vector8& c);
 
-    // Fused multiply (negated) and add (a * b + c)
     // Fused multiply (negated) and add (a * b + c)
     RT_FORCE_INLINE static const Vector8 NegMulAndAdd(const Vector8& a, const Vector8& b, const Vector8& c);
     RT_FORCE_INLINE static const Vector8 NegMulAndAdd(const Vector8& a, const Float b, const Vector8& c);
@@ -140,19 +142,26 @@ struct RT_ALIGN(32) Vector8
     RT_FORCE_INLINE static void Transpose8x8(Vector8& v0, Vector8& v1, Vector8& v2, Vector8& v3, Vector8& v4, Vector8& v5, Vector8& v6, Vector8& v7);
 
 private:
+    friend struct VectorBool8;
 
     union
     {
         Float f[8];
         Int32 i[8];
         Uint32 u[8];
+#ifdef RT_USE_AVX
         __m256 v;
+#else
+        __m128 v[2];
+#endif // RT_USE_AVX
     };
 };
 
 // like Vector8::operator * (Float)
 RT_FORCE_INLINE const Vector8 operator*(Float a, const Vector8& b);
 
+#ifndef RT_KERNEL_TRANSLATION_UNIT
+
 // some commonly used constants
 RT_GLOBAL_CONST Vector8 VECTOR8_EPSILON = { RT_EPSILON, RT_EPSILON, RT_EPSILON, RT_EPSILON, RT_EPSILON, RT_EPSILON, RT_EPSILON, RT_EPSILON };
 RT_GLOBAL_CONST Vector8 VECTOR8_HALVES = { 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f };
@@ -171,7 +180,13 @@ RT_GLOBAL_CONST Vector8 VECTOR8_MASK_SIGN = { 0x80000000u, 0x80000000u, 0x800000
 RT_GLOBAL_CONST Vector8 VECTOR8_INV_255 = { 1.0f / 255.0f, 1.0f / 255.0f, 1.0f / 255.0f, 1.0f / 255.0f, 1.0f / 255.0f, 1.0f / 255.0f, 1.0f / 255.0f, 1.0f / 255.0f };
 RT_GLOBAL_CONST Vector8 VECTOR8_255 = { 255.0f, 255.0f, 255.0f, 255.0f, 255.0f, 255.0f, 255.0f, 255.0f };
 
+#endif // RT_KERNEL_TRANSLATION_UNIT
+
 } // namespace math
 } // namespace rt
 
-#include "Vector8Impl.h"
\ No newline at end of file
+#ifdef RT_USE_AVX
+#include "Vector8Impl.h"
+#else
+#include "Vector8ImplSSE.h"
+#endif // RT_USE_AVX
\ No newline at end of file
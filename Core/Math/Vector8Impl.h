@@ -26,6 +26,16 @@ Vector8::Vector8(const __m256& m)
     : v(m)
 {}
 
+const Vector4 Vector8::Low() const
+{
+    return Vector4(_mm256_extractf128_ps(v, 0));
+}
+
+const Vector4 Vector8::High() const
+{
+    return Vector4(_mm256_extractf128_ps(v, 1));
+}
+
 Vector8::Vector8(Float e0, Float e1, Float e2, Float e3, Float e4, Float e5, Float e6, Float e7)
     : v(_mm256_set_ps(e7, e6, e5, e4, e3, e2, e1, e0))
 {}
@@ -54,6 +64,14 @@ Vector8::Vector8(const Uint32 u)
     : v(_mm256_castsi256_ps(_mm256_set1_epi32(u)))
 {}
 
+Vector8::Vector8(const VectorBool8& mask)
+    : v(mask.v)
+{}
+
+VectorBool8::VectorBool8(const Vector8& other)
+    : v(other.v)
+{}
+
 const Vector8 Vector8::FromInteger(Int32 x)
 {
     return _mm256_cvtepi32_ps(_mm256_set1_epi32(x));
@@ -103,6 +121,11 @@ const Vector8 Vector8::operator^ (const Vector8& b) const
     return _mm256_xor_ps(v, b);
 }
 
+const Vector8 Vector8::AndNot(const Vector8& a, const Vector8& b)
+{
+    return _mm256_andnot_ps(a, b);
+}
+
 Vector8& Vector8::operator&= (const Vector8& b)
 {
     v = _mm256_and_ps(v, b);
@@ -232,7 +255,7 @@ const Vector8 Vector8::NegMulAndSub(const Vector8& a, const Vector8& b, const Ve
 #ifdef RT_USE_FMA
     return _mm256_fnmsub_ps(a, b, c);
 #else
-    return c - a * b;
+    return -(a * b) - c;
 #endif
 }
 
@@ -304,7 +327,7 @@ const Vector8 Vector8::Max(const Vector8& a, const Vector8& b)
 
 const Vector8 Vector8::Abs(const Vector8& v)
 {
-    return _mm256_and_ps(v, VECTOR8_MASK_ABS);
+    return _mm256_and_ps(v, _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF)));
 }
 
 const Vector8 Vector8::Clamped(const Vector8& min, const Vector8& max) const
@@ -416,17 +439,17 @@ bool Vector8::IsZero() const
 
 bool Vector8::IsNaN() const
 {
-    // Test against itself. NaN is always not equal
-    const __m256 temp = _mm256_cmp_ps(v, v, _CMP_NEQ_OQ);
+    // Test against itself. NaN is always unordered
+    const __m256 temp = _mm256_cmp_ps(v, v, _CMP_UNORD_Q);
     return _mm256_movemask_ps(temp) != 0;
 }
 
 bool Vector8::IsInfinite() const
 {
     // Mask off the sign bit
-    __m256 temp = _mm256_and_ps(v, VECTOR8_MASK_ABS);
+    __m256 temp = Abs(*this);
     // Compare to infinity
-    temp = _mm256_cmp_ps(temp, VECTOR8_INF, _CMP_EQ_OQ);
+    temp = _mm256_cmp_ps(temp, _mm256_set1_ps(std::numeric_limits<float>::infinity()), _CMP_EQ_OQ);
     return _mm256_movemask_ps(temp) != 0;
 }
 
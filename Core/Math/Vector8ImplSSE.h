@@ -0,0 +1,456 @@
+#pragma once
+
+// Vector8 emulated with two SSE registers, used when AVX2 is not enabled (v[0] holds lower lanes, v[1] holds higher lanes)
+
+namespace rt {
+namespace math {
+
+// Constructors ===================================================================================
+
+const Vector8 Vector8::Zero()
+{
+    return Vector8(_mm_setzero_ps(), _mm_setzero_ps());
+}
+
+Vector8::Vector8(const Vector8& other)
+{
+    v[0] = other.v[0];
+    v[1] = other.v[1];
+}
+
+Vector8::Vector8(const Vector4& lo)
+{
+    v[0] = lo;
+    v[1] = _mm_setzero_ps();
+}
+
+Vector8::Vector8(const Vector4& lo, const Vector4& hi)
+{
+    v[0] = lo;
+    v[1] = hi;
+}
+
+Vector8::Vector8(Float e0, Float e1, Float e2, Float e3, Float e4, Float e5, Float e6, Float e7)
+{
+    v[0] = _mm_set_ps(e3, e2, e1, e0);
+    v[1] = _mm_set_ps(e7, e6, e5, e4);
+}
+
+Vector8::Vector8(Int32 e0, Int32 e1, Int32 e2, Int32 e3, Int32 e4, Int32 e5, Int32 e6, Int32 e7)
+{
+    v[0] = _mm_castsi128_ps(_mm_set_epi32(e3, e2, e1, e0));
+    v[1] = _mm_castsi128_ps(_mm_set_epi32(e7, e6, e5, e4));
+}
+
+Vector8::Vector8(Uint32 e0, Uint32 e1, Uint32 e2, Uint32 e3, Uint32 e4, Uint32 e5, Uint32 e6, Uint32 e7)
+{
+    v[0] = _mm_castsi128_ps(_mm_set_epi32(e3, e2, e1, e0));
+    v[1] = _mm_castsi128_ps(_mm_set_epi32(e7, e6, e5, e4));
+}
+
+Vector8::Vector8(const Float* src)
+{
+    v[0] = _mm_loadu_ps(src);
+    v[1] = _mm_loadu_ps(src + 4);
+}
+
+Vector8::Vector8(const Float scalar)
+{
+    v[0] = v[1] = _mm_set1_ps(scalar);
+}
+
+Vector8::Vector8(const Int32 i)
+{
+    v[0] = v[1] = _mm_castsi128_ps(_mm_set1_epi32(i));
+}
+
+Vector8::Vector8(const Uint32 u)
+{
+    v[0] = v[1] = _mm_castsi128_ps(_mm_set1_epi32(u));
+}
+
+Vector8::Vector8(const VectorBool8& mask)
+{
+    v[0] = mask.v[0];
+    v[1] = mask.v[1];
+}
+
+VectorBool8::VectorBool8(const Vector8& other)
+{
+    v[0] = other.v[0];
+    v[1] = other.v[1];
+}
+
+const Vector8 Vector8::FromInteger(Int32 x)
+{
+    const __m128 value = _mm_cvtepi32_ps(_mm_set1_epi32(x));
+    return Vector8(value, value);
+}
+
+Vector8& Vector8::operator = (const Vector8& other)
+{
+    v[0] = other.v[0];
+    v[1] = other.v[1];
+    return *this;
+}
+
+const Vector4 Vector8::Low() const
+{
+    return Vector4(v[0]);
+}
+
+const Vector4 Vector8::High() const
+{
+    return Vector4(v[1]);
+}
+
+const Vector8 Vector8::Select(const Vector8& a, const Vector8& b, const VectorBool8& sel)
+{
+    return Vector8(_mm_blendv_ps(a.v[0], b.v[0], sel.v[0]), _mm_blendv_ps(a.v[1], b.v[1], sel.v[1]));
+}
+
+bool Vector8::AlmostEqual(const Vector8& v1, const Vector8& v2, Float epsilon)
+{
+    return (Abs(v1 - v2) < Vector8(epsilon)).All();
+}
+
+template<Uint32 ix, Uint32 iy, Uint32 iz, Uint32 iw>
+const Vector8 Vector8::Swizzle() const
+{
+    static_assert(ix < 4, "Invalid X element index");
+    static_assert(iy < 4, "Invalid Y element index");
+    static_assert(iz < 4, "Invalid Z element index");
+    static_assert(iw < 4, "Invalid W element index");
+
+    return Vector8(_mm_shuffle_ps(v[0], v[0], _MM_SHUFFLE(iw, iz, iy, ix)), _mm_shuffle_ps(v[1], v[1], _MM_SHUFFLE(iw, iz, iy, ix)));
+}
+
+// Logical operations =============================================================================
+
+const Vector8 Vector8::operator& (const Vector8& b) const
+{
+    return Vector8(_mm_and_ps(v[0], b.v[0]), _mm_and_ps(v[1], b.v[1]));
+}
+
+const Vector8 Vector8::operator| (const Vector8& b) const
+{
+    return Vector8(_mm_or_ps(v[0], b.v[0]), _mm_or_ps(v[1], b.v[1]));
+}
+
+const Vector8 Vector8::operator^ (const Vector8& b) const
+{
+    return Vector8(_mm_xor_ps(v[0], b.v[0]), _mm_xor_ps(v[1], b.v[1]));
+}
+
+const Vector8 Vector8::AndNot(const Vector8& a, const Vector8& b)
+{
+    return Vector8(_mm_andnot_ps(a.v[0], b.v[0]), _mm_andnot_ps(a.v[1], b.v[1]));
+}
+
+Vector8& Vector8::operator&= (const Vector8& b)
+{
+    v[0] = _mm_and_ps(v[0], b.v[0]);
+    v[1] = _mm_and_ps(v[1], b.v[1]);
+    return *this;
+}
+
+Vector8& Vector8::operator|= (const Vector8& b)
+{
+    v[0] = _mm_or_ps(v[0], b.v[0]);
+    v[1] = _mm_or_ps(v[1], b.v[1]);
+    return *this;
+}
+
+Vector8& Vector8::operator^= (const Vector8& b)
+{
+    v[0] = _mm_xor_ps(v[0], b.v[0]);
+    v[1] = _mm_xor_ps(v[1], b.v[1]);
+    return *this;
+}
+
+// Simple arithmetics =============================================================================
+
+const Vector8 Vector8::operator- () const
+{
+    return Vector8::Zero() - (*this);
+}
+
+const Vector8 Vector8::operator+ (const Vector8& b) const
+{
+    return Vector8(_mm_add_ps(v[0], b.v[0]), _mm_add_ps(v[1], b.v[1]));
+}
+
+const Vector8 Vector8::operator- (const Vector8& b) const
+{
+    return Vector8(_mm_sub_ps(v[0], b.v[0]), _mm_sub_ps(v[1], b.v[1]));
+}
+
+const Vector8 Vector8::operator* (const Vector8& b) const
+{
+    return Vector8(_mm_mul_ps(v[0], b.v[0]), _mm_mul_ps(v[1], b.v[1]));
+}
+
+const Vector8 Vector8::operator/ (const Vector8& b) const
+{
+    return Vector8(_mm_div_ps(v[0], b.v[0]), _mm_div_ps(v[1], b.v[1]));
+}
+
+const Vector8 Vector8::operator* (Float b) const
+{
+    const __m128 scalar = _mm_set1_ps(b);
+    return Vector8(_mm_mul_ps(v[0], scalar), _mm_mul_ps(v[1], scalar));
+}
+
+const Vector8 Vector8::operator/ (Float b) const
+{
+    const __m128 scalar = _mm_set1_ps(b);
+    return Vector8(_mm_div_ps(v[0], scalar), _mm_div_ps(v[1], scalar));
+}
+
+const Vector8 operator*(Float a, const Vector8& b)
+{
+    return b * a;
+}
+
+
+Vector8& Vector8::operator+= (const Vector8& b)
+{
+    v[0] = _mm_add_ps(v[0], b.v[0]);
+    v[1] = _mm_add_ps(v[1], b.v[1]);
+    return *this;
+}
+
+Vector8& Vector8::operator-= (const Vector8& b)
+{
+    v[0] = _mm_sub_ps(v[0], b.v[0]);
+    v[1] = _mm_sub_ps(v[1], b.v[1]);
+    return *this;
+}
+
+Vector8& Vector8::operator*= (const Vector8& b)
+{
+    v[0] = _mm_mul_ps(v[0], b.v[0]);
+    v[1] = _mm_mul_ps(v[1], b.v[1]);
+    return *this;
+}
+
+Vector8& Vector8::operator/= (const Vector8& b)
+{
+    v[0] = _mm_div_ps(v[0], b.v[0]);
+    v[1] = _mm_div_ps(v[1], b.v[1]);
+    return *this;
+}
+
+Vector8& Vector8::operator*= (Float b)
+{
+    const __m128 scalar = _mm_set1_ps(b);
+    v[0] = _mm_mul_ps(v[0], scalar);
+    v[1] = _mm_mul_ps(v[1], scalar);
+    return *this;
+}
+
+Vector8& Vector8::operator/= (Float b)
+{
+    const __m128 scalar = _mm_set1_ps(b);
+    v[0] = _mm_div_ps(v[0], scalar);
+    v[1] = _mm_div_ps(v[1], scalar);
+    return *this;
+}
+
+const Vector8 Vector8::MulAndAdd(const Vector8& a, const Vector8& b, const Vector8& c)
+{
+    return a * b + c;
+}
+
+const Vector8 Vector8::MulAndSub(const Vector8& a, const Vector8& b, const Vector8& c)
+{
+    return a * b - c;
+}
+
+const Vector8 Vector8::NegMulAndAdd(const Vector8& a, const Vector8& b, const Vector8& c)
+{
+    return c - a * b;
+}
+
+const Vector8 Vector8::NegMulAndSub(const Vector8& a, const Vector8& b, const Vector8& c)
+{
+    return -(a * b) - c;
+}
+
+const Vector8 Vector8::MulAndAdd(const Vector8& a, const Float b, const Vector8& c)
+{
+    return MulAndAdd(a, Vector8(b), c);
+}
+
+const Vector8 Vector8::MulAndSub(const Vector8& a, const Float b, const Vector8& c)
+{
+    return MulAndSub(a, Vector8(b), c);
+}
+
+const Vector8 Vector8::NegMulAndAdd(const Vector8& a, const Float b, const Vector8& c)
+{
+    return NegMulAndAdd(a, Vector8(b), c);
+}
+
+const Vector8 Vector8::NegMulAndSub(const Vector8& a, const Float b, const Vector8& c)
+{
+    return NegMulAndSub(a, Vector8(b), c);
+}
+
+const Vector8 Vector8::Floor(const Vector8& V)
+{
+    const __m128 offset = _mm_set1_ps(0.49999f);
+    return Vector8(_mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_sub_ps(V.v[0], offset))),
+                   _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_sub_ps(V.v[1], offset))));
+}
+
+const Vector8 Vector8::Sqrt(const Vector8& V)
+{
+    return Vector8(_mm_sqrt_ps(V.v[0]), _mm_sqrt_ps(V.v[1]));
+}
+
+const Vector8 Vector8::Reciprocal(const Vector8& V)
+{
+    return Vector8(1.0f) / V;
+}
+
+const Vector8 Vector8::FastReciprocal(const Vector8& v)
+{
+    const Vector8 rcp(_mm_rcp_ps(v.v[0]), _mm_rcp_ps(v.v[1]));
+    const Vector8 rcpSqr = rcp * rcp;
+    const Vector8 rcp2 = rcp + rcp;
+    return NegMulAndAdd(rcpSqr, v, rcp2);
+}
+
+const Vector8 Vector8::Lerp(const Vector8& v1, const Vector8& v2, const Vector8& weight)
+{
+    return MulAndAdd(v2 - v1, weight, v1);
+}
+
+const Vector8 Vector8::Lerp(const Vector8& v1, const Vector8& v2, Float weight)
+{
+    return MulAndAdd(v2 - v1, weight, v1);
+}
+
+const Vector8 Vector8::Min(const Vector8& a, const Vector8& b)
+{
+    return Vector8(_mm_min_ps(a.v[0], b.v[0]), _mm_min_ps(a.v[1], b.v[1]));
+}
+
+const Vector8 Vector8::Max(const Vector8& a, const Vector8& b)
+{
+    return Vector8(_mm_max_ps(a.v[0], b.v[0]), _mm_max_ps(a.v[1], b.v[1]));
+}
+
+const Vector8 Vector8::Abs(const Vector8& v)
+{
+    const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    return Vector8(_mm_and_ps(v.v[0], mask), _mm_and_ps(v.v[1], mask));
+}
+
+const Vector8 Vector8::Clamped(const Vector8& min, const Vector8& max) const
+{
+    return Min(max, Max(min, *this));
+}
+
+Int32 Vector8::GetSignMask() const
+{
+    return _mm_movemask_ps(v[0]) | (_mm_movemask_ps(v[1]) << 4);
+}
+
+const Vector8 Vector8::HorizontalMax() const
+{
+    __m128 temp;
+    temp = _mm_max_ps(v[0], v[1]);
+    temp = _mm_max_ps(temp, _mm_shuffle_ps(temp, temp, _MM_SHUFFLE(2, 3, 0, 1)));
+    temp = _mm_max_ps(temp, _mm_shuffle_ps(temp, temp, _MM_SHUFFLE(1, 0, 3, 2)));
+    return Vector8(temp, temp);
+}
+
+const Vector8 Vector8::Fmod1(const Vector8 x)
+{
+    return Vector8(_mm_sub_ps(x.v[0], _mm_round_ps(x.v[0], _MM_FROUND_TO_ZERO)),
+                   _mm_sub_ps(x.v[1], _mm_round_ps(x.v[1], _MM_FROUND_TO_ZERO)));
+}
+
+void Vector8::Transpose8x8(Vector8& v0, Vector8& v1, Vector8& v2, Vector8& v3, Vector8& v4, Vector8& v5, Vector8& v6, Vector8& v7)
+{
+    // transpose each of four 4x4 blocks separately, off-diagonal blocks are swapped
+    __m128 a0 = v0.v[0], a1 = v1.v[0], a2 = v2.v[0], a3 = v3.v[0];
+    __m128 b0 = v0.v[1], b1 = v1.v[1], b2 = v2.v[1], b3 = v3.v[1];
+    __m128 c0 = v4.v[0], c1 = v5.v[0], c2 = v6.v[0], c3 = v7.v[0];
+    __m128 d0 = v4.v[1], d1 = v5.v[1], d2 = v6.v[1], d3 = v7.v[1];
+
+    _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+    _MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    _MM_TRANSPOSE4_PS(d0, d1, d2, d3);
+
+    v0 = Vector8(a0, c0);
+    v1 = Vector8(a1, c1);
+    v2 = Vector8(a2, c2);
+    v3 = Vector8(a3, c3);
+    v4 = Vector8(b0, d0);
+    v5 = Vector8(b1, d1);
+    v6 = Vector8(b2, d2);
+    v7 = Vector8(b3, d3);
+}
+
+// Comparison functions ===========================================================================
+
+const VectorBool8 Vector8::operator == (const Vector8& b) const
+{
+    return VectorBool8(_mm_cmpeq_ps(v[0], b.v[0]), _mm_cmpeq_ps(v[1], b.v[1]));
+}
+
+const VectorBool8 Vector8::operator < (const Vector8& b) const
+{
+    return VectorBool8(_mm_cmplt_ps(v[0], b.v[0]), _mm_cmplt_ps(v[1], b.v[1]));
+}
+
+const VectorBool8 Vector8::operator <= (const Vector8& b) const
+{
+    return VectorBool8(_mm_cmple_ps(v[0], b.v[0]), _mm_cmple_ps(v[1], b.v[1]));
+}
+
+const VectorBool8 Vector8::operator > (const Vector8& b) const
+{
+    return VectorBool8(_mm_cmpgt_ps(v[0], b.v[0]), _mm_cmpgt_ps(v[1], b.v[1]));
+}
+
+const VectorBool8 Vector8::operator >= (const Vector8& b) const
+{
+    return VectorBool8(_mm_cmpge_ps(v[0], b.v[0]), _mm_cmpge_ps(v[1], b.v[1]));
+}
+
+const VectorBool8 Vector8::operator != (const Vector8& b) const
+{
+    // ordered comparison, like _CMP_NEQ_OQ in AVX version
+    return VectorBool8(_mm_and_ps(_mm_cmpneq_ps(v[0], b.v[0]), _mm_cmpord_ps(v[0], b.v[0])),
+                       _mm_and_ps(_mm_cmpneq_ps(v[1], b.v[1]), _mm_cmpord_ps(v[1], b.v[1])));
+}
+
+bool Vector8::IsZero() const
+{
+    return (*this == Vector8::Zero()).All();
+}
+
+bool Vector8::IsNaN() const
+{
+    // Test against itself. NaN is always unordered
+    return (_mm_movemask_ps(_mm_cmpunord_ps(v[0], v[0])) | _mm_movemask_ps(_mm_cmpunord_ps(v[1], v[1]))) != 0;
+}
+
+bool Vector8::IsInfinite() const
+{
+    // Mask off the sign bit and compare to infinity
+    return (Abs(*this) == Vector8(std::numeric_limits<float>::infinity())).Any();
+}
+
+bool Vector8::IsValid() const
+{
+    return !IsNaN() && !IsInfinite();
+}
+
+} // namespace math
+} // namespace rt
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Math.h"
+#include "VectorBool8.h"
+
+#ifdef RT_ENABLE_AVX512_KERNELS
+
+namespace rt {
+namespace math {
+
+/**
+ * 16-element boolean vector (AVX-512 mask register)
+ * NOTE: can be used only in functions compiled for AVX-512 (see RT_TARGET_AVX512)
+ */
+struct VectorBool16
+{
+    VectorBool16() = default;
+
+    RT_FORCE_INLINE_AVX512 VectorBool16(const __mmask16 other) : v(other) { }
+
+    // combine two 8-element masks
+    RT_FORCE_INLINE_AVX512 VectorBool16(const VectorBool8& lo, const VectorBool8& hi)
+        : v(static_cast<__mmask16>(lo.GetMask() | (hi.GetMask() << 8)))
+    { }
+
+    RT_FORCE_INLINE_AVX512 operator __mmask16() const { return v; }
+
+    template<Uint32 index>
+    RT_FORCE_INLINE_AVX512 bool Get() const
+    {
+        static_assert(index < 16, "Invalid index");
+        return ((v >> index) & 1) != 0;
+    }
+
+    // extract lower 8 elements
+    RT_FORCE_INLINE_AVX512 const VectorBool8 Low() const
+    {
+        return FromMask8(static_cast<__mmask8>(v));
+    }
+
+    // extract higher 8 elements
+    RT_FORCE_INLINE_AVX512 const VectorBool8 High() const
+    {
+        return FromMask8(static_cast<__mmask8>(v >> 8));
+    }
+
+    // combine into 16-bit mask
+    RT_FORCE_INLINE_AVX512 int GetMask() const
+    {
+        return static_cast<int>(v);
+    }
+
+    RT_FORCE_INLINE_AVX512 bool All() const
+    {
+        return v == 0xFFFF;
+    }
+
+    RT_FORCE_INLINE_AVX512 bool None() const
+    {
+        return v == 0;
+    }
+
+    RT_FORCE_INLINE_AVX512 bool Any() const
+    {
+        return v != 0;
+    }
+
+    RT_FORCE_INLINE_AVX512 const VectorBool16 operator & (const VectorBool16 rhs) const
+    {
+        return _kand_mask16(v, rhs.v);
+    }
+
+    RT_FORCE_INLINE_AVX512 const VectorBool16 operator | (const VectorBool16 rhs) const
+    {
+        return _kor_mask16(v, rhs.v);
+    }
+
+    RT_FORCE_INLINE_AVX512 const VectorBool16 operator ^ (const VectorBool16 rhs) const
+    {
+        return _kxor_mask16(v, rhs.v);
+    }
+
+    RT_FORCE_INLINE_AVX512 bool operator == (const VectorBool16 rhs) const
+    {
+        return v == rhs.v;
+    }
+
+private:
+
+    // VectorBool8 is emulated with two SSE registers if AVX is not enabled for the whole translation unit
+    RT_FORCE_INLINE_AVX512 static const VectorBool8 FromMask8(const __mmask8 mask)
+    {
+#ifdef RT_USE_AVX
+        return VectorBool8(_mm256_castsi256_ps(_mm256_movm_epi32(mask)));
+#else
+        return VectorBool8(_mm_castsi128_ps(_mm_movm_epi32(mask)), _mm_castsi128_ps(_mm_movm_epi32(static_cast<__mmask8>(mask >> 4))));
+#endif // RT_USE_AVX
+    }
+
+    __mmask16 v;
+};
+
+} // namespace math
+} // namespace rt
+
+#endif // RT_ENABLE_AVX512_KERNELS
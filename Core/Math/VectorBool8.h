@@ -5,13 +5,21 @@
 namespace rt {
 namespace math {
 
+struct Vector8;
+
 /**
  * 8-element boolean vector
+ * NOTE: when AVX2 is not enabled, the vector is emulated with two SSE registers
  */
 struct RT_ALIGN(32) VectorBool8
 {
     VectorBool8() = default;
 
+    // use vector's sign bits as boolean values
+    RT_FORCE_INLINE explicit VectorBool8(const Vector8& v);
+
+#ifdef RT_USE_AVX
+
     RT_FORCE_INLINE VectorBool8(bool e0, bool e1, bool e2, bool e3, bool e4, bool e5, bool e6, bool e7)
     {
         v = _mm256_castsi256_ps(_mm256_set_epi32(
@@ -32,7 +40,7 @@ struct RT_ALIGN(32) VectorBool8
     RT_FORCE_INLINE bool Get() const
     {
         static_assert(index < 8, "Invalid index");
-        return _mm_extract_ps(v, index) != 0;
+        return (GetMask() & (1 << index)) != 0;
     }
 
     // combine into 8-bit mask
@@ -41,37 +49,92 @@ struct RT_ALIGN(32) VectorBool8
         return _mm256_movemask_ps(v);
     }
 
-    RT_FORCE_INLINE bool All() const
+    RT_FORCE_INLINE const VectorBool8 operator & (const VectorBool8 rhs) const
     {
-        return _mm256_movemask_ps(v) == 0xFF;
+        return _mm256_and_ps(v, rhs.v);
     }
 
-    RT_FORCE_INLINE bool None() const
+    RT_FORCE_INLINE const VectorBool8 operator | (const VectorBool8 rhs) const
     {
-        return _mm256_movemask_ps(v) == 0;
+        return _mm256_or_ps(v, rhs.v);
     }
 
-    RT_FORCE_INLINE bool Any() const
+    RT_FORCE_INLINE const VectorBool8 operator ^ (const VectorBool8 rhs) const
     {
-        return _mm256_movemask_ps(v) != 0;
+        return _mm256_xor_ps(v, rhs.v);
     }
 
-    const VectorBool8 operator & (const VectorBool8 rhs) const
+#else
+
+    RT_FORCE_INLINE VectorBool8(bool e0, bool e1, bool e2, bool e3, bool e4, bool e5, bool e6, bool e7)
     {
-        return _mm256_and_ps(v, rhs.v);
+        v[0] = _mm_castsi128_ps(_mm_set_epi32(
+            e3 ? 0xFFFFFFFF : 0,
+            e2 ? 0xFFFFFFFF : 0,
+            e1 ? 0xFFFFFFFF : 0,
+            e0 ? 0xFFFFFFFF : 0
+        ));
+        v[1] = _mm_castsi128_ps(_mm_set_epi32(
+            e7 ? 0xFFFFFFFF : 0,
+            e6 ? 0xFFFFFFFF : 0,
+            e5 ? 0xFFFFFFFF : 0,
+            e4 ? 0xFFFFFFFF : 0
+        ));
     }
 
-    const VectorBool8 operator | (const VectorBool8 rhs) const
+    // build from lower and higher lanes
+    RT_FORCE_INLINE VectorBool8(const __m128 lo, const __m128 hi)
     {
-        return _mm256_or_ps(v, rhs.v);
+        v[0] = lo;
+        v[1] = hi;
     }
 
-    const VectorBool8 operator ^ (const VectorBool8 rhs) const
+    template<Uint32 index>
+    RT_FORCE_INLINE bool Get() const
     {
-        return _mm256_xor_ps(v, rhs.v);
+        static_assert(index < 8, "Invalid index");
+        return (GetMask() & (1 << index)) != 0;
+    }
+
+    // combine into 8-bit mask
+    RT_FORCE_INLINE int GetMask() const
+    {
+        return _mm_movemask_ps(v[0]) | (_mm_movemask_ps(v[1]) << 4);
+    }
+
+    RT_FORCE_INLINE const VectorBool8 operator & (const VectorBool8 rhs) const
+    {
+        return VectorBool8(_mm_and_ps(v[0], rhs.v[0]), _mm_and_ps(v[1], rhs.v[1]));
+    }
+
+    RT_FORCE_INLINE const VectorBool8 operator | (const VectorBool8 rhs) const
+    {
+        return VectorBool8(_mm_or_ps(v[0], rhs.v[0]), _mm_or_ps(v[1], rhs.v[1]));
+    }
+
+    RT_FORCE_INLINE const VectorBool8 operator ^ (const VectorBool8 rhs) const
+    {
+        return VectorBool8(_mm_xor_ps(v[0], rhs.v[0]), _mm_xor_ps(v[1], rhs.v[1]));
+    }
+
+#endif // RT_USE_AVX
+
+    RT_FORCE_INLINE bool All() const
+    {
+        return GetMask() == 0xFF;
+    }
+
+    RT_FORCE_INLINE bool None() const
+    {
+        return GetMask() == 0;
+    }
+
+    RT_FORCE_INLINE bool Any() const
+    {
+        return GetMask() != 0;
     }
 
-    bool operator == (const VectorBool8 rhs) const
+    RT_FORCE_INLINE bool operator == (const VectorBool8 rhs) const
     {
         return GetMask() == rhs.GetMask();
     }
@@ -79,7 +142,11 @@ struct RT_ALIGN(32) VectorBool8
 private:
     friend struct Vector8;
 
+#ifdef RT_USE_AVX
     __m256 v;
+#else
+    __m128 v[2];
+#endif // RT_USE_AVX
 };
 
 } // namespace math
@@ -10,24 +10,35 @@ struct Vector8;
 
 /**
  * 8-element integer SIMD vector.
+ * NOTE: when AVX2 is not enabled, the vector is emulated with two SSE registers (see VectorInt8ImplSSE.h)
  */
 struct RT_ALIGN(32) VectorInt8
 {
     // constructors
     RT_FORCE_INLINE VectorInt8() = default;
     RT_FORCE_INLINE static const VectorInt8 Zero();
+#ifdef RT_USE_AVX
     RT_FORCE_INLINE VectorInt8(const __m256i& m);
-    RT_FORCE_INLINE VectorInt8(const VectorInt4& lo, const VectorInt4& hi);
     RT_FORCE_INLINE explicit VectorInt8(const __m256& m);
+#endif // RT_USE_AVX
+    RT_FORCE_INLINE VectorInt8(const VectorInt4& lo, const VectorInt4& hi);
     RT_FORCE_INLINE explicit VectorInt8(const Int32 scalar);
     RT_FORCE_INLINE explicit VectorInt8(const Uint32 scalar);
     RT_FORCE_INLINE VectorInt8(const Int32 e0, const Int32 e1, const Int32 e2, const Int32 e3, const Int32 e4, const Int32 e5, const Int32 e6, const Int32 e7);
 
+#ifdef RT_USE_AVX
     RT_FORCE_INLINE operator __m256i() const { return v; }
     RT_FORCE_INLINE operator __m256() const { return _mm256_castsi256_ps(v); }
+#endif // RT_USE_AVX
     RT_FORCE_INLINE Int32 operator[] (const Uint32 index) const { return i[index]; }
     RT_FORCE_INLINE Int32& operator[] (const Uint32 index) { return i[index]; }
 
+    // extract lower lanes
+    RT_FORCE_INLINE const VectorInt4 Low() const;
+
+    // extract higher lanes
+    RT_FORCE_INLINE const VectorInt4 High() const;
+
     // bitwise logic operations
     RT_FORCE_INLINE const VectorInt8 operator & (const VectorInt8& b) const;
     RT_FORCE_INLINE const VectorInt8 operator | (const VectorInt8& b) const;
@@ -36,8 +47,6 @@ struct RT_ALIGN(32) VectorInt8
     RT_FORCE_INLINE VectorInt8& operator |= (const VectorInt8& b);
     RT_FORCE_INLINE VectorInt8& operator ^= (const VectorInt8& b);
 
-#ifdef RT_USE_AVX2
-
     // simple arithmetics
     RT_FORCE_INLINE const VectorInt8 operator - () const;
     RT_FORCE_INLINE const VectorInt8 operator + (const VectorInt8& b) const;
@@ -64,14 +73,16 @@ struct RT_ALIGN(32) VectorInt8
     RT_FORCE_INLINE static const VectorInt8 Max(const VectorInt8& a, const VectorInt8& b);
     RT_FORCE_INLINE const VectorInt8 Clamped(const VectorInt8& min, const VectorInt8& max) const;
 
+    // rearrange elements across lanes: i-th element of the result is taken from "v" at index stored in i-th element of "indices"
+    RT_FORCE_INLINE static const VectorInt8 Permute(const VectorInt8& v, const VectorInt8& indices);
+    RT_FORCE_INLINE static const Vector8 Permute(const Vector8& v, const VectorInt8& indices);
+
     // convert from float vector to integer vector
     RT_FORCE_INLINE static const VectorInt8 Convert(const Vector8& v);
 
     // convert to float vector
     RT_FORCE_INLINE const Vector8 ConvertToFloat() const;
 
-#endif // RT_USE_AVX2
-
     // cast from float vector (preserve bits)
     RT_FORCE_INLINE static const VectorInt8 Cast(const Vector8& v);
 
@@ -93,8 +104,13 @@ private:
     {
         Int32 i[8];
         Uint32 u[8];
+#ifdef RT_USE_AVX
         __m256 f;
         __m256i v;
+#else
+        __m128 f[2];
+        __m128i v[2];
+#endif // RT_USE_AVX
     };
 };
 
@@ -102,4 +118,8 @@ private:
 } // namespace rt
 
 
-#include "VectorInt8Impl.h"
\ No newline at end of file
+#ifdef RT_USE_AVX
+#include "VectorInt8Impl.h"
+#else
+#include "VectorInt8ImplSSE.h"
+#endif // RT_USE_AVX
\ No newline at end of file
@@ -20,9 +20,19 @@ VectorInt8::VectorInt8(const __m256& m)
 {}
 
 VectorInt8::VectorInt8(const VectorInt4& lo, const VectorInt4& hi)
-    : v(_mm256_insertf128_si256(_mm256_castsi128_si256(hi), lo, 1u))
+    : v(_mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1u))
 {}
 
+const VectorInt4 VectorInt8::Low() const
+{
+    return VectorInt4(_mm256_castsi256_si128(v));
+}
+
+const VectorInt4 VectorInt8::High() const
+{
+    return VectorInt4(_mm256_extractf128_si256(v, 1u));
+}
+
 const VectorInt8 VectorInt8::Cast(const Vector8& v)
 {
     return _mm256_castps_si256(v);
@@ -83,8 +93,6 @@ VectorInt8& VectorInt8::operator ^= (const VectorInt8& b)
     return *this;
 }
 
-#ifdef RT_USE_AVX2
-
 const VectorInt8 VectorInt8::Convert(const Vector8& v)
 {
     return _mm256_cvtps_epi32(_mm256_round_ps(v, _MM_FROUND_TO_ZERO));
@@ -97,7 +105,7 @@ const Vector8 VectorInt8::ConvertToFloat() const
 
 const VectorInt8 VectorInt8::operator - () const
 {
-    return VectorInt8() - (*this);
+    return VectorInt8::Zero() - (*this);
 }
 
 const VectorInt8 VectorInt8::operator + (const VectorInt8& b) const
@@ -196,7 +204,15 @@ const VectorInt8 VectorInt8::Max(const VectorInt8& a, const VectorInt8& b)
     return _mm256_max_epi32(a, b);
 }
 
-#endif // RT_USE_AVX2
+const VectorInt8 VectorInt8::Permute(const VectorInt8& v, const VectorInt8& indices)
+{
+    return _mm256_permutevar8x32_epi32(v, indices);
+}
+
+const Vector8 VectorInt8::Permute(const Vector8& v, const VectorInt8& indices)
+{
+    return _mm256_permutevar8x32_ps(v, indices);
+}
 
 } // namespace math
 } // namespace rt
@@ -0,0 +1,233 @@
+#pragma once
+
+#include "Vector8.h"
+
+// VectorInt8 emulated with two SSE registers, used when AVX2 is not enabled (v[0] holds lower lanes, v[1] holds higher lanes)
+
+namespace rt {
+namespace math {
+
+
+const VectorInt8 VectorInt8::Zero()
+{
+    return VectorInt8(_mm_setzero_si128(), _mm_setzero_si128());
+}
+
+VectorInt8::VectorInt8(const VectorInt4& lo, const VectorInt4& hi)
+{
+    v[0] = lo;
+    v[1] = hi;
+}
+
+const VectorInt4 VectorInt8::Low() const
+{
+    return VectorInt4(v[0]);
+}
+
+const VectorInt4 VectorInt8::High() const
+{
+    return VectorInt4(v[1]);
+}
+
+const VectorInt8 VectorInt8::Cast(const Vector8& v)
+{
+    return VectorInt8(_mm_castps_si128(v.Low()), _mm_castps_si128(v.High()));
+}
+
+const Vector8 VectorInt8::CastToFloat() const
+{
+    return Vector8(_mm_castsi128_ps(v[0]), _mm_castsi128_ps(v[1]));
+}
+
+VectorInt8::VectorInt8(const Int32 e0, const Int32 e1, const Int32 e2, const Int32 e3, const Int32 e4, const Int32 e5, const Int32 e6, const Int32 e7)
+{
+    v[0] = _mm_set_epi32(e3, e2, e1, e0);
+    v[1] = _mm_set_epi32(e7, e6, e5, e4);
+}
+
+VectorInt8::VectorInt8(const Int32 i)
+{
+    v[0] = v[1] = _mm_set1_epi32(i);
+}
+
+VectorInt8::VectorInt8(const Uint32 u)
+{
+    v[0] = v[1] = _mm_set1_epi32(u);
+}
+
+const VectorInt8 VectorInt8::SelectBySign(const VectorInt8& a, const VectorInt8& b, const VectorInt8& sel)
+{
+    return VectorInt8::Cast(Vector8(_mm_blendv_ps(a.f[0], b.f[0], sel.f[0]), _mm_blendv_ps(a.f[1], b.f[1], sel.f[1])));
+}
+
+const VectorInt8 VectorInt8::operator & (const VectorInt8& b) const
+{
+    return VectorInt8(_mm_and_si128(v[0], b.v[0]), _mm_and_si128(v[1], b.v[1]));
+}
+
+const VectorInt8 VectorInt8::operator | (const VectorInt8& b) const
+{
+    return VectorInt8(_mm_or_si128(v[0], b.v[0]), _mm_or_si128(v[1], b.v[1]));
+}
+
+const VectorInt8 VectorInt8::operator ^ (const VectorInt8& b) const
+{
+    return VectorInt8(_mm_xor_si128(v[0], b.v[0]), _mm_xor_si128(v[1], b.v[1]));
+}
+
+VectorInt8& VectorInt8::operator &= (const VectorInt8& b)
+{
+    v[0] = _mm_and_si128(v[0], b.v[0]);
+    v[1] = _mm_and_si128(v[1], b.v[1]);
+    return *this;
+}
+
+VectorInt8& VectorInt8::operator |= (const VectorInt8& b)
+{
+    v[0] = _mm_or_si128(v[0], b.v[0]);
+    v[1] = _mm_or_si128(v[1], b.v[1]);
+    return *this;
+}
+
+VectorInt8& VectorInt8::operator ^= (const VectorInt8& b)
+{
+    v[0] = _mm_xor_si128(v[0], b.v[0]);
+    v[1] = _mm_xor_si128(v[1], b.v[1]);
+    return *this;
+}
+
+const VectorInt8 VectorInt8::Convert(const Vector8& v)
+{
+    return VectorInt8(_mm_cvtps_epi32(_mm_round_ps(v.Low(), _MM_FROUND_TO_ZERO)),
+                      _mm_cvtps_epi32(_mm_round_ps(v.High(), _MM_FROUND_TO_ZERO)));
+}
+
+const Vector8 VectorInt8::ConvertToFloat() const
+{
+    return Vector8(_mm_cvtepi32_ps(v[0]), _mm_cvtepi32_ps(v[1]));
+}
+
+const VectorInt8 VectorInt8::operator - () const
+{
+    return VectorInt8::Zero() - (*this);
+}
+
+const VectorInt8 VectorInt8::operator + (const VectorInt8& b) const
+{
+    return VectorInt8(_mm_add_epi32(v[0], b.v[0]), _mm_add_epi32(v[1], b.v[1]));
+}
+
+const VectorInt8 VectorInt8::operator - (const VectorInt8& b) const
+{
+    return VectorInt8(_mm_sub_epi32(v[0], b.v[0]), _mm_sub_epi32(v[1], b.v[1]));
+}
+
+const VectorInt8 VectorInt8::operator * (const VectorInt8& b) const
+{
+    return VectorInt8(_mm_mullo_epi32(v[0], b.v[0]), _mm_mullo_epi32(v[1], b.v[1]));
+}
+
+VectorInt8& VectorInt8::operator += (const VectorInt8& b)
+{
+    *this = *this + b;
+    return *this;
+}
+
+VectorInt8& VectorInt8::operator -= (const VectorInt8& b)
+{
+    *this = *this - b;
+    return *this;
+}
+
+const VectorInt8 VectorInt8::operator + (Int32 b) const
+{
+    return *this + VectorInt8(b);
+}
+
+const VectorInt8 VectorInt8::operator - (Int32 b) const
+{
+    return *this - VectorInt8(b);
+}
+
+const VectorInt8 VectorInt8::operator * (Int32 b) const
+{
+    return *this * VectorInt8(b);
+}
+
+const VectorInt8 VectorInt8::operator % (Int32 b) const
+{
+    // TODO
+    return VectorInt8(i[0] % b, i[1] % b, i[2] % b, i[3] % b, i[4] % b, i[5] % b, i[6] % b, i[7] % b);
+}
+
+VectorInt8& VectorInt8::operator += (Int32 b)
+{
+    *this = *this + VectorInt8(b);
+    return *this;
+}
+
+VectorInt8& VectorInt8::operator -= (Int32 b)
+{
+    *this = *this - VectorInt8(b);
+    return *this;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+bool VectorInt8::operator == (const VectorInt8& b) const
+{
+    const __m128i lo = _mm_cmpeq_epi32(v[0], b.v[0]);
+    const __m128i hi = _mm_cmpeq_epi32(v[1], b.v[1]);
+    return (_mm_movemask_ps(_mm_castsi128_ps(lo)) & _mm_movemask_ps(_mm_castsi128_ps(hi))) == 0xF;
+}
+
+bool VectorInt8::operator != (const VectorInt8& b) const
+{
+    return !(*this == b);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+const VectorInt8 VectorInt8::operator << (Int32 b) const
+{
+    return VectorInt8(_mm_slli_epi32(v[0], b), _mm_slli_epi32(v[1], b));
+}
+
+const VectorInt8 VectorInt8::operator >> (Int32 b) const
+{
+    return VectorInt8(_mm_srli_epi32(v[0], b), _mm_srli_epi32(v[1], b));
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+const VectorInt8 VectorInt8::Min(const VectorInt8& a, const VectorInt8& b)
+{
+    return VectorInt8(_mm_min_epi32(a.v[0], b.v[0]), _mm_min_epi32(a.v[1], b.v[1]));
+}
+
+const VectorInt8 VectorInt8::Max(const VectorInt8& a, const VectorInt8& b)
+{
+    return VectorInt8(_mm_max_epi32(a.v[0], b.v[0]), _mm_max_epi32(a.v[1], b.v[1]));
+}
+
+const VectorInt8 VectorInt8::Permute(const VectorInt8& v, const VectorInt8& indices)
+{
+    // shuffle both halves with byte indices of the selected lanes, then pick the half each index points to
+    const auto permuteHalf = [&v](const __m128i laneIndices)
+    {
+        const __m128i byteIndices = _mm_add_epi32(_mm_mullo_epi32(_mm_and_si128(laneIndices, _mm_set1_epi32(3)), _mm_set1_epi32(0x04040404)),
+                                                  _mm_set1_epi32(0x03020100));
+        const __m128i selectHigh = _mm_cmpgt_epi32(_mm_and_si128(laneIndices, _mm_set1_epi32(7)), _mm_set1_epi32(3));
+        return _mm_blendv_epi8(_mm_shuffle_epi8(v.v[0], byteIndices), _mm_shuffle_epi8(v.v[1], byteIndices), selectHigh);
+    };
+
+    return VectorInt8(permuteHalf(indices.v[0]), permuteHalf(indices.v[1]));
+}
+
+const Vector8 VectorInt8::Permute(const Vector8& v, const VectorInt8& indices)
+{
+    return Permute(VectorInt8::Cast(v), indices).CastToFloat();
+}
+
+} // namespace math
+} // namespace rt
@@ -1,6 +1,7 @@
 #include "PCH.h"
 
 #include "Mesh.h"
+#include "MeshKernels.h"
 #include "Material/Material.h"
 
 #include "BVH/BVHBuilder.h"
@@ -15,8 +16,12 @@
 #include "Math/Simd8Geometry.h"
 
 #include "Utils/Logger.h"
+#include "Utils/CpuFeatures.h"
 #include "Utils/Bitmap.h"
 #include "Utils/AlignmentAllocator.h"
+#include "Utils/Hash.h"
+#include "Utils/ThreadPool.h"
+#include "Utils/Timer.h"
 
 #include <vector>
 #include <sstream>
@@ -26,6 +31,93 @@ namespace rt {
 
 using namespace math;
 
+namespace {
+
+// max number of triangles in BVH leaves (SIMD triangle width)
+// smaller leaves are created whenever SAH says it's cheaper than splitting
+const Uint32 MaxTrianglesPerLeaf = 8;
+
+// number of triangles processed in a single task when updating positions
+const Uint32 TrianglesPerUpdateTask = 16 * 1024;
+
+// hash of all the data BVH depends on
+Uint64 CalculateBVHContentHash(const VertexBufferDesc& desc, const BVHBuilder::BuildingParams& params)
+{
+    Uint64 hash = Hash64(desc.positions, sizeof(float) * 3 * desc.numVertices);
+    hash = Hash64(desc.vertexIndexBuffer, sizeof(Uint32) * 3 * desc.numTriangles, hash);
+
+    // the resulting tree does not depend on the threading params
+    const Uint32 splitAlgorithm = static_cast<Uint32>(params.splitAlgorithm);
+    hash = Hash64(&params.maxLeafNodeSize, sizeof(params.maxLeafNodeSize), hash);
+    hash = Hash64(&params.traversalCost, sizeof(params.traversalCost), hash);
+    hash = Hash64(&params.intersectionCost, sizeof(params.intersectionCost), hash);
+    hash = Hash64(&splitAlgorithm, sizeof(splitAlgorithm), hash);
+    hash = Hash64(&params.nodesLayout, sizeof(params.nodesLayout), hash);
+    hash = Hash64(&params.numBins, sizeof(params.numBins), hash);
+    hash = Hash64(&params.maxDuplicatedReferences, sizeof(params.maxDuplicatedReferences), hash);
+    hash = Hash64(&params.spatialSplitOverlapThreshold, sizeof(params.spatialSplitOverlapThreshold), hash);
+    hash = Hash64(&params.agglomerativeTreeletSize, sizeof(params.agglomerativeTreeletSize), hash);
+    hash = Hash64(&params.optimizationPasses, sizeof(params.optimizationPasses), hash);
+    hash = Hash64(&params.earlySplitBudget, sizeof(params.earlySplitBudget), hash);
+    hash = Hash64(&params.earlySplitThreshold, sizeof(params.earlySplitThreshold), hash);
+
+    // zero means "no hash"
+    return hash != 0 ? hash : 1;
+}
+
+bool FileExists(const std::string& filePath)
+{
+    FILE* file = fopen(filePath.c_str(), "rb");
+    if (file)
+    {
+        fclose(file);
+        return true;
+    }
+    return false;
+}
+
+// find disjoint subtrees to rebuild after refitting
+// A degraded node is rebuilt if its own split got worse, otherwise only its degraded children are processed.
+void FindDegradedSubtrees(const BVH& bvh, const std::vector<Float>& costs, const std::vector<Float>& referenceCosts,
+                          Float threshold, Uint32 nodeIndex, std::vector<Uint32>& outSubtreeRoots)
+{
+    const auto isDegraded = [&](Uint32 index)
+    {
+        return costs[index] > referenceCosts[index] * (1.0f + threshold);
+    };
+
+    if (!isDegraded(nodeIndex))
+    {
+        return;
+    }
+
+    const BVH::Node& node = bvh.GetNodes()[nodeIndex];
+    RT_ASSERT(!node.IsLeaf()); // Leaf cost does not depend on its box
+
+    const Float area = node.GetBox().SurfaceArea();
+
+    // cost of the node assuming its children are as good as after the build
+    Float localCost = area;
+    bool anyChildDegraded = false;
+    for (Uint32 i = 0; i < 2; ++i)
+    {
+        const Uint32 childIndex = node.childIndex + i;
+        localCost += bvh.GetNodes()[childIndex].GetBox().SurfaceArea() * referenceCosts[childIndex];
+        anyChildDegraded |= isDegraded(childIndex);
+    }
+
+    if (!anyChildDegraded || localCost > area * referenceCosts[nodeIndex] * (1.0f + threshold))
+    {
+        outSubtreeRoots.push_back(nodeIndex);
+        return;
+    }
+
+    FindDegradedSubtrees(bvh, costs, referenceCosts, threshold, node.childIndex, outSubtreeRoots);
+    FindDegradedSubtrees(bvh, costs, referenceCosts, threshold, node.childIndex + 1, outSubtreeRoots);
+}
+
+} // namespace
+
 Mesh::Mesh()
 {
 }
@@ -36,59 +128,181 @@ Mesh::~Mesh()
 
 bool Mesh::Initialize(const MeshDesc& desc)
 {
+    mPath = desc.path;
     mBoundingBox = Box::Empty();
+    mBVHNodeCosts.clear();
 
     const Float3* positions = (const Float3*)desc.vertexBufferDesc.positions;
     const Uint32* indexBuffer = desc.vertexBufferDesc.vertexIndexBuffer;
 
-    std::vector<Box, AlignmentAllocator<Box>> boxes;
-    for (Uint32 i = 0; i < desc.vertexBufferDesc.numTriangles; ++i)
+    BVHBuilder::BuildingParams params;
+    params.maxLeafNodeSize = MaxTrianglesPerLeaf;
+    params.nodesLayout = BVHBuilder::NodesLayout::VanEmdeBoas;
+
+    if (desc.useSpatialSplits)
     {
-        const Vector4 v0(positions[indexBuffer[3 * i + 0]]);
-        const Vector4 v1(positions[indexBuffer[3 * i + 1]]);
-        const Vector4 v2(positions[indexBuffer[3 * i + 2]]);
+        params.splitAlgorithm = BVHBuilder::SplitAlgorithm::Spatial;
+    }
+    params.earlySplitBudget = desc.earlySplitBudget;
+
+    BVHBuilder::Indices newTrianglesOrder;
+    bool bvhLoaded = false;
+
+    // try to load the BVH and triangles order from cache
+    std::string bvhCacheFilePath;
+    Uint64 bvhContentHash = 0;
+    if (!desc.bvhCacheDirectory.empty())
+    {
+        bvhContentHash = CalculateBVHContentHash(desc.vertexBufferDesc, params);
 
-        Box triBox(v0, v1, v2);
+        char fileName[32];
+        snprintf(fileName, sizeof(fileName), "%016" PRIx64 ".bvh", bvhContentHash);
+        bvhCacheFilePath = desc.bvhCacheDirectory + "/" + fileName;
 
-        boxes.push_back(triBox);
+        if (FileExists(bvhCacheFilePath) && mBVH.LoadFromFile(bvhCacheFilePath, bvhContentHash, &newTrianglesOrder))
+        {
+            bvhLoaded = std::all_of(newTrianglesOrder.begin(), newTrianglesOrder.end(), [&](const Uint32 index)
+            {
+                return index < desc.vertexBufferDesc.numTriangles;
+            });
 
-        mBoundingBox = Box(mBoundingBox, triBox);
+            if (bvhLoaded)
+            {
+                RT_LOG_INFO("BVH loaded from cache file '%s'", bvhCacheFilePath.c_str());
+            }
+            else
+            {
+                RT_LOG_ERROR("Corrupted BVH cache file '%s' (invalid triangle index)", bvhCacheFilePath.c_str());
+            }
+        }
     }
 
-    BVHBuilder::BuildingParams params;
-    params.maxLeafNodeSize = 2;
+    if (bvhLoaded)
+    {
+        // root box is the union of all the triangle boxes
+        if (mBVH.GetNumNodes() > 0)
+        {
+            mBoundingBox = mBVH.GetNodes()[0].GetBox();
+        }
+    }
+    else
+    {
+        std::vector<Box, AlignmentAllocator<Box>> boxes;
+        for (Uint32 i = 0; i < desc.vertexBufferDesc.numTriangles; ++i)
+        {
+            const Vector4 v0(positions[indexBuffer[3 * i + 0]]);
+            const Vector4 v1(positions[indexBuffer[3 * i + 1]]);
+            const Vector4 v2(positions[indexBuffer[3 * i + 2]]);
 
-    BVHBuilder::Indices newTrianglesOrder;
-    BVHBuilder bvhBuilder(mBVH);
-    if (!bvhBuilder.Build(boxes.data(), desc.vertexBufferDesc.numTriangles, params, newTrianglesOrder))
+            Box triBox(v0, v1, v2);
+
+            boxes.push_back(triBox);
+
+            mBoundingBox = Box(mBoundingBox, triBox);
+        }
+
+        BVHBuilder bvhBuilder(mBVH);
+
+        std::vector<Triangle, AlignmentAllocator<Triangle>> triangles;
+        if (desc.useSpatialSplits || desc.earlySplitBudget > 0.0f)
+        {
+            triangles.reserve(desc.vertexBufferDesc.numTriangles);
+            for (Uint32 i = 0; i < desc.vertexBufferDesc.numTriangles; ++i)
+            {
+                triangles.push_back(Triangle(
+                    Vector4(positions[indexBuffer[3 * i + 0]]),
+                    Vector4(positions[indexBuffer[3 * i + 1]]),
+                    Vector4(positions[indexBuffer[3 * i + 2]])));
+            }
+            bvhBuilder.SetLeafTriangles(triangles.data());
+        }
+
+        if (!bvhBuilder.Build(boxes.data(), desc.vertexBufferDesc.numTriangles, params, newTrianglesOrder))
+        {
+            return false;
+        }
+
+        if (!bvhCacheFilePath.empty())
+        {
+            if (mBVH.SaveToFile(bvhCacheFilePath, bvhContentHash, newTrianglesOrder))
+            {
+                RT_LOG_INFO("BVH saved to cache file '%s'", bvhCacheFilePath.c_str());
+            }
+            else
+            {
+                RT_LOG_WARNING("Failed to save BVH cache file '%s'", bvhCacheFilePath.c_str());
+            }
+        }
+
+        // calculate & print stats (only after the build, loading from cache should be fast)
+        {
+            BVH::Stats stats;
+            mBVH.CalculateStats(stats);
+            RT_LOG_INFO("BVH stats:");
+            RT_LOG_INFO("    - max depth: %u", stats.maxDepth);
+            RT_LOG_INFO("    - total surface area: %f", stats.totalNodesArea);
+            RT_LOG_INFO("    - total volume: %f", stats.totalNodesVolume);
+            RT_LOG_INFO("    - SAH cost: %f", stats.sahCost);
+            RT_LOG_INFO("    - sibling overlap: %f", stats.siblingOverlap);
+            RT_LOG_INFO("    - nodes memory: %" PRIu64 " bytes", stats.nodesMemorySize);
+
+            std::stringstream str;
+            for (size_t i = 0; i < stats.leavesCountHistogram.size(); ++i)
+            {
+                if (i > 0)
+                    str << ", ";
+                str << i << " (" << stats.leavesCountHistogram[i] << ")";
+            }
+            RT_LOG_INFO("    - leaf nodes histogram: %s", str.str().c_str());
+        }
+    }
+
+#if RT_BVH_WIDTH > 2
+    // the wide BVH is cached next to the binary one (it's collapsed from the cached tree, so it's loaded only with it)
+    std::string wideBVHCacheFilePath;
+    bool wideBVHLoaded = false;
+    if (!bvhCacheFilePath.empty())
     {
-        return false;
+#ifdef RT_BVH_QUANTIZED_NODES
+        const char* quantizedSuffix = "q";
+#else
+        const char* quantizedSuffix = "";
+#endif // RT_BVH_QUANTIZED_NODES
+
+        char fileName[32];
+        snprintf(fileName, sizeof(fileName), "%016" PRIx64 ".bvh%u%s", bvhContentHash, RT_BVH_WIDTH, quantizedSuffix);
+        wideBVHCacheFilePath = desc.bvhCacheDirectory + "/" + fileName;
+
+        if (bvhLoaded && FileExists(wideBVHCacheFilePath) &&
+            mWideBVH.LoadFromFile(wideBVHCacheFilePath, bvhContentHash, static_cast<Uint32>(newTrianglesOrder.size())))
+        {
+            wideBVHLoaded = true;
+            RT_LOG_INFO("%u-wide BVH loaded from cache file '%s'", RT_BVH_WIDTH, wideBVHCacheFilePath.c_str());
+        }
     }
 
-    // calculate & print stats
+    if (!wideBVHLoaded)
     {
-        BVH::Stats stats;
-        mBVH.CalculateStats(stats);
-        RT_LOG_INFO("BVH stats:");
-        RT_LOG_INFO("    - max depth: %u", stats.maxDepth);
-        RT_LOG_INFO("    - total surface area: %f", stats.totalNodesArea);
-        RT_LOG_INFO("    - total volume: %f", stats.totalNodesVolume);
+        if (!mWideBVH.Build(mBVH))
+        {
+            RT_LOG_ERROR("Failed to build %u-wide BVH", RT_BVH_WIDTH);
+            return false;
+        }
+        RT_LOG_INFO("Collapsed BVH to %u-wide one (num nodes = %u)", RT_BVH_WIDTH, mWideBVH.GetNumNodes());
 
-        std::stringstream str;
-        for (size_t i = 0; i < stats.leavesCountHistogram.size(); ++i)
+        if (!wideBVHCacheFilePath.empty() && !mWideBVH.SaveToFile(wideBVHCacheFilePath, bvhContentHash))
         {
-            if (i > 0)
-                str << ", ";
-            str << i << " (" << stats.leavesCountHistogram[i] << ")";
+            RT_LOG_WARNING("Failed to save wide BVH cache file '%s'", wideBVHCacheFilePath.c_str());
         }
-        RT_LOG_INFO("    - leaf nodes histogram: %s", str.str().c_str());
     }
+#endif // RT_BVH_WIDTH > 2
 
-    // reorder triangles
+    // reorder triangles (spatial splits may reference the same triangle from multiple leaves)
     {
-        std::vector<Uint32> newIndexBuffer(desc.vertexBufferDesc.numTriangles * 3);
-        std::vector<Uint32> newMaterialIndexBuffer(desc.vertexBufferDesc.numTriangles);
-        for (Uint32 i = 0; i < desc.vertexBufferDesc.numTriangles; ++i)
+        const Uint32 numTriangles = static_cast<Uint32>(newTrianglesOrder.size());
+        std::vector<Uint32> newIndexBuffer(numTriangles * 3);
+        std::vector<Uint32> newMaterialIndexBuffer(numTriangles);
+        for (Uint32 i = 0; i < numTriangles; ++i)
         {
             const Uint32 newTriangleIndex = newTrianglesOrder[i];
             RT_ASSERT(newTriangleIndex < desc.vertexBufferDesc.numTriangles);
@@ -100,6 +314,7 @@ bool Mesh::Initialize(const MeshDesc& desc)
         }
 
         VertexBufferDesc vertexBufferDesc = desc.vertexBufferDesc;
+        vertexBufferDesc.numTriangles = numTriangles;
         vertexBufferDesc.vertexIndexBuffer = newIndexBuffer.data();
         vertexBufferDesc.materialIndexBuffer = newMaterialIndexBuffer.data();
 
@@ -116,6 +331,116 @@ bool Mesh::Initialize(const MeshDesc& desc)
     return true;
 }
 
+bool Mesh::UpdatePositions(const float* positions, Float rebuildThreshold, ThreadPool* threadPool)
+{
+    if (!positions)
+    {
+        RT_LOG_ERROR("Positions buffer must be provided");
+        return false;
+    }
+
+    const Uint32 numTriangles = mVertexBuffer.GetNumTriangles();
+    if (numTriangles == 0)
+    {
+        return true;
+    }
+
+    Timer timer;
+    timer.Start();
+
+    mVertexBuffer.SetPositions(positions);
+
+    // task ranges are fixed, so the results do not depend on the number of threads
+    const Uint32 numTasks = (numTriangles + TrianglesPerUpdateTask - 1) / TrianglesPerUpdateTask;
+
+    // triangle boxes in the BVH leaves order (the same as the vertex buffer's one)
+    std::vector<Box, AlignmentAllocator<Box>> boxes(numTriangles);
+    std::vector<Box, AlignmentAllocator<Box>> taskBoxes(numTasks);
+
+    const Float3* vertices = reinterpret_cast<const Float3*>(positions);
+    const auto taskCallback = [&](Uint32 taskID, Uint32)
+    {
+        const Uint32 firstTriangle = taskID * TrianglesPerUpdateTask;
+        const Uint32 numTaskTriangles = std::min(TrianglesPerUpdateTask, numTriangles - firstTriangle);
+
+        mVertexBuffer.UpdateTriangles(firstTriangle, numTaskTriangles);
+
+        Box taskBox = Box::Empty();
+        for (Uint32 i = firstTriangle; i < firstTriangle + numTaskTriangles; ++i)
+        {
+            VertexIndices indices;
+            mVertexBuffer.GetVertexIndices(i, indices);
+            boxes[i] = Box(Vector4(vertices[indices.i0]), Vector4(vertices[indices.i1]), Vector4(vertices[indices.i2]));
+            taskBox = Box(taskBox, boxes[i]);
+        }
+        taskBoxes[taskID] = taskBox;
+    };
+
+    if (threadPool && numTasks > 1)
+    {
+        threadPool->RunParallelTask(taskCallback, numTasks);
+    }
+    else
+    {
+        for (Uint32 i = 0; i < numTasks; ++i)
+        {
+            taskCallback(i, 0);
+        }
+    }
+
+    mBoundingBox = Box::Empty();
+    for (const Box& box : taskBoxes)
+    {
+        mBoundingBox = Box(mBoundingBox, box);
+    }
+
+    // reference costs are calculated before the first refit (not when the mesh is initialized, so loading from cache is fast)
+    if (mBVHNodeCosts.empty())
+    {
+        mBVH.CalculateNodeCosts(mBVHNodeCosts);
+    }
+
+    mBVH.Refit(boxes.data(), threadPool);
+
+    std::vector<Uint32> subtreesToRebuild;
+    if (rebuildThreshold > 0.0f)
+    {
+        std::vector<Float> costs;
+        mBVH.CalculateNodeCosts(costs);
+        FindDegradedSubtrees(mBVH, costs, mBVHNodeCosts, rebuildThreshold, 0, subtreesToRebuild);
+    }
+
+    if (!subtreesToRebuild.empty())
+    {
+        BVHBuilder::BuildingParams params;
+        params.maxLeafNodeSize = MaxTrianglesPerLeaf;
+        params.nodesLayout = BVHBuilder::NodesLayout::VanEmdeBoas;
+
+        BVHBuilder::Indices newTrianglesOrder;
+        BVHBuilder bvhBuilder(mBVH);
+        if (!bvhBuilder.RebuildSubtrees(subtreesToRebuild, boxes.data(), numTriangles, params, newTrianglesOrder))
+        {
+            RT_LOG_ERROR("Failed to rebuild BVH subtrees");
+            return false;
+        }
+
+        mVertexBuffer.ReorderTriangles(newTrianglesOrder);
+        mBVH.CalculateNodeCosts(mBVHNodeCosts);
+    }
+
+#if RT_BVH_WIDTH > 2
+    if (!mWideBVH.Build(mBVH))
+    {
+        RT_LOG_ERROR("Failed to build %u-wide BVH", RT_BVH_WIDTH);
+        return false;
+    }
+#endif // RT_BVH_WIDTH > 2
+
+    RT_LOG_INFO("Mesh '%s' positions updated in %.3f ms (rebuilt BVH subtrees: %u)",
+                !mPath.empty() ? mPath.c_str() : "unnamed", 1000.0 * timer.Stop(), static_cast<Uint32>(subtreesToRebuild.size()));
+    return true;
+}
+
 void Mesh::Traverse_Leaf_Single(const SingleTraversalContext& context, const Uint32 objectID, const BVH::Node& node) const
 {
     float distance, u, v;
@@ -180,7 +505,6 @@ bool Mesh::Traverse_Leaf_Shadow_Single(const SingleTraversalContext& context, co
     return false;
 }
 
-/*
 void Mesh::Traverse_Leaf_Simd8(const SimdTraversalContext& context, const Uint32 objectID, const BVH::Node& node) const
 {
     const VectorInt8 objectIndexVec(objectID);
@@ -200,18 +524,18 @@ void Mesh::Traverse_Leaf_Simd8(const SimdTraversalContext& context, const Uint32
 
         mVertexBuffer.GetTriangle(triangleIndex, tri);
 
-        const Vector8 mask = Intersect_TriangleRay_Simd8(context.ray.dir, context.ray.origin, tri, hitPoint.distance, u, v, distance);
-        const Uint32 intMask = mask.GetSignMask();
+        const VectorBool8 mask = Intersect_TriangleRay_Simd8(context.ray.dir, context.ray.origin, tri, hitPoint.distance, u, v, distance);
+        const Int32 intMask = mask.GetMask();
 
         // TODO triangle & object filtering
         if (intMask)
         {
             // combine results according to mask
-            hitPoint.u = Vector8::SelectBySign(hitPoint.u, u, mask);
-            hitPoint.v = Vector8::SelectBySign(hitPoint.v, v, mask);
-            hitPoint.distance = Vector8::SelectBySign(hitPoint.distance, distance, mask);
-            hitPoint.subObjectId = VectorInt8::SelectBySign(hitPoint.subObjectId, triangleIndexVec, VectorInt8::Cast(mask));
-            hitPoint.objectId = VectorInt8::SelectBySign(hitPoint.objectId, objectIndexVec, VectorInt8::Cast(mask));
+            hitPoint.u = Vector8::Select(hitPoint.u, u, mask);
+            hitPoint.v = Vector8::Select(hitPoint.v, v, mask);
+            hitPoint.distance = Vector8::Select(hitPoint.distance, distance, mask);
+            hitPoint.subObjectId = VectorInt8::Cast(Vector8::Select(hitPoint.subObjectId.CastToFloat(), triangleIndexVec.CastToFloat(), mask));
+            hitPoint.objectId = VectorInt8::Cast(Vector8::Select(hitPoint.objectId.CastToFloat(), objectIndexVec.CastToFloat(), mask));
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
             context.context.localCounters.numPassedRayTriangleTests += PopCount(intMask);
@@ -219,37 +543,43 @@ void Mesh::Traverse_Leaf_Simd8(const SimdTraversalContext& context, const Uint32
         }
     }
 }
-*/
 
 void Mesh::Traverse_Leaf_Packet(const PacketTraversalContext& context, const Uint32 objectID, const BVH::Node& node, const Uint32 numActiveGroups) const
 {
-    Vector8 distance, u, v;
-    Triangle_Simd8 tri;
-
-#ifdef RT_ENABLE_INTERSECTION_COUNTERS
-    context.context.localCounters.numRayTriangleTests += 8 * node.numLeaves * numActiveGroups;
-#endif // RT_ENABLE_INTERSECTION_COUNTERS
-
-    for (Uint32 i = 0; i < node.numLeaves; ++i)
+#ifdef RT_ENABLE_AVX512_KERNELS
+    if (GetKernelInstructionSet() == InstructionSet::AVX512)
     {
-        const Uint32 triangleIndex = node.childIndex + i;
-        const Vector8 triangleIndexVec(triangleIndex);
-
-        mVertexBuffer.GetTriangle(triangleIndex, tri);
+        Traverse_Leaf_Packet_AVX512(context, mVertexBuffer, objectID, node, numActiveGroups);
+        return;
+    }
+#endif // RT_ENABLE_AVX512_KERNELS
 
-        for (Uint32 j = 0; j < numActiveGroups; ++j)
-        {
-            RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[j]];
+    if (GetKernelInstructionSet() == InstructionSet::AVX2)
+    {
+        Traverse_Leaf_Packet_AVX2(context, mVertexBuffer, objectID, node, numActiveGroups);
+        return;
+    }
 
-            const VectorBool8 mask = Intersect_TriangleRay_Simd8(rayGroup.rays[1].dir, rayGroup.rays[1].origin, tri, rayGroup.maxDistances, u, v, distance);
+    Traverse_Leaf_Packet_Generic(context, mVertexBuffer, objectID, node, numActiveGroups);
+}
 
-            context.StoreIntersection(rayGroup, distance, mask, objectID, triangleIndex);
+void Mesh::Traverse_Leaf_Shadow_Packet(const PacketTraversalContext& context, const BVH::Node& node, const Uint32 numActiveGroups) const
+{
+#ifdef RT_ENABLE_AVX512_KERNELS
+    if (GetKernelInstructionSet() == InstructionSet::AVX512)
+    {
+        Traverse_Leaf_Shadow_Packet_AVX512(context, mVertexBuffer, node, numActiveGroups);
+        return;
+    }
+#endif // RT_ENABLE_AVX512_KERNELS
 
-#ifdef RT_ENABLE_INTERSECTION_COUNTERS
-            context.context.localCounters.numPassedRayTriangleTests += PopCount(mask.GetMask());
-#endif // RT_ENABLE_INTERSECTION_COUNTERS
-        }
+    if (GetKernelInstructionSet() == InstructionSet::AVX2)
+    {
+        Traverse_Leaf_Shadow_Packet_AVX2(context, mVertexBuffer, node, numActiveGroups);
+        return;
     }
+
+    Traverse_Leaf_Shadow_Packet_Generic(context, mVertexBuffer, node, numActiveGroups);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
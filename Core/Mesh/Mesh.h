@@ -6,6 +6,7 @@
 
 #include "../Traversal/HitPoint.h"
 #include "../BVH/BVH.h"
+#include "../BVH/WideBVH.h"
 
 #include "../Math/Box.h"
 #include "../Math/Ray.h"
@@ -16,12 +17,25 @@ namespace rt {
 
 struct ShadingData;
 struct SingleTraversalContext;
+struct SimdTraversalContext;
 struct PacketTraversalContext;
 
 struct MeshDesc
 {
     VertexBufferDesc vertexBufferDesc;
     std::string path;
+
+    // build BVH with spatial splits (improves traversal of meshes with long, thin triangles,
+    // at the cost of longer build and duplicated triangles in the vertex buffer)
+    bool useSpatialSplits = false;
+
+    // number of extra triangle references created by splitting oversized triangles before the BVH build
+    // (relative to the number of triangles, 0 disables it)
+    float earlySplitBudget = 0.0f;
+
+    // directory for BVH cache files (empty means no caching)
+    // BVH and triangles order are loaded from the cache if the geometry and building params did not change
+    std::string bvhCacheDirectory;
 };
 
 
@@ -37,16 +51,29 @@ public:
     // Initialize the mesh
     bool Initialize(const MeshDesc& desc);
 
+    // Update vertex positions of a deforming mesh (topology must stay the same)
+    // BVH is refitted and its subtrees whose SAH cost grew by more than rebuildThreshold (relative to the cost
+    // after the last build, e.g. 0.5 means 50%) are rebuilt. Zero threshold disables rebuilding.
+    // Triangles are updated and the BVH is refitted in parallel if the thread pool is provided.
+    // NOTE: triangles duplicated by spatial splits are bounded with whole triangle boxes after the update
+    bool UpdatePositions(const float* positions, Float rebuildThreshold = 0.0f, ThreadPool* threadPool = nullptr);
+
     RT_FORCE_INLINE const math::Box& GetBoundingBox() const { return mBoundingBox; }
     RT_FORCE_INLINE const BVH& GetBVH() const { return mBVH; }
 
+#if RT_BVH_WIDTH > 2
+    RT_FORCE_INLINE const DefaultWideBVH& GetWideBVH() const { return mWideBVH; }
+#endif // RT_BVH_WIDTH > 2
+
     // Intersect ray(s) with BVH leaf
     void Traverse_Leaf_Single(const SingleTraversalContext& context, const Uint32 objectID, const BVH::Node& node) const;
+    void Traverse_Leaf_Simd8(const SimdTraversalContext& context, const Uint32 objectID, const BVH::Node& node) const;
     void Traverse_Leaf_Packet(const PacketTraversalContext& context, const Uint32 objectID, const BVH::Node& node, const Uint32 numActiveGroups) const;
 
     // Intersect shadow ray(s) with BVH leaf
     // Returns true if any hit was found
     bool Traverse_Leaf_Shadow_Single(const SingleTraversalContext& context, const BVH::Node& node) const;
+    void Traverse_Leaf_Shadow_Packet(const PacketTraversalContext& context, const BVH::Node& node, const Uint32 numActiveGroups) const;
 
     // Calculate input data for shading routine
     void EvaluateShadingData_Single(const HitPoint& hitPoint, ShadingData& outShadingData, const Material* defaultMaterial) const;
@@ -62,6 +89,14 @@ private:
     // bounding volume hierarchy for tracing acceleration
     BVH mBVH;
 
+    // SAH costs of BVH nodes after the last (re)build, used to detect degradation caused by refitting
+    std::vector<Float> mBVHNodeCosts;
+
+#if RT_BVH_WIDTH > 2
+    // collapsed BVH used for traversal
+    DefaultWideBVH mWideBVH;
+#endif // RT_BVH_WIDTH > 2
+
     std::string mPath;
 };
 
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Mesh.h"
+#include "Rendering/Context.h"
+#include "Traversal/TraversalContext.h"
+#include "Math/Simd8Triangle.h"
+#include "Math/Simd8Geometry.h"
+
+// Ray packet vs. triangles kernels. Compiled once for the baseline and once per additional instruction set
+// (see Mesh_AVX2.cpp and Mesh_AVX512.cpp), so all the functions here must be inlined or static.
+// Global vector constants (e.g. VECTOR8_ONE) are not available here either (see RT_KERNEL_TRANSLATION_UNIT).
+
+namespace rt {
+
+RT_FORCE_INLINE static void Traverse_Leaf_Packet_Generic(const PacketTraversalContext& context, const VertexBuffer& vertexBuffer, const Uint32 objectID, const BVH::Node& node, const Uint32 numActiveGroups)
+{
+    math::Vector8 distance, u, v;
+    math::Triangle_Simd8 tri;
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+    context.context.localCounters.numRayTriangleTests += 8 * node.numLeaves * numActiveGroups;
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+    for (Uint32 i = 0; i < node.numLeaves; ++i)
+    {
+        const Uint32 triangleIndex = node.childIndex + i;
+
+        vertexBuffer.GetTriangle(triangleIndex, tri);
+
+        for (Uint32 j = 0; j < numActiveGroups; ++j)
+        {
+            RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[j]];
+
+            const math::VectorBool8 mask = math::Intersect_TriangleRay_Simd8(rayGroup.rays[1].dir, rayGroup.rays[1].origin, tri, rayGroup.maxDistances, u, v, distance);
+
+            context.StoreIntersection(rayGroup, distance, mask, objectID, triangleIndex);
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+            context.context.localCounters.numPassedRayTriangleTests += math::PopCount(mask.GetMask());
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+        }
+    }
+}
+
+RT_FORCE_INLINE static void Traverse_Leaf_Shadow_Packet_Generic(const PacketTraversalContext& context, const VertexBuffer& vertexBuffer, const BVH::Node& node, const Uint32 numActiveGroups)
+{
+    math::Vector8 distance, u, v;
+    math::Triangle_Simd8 tri;
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+    context.context.localCounters.numRayTriangleTests += 8 * node.numLeaves * numActiveGroups;
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+    for (Uint32 i = 0; i < node.numLeaves; ++i)
+    {
+        const Uint32 triangleIndex = node.childIndex + i;
+
+        vertexBuffer.GetTriangle(triangleIndex, tri);
+
+        for (Uint32 j = 0; j < numActiveGroups; ++j)
+        {
+            RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[j]];
+
+            const math::VectorBool8 mask = math::Intersect_TriangleRay_Simd8(rayGroup.rays[1].dir, rayGroup.rays[1].origin, tri, rayGroup.maxDistances, u, v, distance);
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+            context.context.localCounters.numPassedRayTriangleTests += math::PopCount(mask.GetMask());
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+            if (context.StoreOcclusion(rayGroup, distance, mask))
+            {
+                return;
+            }
+        }
+    }
+}
+
+// variants compiled for additional instruction sets, selected at runtime (see GetKernelInstructionSet)
+void Traverse_Leaf_Packet_AVX2(const PacketTraversalContext& context, const VertexBuffer& vertexBuffer, const Uint32 objectID, const BVH::Node& node, const Uint32 numActiveGroups);
+void Traverse_Leaf_Shadow_Packet_AVX2(const PacketTraversalContext& context, const VertexBuffer& vertexBuffer, const BVH::Node& node, const Uint32 numActiveGroups);
+
+#ifdef RT_ENABLE_AVX512_KERNELS
+void Traverse_Leaf_Packet_AVX512(const PacketTraversalContext& context, const VertexBuffer& vertexBuffer, const Uint32 objectID, const BVH::Node& node, const Uint32 numActiveGroups);
+void Traverse_Leaf_Shadow_Packet_AVX512(const PacketTraversalContext& context, const VertexBuffer& vertexBuffer, const BVH::Node& node, const Uint32 numActiveGroups);
+#endif // RT_ENABLE_AVX512_KERNELS
+
+} // namespace rt
@@ -0,0 +1,21 @@
+#define RT_KERNEL_TRANSLATION_UNIT
+#include "PCH.h"
+#include "MeshKernels.h"
+
+#ifndef RT_USE_AVX2
+#error "This file must be compiled with AVX2 enabled"
+#endif // RT_USE_AVX2
+
+namespace rt {
+
+void Traverse_Leaf_Packet_AVX2(const PacketTraversalContext& context, const VertexBuffer& vertexBuffer, const Uint32 objectID, const BVH::Node& node, const Uint32 numActiveGroups)
+{
+    Traverse_Leaf_Packet_Generic(context, vertexBuffer, objectID, node, numActiveGroups);
+}
+
+void Traverse_Leaf_Shadow_Packet_AVX2(const PacketTraversalContext& context, const VertexBuffer& vertexBuffer, const BVH::Node& node, const Uint32 numActiveGroups)
+{
+    Traverse_Leaf_Shadow_Packet_Generic(context, vertexBuffer, node, numActiveGroups);
+}
+
+} // namespace rt
@@ -0,0 +1,143 @@
+#define RT_KERNEL_TRANSLATION_UNIT
+#include "PCH.h"
+#include "MeshKernels.h"
+#include "Math/Simd16Geometry.h"
+
+#ifdef RT_ENABLE_AVX512_KERNELS
+
+#ifndef __AVX512F__
+#error "This file must be compiled with AVX-512 enabled"
+#endif // __AVX512F__
+
+namespace rt {
+
+using namespace math;
+
+// 16-wide version of Traverse_Leaf_Packet_Generic, pairs of 8-ray groups are tested together
+void Traverse_Leaf_Packet_AVX512(const PacketTraversalContext& context, const VertexBuffer& vertexBuffer, const Uint32 objectID, const BVH::Node& node, const Uint32 numActiveGroups)
+{
+    Vector16 distance, u, v;
+    Triangle_Simd8 tri;
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+    context.context.localCounters.numRayTriangleTests += 8 * node.numLeaves * numActiveGroups;
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+    for (Uint32 i = 0; i < node.numLeaves; ++i)
+    {
+        const Uint32 triangleIndex = node.childIndex + i;
+
+        vertexBuffer.GetTriangle(triangleIndex, tri);
+        const Triangle_Simd16 tri16(tri);
+
+        Uint32 j = 0;
+        for (; j + 2 <= numActiveGroups; j += 2)
+        {
+            RayGroup& rayGroupA = context.ray.groups[context.context.activeGroupsIndices[j + 0]];
+            RayGroup& rayGroupB = context.ray.groups[context.context.activeGroupsIndices[j + 1]];
+
+            const Vector3x16 rayDir(rayGroupA.rays[1].dir, rayGroupB.rays[1].dir);
+            const Vector3x16 rayOrigin(rayGroupA.rays[1].origin, rayGroupB.rays[1].origin);
+            const Vector16 maxDistances(rayGroupA.maxDistances, rayGroupB.maxDistances);
+
+            const VectorBool16 mask = Intersect_TriangleRay_Simd16(rayDir, rayOrigin, tri16, maxDistances, u, v, distance);
+            const Uint32 intMask = static_cast<Uint32>(mask.GetMask());
+
+            if (intMask & 0xFF)
+            {
+                context.StoreIntersection(rayGroupA, distance.Low(), mask.Low(), objectID, triangleIndex);
+            }
+
+            if (intMask >> 8)
+            {
+                context.StoreIntersection(rayGroupB, distance.High(), mask.High(), objectID, triangleIndex);
+            }
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+            context.context.localCounters.numPassedRayTriangleTests += PopCount(intMask);
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+        }
+
+        if (j < numActiveGroups)
+        {
+            RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[j]];
+
+            Vector8 distance8, u8, v8;
+            const VectorBool8 mask = Intersect_TriangleRay_Simd8(rayGroup.rays[1].dir, rayGroup.rays[1].origin, tri, rayGroup.maxDistances, u8, v8, distance8);
+
+            context.StoreIntersection(rayGroup, distance8, mask, objectID, triangleIndex);
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+            context.context.localCounters.numPassedRayTriangleTests += PopCount(mask.GetMask());
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+        }
+    }
+}
+
+// 16-wide version of Traverse_Leaf_Shadow_Packet_Generic, pairs of 8-ray groups are tested together
+void Traverse_Leaf_Shadow_Packet_AVX512(const PacketTraversalContext& context, const VertexBuffer& vertexBuffer, const BVH::Node& node, const Uint32 numActiveGroups)
+{
+    Vector16 distance, u, v;
+    Triangle_Simd8 tri;
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+    context.context.localCounters.numRayTriangleTests += 8 * node.numLeaves * numActiveGroups;
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+    for (Uint32 i = 0; i < node.numLeaves; ++i)
+    {
+        const Uint32 triangleIndex = node.childIndex + i;
+
+        vertexBuffer.GetTriangle(triangleIndex, tri);
+        const Triangle_Simd16 tri16(tri);
+
+        Uint32 j = 0;
+        for (; j + 2 <= numActiveGroups; j += 2)
+        {
+            RayGroup& rayGroupA = context.ray.groups[context.context.activeGroupsIndices[j + 0]];
+            RayGroup& rayGroupB = context.ray.groups[context.context.activeGroupsIndices[j + 1]];
+
+            const Vector3x16 rayDir(rayGroupA.rays[1].dir, rayGroupB.rays[1].dir);
+            const Vector3x16 rayOrigin(rayGroupA.rays[1].origin, rayGroupB.rays[1].origin);
+            const Vector16 maxDistances(rayGroupA.maxDistances, rayGroupB.maxDistances);
+
+            const VectorBool16 mask = Intersect_TriangleRay_Simd16(rayDir, rayOrigin, tri16, maxDistances, u, v, distance);
+            const Uint32 intMask = static_cast<Uint32>(mask.GetMask());
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+            context.context.localCounters.numPassedRayTriangleTests += PopCount(intMask);
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+            if ((intMask & 0xFF) && context.StoreOcclusion(rayGroupA, distance.Low(), mask.Low()))
+            {
+                return;
+            }
+
+            if ((intMask >> 8) && context.StoreOcclusion(rayGroupB, distance.High(), mask.High()))
+            {
+                return;
+            }
+        }
+
+        if (j < numActiveGroups)
+        {
+            RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[j]];
+
+            Vector8 distance8, u8, v8;
+            const VectorBool8 mask = Intersect_TriangleRay_Simd8(rayGroup.rays[1].dir, rayGroup.rays[1].origin, tri, rayGroup.maxDistances, u8, v8, distance8);
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+            context.context.localCounters.numPassedRayTriangleTests += PopCount(mask.GetMask());
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+            if (context.StoreOcclusion(rayGroup, distance8, mask))
+            {
+                return;
+            }
+        }
+    }
+}
+
+} // namespace rt
+
+#endif // RT_ENABLE_AVX512_KERNELS
@@ -189,6 +189,48 @@ bool VertexBuffer::Initialize(const VertexBufferDesc& desc)
     return true;
 }
 
+void VertexBuffer::SetPositions(const float* positions)
+{
+    memcpy(mBuffer, positions, sizeof(Float3) * mNumVertices);
+}
+
+void VertexBuffer::UpdateTriangles(const Uint32 firstTriangle, const Uint32 numTriangles)
+{
+    RT_ASSERT(firstTriangle + numTriangles <= mNumTriangles);
+
+    const Float3* positions = reinterpret_cast<const Float3*>(mBuffer);
+    const VertexIndices* indexBuffer = reinterpret_cast<const VertexIndices*>(mBuffer + mVertexIndexBufferOffset);
+
+    for (Uint32 i = firstTriangle; i < firstTriangle + numTriangles; ++i)
+    {
+        const VertexIndices& indices = indexBuffer[i];
+        const Vector4 v0(positions[indices.i0]);
+        const Vector4 v1(positions[indices.i1]);
+        const Vector4 v2(positions[indices.i2]);
+
+        mPreprocessedTriangles[i].v0 = v0.ToFloat3();
+        mPreprocessedTriangles[i].edge1 = (v1 - v0).ToFloat3();
+        mPreprocessedTriangles[i].edge2 = (v2 - v0).ToFloat3();
+    }
+}
+
+void VertexBuffer::ReorderTriangles(const std::vector<Uint32>& order)
+{
+    RT_ASSERT(order.size() == mNumTriangles);
+
+    VertexIndices* indexBuffer = reinterpret_cast<VertexIndices*>(mBuffer + mVertexIndexBufferOffset);
+
+    const std::vector<VertexIndices> oldIndices(indexBuffer, indexBuffer + mNumTriangles);
+    const std::vector<ProcessedTriangle> oldTriangles(mPreprocessedTriangles, mPreprocessedTriangles + mNumTriangles);
+
+    for (Uint32 i = 0; i < mNumTriangles; ++i)
+    {
+        RT_ASSERT(order[i] < mNumTriangles);
+        indexBuffer[i] = oldIndices[order[i]];
+        mPreprocessedTriangles[i] = oldTriangles[order[i]];
+    }
+}
+
 void VertexBuffer::GetVertexIndices(const Uint32 triangleIndex, VertexIndices& indices) const
 {
     // RT_ASSERT(triangleIndex < mNumTriangles);
@@ -44,6 +44,16 @@ public:
     // Initialize the vertex buffer with a new content
     bool Initialize(const VertexBufferDesc& desc);
 
+    // replace vertex positions (the number of vertices stays the same)
+    // NOTE: preprocessed triangles are not updated, UpdateTriangles must be called afterwards
+    void SetPositions(const float* positions);
+
+    // recalculate preprocessed data of a range of triangles from the current vertex positions
+    void UpdateTriangles(const Uint32 firstTriangle, const Uint32 numTriangles);
+
+    // reorder triangles, new i-th triangle is the old order[i]-th one
+    void ReorderTriangles(const std::vector<Uint32>& order);
+
     // get vertex indices for given triangle
     void GetVertexIndices(const Uint32 triangleIndex, VertexIndices& indices) const;
 
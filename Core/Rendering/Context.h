@@ -13,6 +13,13 @@ namespace rt {
 
 struct PathDebugData;
 
+// per-thread buffers of wavefront path tracing (see PathTracer::Raytrace_Packet)
+struct PathTracerBuffers;
+struct RAYLIB_API PathTracerBuffersDeleter
+{
+    void operator()(PathTracerBuffers* buffers) const;
+};
+
 enum class TraversalMode : Uint8
 {
     Single = 0,
@@ -56,6 +63,15 @@ struct RenderingParams
     // select mode of ray traversal
     TraversalMode traversalMode = TraversalMode::Packet;
 
+    // packet traversal moves rays alive to the front ray groups when fraction of active lanes
+    // in the groups drops below this value, zero disables the reordering
+    Float rayReorderingThreshold = 0.5f;
+
+    // packet traversal switches to traversing ray groups separately (8 rays at a time)
+    // when number of groups alive drops to this value, zero disables the switch
+    // (see Benchmark_Traversal_PacketSimdFallback, higher values lose to packet traversal)
+    Uint32 simdTraversalMaxGroups = 1;
+
     // adaptive rendering settings
     AdaptiveRenderingSettings adaptiveSettings;
 };
@@ -76,6 +92,9 @@ struct RT_ALIGN(64) RenderingContext : public Aligned<64>
     Uint8 activeRaysMask[RayPacket::MaxNumGroups];
     Uint16 activeGroupsIndices[RayPacket::MaxNumGroups];
 
+    // number of rays not occluded yet during shadow packet traversal (including unused lanes of the last group)
+    Uint32 numActiveShadowRays = 0;
+
     // per-thread pseudo-random number generator
     math::Random randomGenerator;
 
@@ -93,6 +112,9 @@ struct RT_ALIGN(64) RenderingContext : public Aligned<64>
 
     // optional path debugging data
     PathDebugData* pathDebugData = nullptr;
+
+    // allocated on first use, so the buffers are reused by subsequent packets
+    std::unique_ptr<PathTracerBuffers, PathTracerBuffersDeleter> pathTracerBuffers;
 };
 
 
@@ -10,6 +10,7 @@ namespace rt {
 struct LocalCounters
 {
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
+    Uint32 numTraversedNodes;
     Uint32 numRayBoxTests;
     Uint32 numPassedRayBoxTests;
     Uint32 numRayTriangleTests;
@@ -24,6 +25,7 @@ struct LocalCounters
     RT_FORCE_INLINE void Reset()
     {
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        numTraversedNodes = 0;
         numRayBoxTests = 0;
         numPassedRayBoxTests = 0;
         numRayTriangleTests = 0;
@@ -38,6 +40,7 @@ struct RayTracingCounters
     Uint64 numPrimaryRays;
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
+    Uint64 numTraversedNodes;
     Uint64 numRayBoxTests;
     Uint64 numPassedRayBoxTests;
     Uint64 numRayTriangleTests;
@@ -50,6 +53,7 @@ struct RayTracingCounters
         numPrimaryRays = 0;
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        numTraversedNodes = 0;
         numRayBoxTests = 0;
         numPassedRayBoxTests = 0;
         numRayTriangleTests = 0;
@@ -62,6 +66,7 @@ struct RayTracingCounters
     {
         RT_UNUSED(other);
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        numTraversedNodes += other.numTraversedNodes;
         numRayBoxTests += other.numRayBoxTests;
         numPassedRayBoxTests += other.numPassedRayBoxTests;
         numRayTriangleTests += other.numRayTriangleTests;
@@ -75,6 +80,7 @@ struct RayTracingCounters
         numPrimaryRays += other.numPrimaryRays;
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        numTraversedNodes += other.numTraversedNodes;
         numRayBoxTests += other.numRayBoxTests;
         numPassedRayBoxTests += other.numPassedRayBoxTests;
         numRayTriangleTests += other.numRayTriangleTests;
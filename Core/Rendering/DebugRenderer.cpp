@@ -178,7 +178,9 @@ void DebugRenderer::Raytrace_Packet(RayPacket& packet, RenderingContext& context
 
         for (Uint32 j = 0; j < RayPacket::RaysPerGroup; ++j)
         {
-            const HitPoint& hitPoint = context.hitPoints[RayPacket::RaysPerGroup * i + j];
+            // rays may be reordered during traversal
+            const Uint32 rayOffset = packet.groups[i].rayOffsets[j];
+            const HitPoint& hitPoint = context.hitPoints[rayOffset];
 
             Vector4 color = Vector4::Zero();
 
@@ -218,7 +220,7 @@ void DebugRenderer::Raytrace_Packet(RayPacket& packet, RenderingContext& context
                 }
             }
 
-            const ImageLocationInfo& imageLocation = packet.imageLocations[RayPacket::RaysPerGroup * i + j];
+            const ImageLocationInfo& imageLocation = packet.imageLocations[rayOffset];
             viewport.Internal_AccumulateColor(imageLocation.x, imageLocation.y, color);
         }
     }
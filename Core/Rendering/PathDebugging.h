@@ -43,9 +43,9 @@ struct PathDebugData
         Color throughput;
 
         // evaluated ray color (excluding weight)
-        math::Vector4 color;
+        math::Vector4 color = math::Vector4::Zero();
 
-        RaySource raySource;
+        RaySource raySource = RaySource::Eye;
 
         BSDF::EventType bsdfEvent;
     };
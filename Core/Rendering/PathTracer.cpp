@@ -2,12 +2,14 @@
 #include "PathTracer.h"
 #include "Context.h"
 #include "PathDebugging.h"
+#include "Viewport.h"
 #include "Scene/Scene.h"
 #include "Scene/Light/Light.h"
 #include "Scene/Light/BackgroundLight.h"
 #include "Scene/Object/SceneObject_Light.h"
 #include "Material/Material.h"
 #include "Traversal/TraversalContext.h"
+#include "Traversal/RayStream.h"
 
 namespace rt {
 
@@ -38,7 +40,7 @@ PathTracer::PathTracer(const Scene& scene)
 {
 }
 
-const Color PathTracer::SampleLight(const ILight* light, const ShadingData& shadingData, RenderingContext& context) const
+const Color PathTracer::SampleLight(const ILight* light, const ShadingData& shadingData, RenderingContext& context, Ray& outShadowRay, Float& outShadowRayDistance) const
 {
     ILight::IlluminateParam illuminateParam = { shadingData, context };
 
@@ -65,20 +67,10 @@ const Color PathTracer::SampleLight(const ILight* light, const ShadingData& shad
 
     RT_ASSERT(bsdfPdfW > 0.0f && IsValid(bsdfPdfW));
 
-    // cast shadow ray
-    {
-        HitPoint hitPoint;
-        hitPoint.distance = illuminateParam.outDistance;
-
-        Ray shadowRay(shadingData.position, illuminateParam.outDirectionToLight);
-        shadowRay.origin += shadowRay.dir * 0.001f;
-
-        if (mScene.Traverse_Shadow_Single({ shadowRay, hitPoint, context }))
-        {
-            // shadow ray missed the light - light is occluded
-            return Color::Zero();
-        }
-    }
+    // shadow ray
+    outShadowRay = Ray(shadingData.position, illuminateParam.outDirectionToLight);
+    outShadowRay.origin += outShadowRay.dir * 0.001f;
+    outShadowRayDistance = illuminateParam.outDistance;
 
     float weight = 1.0f;
     if (!light->IsDelta())
@@ -93,199 +85,247 @@ const Color PathTracer::SampleLight(const ILight* light, const ShadingData& shad
     return (radiance * factor) * (weight / illuminateParam.outDirectPdfW);
 }
 
-const Color PathTracer::SampleLights(const ShadingData& shadingData, RenderingContext& context) const
+struct PathTracer::ShadowRayQueue
+{
+    struct Entry
+    {
+        Ray ray;
+        Color contribution;
+        Float distance;
+        Uint32 pathIndex;
+    };
+
+    std::vector<Entry, AlignmentAllocator<Entry>> entries;
+
+    // path the queued rays belong to
+    Uint32 pathIndex = 0;
+};
+
+const Color PathTracer::SampleLights(const ShadingData& shadingData, RenderingContext& context, ShadowRayQueue* shadowRays) const
 {
     Color accumulatedColor = Color::Zero();
 
+    const auto sampleLight = [&](const ILight* light)
+    {
+        Ray shadowRay;
+        Float shadowRayDistance;
+        const Color contribution = SampleLight(light, shadingData, context, shadowRay, shadowRayDistance);
+        if (contribution.AlmostZero())
+        {
+            return;
+        }
+
+        if (shadowRays)
+        {
+            shadowRays->entries.push_back({ shadowRay, contribution, shadowRayDistance, shadowRays->pathIndex });
+            return;
+        }
+
+        HitPoint hitPoint;
+        hitPoint.distance = shadowRayDistance;
+
+        // shadow ray hit something before reaching the light - light is occluded
+        if (!mScene.Traverse_Shadow_Single({ shadowRay, hitPoint, context }))
+        {
+            accumulatedColor += contribution;
+        }
+    };
+
     // TODO check only one (or few) lights per sample instead all of them
     // TODO check only nearest lights
     for (const LightPtr& light : mScene.GetLights())
     {
-        accumulatedColor += SampleLight(light.get(), shadingData, context);
+        sampleLight(light.get());
     }
 
     // TODO background light should be on mScene.GetLights() list
     if (const BackgroundLight* light = mScene.GetBackgroundLight())
     {
-        accumulatedColor += SampleLight(light, shadingData, context);
+        sampleLight(light);
     }
 
     return accumulatedColor;
 }
 
-const Color PathTracer::TraceRay_Single(const Ray& primaryRay, RenderingContext& context) const
+struct RT_ALIGN(16) PathTracer::PathState
 {
-    Uint32 depth = 0;
-    HitPoint hitPoint;
-    Ray ray = primaryRay;
-
-    ShadingData shadingData;
-
+    Ray ray;
     Color resultColor = Color::Zero();
     Color throughput = Color::One();
-
-    PathTerminationReason pathTerminationReason = PathTerminationReason::None;
-
+    Uint32 depth = 0;
     bool lastSpecular = true;
     float lastPdfW = 1.0f;
     BSDF::EventType lastSampledBsdfEvent = BSDF::NullEvent;
 
-    for (;;)
-    {
-        hitPoint.distance = FLT_MAX;
-        context.localCounters.Reset();
-        mScene.Traverse_Single({ ray, hitPoint, context });
-        context.counters.Append(context.localCounters);
-
-        // ray missed - return background color
-        if (hitPoint.distance == FLT_MAX)
-        {
-            if (const BackgroundLight* light = mScene.GetBackgroundLight())
-            {
-                float directPdfW;
-                const Color lightContribution = light->GetRadiance(context, ray.dir, Vector4::Zero(), &directPdfW);
-                RT_ASSERT(lightContribution.IsValid());
+    // used in packet mode only
+    Wavelength wavelength; // sampling BSDF may collapse the wavelength, so each path keeps its own
+    Vector4 weight;
+    ImageLocationInfo imageLocation;
+    PathTerminationReason terminationReason = PathTerminationReason::None;
 
-                if (!lightContribution.AlmostZero())
-                {
-                    RT_ASSERT(directPdfW > 0.0f && IsValid(directPdfW));
+    PathState() = default;
 
-                    float misWeight = 1.0f;
-                    if (mSampleLights && depth > 0 && !lastSpecular)
-                    {
-                        misWeight = CombineMis(lastPdfW, directPdfW);
-                    }
+    explicit PathState(const Ray& ray)
+        : ray(ray)
+    { }
+};
 
-                    resultColor += throughput * lightContribution * misWeight;
-                }
-            }
+struct PathTracerBuffers
+{
+    // path states are kept outside of the packet, because the traversal may reorder rays within a group
+    std::vector<PathTracer::PathState, AlignmentAllocator<PathTracer::PathState>> paths;
+    std::vector<PathTracer::PathState, AlignmentAllocator<PathTracer::PathState>> sortedPaths;
 
-            pathTerminationReason = PathTerminationReason::HitBackground;
-            break;
-        }
+    PathTracer::ShadowRayQueue shadowRays;
+    std::vector<PathTracer::ShadowRayQueue::Entry, AlignmentAllocator<PathTracer::ShadowRayQueue::Entry>> sortedShadowRays;
 
-        mScene.ExtractShadingData(ray.origin, ray.dir, hitPoint, context.time, shadingData);
+    // ray groups built from sorted rays rarely mix octants
+    RaySorter raySorter;
+};
 
-        // we hit a light directly
-        if (hitPoint.subObjectId == RT_LIGHT_OBJECT)
-        {
-            // HACK
-            const LightSceneObject* lightSceneObj = static_cast<const LightSceneObject*>(mScene.GetObjects()[hitPoint.objectId].get());
-            const ILight& light = lightSceneObj->GetLight();
+void PathTracerBuffersDeleter::operator()(PathTracerBuffers* buffers) const
+{
+    delete buffers;
+}
 
-            const Vector4 hitPos = ray.GetAtDistance(hitPoint.distance);
+PathTerminationReason PathTracer::ShadeHitPoint(PathState& path, const HitPoint& hitPoint, ShadingData& shadingData, RenderingContext& context, ShadowRayQueue* shadowRays) const
+{
+    const Ray& ray = path.ray;
 
-            float directPdfA;
-            const Color lightContribution = light.GetRadiance(context, ray.dir, hitPos, &directPdfA);
+    // ray missed - return background color
+    if (hitPoint.distance == FLT_MAX)
+    {
+        if (const BackgroundLight* light = mScene.GetBackgroundLight())
+        {
+            float directPdfW;
+            const Color lightContribution = light->GetRadiance(context, ray.dir, Vector4::Zero(), &directPdfW);
             RT_ASSERT(lightContribution.IsValid());
 
             if (!lightContribution.AlmostZero())
             {
-                RT_ASSERT(directPdfA > 0.0f && IsValid(directPdfA));
+                RT_ASSERT(directPdfW > 0.0f && IsValid(directPdfW));
 
                 float misWeight = 1.0f;
-                if (mSampleLights && depth > 0 && !lastSpecular)
+                if (mSampleLights && path.depth > 0 && !path.lastSpecular)
                 {
-                    const float cosTheta = Vector4::Dot3(-ray.dir, shadingData.normal);
-                    const float directPdfW = PdfAtoW(directPdfA, hitPoint.distance, cosTheta);
-                    misWeight = CombineMis(lastPdfW, directPdfW);
+                    misWeight = CombineMis(path.lastPdfW, directPdfW);
                 }
 
-                resultColor += throughput * lightContribution * misWeight;
+                path.resultColor += path.throughput * lightContribution * misWeight;
             }
-
-            pathTerminationReason = PathTerminationReason::HitLight;
-            break;
         }
 
-        // fill up structure with shading data
-        {
-            shadingData.outgoingDirWorldSpace = -ray.dir;
-            shadingData.outgoingDirLocalSpace = shadingData.WorldToLocal(shadingData.outgoingDirWorldSpace);
+        return PathTerminationReason::HitBackground;
+    }
 
-            RT_ASSERT(shadingData.material != nullptr);
-            shadingData.material->EvaluateShadingData(context.wavelength, shadingData);
-        }
+    mScene.ExtractShadingData(ray.origin, ray.dir, hitPoint, context.time, shadingData);
 
-        // accumulate emission color
-        const Color emissionColor = Color::SampleRGB(context.wavelength, shadingData.material->emission.Evaluate(shadingData.texCoord));
-        RT_ASSERT(emissionColor.IsValid());
-        resultColor += throughput * emissionColor;
-        RT_ASSERT(resultColor.IsValid());
+    // we hit a light directly
+    if (hitPoint.subObjectId == RT_LIGHT_OBJECT)
+    {
+        // HACK
+        const LightSceneObject* lightSceneObj = static_cast<const LightSceneObject*>(mScene.GetObjects()[hitPoint.objectId].get());
+        const ILight& light = lightSceneObj->GetLight();
 
-        if (mSampleLights)
-        {
-            // sample lights directly (a.k.a. next event estimation)
-            resultColor += throughput * SampleLights(shadingData, context);
-        }
+        const Vector4 hitPos = ray.GetAtDistance(hitPoint.distance);
 
-        // check if the ray depth won't be exeeded in the next iteration
-        if (depth >= context.params->maxRayDepth)
-        {
-            pathTerminationReason = PathTerminationReason::Depth;
-            break;
-        }
+        float directPdfA;
+        const Color lightContribution = light.GetRadiance(context, ray.dir, hitPos, &directPdfA);
+        RT_ASSERT(lightContribution.IsValid());
 
-        // Russian roulette algorithm
-        if (depth >= context.params->minRussianRouletteDepth)
+        if (!lightContribution.AlmostZero())
         {
-            const Float threshold = throughput.Max();
-            if (context.randomGenerator.GetFloat() > threshold)
+            RT_ASSERT(directPdfA > 0.0f && IsValid(directPdfA));
+
+            float misWeight = 1.0f;
+            if (mSampleLights && path.depth > 0 && !path.lastSpecular)
             {
-                pathTerminationReason = PathTerminationReason::RussianRoulette;
-                break;
+                const float cosTheta = Vector4::Dot3(-ray.dir, shadingData.normal);
+                const float directPdfW = PdfAtoW(directPdfA, hitPoint.distance, cosTheta);
+                misWeight = CombineMis(path.lastPdfW, directPdfW);
             }
-            throughput *= 1.0f / threshold;
+
+            path.resultColor += path.throughput * lightContribution * misWeight;
         }
 
-        // sample BSDF
-        float pdf;
-        Vector4 incomingDirWorldSpace;
-        lastSampledBsdfEvent = BSDF::NullEvent;
-        const Color bsdfValue = shadingData.material->Sample(context.wavelength, incomingDirWorldSpace, shadingData, context.randomGenerator, pdf, lastSampledBsdfEvent);
+        return PathTerminationReason::HitLight;
+    }
 
-        if (lastSampledBsdfEvent == BSDF::NullEvent)
-        {
-            pathTerminationReason = PathTerminationReason::NoSampledEvent;
-            break;
-        }
+    // fill up structure with shading data
+    {
+        shadingData.outgoingDirWorldSpace = -ray.dir;
+        shadingData.outgoingDirLocalSpace = shadingData.WorldToLocal(shadingData.outgoingDirWorldSpace);
+
+        RT_ASSERT(shadingData.material != nullptr);
+        shadingData.material->EvaluateShadingData(context.wavelength, shadingData);
+    }
+
+    // accumulate emission color
+    const Color emissionColor = Color::SampleRGB(context.wavelength, shadingData.material->emission.Evaluate(shadingData.texCoord));
+    RT_ASSERT(emissionColor.IsValid());
+    path.resultColor += path.throughput * emissionColor;
+    RT_ASSERT(path.resultColor.IsValid());
 
-        RT_ASSERT(bsdfValue.IsValid());
-        RT_ASSERT(pdf > 0.0f);
-        throughput *= bsdfValue;
+    if (mSampleLights)
+    {
+        const size_t firstShadowRay = shadowRays ? shadowRays->entries.size() : 0;
 
-        // ray is not visible anymore
-        if (throughput.AlmostZero())
+        // sample lights directly (a.k.a. next event estimation)
+        path.resultColor += path.throughput * SampleLights(shadingData, context, shadowRays);
+
+        if (shadowRays)
         {
-            pathTerminationReason = PathTerminationReason::Throughput;
-            break;
+            for (size_t i = firstShadowRay; i < shadowRays->entries.size(); ++i)
+            {
+                shadowRays->entries[i].contribution *= path.throughput;
+            }
         }
+    }
 
-        lastSpecular = (lastSampledBsdfEvent & BSDF::SpecularEvent) != 0;
-        lastPdfW = pdf;
-        throughput *= 1.0f / pdf;
-
-        // TODO check for NaNs
+    // check if the ray depth won't be exeeded in the next iteration
+    if (path.depth >= context.params->maxRayDepth)
+    {
+        return PathTerminationReason::Depth;
+    }
 
-        if (context.pathDebugData)
+    // Russian roulette algorithm
+    if (path.depth >= context.params->minRussianRouletteDepth)
+    {
+        const Float threshold = path.throughput.Max();
+        if (context.randomGenerator.GetFloat() > threshold)
         {
-            PathDebugData::HitPointData data;
-            data.rayOrigin = ray.origin;
-            data.rayDir = ray.dir;
-            data.hitPoint = hitPoint;
-            data.shadingData = shadingData;
-            data.throughput = throughput;
-            data.bsdfEvent = lastSampledBsdfEvent;
-            context.pathDebugData->data.push_back(data);
+            return PathTerminationReason::RussianRoulette;
         }
+        path.throughput *= 1.0f / threshold;
+    }
+
+    // sample BSDF
+    float pdf;
+    Vector4 incomingDirWorldSpace;
+    path.lastSampledBsdfEvent = BSDF::NullEvent;
+    const Color bsdfValue = shadingData.material->Sample(context.wavelength, incomingDirWorldSpace, shadingData, context.randomGenerator, pdf, path.lastSampledBsdfEvent);
+
+    if (path.lastSampledBsdfEvent == BSDF::NullEvent)
+    {
+        return PathTerminationReason::NoSampledEvent;
+    }
 
-        // generate secondary ray
-        ray = Ray(shadingData.position, incomingDirWorldSpace);
-        ray.origin += ray.dir * 0.001f;
+    RT_ASSERT(bsdfValue.IsValid());
+    RT_ASSERT(pdf > 0.0f);
+    path.throughput *= bsdfValue;
 
-        depth++;
+    // ray is not visible anymore
+    if (path.throughput.AlmostZero())
+    {
+        return PathTerminationReason::Throughput;
     }
 
+    path.lastSpecular = (path.lastSampledBsdfEvent & BSDF::SpecularEvent) != 0;
+    path.lastPdfW = pdf;
+    path.throughput *= 1.0f / pdf;
+
+    // TODO check for NaNs
+
     if (context.pathDebugData)
     {
         PathDebugData::HitPointData data;
@@ -293,13 +333,189 @@ const Color PathTracer::TraceRay_Single(const Ray& primaryRay, RenderingContext&
         data.rayDir = ray.dir;
         data.hitPoint = hitPoint;
         data.shadingData = shadingData;
-        data.throughput = throughput;
-        data.bsdfEvent = lastSampledBsdfEvent;
+        data.throughput = path.throughput;
+        data.bsdfEvent = path.lastSampledBsdfEvent;
+        context.pathDebugData->data.push_back(data);
+    }
+
+    // generate secondary ray
+    path.ray = Ray(shadingData.position, incomingDirWorldSpace);
+    path.ray.origin += path.ray.dir * 0.001f;
+
+    path.depth++;
+
+    return PathTerminationReason::None;
+}
+
+const Color PathTracer::TraceRay_Single(const Ray& primaryRay, RenderingContext& context) const
+{
+    PathState path(primaryRay);
+    HitPoint hitPoint;
+    ShadingData shadingData;
+
+    PathTerminationReason pathTerminationReason = PathTerminationReason::None;
+    while (pathTerminationReason == PathTerminationReason::None)
+    {
+        hitPoint.distance = FLT_MAX;
+        context.localCounters.Reset();
+        mScene.Traverse_Single({ path.ray, hitPoint, context });
+        context.counters.Append(context.localCounters);
+
+        pathTerminationReason = ShadeHitPoint(path, hitPoint, shadingData, context);
+    }
+
+    if (context.pathDebugData)
+    {
+        PathDebugData::HitPointData data;
+        data.rayOrigin = path.ray.origin;
+        data.rayDir = path.ray.dir;
+        data.hitPoint = hitPoint;
+        data.shadingData = shadingData;
+        data.throughput = path.throughput;
+        data.bsdfEvent = path.lastSampledBsdfEvent;
         context.pathDebugData->data.push_back(data);
         context.pathDebugData->terminationReason = pathTerminationReason;
     }
 
-    return resultColor;
+    return path.resultColor;
+}
+
+void PathTracer::Raytrace_Packet(RayPacket& packet, RenderingContext& context, Viewport& viewport) const
+{
+    if (!context.pathTracerBuffers)
+    {
+        context.pathTracerBuffers.reset(new PathTracerBuffers);
+    }
+
+    PathTracerBuffers& buffers = *context.pathTracerBuffers;
+    auto& paths = buffers.paths;
+    auto& sortedPaths = buffers.sortedPaths;
+    auto& shadowRays = buffers.shadowRays;
+    auto& sortedShadowRays = buffers.sortedShadowRays;
+
+    // reset states left from the previous packet
+    paths.clear();
+    paths.resize(packet.numRays);
+    sortedPaths.resize(packet.numRays);
+
+    for (Uint32 i = 0; i < packet.numRays; ++i)
+    {
+        const Uint32 groupIndex = i / RayPacket::RaysPerGroup;
+        const Uint32 rayIndex = i % RayPacket::RaysPerGroup;
+        const RayGroup& group = packet.groups[groupIndex];
+        const Vector3x8& weights = packet.rayWeights[groupIndex];
+
+        const Uint32 rayOffset = group.rayOffsets[rayIndex];
+        PathState& path = paths[rayOffset];
+        const Vector4 origin(group.rays[0].origin.x[rayIndex], group.rays[0].origin.y[rayIndex], group.rays[0].origin.z[rayIndex], 0.0f);
+        const Vector4 dir(group.rays[0].dir.x[rayIndex], group.rays[0].dir.y[rayIndex], group.rays[0].dir.z[rayIndex], 0.0f);
+        path.ray = Ray(origin, dir);
+        path.weight = Vector4(weights.x[rayIndex], weights.y[rayIndex], weights.z[rayIndex], 0.0f);
+        path.imageLocation = packet.imageLocations[rayOffset];
+        path.wavelength = context.wavelength;
+    }
+
+    const Wavelength packetWavelength = context.wavelength;
+
+    ShadingData shadingData;
+
+    Uint32 numPaths = packet.numRays;
+    while (numPaths > 0)
+    {
+        // extend all paths at once
+        context.localCounters.Reset();
+        mScene.Traverse_Packet({ packet, context });
+        context.counters.Append(context.localCounters);
+
+        // shade - hit points are indexed with ray offsets, which match path indices
+        shadowRays.entries.clear();
+        for (Uint32 i = 0; i < numPaths; ++i)
+        {
+            PathState& path = paths[i];
+            shadowRays.pathIndex = i;
+
+            context.wavelength = path.wavelength;
+            path.terminationReason = ShadeHitPoint(path, context.hitPoints[i], shadingData, context, &shadowRays);
+            path.wavelength = context.wavelength;
+        }
+
+        // trace shadow rays of all the paths (the packet is rebuilt for the next bounce anyway)
+        const size_t numShadowRays = shadowRays.entries.size();
+        const std::vector<Uint32>& shadowRaysOrder = buffers.raySorter.Sort(static_cast<Uint32>(numShadowRays),
+            [&shadowRays](Uint32 i) -> const Ray& { return shadowRays.entries[i].ray; });
+        sortedShadowRays.resize(numShadowRays);
+        for (size_t i = 0; i < numShadowRays; ++i)
+        {
+            sortedShadowRays[i] = shadowRays.entries[shadowRaysOrder[i]];
+        }
+        for (size_t first = 0; first < numShadowRays; first += MaxRayPacketSize)
+        {
+            const size_t last = std::min<size_t>(first + MaxRayPacketSize, numShadowRays);
+
+            packet.Clear();
+            for (size_t i = first; i < last; ++i)
+            {
+                const ShadowRayQueue::Entry& entry = sortedShadowRays[i];
+                packet.PushRay(entry.ray, Vector4::Zero(), ImageLocationInfo(), entry.distance);
+            }
+            packet.FillLastGroup();
+
+            context.localCounters.Reset();
+            mScene.Traverse_Shadow_Packet({ packet, context });
+            context.counters.Append(context.localCounters);
+
+            for (size_t i = first; i < last; ++i)
+            {
+                const ShadowRayQueue::Entry& entry = sortedShadowRays[i];
+                if (context.hitPoints[i - first].distance == FLT_MAX)
+                {
+                    paths[entry.pathIndex].resultColor += entry.contribution;
+                }
+            }
+        }
+
+        // compact - terminated paths are accumulated in the viewport
+        Uint32 numActivePaths = 0;
+        for (Uint32 i = 0; i < numPaths; ++i)
+        {
+            PathState& path = paths[i];
+            if (path.terminationReason == PathTerminationReason::None)
+            {
+                if (numActivePaths != i)
+                {
+                    paths[numActivePaths] = path;
+                }
+                numActivePaths++;
+            }
+            else
+            {
+                const Vector4 color = path.resultColor.Resolve(path.wavelength) * path.weight;
+                viewport.Internal_AccumulateColor(path.imageLocation.x, path.imageLocation.y, color);
+            }
+        }
+
+        // generate next bounce
+        const std::vector<Uint32>& pathsOrder = buffers.raySorter.Sort(numActivePaths, [&paths](Uint32 i) -> const Ray& { return paths[i].ray; });
+        for (Uint32 i = 0; i < numActivePaths; ++i)
+        {
+            sortedPaths[i] = paths[pathsOrder[i]];
+        }
+        std::swap(paths, sortedPaths);
+
+        packet.Clear();
+        for (Uint32 i = 0; i < numActivePaths; ++i)
+        {
+            packet.PushRay(paths[i].ray, paths[i].weight, paths[i].imageLocation);
+        }
+        packet.FillLastGroup();
+
+        numPaths = numActivePaths;
+    }
+
+    context.wavelength = packetWavelength;
+
+    // counters are already appended
+    context.localCounters.Reset();
 }
 
 } // namespace rt
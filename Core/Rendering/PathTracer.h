@@ -5,7 +5,9 @@
 namespace rt {
 
 struct ShadingData;
+struct HitPoint;
 class ILight;
+enum class PathTerminationReason;
 
 // Unidirectional path tracer
 class RAYLIB_API PathTracer : public IRenderer
@@ -15,15 +17,31 @@ public:
 
     virtual const Color TraceRay_Single(const math::Ray& ray, RenderingContext& context) const override;
 
+    // wavefront path tracing: all paths of the packet are extended with a packet traversal,
+    // shaded one by one and the terminated ones are removed from the packet before the next bounce
+    // shadow rays of all the paths are traced together as packets
+    virtual void Raytrace_Packet(RayPacket& packet, RenderingContext& context, Viewport& viewport) const override;
+
     // a.k.a. next event estimation (NEE)
     bool mSampleLights = true;
 
 private:
+    friend struct PathTracerBuffers;
+
+    struct PathState;
+    struct ShadowRayQueue;
+
+    // process path vertex at given hit point: accumulate its contribution and sample the next ray
+    // returns PathTerminationReason::None if the path should be continued
+    // if shadow ray queue is given, light samples are added to the path after their occlusion is checked by the caller
+    PathTerminationReason ShadeHitPoint(PathState& path, const HitPoint& hitPoint, ShadingData& shadingData, RenderingContext& context, ShadowRayQueue* shadowRays = nullptr) const;
+
     // importance sample light sources
-    const Color SampleLights(const ShadingData& shadingData, RenderingContext& context) const;
+    // returns contribution of visible samples, or queues the shadow rays if the queue is given
+    const Color SampleLights(const ShadingData& shadingData, RenderingContext& context, ShadowRayQueue* shadowRays) const;
 
-    // importance sample single light source
-    const Color SampleLight(const ILight* light, const ShadingData& shadingData, RenderingContext& context) const;
+    // importance sample single light source (light visibility is not checked)
+    const Color SampleLight(const ILight* light, const ShadingData& shadingData, RenderingContext& context, math::Ray& outShadowRay, Float& outShadowRayDistance) const;
 };
 
 } // namespace rt
@@ -8,7 +8,7 @@ namespace rt {
 
 struct RT_ALIGN(16) PostprocessParams
 {
-    math::Vector4 colorFilter = math::VECTOR_ONE;
+    math::Vector4 colorFilter = math::Vector4(1.0f);
 
     // exposure in log scale
     float exposure = 0.0f;
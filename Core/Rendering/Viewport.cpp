@@ -1,7 +1,9 @@
 #include "PCH.h"
 #include "Viewport.h"
+#include "ViewportKernels.h"
 #include "Renderer.h"
 #include "Utils/Logger.h"
+#include "Utils/CpuFeatures.h"
 #include "Scene/Camera.h"
 #include "Color/Color.h"
 #include "Color/ColorHelpers.h"
@@ -352,29 +354,27 @@ void Viewport::PostProcessTile(const Block& block, Uint32 threadID)
     Random& randomGenerator = mThreadData[threadID].randomGenerator;
 
     const Float3* __restrict sumPixels = mSum.GetDataAs<Float3>();
+    const Uint32* __restrict passesPerPixel = mPassesPerPixel.data();
     Uint8* __restrict frontBufferPixels = mFrontBuffer.GetDataAs<Uint8>();
 
-    for (Uint32 y = block.minY; y < block.maxY; ++y)
-    {
-        for (Uint32 x = block.minX; x < block.maxX; ++x)
-        {
-            const size_t pixelIndex = GetWidth() * y + x;
-
-#ifdef RT_ENABLE_SPECTRAL_RENDERING
-            const Vector4 xyzColor = Vector4(sumPixels[pixelIndex]);
-            const Vector4 rgbColor = ConvertXYZtoRGB(xyzColor);
-#else
-            const Vector4 rgbColor = Vector4(sumPixels[pixelIndex]);
-#endif
-
-            const Float pixelScaling = 1.0f / static_cast<Float>(mPassesPerPixel[pixelIndex]);
+    const Vector4& colorScale = mPostprocessParams.colorScale;
+    const Float ditheringStrength = mPostprocessParams.params.ditheringStrength;
 
-            const Vector4 toneMapped = ToneMap(rgbColor * mPostprocessParams.colorScale * pixelScaling);
-            const Vector4 dithered = Vector4::MulAndAdd(randomGenerator.GetVector4Bipolar(), mPostprocessParams.params.ditheringStrength, toneMapped);
+#ifdef RT_ENABLE_AVX512_KERNELS
+    if (GetKernelInstructionSet() == InstructionSet::AVX512)
+    {
+        PostProcessTile_AVX512(block, GetWidth(), sumPixels, passesPerPixel, colorScale, ditheringStrength, randomGenerator, frontBufferPixels);
+        return;
+    }
+#endif // RT_ENABLE_AVX512_KERNELS
 
-            dithered.StoreBGR_NonTemporal(frontBufferPixels + 4 * pixelIndex);
-        }
+    if (GetKernelInstructionSet() == InstructionSet::AVX2)
+    {
+        PostProcessTile_AVX2(block, GetWidth(), sumPixels, passesPerPixel, colorScale, ditheringStrength, randomGenerator, frontBufferPixels);
+        return;
     }
+
+    PostProcessTile_Generic(block, GetWidth(), sumPixels, passesPerPixel, colorScale, ditheringStrength, randomGenerator, frontBufferPixels);
 }
 
 Float Viewport::ComputeBlockError(const Block& block) const
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "PostProcess.h"
+#include "Color/ColorHelpers.h"
+#include "Math/Rectangle.h"
+#include "Math/Random.h"
+
+// Post-processing kernels. Compiled once for the baseline and once per additional instruction set
+// (see Viewport_AVX2.cpp and Viewport_AVX512.cpp), so all the functions here must be inlined or static.
+// Global vector constants (e.g. VECTOR8_ONE) are not available here either (see RT_KERNEL_TRANSLATION_UNIT).
+
+namespace rt {
+
+RT_FORCE_INLINE static void PostProcessTile_Generic(const math::Rectangle<Uint32>& block, Uint32 width, const math::Float3* __restrict sumPixels, const Uint32* __restrict passesPerPixel,
+                                                    const math::Vector4& colorScale, const Float ditheringStrength, math::Random& randomGenerator, Uint8* __restrict frontBufferPixels)
+{
+    for (Uint32 y = block.minY; y < block.maxY; ++y)
+    {
+        for (Uint32 x = block.minX; x < block.maxX; ++x)
+        {
+            const size_t pixelIndex = width * y + x;
+
+#ifdef RT_ENABLE_SPECTRAL_RENDERING
+            const math::Vector4 xyzColor = math::Vector4(sumPixels[pixelIndex]);
+            const math::Vector4 rgbColor = ConvertXYZtoRGB(xyzColor);
+#else
+            const math::Vector4 rgbColor = math::Vector4(sumPixels[pixelIndex]);
+#endif
+
+            const Float pixelScaling = 1.0f / static_cast<Float>(passesPerPixel[pixelIndex]);
+
+            const math::Vector4 toneMapped = ToneMap(rgbColor * colorScale * pixelScaling);
+            const math::Vector4 dithered = math::Vector4::MulAndAdd(randomGenerator.GetVector4Bipolar(), ditheringStrength, toneMapped);
+
+            dithered.StoreBGR_NonTemporal(frontBufferPixels + 4 * pixelIndex);
+        }
+    }
+}
+
+// variants compiled for additional instruction sets, selected at runtime (see GetKernelInstructionSet)
+void PostProcessTile_AVX2(const math::Rectangle<Uint32>& block, Uint32 width, const math::Float3* __restrict sumPixels, const Uint32* __restrict passesPerPixel,
+                          const math::Vector4& colorScale, const Float ditheringStrength, math::Random& randomGenerator, Uint8* __restrict frontBufferPixels);
+
+#ifdef RT_ENABLE_AVX512_KERNELS
+void PostProcessTile_AVX512(const math::Rectangle<Uint32>& block, Uint32 width, const math::Float3* __restrict sumPixels, const Uint32* __restrict passesPerPixel,
+                            const math::Vector4& colorScale, const Float ditheringStrength, math::Random& randomGenerator, Uint8* __restrict frontBufferPixels);
+#endif // RT_ENABLE_AVX512_KERNELS
+
+} // namespace rt
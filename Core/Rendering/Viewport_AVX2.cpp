@@ -0,0 +1,17 @@
+#define RT_KERNEL_TRANSLATION_UNIT
+#include "PCH.h"
+#include "ViewportKernels.h"
+
+#ifndef RT_USE_AVX2
+#error "This file must be compiled with AVX2 enabled"
+#endif // RT_USE_AVX2
+
+namespace rt {
+
+void PostProcessTile_AVX2(const math::Rectangle<Uint32>& block, Uint32 width, const math::Float3* __restrict sumPixels, const Uint32* __restrict passesPerPixel,
+                          const math::Vector4& colorScale, const Float ditheringStrength, math::Random& randomGenerator, Uint8* __restrict frontBufferPixels)
+{
+    PostProcessTile_Generic(block, width, sumPixels, passesPerPixel, colorScale, ditheringStrength, randomGenerator, frontBufferPixels);
+}
+
+} // namespace rt
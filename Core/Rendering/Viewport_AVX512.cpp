@@ -0,0 +1,21 @@
+#define RT_KERNEL_TRANSLATION_UNIT
+#include "PCH.h"
+#include "ViewportKernels.h"
+
+#ifdef RT_ENABLE_AVX512_KERNELS
+
+#ifndef __AVX512F__
+#error "This file must be compiled with AVX-512 enabled"
+#endif // __AVX512F__
+
+namespace rt {
+
+void PostProcessTile_AVX512(const math::Rectangle<Uint32>& block, Uint32 width, const math::Float3* __restrict sumPixels, const Uint32* __restrict passesPerPixel,
+                            const math::Vector4& colorScale, const Float ditheringStrength, math::Random& randomGenerator, Uint8* __restrict frontBufferPixels)
+{
+    PostProcessTile_Generic(block, width, sumPixels, passesPerPixel, colorScale, ditheringStrength, randomGenerator, frontBufferPixels);
+}
+
+} // namespace rt
+
+#endif // RT_ENABLE_AVX512_KERNELS
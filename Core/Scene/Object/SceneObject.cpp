@@ -7,13 +7,29 @@ using namespace math;
 
 ISceneObject::~ISceneObject() = default;
 
+void ISceneObject::GetMotionBoundingBoxes(Box& outStartBox, Box& outEndBox) const
+{
+    outStartBox = GetBoundingBox();
+    outEndBox = outStartBox;
+}
+
+bool ISceneObject::IsMoving() const
+{
+    return mLinearVelocity.SqrLength3() > 0.0f || IsRotating();
+}
+
+bool ISceneObject::IsRotating() const
+{
+    return !Quaternion::AlmostEqual(mAngularVelocity, Quaternion::Identity());
+}
+
 Transform ISceneObject::ComputeTransform(const float t) const
 {
     const Vector4 position = Vector4::MulAndAdd(mLinearVelocity, t, mTransform.GetTranslation());
     const Quaternion rotation0 = mTransform.GetRotation();
     Quaternion rotation;
 
-    if (Quaternion::AlmostEqual(mAngularVelocity, Quaternion::Identity()))
+    if (!IsRotating())
     {
         rotation = rotation0;
     }
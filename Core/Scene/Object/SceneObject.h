@@ -31,6 +31,9 @@ public:
     // check shadow ray occlusion
     virtual bool Traverse_Shadow_Single(const SingleTraversalContext& context) const = 0;
 
+    // check shadow rays occlusion, occluded rays are retired from the packet (see PacketTraversalContext::StoreOcclusion)
+    virtual void Traverse_Shadow_Packet(const PacketTraversalContext& context, const Uint32 numActiveGroups) const = 0;
+
     // Calculate input data for shading routine
     // NOTE: all calculations are performed in local space
     virtual void EvaluateShadingData_Single(const HitPoint& hitPoint, ShadingData& outShadingData) const = 0;
@@ -38,6 +41,15 @@ public:
     // Get world-space bounding box
     virtual math::Box GetBoundingBox() const = 0;
 
+    // Get world-space bounding boxes at time=0.0 and time=1.0
+    // boxes interpolated between them must enclose the object at any time in between
+    // (by default both of them are the bounding box of the whole motion)
+    virtual void GetMotionBoundingBoxes(math::Box& outStartBox, math::Box& outEndBox) const;
+
+    // check if the object moves during a frame
+    bool IsMoving() const;
+    bool IsRotating() const;
+
     math::Transform ComputeTransform(const float t) const;
     math::Transform ComputeInverseTransform(const float t) const;
 
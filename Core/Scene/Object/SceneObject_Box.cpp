@@ -91,6 +91,20 @@ Box BoxSceneObject::GetBoundingBox() const
     return Box(box0, box1);
 }
 
+void BoxSceneObject::GetMotionBoundingBoxes(Box& outStartBox, Box& outEndBox) const
+{
+    // rotated box's bounds do not change linearly
+    if (IsRotating())
+    {
+        ISceneObject::GetMotionBoundingBoxes(outStartBox, outEndBox);
+        return;
+    }
+
+    const Box localBox(-mSize, mSize);
+    outStartBox = mTransform.TransformBox(localBox);
+    outEndBox = ComputeTransform(1.0f).TransformBox(localBox);
+}
+
 void BoxSceneObject::Traverse_Single(const SingleTraversalContext& context, const Uint32 objectID) const
 {
     const Box box(-mSize, mSize);
@@ -128,9 +142,11 @@ bool BoxSceneObject::Traverse_Shadow_Single(const SingleTraversalContext& contex
 {
     const Box box(-mSize, mSize);
 
-    float dist;
-    if (Intersect_BoxRay(context.ray, box, dist))
+    // box is two-sided (the same as in closest hit traversal)
+    float nearDist, farDist;
+    if (Intersect_BoxRay_TwoSided(context.ray, box, nearDist, farDist))
     {
+        const float dist = nearDist > 0.0f ? nearDist : farDist;
         if (dist > 0.0f && dist < context.hitPoint.distance)
         {
             context.hitPoint.distance = dist;
@@ -141,21 +157,44 @@ bool BoxSceneObject::Traverse_Shadow_Single(const SingleTraversalContext& contex
     return false;
 }
 
+VectorBool8 BoxSceneObject::Traverse_Packet_Internal(const RayGroup& rayGroup, Vector8& outDist) const
+{
+    const Ray_Simd8& ray = rayGroup.rays[1];
+
+    const Box_Simd8 box(Box(-mSize, mSize));
+
+    Vector8 nearDist, farDist;
+    const VectorBool8 mask = Intersect_BoxRay_TwoSided_Simd8(ray.invDir, ray.origin * ray.invDir, box, rayGroup.maxDistances, nearDist, farDist);
+
+    // the far hit may lie beyond max distance when the ray starts inside the box
+    outDist = Vector8::Select(nearDist, farDist, nearDist < Vector8::Zero());
+    return mask & (outDist < rayGroup.maxDistances);
+}
+
 void BoxSceneObject::Traverse_Packet(const PacketTraversalContext& context, const Uint32 objectID, const Uint32 numActiveGroups) const
 {
     for (Uint32 i = 0; i < numActiveGroups; ++i)
     {
         RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[i]];
-        const Ray_Simd8& ray = rayGroup.rays[1];
 
-        const Box_Simd8 box(Box(-mSize, mSize));
-
-        Vector8 nearDist, farDist;
-        const VectorBool8 mask = Intersect_BoxRay_TwoSided_Simd8(ray.invDir, ray.origin * ray.invDir, box, rayGroup.maxDistances, nearDist, farDist);
+        Vector8 t;
+        const VectorBool8 mask = Traverse_Packet_Internal(rayGroup, t);
+        context.StoreIntersection(rayGroup, t, mask, objectID);
+    }
+}
 
-        const Vector8 t = Vector8::Select(nearDist, farDist, nearDist < Vector8::Zero());
+void BoxSceneObject::Traverse_Shadow_Packet(const PacketTraversalContext& context, const Uint32 numActiveGroups) const
+{
+    for (Uint32 i = 0; i < numActiveGroups; ++i)
+    {
+        RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[i]];
 
-        context.StoreIntersection(rayGroup, t, mask, objectID);
+        Vector8 t;
+        const VectorBool8 mask = Traverse_Packet_Internal(rayGroup, t);
+        if (context.StoreOcclusion(rayGroup, t, mask))
+        {
+            return;
+        }
     }
 }
 
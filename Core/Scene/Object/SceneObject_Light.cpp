@@ -38,6 +38,13 @@ bool LightSceneObject::Traverse_Shadow_Single(const SingleTraversalContext& cont
     return false;
 }
 
+void LightSceneObject::Traverse_Shadow_Packet(const PacketTraversalContext& context, const Uint32 numActiveGroups) const
+{
+    // lights do not occlude (the same as in single ray traversal)
+    RT_UNUSED(context);
+    RT_UNUSED(numActiveGroups);
+}
+
 void LightSceneObject::Traverse_Packet(const PacketTraversalContext& context, const Uint32 objectID, const Uint32 numActiveGroups) const
 {
     RT_UNUSED(context);
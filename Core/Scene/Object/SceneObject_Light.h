@@ -21,6 +21,7 @@ private:
     virtual void Traverse_Packet(const PacketTraversalContext& context, const Uint32 objectID, const Uint32 numActiveGroups) const override;
 
     virtual bool Traverse_Shadow_Single(const SingleTraversalContext& context) const override;
+    virtual void Traverse_Shadow_Packet(const PacketTraversalContext& context, const Uint32 numActiveGroups) const override;
 
     virtual void EvaluateShadingData_Single(const HitPoint& hitPoint, ShadingData& outShadingData) const override;
 
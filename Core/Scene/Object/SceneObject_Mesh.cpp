@@ -25,19 +25,54 @@ Box MeshSceneObject::GetBoundingBox() const
     return Box(box0, box1);
 }
 
+void MeshSceneObject::GetMotionBoundingBoxes(Box& outStartBox, Box& outEndBox) const
+{
+    // rotated mesh's bounds do not change linearly
+    if (IsRotating())
+    {
+        ISceneObject::GetMotionBoundingBoxes(outStartBox, outEndBox);
+        return;
+    }
+
+    const Box localBox = mMesh->GetBoundingBox();
+    outStartBox = mTransform.TransformBox(localBox);
+    outEndBox = ComputeTransform(1.0f).TransformBox(localBox);
+}
+
 void MeshSceneObject::Traverse_Single(const SingleTraversalContext& context, const Uint32 objectID) const
 {
+#if RT_BVH_WIDTH > 2
+    GenericTraverse_Wide_Single<Mesh, RT_BVH_WIDTH>(context, objectID, mMesh.get());
+#else
     GenericTraverse_Single<Mesh>(context, objectID, mMesh.get());
+#endif // RT_BVH_WIDTH > 2
 }
 
 bool MeshSceneObject::Traverse_Shadow_Single(const SingleTraversalContext& context) const
 {
+#if RT_BVH_WIDTH > 2
+    return GenericTraverse_Wide_Shadow_Single<Mesh, RT_BVH_WIDTH>(context, mMesh.get());
+#else
     return GenericTraverse_Shadow_Single<Mesh>(context, mMesh.get());
+#endif // RT_BVH_WIDTH > 2
 }
 
 void MeshSceneObject::Traverse_Packet(const PacketTraversalContext& context, const Uint32 objectID, const Uint32 numActiveGroups) const
 {
+#if RT_BVH_WIDTH > 2
+    GenericTraverse_Wide_Packet<Mesh, RT_BVH_WIDTH, 1>(context, objectID, mMesh.get(), numActiveGroups);
+#else
     GenericTraverse_Packet<Mesh, 1>(context, objectID, mMesh.get(), numActiveGroups);
+#endif // RT_BVH_WIDTH > 2
+}
+
+void MeshSceneObject::Traverse_Shadow_Packet(const PacketTraversalContext& context, const Uint32 numActiveGroups) const
+{
+#if RT_BVH_WIDTH > 2
+    GenericTraverse_Wide_Shadow_Packet<Mesh, RT_BVH_WIDTH, 1>(context, mMesh.get(), numActiveGroups);
+#else
+    GenericTraverse_Shadow_Packet<Mesh, 1>(context, mMesh.get(), numActiveGroups);
+#endif // RT_BVH_WIDTH > 2
 }
 
 void MeshSceneObject::EvaluateShadingData_Single(const HitPoint& hitPoint, ShadingData& outShadingData) const
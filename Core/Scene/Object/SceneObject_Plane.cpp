@@ -58,25 +58,46 @@ bool PlaneSceneObject::Traverse_Shadow_Single(const SingleTraversalContext& cont
     return Traverse_Single_Internal(context, context.hitPoint.distance);
 }
 
+VectorBool8 PlaneSceneObject::Traverse_Packet_Internal(const RayGroup& rayGroup, Vector8& outDist) const
+{
+    const Vector8 t = -rayGroup.rays[1].origin.y * rayGroup.rays[1].invDir.y;
+    outDist = t;
+
+    const VectorBool8 mask = (t > Vector8::Zero()) & (t < rayGroup.maxDistances);
+    if (mask.None())
+    {
+        return mask;
+    }
+
+    const Vector8 x = Vector8::MulAndAdd(rayGroup.rays[1].dir.x, t, rayGroup.rays[1].origin.x);
+    const Vector8 z = Vector8::MulAndAdd(rayGroup.rays[1].dir.z, t, rayGroup.rays[1].origin.z);
+    return mask & (Vector8::Abs(x) < Vector8(mSize.x)) & (Vector8::Abs(z) < Vector8(mSize.y));
+}
+
 void PlaneSceneObject::Traverse_Packet(const PacketTraversalContext& context, const Uint32 objectID, const Uint32 numActiveGroups) const
 {
     for (Uint32 i = 0; i < numActiveGroups; ++i)
     {
         RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[i]];
 
-        const Vector8 t = -rayGroup.rays[1].origin.y * rayGroup.rays[1].invDir.y;
-        VectorBool8 mask = (t > Vector8::Zero()) & (t < rayGroup.maxDistances);
+        Vector8 t;
+        const VectorBool8 mask = Traverse_Packet_Internal(rayGroup, t);
+        context.StoreIntersection(rayGroup, t, mask, objectID);
+    }
+}
+
+void PlaneSceneObject::Traverse_Shadow_Packet(const PacketTraversalContext& context, const Uint32 numActiveGroups) const
+{
+    for (Uint32 i = 0; i < numActiveGroups; ++i)
+    {
+        RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[i]];
 
-        if (mask.None())
+        Vector8 t;
+        const VectorBool8 mask = Traverse_Packet_Internal(rayGroup, t);
+        if (context.StoreOcclusion(rayGroup, t, mask))
         {
-            continue;
+            return;
         }
-
-        const Vector8 x = Vector8::MulAndAdd(rayGroup.rays[1].dir.x, t, rayGroup.rays[1].origin.x);
-        const Vector8 z = Vector8::MulAndAdd(rayGroup.rays[1].dir.z, t, rayGroup.rays[1].origin.z);
-        mask = mask & (Vector8::Abs(x) < Vector8(mSize.x)) & (Vector8::Abs(z) < Vector8(mSize.y));
-
-        context.StoreIntersection(rayGroup, t, mask, objectID);
     }
 }
 
@@ -17,11 +17,13 @@ private:
     virtual math::Box GetBoundingBox() const override;
 
     bool Traverse_Single_Internal(const SingleTraversalContext& context, float& outDist) const;
+    math::VectorBool8 Traverse_Packet_Internal(const RayGroup& rayGroup, math::Vector8& outDist) const;
 
     virtual void Traverse_Single(const SingleTraversalContext& context, const Uint32 objectID) const override;
     virtual void Traverse_Packet(const PacketTraversalContext& context, const Uint32 objectID, const Uint32 numActiveGroups) const override;
 
     virtual bool Traverse_Shadow_Single(const SingleTraversalContext& context) const override;
+    virtual void Traverse_Shadow_Packet(const PacketTraversalContext& context, const Uint32 numActiveGroups) const override;
 
     virtual void EvaluateShadingData_Single(const HitPoint& intersechitPointtionData, ShadingData& outShadingData) const override;
 
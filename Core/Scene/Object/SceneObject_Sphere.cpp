@@ -23,6 +23,15 @@ Box SphereSceneObject::GetBoundingBox() const
     return Box(localBox, localBox + mLinearVelocity);
 }
 
+void SphereSceneObject::GetMotionBoundingBoxes(Box& outStartBox, Box& outEndBox) const
+{
+    const Vector4 radius = Vector4(mRadius, mRadius, mRadius, 0.0f);
+
+    // rotation does not change sphere's bounds
+    outStartBox = Box(mTransform.GetTranslation() - radius, mTransform.GetTranslation() + radius);
+    outEndBox = outStartBox + mLinearVelocity;
+}
+
 void SphereSceneObject::Traverse_Single(const SingleTraversalContext& context, const Uint32 objectID) const
 {
     const double v = Vector4::Dot3(context.ray.dir, -context.ray.origin);
@@ -80,30 +89,52 @@ bool SphereSceneObject::Traverse_Shadow_Single(const SingleTraversalContext& con
     return false;
 }
 
+VectorBool8 SphereSceneObject::Traverse_Packet_Internal(const RayGroup& rayGroup, Vector8& outDist) const
+{
+    const Ray_Simd8& ray = rayGroup.rays[1];
+
+    const Vector8 v = Vector3x8::Dot(ray.dir, -ray.origin);
+    const Vector8 det = Vector8(mRadius * mRadius) - Vector3x8::Dot(ray.origin, ray.origin) + v * v;
+
+    const VectorBool8 detSign = det > Vector8::Zero();
+    if (detSign.None())
+    {
+        outDist = VECTOR8_MAX;
+        return detSign;
+    }
+
+    const Vector8 sqrtDet = Vector8::Sqrt(det);
+    const Vector8 nearDist = v - sqrtDet;
+    const Vector8 farDist = v + sqrtDet;
+    outDist = Vector8::Select(nearDist, farDist, nearDist < Vector8::Zero());
+
+    return detSign & (outDist > Vector8::Zero()) & (outDist < rayGroup.maxDistances);
+}
+
 void SphereSceneObject::Traverse_Packet(const PacketTraversalContext& context, const Uint32 objectID, const Uint32 numActiveGroups) const
 {
     for (Uint32 i = 0; i < numActiveGroups; ++i)
     {
         RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[i]];
-        const Ray_Simd8& ray = rayGroup.rays[1];
 
-        const Vector8 v = Vector3x8::Dot(ray.dir, -ray.origin);
-        const Vector8 det = Vector8(mRadius * mRadius) - Vector3x8::Dot(ray.origin, ray.origin) + v * v;
+        Vector8 t;
+        const VectorBool8 mask = Traverse_Packet_Internal(rayGroup, t);
+        context.StoreIntersection(rayGroup, t, mask, objectID);
+    }
+}
+
+void SphereSceneObject::Traverse_Shadow_Packet(const PacketTraversalContext& context, const Uint32 numActiveGroups) const
+{
+    for (Uint32 i = 0; i < numActiveGroups; ++i)
+    {
+        RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[i]];
 
-        const VectorBool8 detSign = det > Vector8::Zero();
-        if (detSign.None())
+        Vector8 t;
+        const VectorBool8 mask = Traverse_Packet_Internal(rayGroup, t);
+        if (context.StoreOcclusion(rayGroup, t, mask))
         {
-            continue;
+            return;
         }
-
-        const Vector8 sqrtDet = Vector8::Sqrt(det);
-        const Vector8 nearDist = v - sqrtDet;
-        const Vector8 farDist = v + sqrtDet;
-        const Vector8 t = Vector8::Select(nearDist, farDist, nearDist < Vector8::Zero());
-
-        const VectorBool8 distMask = detSign & (t > Vector8::Zero()) & (t < rayGroup.maxDistances);
-
-        context.StoreIntersection(rayGroup, t, distMask, objectID);
     }
 }
 
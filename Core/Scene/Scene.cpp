@@ -4,6 +4,7 @@
 #include "Object/SceneObject_Light.h"
 #include "Rendering/ShadingData.h"
 #include "BVH/BVHBuilder.h"
+#include "Utils/Logger.h"
 
 #include "Traversal/Traversal_Single.h"
 #include "Traversal/Traversal_Packet.h"
@@ -32,51 +33,197 @@ void Scene::AddLight(LightPtr object)
     mLights.push_back(std::move(object));
 }
 
-void Scene::AddObject(SceneObjectPtr object)
+Uint32 Scene::AddObject(SceneObjectPtr object)
 {
     RT_ASSERT(object->mTransform.GetTranslation().IsValid());
     RT_ASSERT(object->mTransform.GetRotation().IsValid());
     RT_ASSERT(object->mLinearVelocity.IsValid());
     RT_ASSERT(object->mAngularVelocity.IsValid());
 
+    const Uint32 objectID = static_cast<Uint32>(mObjects.size());
     mObjects.push_back(std::move(object));
+
+    if (mIsBVHBuilt)
+    {
+        if (!mBVHUpdater.InsertLeaf(mBVH, objectID, mObjects.back()->GetBoundingBox()))
+        {
+            BuildBVH();
+        }
+        else
+        {
+            UpdateDerivedBVHs(objectID);
+        }
+    }
+
+    return objectID;
+}
+
+void Scene::RemoveObject(Uint32 objectID)
+{
+    RT_ASSERT(objectID < mObjects.size() && mObjects[objectID], "Invalid object ID");
+
+    if (mIsBVHBuilt)
+    {
+        mBVHUpdater.RemoveLeaf(mBVH, objectID);
+        UpdateDerivedBVHs(objectID);
+    }
+
+    mObjects[objectID].reset();
+}
+
+bool Scene::UpdateObject(Uint32 objectID)
+{
+    RT_ASSERT(objectID < mObjects.size() && mObjects[objectID], "Invalid object ID");
+
+    if (!mIsBVHBuilt)
+    {
+        return true;
+    }
+
+    if (!mBVHUpdater.UpdateLeaf(mBVH, objectID, mObjects[objectID]->GetBoundingBox()))
+    {
+        return BuildBVH();
+    }
+
+    return UpdateDerivedBVHs(objectID);
+}
+
+bool Scene::UpdateDerivedBVHs(Uint32 changedObjectID)
+{
+#if RT_BVH_WIDTH > 2
+    // only the wide nodes covering the modified ones are collapsed again
+    if (!mWideBVH.Update(mBVH, mBVHUpdater.GetModifiedNodes()))
+    {
+        RT_LOG_ERROR("Failed to update %u-wide BVH", RT_BVH_WIDTH);
+        mBVHUpdater.ClearModifiedNodes();
+        return false;
+    }
+#endif // RT_BVH_WIDTH > 2
+
+    // motion BVH has the same topology, so only the modified nodes are updated
+    bool result = true;
+    if (mMotionBVH.GetNumNodes() > 0)
+    {
+        const auto leafBoxesCallback = [this](Uint32 leafIndex, Box& outStartBox, Box& outEndBox)
+        {
+            const Uint32 objectID = mBVHUpdater.GetLeavesOrder()[leafIndex];
+            mObjects[objectID]->GetMotionBoundingBoxes(outStartBox, outEndBox);
+        };
+        mMotionBVH.Refit(mBVH, mBVHUpdater.GetModifiedNodes(), leafBoxesCallback);
+    }
+    else if (mBVHUpdater.ContainsLeaf(changedObjectID) && mObjects[changedObjectID]->IsMoving())
+    {
+        result = BuildMotionBVH();
+    }
+
+    mBVHUpdater.ClearModifiedNodes();
+    return result;
 }
 
-bool Scene::BuildBVH()
+bool Scene::BuildMotionBVH()
 {
-    for (const LightPtr& light : mLights)
+    // the tree topology is built for whole motion bounds, but traversal uses bounds interpolated for ray's time
+    const std::vector<Uint32>& leavesOrder = mBVHUpdater.GetLeavesOrder();
+    std::vector<Box, AlignmentAllocator<Box>> startBoxes(leavesOrder.size(), Box::Empty());
+    std::vector<Box, AlignmentAllocator<Box>> endBoxes(leavesOrder.size(), Box::Empty());
+    for (size_t i = 0; i < leavesOrder.size(); ++i)
     {
-        if (!light->IsDelta() && light->IsFinite())
+        // removed objects leave unused entries
+        if (leavesOrder[i] != BVHUpdater::InvalidIndex)
         {
-            mObjects.emplace_back(std::make_unique<LightSceneObject>(*light));
+            mObjects[leavesOrder[i]]->GetMotionBoundingBoxes(startBoxes[i], endBoxes[i]);
         }
     }
 
+    if (!mMotionBVH.Build(mBVH, startBoxes.data(), endBoxes.data()))
+    {
+        RT_LOG_ERROR("Failed to build motion BVH");
+        return false;
+    }
+
+    return true;
+}
+
+bool Scene::BuildBVH(bool fastBuild)
+{
+    for (; mNumLightObjects < mLights.size(); ++mNumLightObjects)
+    {
+        const ILight& light = *mLights[mNumLightObjects];
+        if (!light.IsDelta() && light.IsFinite())
+        {
+            mObjects.emplace_back(std::make_unique<LightSceneObject>(light));
+        }
+    }
+
+    // removed objects leave holes, so object IDs do not change
+    std::vector<Uint32> objectIDs;
     std::vector<Box, AlignmentAllocator<Box>> boxes;
-    for (const auto& obj : mObjects)
+    for (Uint32 i = 0; i < mObjects.size(); ++i)
     {
-        boxes.push_back(obj->GetBoundingBox());
+        if (mObjects[i])
+        {
+            objectIDs.push_back(i);
+            boxes.push_back(mObjects[i]->GetBoundingBox());
+        }
     }
 
     BVHBuilder::BuildingParams params;
-    params.maxLeafNodeSize = 2;
 
-    BVHBuilder::Indices newOrder;
+    // intersecting an object means transforming the ray and traversing the object's own BVH
+    params.intersectionCost = 4.0f;
+    params.nodesLayout = BVHBuilder::NodesLayout::VanEmdeBoas;
+
+    if (fastBuild)
+    {
+        params.splitAlgorithm = BVHBuilder::SplitAlgorithm::Linear;
+        params.agglomerativeTreeletSize = 64;
+    }
+
+    mIsBVHBuilt = false;
+#if RT_BVH_WIDTH > 2
+    mWideBVH.Clear();
+#endif // RT_BVH_WIDTH > 2
+    mMotionBVH.Clear();
+    mBVHUpdater.Clear();
+
+    BVHBuilder::Indices leavesOrder;
     BVHBuilder bvhBuilder(mBVH);
-    if (!bvhBuilder.Build(boxes.data(), (Uint32)mObjects.size(), params, newOrder))
+    if (!bvhBuilder.Build(boxes.data(), (Uint32)objectIDs.size(), params, leavesOrder))
     {
         return false;
     }
 
-    std::vector<SceneObjectPtr> newObjectsArray;
-    newObjectsArray.reserve(mObjects.size());
-    for (size_t i = 0; i < mObjects.size(); ++i)
+#if RT_BVH_WIDTH > 2
+    // the wide BVH follows incremental changes of the binary one
+    if (!mWideBVH.Build(mBVH, true))
+    {
+        RT_LOG_ERROR("Failed to build %u-wide BVH", RT_BVH_WIDTH);
+        return false;
+    }
+#endif // RT_BVH_WIDTH > 2
+
+    // BVH leaves reference object IDs
+    std::vector<Box, AlignmentAllocator<Box>> leafBoxes;
+    leafBoxes.reserve(leavesOrder.size());
+    for (Uint32& leaf : leavesOrder)
+    {
+        leafBoxes.push_back(boxes[leaf]);
+        leaf = objectIDs[leaf];
+    }
+
+    mBVHUpdater.Initialize(mBVH, leavesOrder, leafBoxes.data());
+    mIsBVHBuilt = true;
+
+    bool hasMovingObjects = false;
+    for (const Uint32 objectID : leavesOrder)
     {
-        Uint32 sourceIndex = newOrder[i];
-        newObjectsArray.push_back(std::move(mObjects[sourceIndex]));
+        hasMovingObjects |= mObjects[objectID]->IsMoving();
     }
 
-    mObjects = std::move(newObjectsArray);
+    if (hasMovingObjects)
+    {
+        return BuildMotionBVH();
+    }
 
     return true;
 }
@@ -133,7 +280,7 @@ void Scene::Traverse_Leaf_Single(const SingleTraversalContext& context, const Ui
 
     for (Uint32 i = 0; i < node.numLeaves; ++i)
     {
-        const Uint32 objectIndex = node.childIndex + i;
+        const Uint32 objectIndex = mBVHUpdater.GetLeavesOrder()[node.childIndex + i];
         Traverse_Object_Single(context, objectIndex);
     }
 }
@@ -142,7 +289,7 @@ bool Scene::Traverse_Leaf_Shadow_Single(const SingleTraversalContext& context, c
 {
     for (Uint32 i = 0; i < node.numLeaves; ++i)
     {
-        const Uint32 objectIndex = node.childIndex + i;
+        const Uint32 objectIndex = mBVHUpdater.GetLeavesOrder()[node.childIndex + i];
         if (Traverse_Object_Shadow_Single(context, objectIndex))
         {
             return true;
@@ -158,35 +305,67 @@ void Scene::Traverse_Leaf_Packet(const PacketTraversalContext& context, const Ui
 
     for (Uint32 i = 0; i < node.numLeaves; ++i)
     {
-        const Uint32 objectIndex = node.childIndex + i;
+        const Uint32 objectIndex = mBVHUpdater.GetLeavesOrder()[node.childIndex + i];
         const ISceneObject* object = mObjects[objectIndex].get();
-        const auto invTransform = object->ComputeInverseTransform(context.context.time);
 
-        // transform ray to local-space
-        for (Uint32 j = 0; j < numActiveGroups; ++j)
+        TransformPacketToLocalSpace(context, object, numActiveGroups);
+        object->Traverse_Packet(context, objectIndex, numActiveGroups);
+    }
+}
+
+void Scene::Traverse_Leaf_Shadow_Packet(const PacketTraversalContext& context, const BVH::Node& node, Uint32 numActiveGroups) const
+{
+    for (Uint32 i = 0; i < node.numLeaves; ++i)
+    {
+        const Uint32 objectIndex = mBVHUpdater.GetLeavesOrder()[node.childIndex + i];
+        const ISceneObject* object = mObjects[objectIndex].get();
+
+        TransformPacketToLocalSpace(context, object, numActiveGroups);
+        object->Traverse_Shadow_Packet(context, numActiveGroups);
+
+        if (context.context.numActiveShadowRays == 0)
         {
-            RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[j]];
-            rayGroup.rays[1].origin = invTransform.TransformPoint(rayGroup.rays[0].origin);
-            rayGroup.rays[1].dir = invTransform.TransformVector(rayGroup.rays[0].dir);
-            rayGroup.rays[1].invDir = Vector3x8::FastReciprocal(rayGroup.rays[1].dir);
+            // all rays are occluded
+            return;
         }
+    }
+}
 
-        object->Traverse_Packet(context, objectIndex, numActiveGroups);
+void Scene::TransformPacketToLocalSpace(const PacketTraversalContext& context, const ISceneObject* object, Uint32 numActiveGroups)
+{
+    const auto invTransform = object->ComputeInverseTransform(context.context.time);
+
+    for (Uint32 j = 0; j < numActiveGroups; ++j)
+    {
+        RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[j]];
+        rayGroup.rays[1].origin = invTransform.TransformPoint(rayGroup.rays[0].origin);
+        rayGroup.rays[1].dir = invTransform.TransformVector(rayGroup.rays[0].dir);
+        rayGroup.rays[1].invDir = Vector3x8::FastReciprocal(rayGroup.rays[1].dir);
     }
 }
 
 void Scene::Traverse_Single(const SingleTraversalContext& context) const
 {
-    size_t numObjects = mObjects.size();
-
-    if (numObjects == 0) // scene is empty
+    if (mBVH.GetNumNodes() == 0) // scene is empty
     {
         return;
     }
-    else if (numObjects == 1) // bypass BVH
+
+    const BVH::Node& root = mBVH.GetNodes()[0];
+    if (root.IsLeaf()) // bypass BVH
+    {
+        Traverse_Leaf_Single(context, 0, root);
+    }
+    else if (mMotionBVH.GetNumNodes() > 0)
+    {
+        GenericTraverse_Motion_Single(context, 0, this);
+    }
+#if RT_BVH_WIDTH > 2
+    else if (mWideBVH.GetNumNodes() > 0)
     {
-        Traverse_Object_Single(context, 0);
+        GenericTraverse_Wide_Single<Scene, RT_BVH_WIDTH>(context, 0, this);
     }
+#endif // RT_BVH_WIDTH > 2
     else // full BVH traversal
     {
         GenericTraverse_Single(context, 0, this);
@@ -195,16 +374,26 @@ void Scene::Traverse_Single(const SingleTraversalContext& context) const
 
 bool Scene::Traverse_Shadow_Single(const SingleTraversalContext& context) const
 {
-    size_t numObjects = mObjects.size();
-
-    if (numObjects == 0) // scene is empty
+    if (mBVH.GetNumNodes() == 0) // scene is empty
     {
         return false;
     }
-    else if (numObjects == 1) // bypass BVH
+
+    const BVH::Node& root = mBVH.GetNodes()[0];
+    if (root.IsLeaf()) // bypass BVH
+    {
+        return Traverse_Leaf_Shadow_Single(context, root);
+    }
+    else if (mMotionBVH.GetNumNodes() > 0)
     {
-        return Traverse_Object_Shadow_Single(context, 0);
+        return GenericTraverse_Motion_Shadow_Single(context, this);
     }
+#if RT_BVH_WIDTH > 2
+    else if (mWideBVH.GetNumNodes() > 0)
+    {
+        return GenericTraverse_Wide_Shadow_Single<Scene, RT_BVH_WIDTH>(context, this);
+    }
+#endif // RT_BVH_WIDTH > 2
     else // full BVH traversal
     {
         return GenericTraverse_Shadow_Single(context, this);
@@ -213,8 +402,6 @@ bool Scene::Traverse_Shadow_Single(const SingleTraversalContext& context) const
 
 void Scene::Traverse_Packet(const PacketTraversalContext& context) const
 {
-    size_t numObjects = mObjects.size();
-
     const Uint32 numRayGroups = context.ray.GetNumGroups();
     for (Uint32 i = 0; i < numRayGroups; ++i)
     {
@@ -222,34 +409,79 @@ void Scene::Traverse_Packet(const PacketTraversalContext& context) const
         context.context.activeGroupsIndices[i] = (Uint16)i;
     }
 
-    for (Uint32 i = 0; i < context.ray.numRays; ++i)
+    // lanes of the last group past numRays are traversed as well
+    for (Uint32 i = 0; i < numRayGroups * RayPacket::RaysPerGroup; ++i)
     {
         context.context.hitPoints[i].distance = FLT_MAX;
         context.context.hitPoints[i].objectId = UINT32_MAX;
     }
 
-    if (numObjects == 0) // scene is empty
+    if (mBVH.GetNumNodes() == 0) // scene is empty
     {
         return;
     }
-    else if (numObjects == 1) // bypass BVH
+
+    const BVH::Node& root = mBVH.GetNodes()[0];
+    if (root.IsLeaf()) // bypass BVH
+    {
+        Traverse_Leaf_Packet(context, 0, root, numRayGroups);
+    }
+    else if (mMotionBVH.GetNumNodes() > 0)
     {
-        const ISceneObject* object = mObjects.front().get();
-        const auto invTransform = object->ComputeInverseTransform(context.context.time);
+        GenericTraverse_Motion_Packet<Scene, 0>(context, 0, this, numRayGroups);
+    }
+#if RT_BVH_WIDTH > 2
+    else if (mWideBVH.GetNumNodes() > 0)
+    {
+        GenericTraverse_Wide_Packet<Scene, RT_BVH_WIDTH, 0>(context, 0, this, numRayGroups);
+    }
+#endif // RT_BVH_WIDTH > 2
+    else // full BVH traversal
+    {
+        GenericTraverse_Packet<Scene, 0>(context, 0, this, numRayGroups);
+    }
+}
 
-        for (Uint32 j = 0; j < numRayGroups; ++j)
-        {
-            RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[j]];
-            rayGroup.rays[1].origin = invTransform.TransformPoint(rayGroup.rays[0].origin);
-            rayGroup.rays[1].dir = invTransform.TransformVector(rayGroup.rays[0].dir);
-            rayGroup.rays[1].invDir = Vector3x8::FastReciprocal(rayGroup.rays[1].dir);
-        }
+void Scene::Traverse_Shadow_Packet(const PacketTraversalContext& context) const
+{
+    // max distances are given by the caller
+    const Uint32 numRayGroups = context.ray.GetNumGroups();
+    for (Uint32 i = 0; i < numRayGroups; ++i)
+    {
+        context.context.activeGroupsIndices[i] = (Uint16)i;
+    }
+
+    // lanes of the last group past numRays are traversed as well
+    for (Uint32 i = 0; i < numRayGroups * RayPacket::RaysPerGroup; ++i)
+    {
+        context.context.hitPoints[i].distance = FLT_MAX;
+    }
+
+    context.context.numActiveShadowRays = numRayGroups * RayPacket::RaysPerGroup;
+
+    if (mBVH.GetNumNodes() == 0) // scene is empty
+    {
+        return;
+    }
 
-        mObjects.front()->Traverse_Packet(context, 0, numRayGroups);
+    const BVH::Node& root = mBVH.GetNodes()[0];
+    if (root.IsLeaf()) // bypass BVH
+    {
+        Traverse_Leaf_Shadow_Packet(context, root, numRayGroups);
+    }
+    else if (mMotionBVH.GetNumNodes() > 0)
+    {
+        GenericTraverse_Motion_Shadow_Packet<Scene, 0>(context, this, numRayGroups);
+    }
+#if RT_BVH_WIDTH > 2
+    else if (mWideBVH.GetNumNodes() > 0)
+    {
+        GenericTraverse_Wide_Shadow_Packet<Scene, RT_BVH_WIDTH, 0>(context, this, numRayGroups);
     }
+#endif // RT_BVH_WIDTH > 2
     else // full BVH traversal
     {
-        GenericTraverse_Packet<Scene, 0>(context, 0, this, numRayGroups);
+        GenericTraverse_Shadow_Packet<Scene, 0>(context, this, numRayGroups);
     }
 }
 
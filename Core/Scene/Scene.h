@@ -5,6 +5,9 @@
 #include "../Color/Color.h"
 #include "../Traversal/HitPoint.h"
 #include "../BVH/BVH.h"
+#include "../BVH/WideBVH.h"
+#include "../BVH/MotionBVH.h"
+#include "../BVH/BVHUpdater.h"
 
 #include <vector>
 
@@ -45,11 +48,30 @@ public:
 
     void SetBackgroundLight(std::unique_ptr<BackgroundLight> light);
     void AddLight(LightPtr object);
-    void AddObject(SceneObjectPtr object);
 
-    bool BuildBVH();
+    // returns object ID, which stays valid until the object is removed
+    // if the BVH is already built, the object is inserted into it incrementally
+    Uint32 AddObject(SceneObjectPtr object);
+
+    // remove object from the scene and the BVH (other object IDs do not change)
+    void RemoveObject(Uint32 objectID);
+
+    // move object in the BVH after its transform or velocity was changed
+    // NOTE: the motion BVH is refitted and the wide BVH is collapsed again only along the changed path
+    bool UpdateObject(Uint32 objectID);
+
+    // fast build uses linear (Morton code) builder, which is meant for interactive changes of the scene
+    bool BuildBVH(bool fastBuild = false);
 
     RT_FORCE_INLINE const BVH& GetBVH() const { return mBVH; }
+
+    // empty if there are no moving objects
+    RT_FORCE_INLINE const MotionBVH& GetMotionBVH() const { return mMotionBVH; }
+
+#if RT_BVH_WIDTH > 2
+    RT_FORCE_INLINE const DefaultWideBVH& GetWideBVH() const { return mWideBVH; }
+#endif // RT_BVH_WIDTH > 2
+    // indexed with object ID (removed objects leave null entries)
     RT_FORCE_INLINE const std::vector<SceneObjectPtr>& GetObjects() const { return mObjects; }
     RT_FORCE_INLINE const std::vector<LightPtr>& GetLights() const { return mLights; }
     RT_FORCE_INLINE const BackgroundLight* GetBackgroundLight() const { return mBackground.get(); }
@@ -61,6 +83,10 @@ public:
     // cast shadow ray
     bool Traverse_Shadow_Single(const SingleTraversalContext& context) const;
 
+    // cast shadow rays, ray's max distance must be set in the packet
+    // hit point distance of occluded rays is set to the occluder distance (it stays FLT_MAX for visible rays)
+    void Traverse_Shadow_Packet(const PacketTraversalContext& context) const;
+
     void ExtractShadingData(const math::Vector4& rayOrigin, const math::Vector4& rayDir, const HitPoint& hitPoint, const float time, ShadingData& outShadingData) const;
 
     void TraceRay_Simd8(const math::Ray_Simd8& ray, RenderingContext& context, Color* outColors) const;
@@ -69,14 +95,24 @@ public:
     void Traverse_Leaf_Packet(const PacketTraversalContext& context, const Uint32 objectID, const BVH::Node& node, Uint32 numActiveGroups) const;
 
     bool Traverse_Leaf_Shadow_Single(const SingleTraversalContext& context, const BVH::Node& node) const;
+    void Traverse_Leaf_Shadow_Packet(const PacketTraversalContext& context, const BVH::Node& node, Uint32 numActiveGroups) const;
 
 private:
     Scene(const Scene&) = delete;
     Scene& operator = (const Scene&) = delete;
 
+    // apply incremental changes of the binary BVH to the wide and motion BVHs
+    // the changed object is needed to detect the first moving object
+    bool UpdateDerivedBVHs(Uint32 changedObjectID);
+
+    bool BuildMotionBVH();
+
     void Traverse_Object_Single(const SingleTraversalContext& context, const Uint32 objectID) const;
     bool Traverse_Object_Shadow_Single(const SingleTraversalContext& context, const Uint32 objectID) const;
 
+    // transform rays of active groups to object's local space (ray groups' rays[1])
+    static void TransformPacketToLocalSpace(const PacketTraversalContext& context, const ISceneObject* object, Uint32 numActiveGroups);
+
     std::vector<LightPtr> mLights;
     std::unique_ptr<BackgroundLight> mBackground;
 
@@ -84,6 +120,21 @@ private:
 
     // bounding volume hierarchy for scene object
     BVH mBVH;
+
+    // keeps the BVH leaves order (object IDs) and allows for incremental changes
+    BVHUpdater mBVHUpdater;
+    bool mIsBVHBuilt = false;
+
+    // number of lights already added as scene objects
+    size_t mNumLightObjects = 0;
+
+#if RT_BVH_WIDTH > 2
+    // collapsed BVH used for traversal
+    DefaultWideBVH mWideBVH;
+#endif // RT_BVH_WIDTH > 2
+
+    // the same tree with node bounds at the beginning and the end of a frame, used if any object moves
+    MotionBVH mMotionBVH;
 };
 
 } // namespace rt
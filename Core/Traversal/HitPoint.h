@@ -45,7 +45,7 @@ struct RT_ALIGN(32) HitPoint_Simd8
     math::VectorInt8 subObjectId;
 
     RT_FORCE_INLINE HitPoint_Simd8()
-        : distance(math::VECTOR8_MAX)
+        : distance(FLT_MAX)
         , objectId(RT_INVALID_OBJECT)
     {}
 
@@ -57,7 +57,7 @@ struct RT_ALIGN(32) RayPacket
         return (numRays + RaysPerGroup - 1) / RaysPerGroup;
     }
 
-    RT_FORCE_INLINE void PushRay(const math::Ray& ray, const math::Vector4& weight, const ImageLocationInfo& location)
+    RT_FORCE_INLINE void PushRay(const math::Ray& ray, const math::Vector4& weight, const ImageLocationInfo& location, const Float maxDistance = FLT_MAX)
     {
         RT_ASSERT(numRays < MaxRayPacketSize);
 
@@ -74,7 +74,7 @@ struct RT_ALIGN(32) RayPacket
         group.rays[0].invDir.x[rayIndex] = ray.invDir.x;
         group.rays[0].invDir.y[rayIndex] = ray.invDir.y;
         group.rays[0].invDir.z[rayIndex] = ray.invDir.z;
-        group.maxDistances[rayIndex] = FLT_MAX;
+        group.maxDistances[rayIndex] = maxDistance;
         group.rayOffsets[rayIndex] = numRays;
 
         rayWeights[groupIndex].x[rayIndex] = weight.x;
@@ -93,7 +93,7 @@ struct RT_ALIGN(32) RayPacket
 
         RayGroup& group = groups[numRays / RaysPerGroup];
         group.rays[0] = rays;
-        group.maxDistances = math::VECTOR8_MAX;
+        group.maxDistances = math::Vector8(FLT_MAX);
         group.rayOffsets = math::VectorInt8(numRays) + math::VectorInt8(0, 1, 2, 3, 4, 5, 6, 7);
 
         rayWeights[numRays / RaysPerGroup] = weights;
@@ -104,6 +104,40 @@ struct RT_ALIGN(32) RayPacket
         numRays += RaysPerGroup;
     }
 
+    // fill unused lanes of the last ray group with copies of the last ray, so whole groups can be traversed
+    // (results of these lanes are written past numRays and should be ignored)
+    RT_FORCE_INLINE void FillLastGroup()
+    {
+        if (numRays % RaysPerGroup == 0)
+        {
+            return;
+        }
+
+        const Uint32 groupIndex = numRays / RaysPerGroup;
+        const Uint32 lastRayIndex = numRays % RaysPerGroup - 1;
+
+        RayGroup& group = groups[groupIndex];
+        math::Ray_Simd8& rays = group.rays[0];
+        for (Uint32 i = lastRayIndex + 1; i < RaysPerGroup; ++i)
+        {
+            rays.dir.x[i] = rays.dir.x[lastRayIndex];
+            rays.dir.y[i] = rays.dir.y[lastRayIndex];
+            rays.dir.z[i] = rays.dir.z[lastRayIndex];
+            rays.origin.x[i] = rays.origin.x[lastRayIndex];
+            rays.origin.y[i] = rays.origin.y[lastRayIndex];
+            rays.origin.z[i] = rays.origin.z[lastRayIndex];
+            rays.invDir.x[i] = rays.invDir.x[lastRayIndex];
+            rays.invDir.y[i] = rays.invDir.y[lastRayIndex];
+            rays.invDir.z[i] = rays.invDir.z[lastRayIndex];
+            group.maxDistances[i] = group.maxDistances[lastRayIndex];
+            group.rayOffsets[i] = groupIndex * RaysPerGroup + i;
+
+            rayWeights[groupIndex].x[i] = 0.0f;
+            rayWeights[groupIndex].y[i] = 0.0f;
+            rayWeights[groupIndex].z[i] = 0.0f;
+        }
+    }
+
     RT_FORCE_INLINE void Clear()
     {
         numRays = 0;
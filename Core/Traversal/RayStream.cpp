@@ -1,10 +1,95 @@
 #include "PCH.h"
 #include "RayStream.h"
+#include "Math/Morton.h"
+#include "Utils/RadixSort.h"
 
 namespace rt {
 
+using namespace math;
+
+namespace {
+
+// number of direction cells along each axis of a cube-map face
+const Uint32 DirectionGridBits = 2;
+const Uint32 DirectionGridSize = 1u << DirectionGridBits;
+
+// number of origin cells along each axis of the origins' bounding box
+const Uint32 OriginGridBits = 3;
+const Uint32 OriginGridSize = 1u << OriginGridBits;
+
+// sort key layout (from the most significant bits): octant, cube-map face, face cell, origin cell
+const Uint32 OriginKeyBits = 3 * OriginGridBits;
+const Uint32 DirectionKeyBits = 2 + 2 * DirectionGridBits;
+const Uint32 SortKeyBits = 3 + DirectionKeyBits + OriginKeyBits;
+
+// sign bits are used (the same way as in Ray::GetOctant), so negative zeros are consistent with reciprocals
+RT_FORCE_INLINE Uint32 GetDirectionOctant(const Float3& dir)
+{
+    return (std::signbit(dir.x) ? 1u : 0u) | (std::signbit(dir.y) ? 2u : 0u) | (std::signbit(dir.z) ? 4u : 0u);
+}
+
+// cube-map face (dominant axis) and grid cell of a direction, the octant determines the sign
+Uint32 GetDirectionCell(const Vector4& dir)
+{
+    const Float absDir[3] = { fabsf(dir.x), fabsf(dir.y), fabsf(dir.z) };
+
+    Uint32 axis = 0;
+    for (Uint32 i = 1; i < 3; ++i)
+    {
+        if (absDir[i] > absDir[axis])
+        {
+            axis = i;
+        }
+    }
+
+    if (absDir[axis] <= 0.0f)
+    {
+        return 0;
+    }
+
+    const Float scale = static_cast<Float>(DirectionGridSize) / absDir[axis];
+    const Uint32 u = std::min(static_cast<Uint32>(absDir[(axis + 1) % 3] * scale), DirectionGridSize - 1);
+    const Uint32 v = std::min(static_cast<Uint32>(absDir[(axis + 2) % 3] * scale), DirectionGridSize - 1);
+    return (axis << (2 * DirectionGridBits)) | (u << DirectionGridBits) | v;
+}
+
+} // namespace
+
+void RaySorter::SetOriginsBox(const Box& box)
+{
+    const Vector4 extent = box.max - box.min;
+    const Float gridSize = static_cast<Float>(OriginGridSize);
+
+    mOriginsMin = box.min;
+    mOriginScale = Vector4(
+        extent.x > 0.0f ? gridSize / extent.x : 0.0f,
+        extent.y > 0.0f ? gridSize / extent.y : 0.0f,
+        extent.z > 0.0f ? gridSize / extent.z : 0.0f,
+        0.0f);
+}
+
+Uint64 RaySorter::CalculateSortKey(const Vector4& origin, const Vector4& dir) const
+{
+    const Vector4 coords = (origin - mOriginsMin) * mOriginScale;
+    const Uint32 x = std::min(static_cast<Uint32>(coords.x), OriginGridSize - 1);
+    const Uint32 y = std::min(static_cast<Uint32>(coords.y), OriginGridSize - 1);
+    const Uint32 z = std::min(static_cast<Uint32>(coords.z), OriginGridSize - 1);
+    const Uint32 originCell = EncodeMorton30(x, y, z);
+
+    // sign bits are used (the same way as in Ray::GetOctant)
+    const Uint32 octant = static_cast<Uint32>(dir.GetSignMask()) & 0x7u;
+    const Uint32 directionKey = (octant << DirectionKeyBits) | GetDirectionCell(dir);
+    return (static_cast<Uint64>(directionKey) << OriginKeyBits) | originCell;
+}
+
+void RaySorter::SortKeys()
+{
+    // stable, so rays within a cell keep their order
+    RadixSort(mSortKeys, mSortedIndices, SortKeyBits);
+}
+
 RayStream::RayStream()
-    : mNumRays(0)
+    : mNumPoppedRays(0)
 {
 }
 
@@ -12,37 +97,84 @@ RayStream::~RayStream() = default;
 
 void RayStream::PushRay(const math::Ray& ray, const math::Vector4& weight, const ImageLocationInfo& imageLocation)
 {
-    RT_ASSERT(mNumRays < MaxRays);
+    RT_ASSERT(GetNumRays() < MaxRays);
 
-    PendingRay& pendingRay = mRays[mNumRays];
+    PendingRay pendingRay;
     pendingRay.rayWeight = weight;
-    pendingRay.rayDir = ray.dir.ToFloat3();
-    pendingRay.rayOrigin = ray.origin.ToFloat3();
+    pendingRay.dir = ray.dir.ToFloat3();
+    pendingRay.origin = ray.origin.ToFloat3();
     pendingRay.imageLocation = imageLocation;
 
-    mNumRays++;
+    mRays.push_back(pendingRay);
+}
+
+Uint32 RayStream::GetNumRays() const
+{
+    return static_cast<Uint32>(mRays.size() + mSortedRays.size()) - mNumPoppedRays;
+}
+
+void RayStream::Clear()
+{
+    mRays.clear();
+    mSortedRays.clear();
+    mNumPoppedRays = 0;
 }
 
 void RayStream::Sort()
 {
-    // TODO sort rays by position (median axis split partitioning) - O(N log N) or can be better?
-    // TODO sort rays by direction (map ray direction to cube-map grids) - O(N)
+    // rays not popped yet are sorted again along with the new ones
+    mRays.insert(mRays.end(), mSortedRays.begin() + mNumPoppedRays, mSortedRays.end());
+    mSortedRays.clear();
+    mNumPoppedRays = 0;
+
+    const Uint32 numRays = static_cast<Uint32>(mRays.size());
+    if (numRays == 0)
+    {
+        return;
+    }
+
+    // rays within a cell keep the order they were pushed in
+    const std::vector<Uint32>& sortedIndices = mSorter.Sort(numRays, [this](Uint32 i) -> const PendingRay& { return mRays[i]; });
+
+    mSortedRays.resize(numRays);
+    for (Uint32 i = 0; i < numRays; ++i)
+    {
+        mSortedRays[i] = mRays[sortedIndices[i]];
+    }
+
+    mRays.clear();
 }
 
 bool RayStream::PopPacket(RayPacket& outPacket)
 {
-    if (mNumRays == 0)
+    const Uint32 numSortedRays = static_cast<Uint32>(mSortedRays.size());
+    if (mNumPoppedRays == numSortedRays)
     {
         return false;
     }
 
-    Uint32 numRaysInPacket = math::Min(mNumRays, MaxRayPacketSize);
-    Uint32 numRayGroups = math::RoundUp(numRaysInPacket, RayPacket::RaysPerGroup) / RayPacket::RaysPerGroup;
+    outPacket.Clear();
+
+    const Uint32 octant = GetDirectionOctant(mSortedRays[mNumPoppedRays].dir);
+    while (mNumPoppedRays < numSortedRays && outPacket.numRays < MaxRayPacketSize)
+    {
+        const PendingRay& ray = mSortedRays[mNumPoppedRays];
+        if (GetDirectionOctant(ray.dir) != octant)
+        {
+            break;
+        }
+
+        outPacket.PushRay(Ray(Vector4(ray.origin), Vector4(ray.dir)), ray.rayWeight, ray.imageLocation);
+        mNumPoppedRays++;
+    }
+
+    outPacket.FillLastGroup();
 
-    // TODO
-    (void)outPacket;
-    (void)numRaysInPacket;
-    (void)numRayGroups;
+    if (mNumPoppedRays == numSortedRays)
+    {
+        mSortedRays.clear();
+        mNumPoppedRays = 0;
+    }
 
     return true;
 }
@@ -1,14 +1,64 @@
 #pragma once
 
 #include "RayPacket.h"
+#include "../Math/Box.h"
+#include "../Utils/AlignmentAllocator.h"
+
+#include <vector>
 
 
 namespace rt {
 
+// Calculates coherent order of rays:
+// by direction octant, then by direction (cube-map grid cell) and then by origin
+// (grid cell within bounds of all the origins), using O(N) radix sort of the quantized keys.
+class RAYLIB_API RaySorter
+{
+public:
+    // "getRay" returns ray-like structure (with "origin" and "dir" members) for a given index
+    // the order is stable, returned indices are valid until the next call
+    template<typename GetRayFunc>
+    const std::vector<Uint32>& Sort(Uint32 numRays, const GetRayFunc& getRay);
+
+private:
+    void SetOriginsBox(const math::Box& box);
+    Uint64 CalculateSortKey(const math::Vector4& origin, const math::Vector4& dir) const;
+    void SortKeys();
+
+    math::Vector4 mOriginsMin;
+    math::Vector4 mOriginScale;
+
+    std::vector<Uint64> mSortKeys;
+    std::vector<Uint32> mSortedIndices;
+};
+
+template<typename GetRayFunc>
+const std::vector<Uint32>& RaySorter::Sort(Uint32 numRays, const GetRayFunc& getRay)
+{
+    math::Box originsBox = math::Box::Empty();
+    for (Uint32 i = 0; i < numRays; ++i)
+    {
+        originsBox.AddPoint(math::Vector4(getRay(i).origin));
+    }
+    SetOriginsBox(originsBox);
+
+    mSortKeys.resize(numRays);
+    mSortedIndices.resize(numRays);
+    for (Uint32 i = 0; i < numRays; ++i)
+    {
+        const auto& ray = getRay(i);
+        mSortKeys[i] = CalculateSortKey(math::Vector4(ray.origin), math::Vector4(ray.dir));
+        mSortedIndices[i] = i;
+    }
+
+    SortKeys();
+    return mSortedIndices;
+}
+
 
 // Ray stream - generator of ray packets
 // Push incoherent rays, pops coherent ray packets
-class RayStream
+class RAYLIB_API RayStream
 {
 public:
     static constexpr Uint32 MaxRays = 1024 * 1024;
@@ -21,25 +71,37 @@ public:
 
     // Convert collected rays into ray packets.
     // This will flush all the pushed rays and generate list of fresh ray packets
+    // Rays are sorted for coherence (see RaySorter).
     void Sort();
 
     // Pop generated packet
     // If there's no packets pending the function returns false
-    // Note: ray stream keeps the packet ownership
+    // Each packet contains rays of a single direction octant, unused lanes of the last ray group
+    // are filled with copies of the last ray.
     bool PopPacket(RayPacket& outPacket);
 
+    // number of rays pushed or not popped yet
+    Uint32 GetNumRays() const;
+
+    void Clear();
+
 private:
 
     struct PendingRay
     {
         math::Vector4 rayWeight;
-        math::Float3 rayOrigin;
-        math::Float3 rayDir;
+        math::Float3 origin;
+        math::Float3 dir;
         ImageLocationInfo imageLocation;
     };
 
-    Uint32 mNumRays;
-    PendingRay mRays[MaxRays];
+    using PendingRays = std::vector<PendingRay, AlignmentAllocator<PendingRay>>;
+
+    PendingRays mRays;          // pushed rays
+    PendingRays mSortedRays;    // rays waiting for PopPacket
+    Uint32 mNumPoppedRays;
+
+    RaySorter mSorter;
 };
 
 
@@ -31,4 +31,28 @@ void PacketTraversalContext::StoreIntersection(RayGroup& rayGroup, const Vector8
     }
 }
 
+bool PacketTraversalContext::StoreOcclusion(RayGroup& rayGroup, const Vector8& t, const VectorBool8& mask) const
+{
+    const int intMask = mask.GetMask();
+
+    if (intMask)
+    {
+        // occluded rays fail all further box and primitive tests, so they drop out of the active rays mask
+        rayGroup.maxDistances = Vector8::Select(rayGroup.maxDistances, -VECTOR8_INF, mask);
+
+        for (Uint32 k = 0; k < 8; ++k)
+        {
+            if ((intMask >> k) & 1)
+            {
+                context.hitPoints[rayGroup.rayOffsets[k]].distance = t[k];
+            }
+        }
+
+        RT_ASSERT(context.numActiveShadowRays >= PopCount(intMask));
+        context.numActiveShadowRays -= PopCount(intMask);
+    }
+
+    return context.numActiveShadowRays == 0;
+}
+
 } // namespace rt
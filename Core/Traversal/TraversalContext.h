@@ -31,6 +31,10 @@ struct PacketTraversalContext
     RenderingContext& context;
 
     void StoreIntersection(RayGroup& rayGroup, const math::Vector8& t, const math::VectorBool8& mask, Uint32 objectID, Uint32 subObjectID = 0) const;
+
+    // mark shadow rays as occluded and retire them from further traversal
+    // returns true if all rays of the packet are occluded
+    bool StoreOcclusion(RayGroup& rayGroup, const math::Vector8& t, const math::VectorBool8& mask) const;
 };
 
 } // namespace rt
@@ -1,5 +1,7 @@
 #include "PCH.h"
 #include "Traversal_Packet.h"
+#include "Traversal_PacketKernels.h"
+#include "Utils/CpuFeatures.h"
 
 namespace rt {
 
@@ -55,110 +57,235 @@ Uint32 RemoveMissedGroups(RenderingContext& context, Uint32 numGroups)
     }
 }
 
-// TODO this is ugly AF, but actually works
-static void SwapRays(RenderingContext& context, Uint32 a, Uint32 b, Uint32 traversalDepth)
+namespace {
+
+// all the per-lane data of a ray group, treated as raw vectors, so lanes can be moved with bitwise operations
+constexpr Uint32 NumGroupVectors = sizeof(RayGroup) / sizeof(Vector8);
+static_assert(sizeof(RayGroup) == NumGroupVectors * sizeof(Vector8), "Ray group must consist of 8-wide vectors only");
+
+// for each lanes mask: indices of the set lanes followed by indices of the cleared lanes
+struct CompactionPermutations
 {
-    RayGroup& groupA = context.rayPacket.groups[context.activeGroupsIndices[a / RayPacket::RaysPerGroup]];
-    RayGroup& groupB = context.rayPacket.groups[context.activeGroupsIndices[b / RayPacket::RaysPerGroup]];
+    VectorInt8 indices[256];
+
+    CompactionPermutations()
+    {
+        for (Uint32 mask = 0; mask < 256; ++mask)
+        {
+            Int32 lanes[RayPacket::RaysPerGroup];
+            Uint32 numLanes = 0;
+            for (Uint32 lane = 0; lane < RayPacket::RaysPerGroup; ++lane)
+            {
+                if (mask & (1u << lane))
+                {
+                    lanes[numLanes++] = lane;
+                }
+            }
+            for (Uint32 lane = 0; lane < RayPacket::RaysPerGroup; ++lane)
+            {
+                if (!(mask & (1u << lane)))
+                {
+                    lanes[numLanes++] = lane;
+                }
+            }
 
-    std::swap(groupA.rays[traversalDepth].dir.x[a % 8], groupB.rays[traversalDepth].dir.x[b % RayPacket::RaysPerGroup]);
-    std::swap(groupA.rays[traversalDepth].dir.y[a % 8], groupB.rays[traversalDepth].dir.y[b % RayPacket::RaysPerGroup]);
-    std::swap(groupA.rays[traversalDepth].dir.z[a % 8], groupB.rays[traversalDepth].dir.z[b % RayPacket::RaysPerGroup]);
+            indices[mask] = VectorInt8(lanes[0], lanes[1], lanes[2], lanes[3], lanes[4], lanes[5], lanes[6], lanes[7]);
+        }
+    }
+};
 
-    std::swap(groupA.rays[traversalDepth].origin.x[a % 8], groupB.rays[traversalDepth].origin.x[b % RayPacket::RaysPerGroup]);
-    std::swap(groupA.rays[traversalDepth].origin.y[a % 8], groupB.rays[traversalDepth].origin.y[b % RayPacket::RaysPerGroup]);
-    std::swap(groupA.rays[traversalDepth].origin.z[a % 8], groupB.rays[traversalDepth].origin.z[b % RayPacket::RaysPerGroup]);
+const CompactionPermutations gCompactionPermutations;
 
-    std::swap(groupA.rays[traversalDepth].invDir.x[a % 8], groupB.rays[traversalDepth].invDir.x[b % RayPacket::RaysPerGroup]);
-    std::swap(groupA.rays[traversalDepth].invDir.y[a % 8], groupB.rays[traversalDepth].invDir.y[b % RayPacket::RaysPerGroup]);
-    std::swap(groupA.rays[traversalDepth].invDir.z[a % 8], groupB.rays[traversalDepth].invDir.z[b % RayPacket::RaysPerGroup]);
+// move active lanes of a group to the front
+RT_FORCE_INLINE void CompressGroup(RayPacket& packet, Uint32 groupIndex, Uint8 activeMask)
+{
+    const VectorInt8 indices = gCompactionPermutations.indices[activeMask];
 
-    std::swap(groupA.maxDistances[a % 8], groupB.maxDistances[b % 8]);
+    Vector8* data = reinterpret_cast<Vector8*>(packet.groups + groupIndex);
+    for (Uint32 i = 0; i < NumGroupVectors; ++i)
+    {
+        data[i] = VectorInt8::Permute(data[i], indices);
+    }
 
-    std::swap(groupA.rayOffsets[a % 8], groupB.rayOffsets[b % 8]);
+    Vector3x8& weights = packet.rayWeights[groupIndex];
+    weights.x = VectorInt8::Permute(weights.x, indices);
+    weights.y = VectorInt8::Permute(weights.y, indices);
+    weights.z = VectorInt8::Permute(weights.z, indices);
 }
 
-static void SwapBits(Uint8& a, Uint8& b, Uint32 indexA, Uint32 indexB)
+// fill lanes of group "a" past its first "count" active lanes with leading lanes of group "b",
+// remaining active lanes of "b" are moved to its front
+RT_FORCE_INLINE void MergeGroups(RayPacket& packet, Uint32 groupIndexA, Uint32 groupIndexB, Uint32 count)
 {
-    const Uint8 bitA = (a >> indexA) & 1;
-    const Uint8 bitB = (b >> indexB) & 1;
-    a ^= (-bitB ^ a) & (1UL << indexA);
-    b ^= (-bitA ^ b) & (1UL << indexB);
+    const VectorInt8 laneIndices(0, 1, 2, 3, 4, 5, 6, 7);
+    const VectorInt8 rotation = (laneIndices - static_cast<Int32>(count)) & VectorInt8(7);
+    const VectorBool8 keepA = laneIndices.ConvertToFloat() < Vector8(static_cast<Float>(count));
+
+    const auto exchange = [&](Vector8& a, Vector8& b)
+    {
+        const Vector8 rotatedB = VectorInt8::Permute(b, rotation);
+        b = Vector8::Select(a, rotatedB, keepA);
+        a = Vector8::Select(rotatedB, a, keepA);
+    };
+
+    Vector8* dataA = reinterpret_cast<Vector8*>(packet.groups + groupIndexA);
+    Vector8* dataB = reinterpret_cast<Vector8*>(packet.groups + groupIndexB);
+    for (Uint32 i = 0; i < NumGroupVectors; ++i)
+    {
+        exchange(dataA[i], dataB[i]);
+    }
+
+    Vector3x8& weightsA = packet.rayWeights[groupIndexA];
+    Vector3x8& weightsB = packet.rayWeights[groupIndexB];
+    exchange(weightsA.x, weightsB.x);
+    exchange(weightsA.y, weightsB.y);
+    exchange(weightsA.z, weightsB.z);
 }
 
-void ReorderRays(RenderingContext& context, Uint32 numGroups, Uint32 traversalDepth)
+} // namespace
+
+Uint32 ReorderRays(RenderingContext& context, Uint32 numGroups)
 {
-    Uint32 numRays = numGroups * RayPacket::RaysPerGroup;
-    Uint32 i = 0;
-    while (i < numRays)
+    RayPacket& packet = context.rayPacket;
+    Uint16* groupsIndices = context.activeGroupsIndices;
+
+    // groups at positions [0, numFullGroups) are filled with active rays,
+    // the group at position numFullGroups holds numPendingRays active rays at its front,
+    // the rest of processed groups hold inactive rays only
+    Uint32 numFullGroups = 0;
+    Uint32 numPendingRays = 0;
+
+    for (Uint32 i = 0; i < numGroups; ++i)
     {
-        const Uint32 groupIndex = i / RayPacket::RaysPerGroup;
-        const Uint32 rayIndex = i % RayPacket::RaysPerGroup;
+        const Uint8 activeMask = context.activeRaysMask[i];
+        if (activeMask == 0)
+        {
+            continue;
+        }
 
-        if (context.activeRaysMask[groupIndex] & (1 << rayIndex))
+        const Uint32 numRays = PopCount(activeMask);
+        if (activeMask != (1u << numRays) - 1u)
         {
-            i++;
+            CompressGroup(packet, groupsIndices[i], activeMask);
+        }
+
+        if (numPendingRays == 0)
+        {
+            std::swap(groupsIndices[numFullGroups], groupsIndices[i]);
+            numPendingRays = numRays;
         }
         else
         {
-            numRays--;
-            SwapRays(context, i, numRays, traversalDepth);
-            SwapBits(context.activeRaysMask[i / 8], context.activeRaysMask[numRays / 8], i % 8, numRays % 8);
+            MergeGroups(packet, groupsIndices[numFullGroups], groupsIndices[i], numPendingRays);
+            numPendingRays += numRays;
+
+            if (numPendingRays > RayPacket::RaysPerGroup)
+            {
+                // leftover rays start a new group
+                numFullGroups++;
+                numPendingRays -= RayPacket::RaysPerGroup;
+                std::swap(groupsIndices[numFullGroups], groupsIndices[i]);
+            }
+        }
+
+        if (numPendingRays == RayPacket::RaysPerGroup)
+        {
+            numFullGroups++;
+            numPendingRays = 0;
         }
     }
+
+    return numFullGroups + (numPendingRays > 0 ? 1 : 0);
 }
 
-Uint32 TestRayPacket(RayPacket& packet, Uint32 numGroups, const BVH::Node& node, RenderingContext& context, Uint32 traversalDepth)
+Uint32 TestRayPacket(RayPacket& packet, Uint32 numGroups, const math::Box_Simd8& box, RenderingContext& context, Uint32 traversalDepth, Uint32 rayOctant)
 {
-    Vector8 distance;
+#ifdef RT_ENABLE_AVX512_KERNELS
+    if (GetKernelInstructionSet() == InstructionSet::AVX512)
+    {
+        return TestRayPacket_AVX512(packet, numGroups, box, context, traversalDepth, rayOctant);
+    }
+#endif // RT_ENABLE_AVX512_KERNELS
 
-    Uint32 raysHit = 0;
-    Uint32 i = 0;
+    if (GetKernelInstructionSet() == InstructionSet::AVX2)
+    {
+        return TestRayPacket_AVX2(packet, numGroups, box, context, traversalDepth, rayOctant);
+    }
 
-    const math::Box_Simd8 box = node.GetBox_Simd8();
+    return TestRayPacket_Generic(packet, numGroups, box, context, traversalDepth, rayOctant);
+}
 
-    // unrolled version of the loop below
-    while (i + 4 <= numGroups)
-    {
-        const RayGroup& rayGroupA = packet.groups[context.activeGroupsIndices[i + 0]];
-        const RayGroup& rayGroupB = packet.groups[context.activeGroupsIndices[i + 1]];
-        const RayGroup& rayGroupC = packet.groups[context.activeGroupsIndices[i + 2]];
-        const RayGroup& rayGroupD = packet.groups[context.activeGroupsIndices[i + 3]];
+void BuildRayPacketFrustum(const RenderingContext& context, const RayPacket& packet, Uint32 numGroups, Uint32 traversalDepth, Uint32 rayOctant,
+                           RayPacketFrustum& outFrustum)
+{
+    outFrustum.isValid = false;
 
-        const Vector3x8 rayOriginDivDirA = rayGroupA.rays[traversalDepth].origin * rayGroupA.rays[traversalDepth].invDir;
-        const Vector3x8 rayOriginDivDirB = rayGroupB.rays[traversalDepth].origin * rayGroupB.rays[traversalDepth].invDir;
-        const Vector3x8 rayOriginDivDirC = rayGroupC.rays[traversalDepth].origin * rayGroupC.rays[traversalDepth].invDir;
-        const Vector3x8 rayOriginDivDirD = rayGroupD.rays[traversalDepth].origin * rayGroupD.rays[traversalDepth].invDir;
-        
-        const Vector8 maskA = Intersect_BoxRay_Simd8(rayGroupA.rays[traversalDepth].invDir, rayOriginDivDirA, box, rayGroupA.maxDistances, distance);
-        const Vector8 maskB = Intersect_BoxRay_Simd8(rayGroupB.rays[traversalDepth].invDir, rayOriginDivDirB, box, rayGroupB.maxDistances, distance);
-        const Vector8 maskC = Intersect_BoxRay_Simd8(rayGroupC.rays[traversalDepth].invDir, rayOriginDivDirC, box, rayGroupC.maxDistances, distance);
-        const Vector8 maskD = Intersect_BoxRay_Simd8(rayGroupD.rays[traversalDepth].invDir, rayOriginDivDirD, box, rayGroupD.maxDistances, distance);
+    if (rayOctant == MixedRayOctant || numGroups < RayPacketFrustum::MinNumGroups)
+    {
+        return;
+    }
 
-        const Uint32 intMaskA = maskA.GetSignMask();
-        const Uint32 intMaskB = maskB.GetSignMask();
-        const Uint32 intMaskC = maskC.GetSignMask();
-        const Uint32 intMaskD = maskD.GetSignMask();
+    Vector3x8 originMin(VECTOR8_MAX), originMax(-VECTOR8_MAX);
+    Vector3x8 invDirMin(VECTOR8_MAX), invDirMax(-VECTOR8_MAX);
+    Vector8 maxDistance(-VECTOR8_MAX);
 
-        const Uint32 intMaskCombined = (intMaskA | (intMaskB << 8u)) | ((intMaskC << 16u) | (intMaskD << 24u));
-        *reinterpret_cast<Uint32*>(context.activeRaysMask + i) = intMaskCombined;
-        raysHit += PopCount(intMaskCombined);
+    for (Uint32 i = 0; i < numGroups; ++i)
+    {
+        const RayGroup& rayGroup = packet.groups[context.activeGroupsIndices[i]];
+        const Ray_Simd8& rays = rayGroup.rays[traversalDepth];
 
-        i += 4;
+        originMin = Vector3x8::Min(originMin, rays.origin);
+        originMax = Vector3x8::Max(originMax, rays.origin);
+        invDirMin = Vector3x8::Min(invDirMin, rays.invDir);
+        invDirMax = Vector3x8::Max(invDirMax, rays.invDir);
+        maxDistance = Vector8::Max(maxDistance, rayGroup.maxDistances);
     }
 
-    for (; i < numGroups; ++i)
+    const auto reduceMin = [](const Vector3x8& v)
     {
-        const RayGroup& rayGroup = packet.groups[context.activeGroupsIndices[i]];
-        const Vector3x8 rayOriginDivDir = rayGroup.rays[traversalDepth].origin * rayGroup.rays[traversalDepth].invDir;
+        return Vector4(-(-v.x).HorizontalMax()[0], -(-v.y).HorizontalMax()[0], -(-v.z).HorizontalMax()[0], 0.0f);
+    };
+
+    const auto reduceMax = [](const Vector3x8& v)
+    {
+        return Vector4(v.x.HorizontalMax()[0], v.y.HorizontalMax()[0], v.z.HorizontalMax()[0], 0.0f);
+    };
 
-        const Vector8 mask = Intersect_BoxRay_Simd8(rayGroup.rays[traversalDepth].invDir, rayOriginDivDir, box, rayGroup.maxDistances, distance);
-        const Uint32 intMask = mask.GetSignMask();
-        context.activeRaysMask[i] = (Uint8)intMask;
-        raysHit += PopCount(intMask);
+    outFrustum.originMin = reduceMin(originMin);
+    outFrustum.originMax = reduceMax(originMax);
+    outFrustum.invDirMin = reduceMin(invDirMin);
+    outFrustum.invDirMax = reduceMax(invDirMax);
+    outFrustum.maxDistance = maxDistance.HorizontalMax()[0];
+
+    // interval products are not defined for infinite reciprocals (rays parallel to an axis)
+    const Vector4 invDirAbsMax = Vector4::Max(Vector4::Abs(outFrustum.invDirMin), Vector4::Abs(outFrustum.invDirMax));
+    outFrustum.isValid = (invDirAbsMax < Vector4(FLT_MAX)).All() && outFrustum.originMin.IsValid() && outFrustum.originMax.IsValid();
+}
+
+void SortGroupsByOctant(const RenderingContext& context, const RayPacket& packet, Uint32 numGroups, Uint32 traversalDepth,
+                        Uint16* outSortedIndices, Uint32* outOctantOffsets)
+{
+    Uint8 groupOctants[RayPacket::MaxNumGroups];
+    Uint32 counts[MixedRayOctant + 1] = { 0 };
+
+    for (Uint32 i = 0; i < numGroups; ++i)
+    {
+        const Uint32 octant = packet.groups[context.activeGroupsIndices[i]].rays[traversalDepth].GetOctant();
+        groupOctants[i] = static_cast<Uint8>(octant < MixedRayOctant ? octant : MixedRayOctant);
+        counts[groupOctants[i]]++;
     }
 
-    return raysHit;
+    outOctantOffsets[0] = 0;
+    for (Uint32 octant = 0; octant <= MixedRayOctant; ++octant)
+    {
+        outOctantOffsets[octant + 1] = outOctantOffsets[octant] + counts[octant];
+        counts[octant] = outOctantOffsets[octant];
+    }
+
+    for (Uint32 i = 0; i < numGroups; ++i)
+    {
+        outSortedIndices[counts[groupOctants[i]]++] = context.activeGroupsIndices[i];
+    }
 }
 
 } // namespace rt
@@ -3,15 +3,17 @@
 #include "RayPacket.h"
 #include "HitPoint.h"
 #include "TraversalContext.h"
+#include "Traversal_Simd.h"
 #include "Math/Ray.h"
 #include "BVH/BVH.h"
+#include "BVH/WideBVH.h"
+#include "BVH/MotionBVH.h"
 #include "Math/Geometry.h"
 #include "Math/Simd8Geometry.h"
 #include "Utils/iacaMarks.h"
 #include "Rendering/Counters.h"
 #include "Rendering/Context.h"
 
-#define RT_NO_RAY_REORDERING
 
 namespace rt {
 
@@ -20,14 +22,249 @@ struct RenderingContext;
 // remove groups where all rays missed a bounding box
 RT_FORCE_NOINLINE Uint32 RemoveMissedGroups(RenderingContext& context, Uint32 numGroups);
 
-// reorder rays to restore coherency
-RT_FORCE_NOINLINE void ReorderRays(RenderingContext& context, Uint32 numRays, Uint32 traversalDepth);
+// move active rays (see activeRaysMask) of active groups to the front groups, so the groups are fully utilized
+// all the per-ray data is moved (rays of all traversal depths, max distances, offsets and weights)
+// returns number of groups holding the active rays
+RT_FORCE_NOINLINE Uint32 ReorderRays(RenderingContext& context, Uint32 numGroups);
 
-// test all alive groups in a packet agains a BVH node
-RT_FORCE_NOINLINE Uint32 TestRayPacket(RayPacket& packet, Uint32 numGroups, const BVH::Node& node, RenderingContext& context, Uint32 traversalDepth);
+// groups utilization threshold for ray reordering (see RenderingParams::rayReorderingThreshold)
+RT_FORCE_INLINE Float GetRayReorderingThreshold(const RenderingContext& context)
+{
+    return context.params ? context.params->rayReorderingThreshold : 0.0f;
+}
 
-template <typename ObjectType, Uint32 traversalDepth>
-void GenericTraverse_Packet(const PacketTraversalContext& context, const Uint32 objectID, const ObjectType* object, Uint32 numActiveGroups)
+// groups count threshold for switching to 8-ray traversal (see RenderingParams::simdTraversalMaxGroups)
+RT_FORCE_INLINE Uint32 GetSimdTraversalMaxGroups(const RenderingContext& context)
+{
+    return context.params ? context.params->simdTraversalMaxGroups : 0;
+}
+
+// reorder rays if only a small fraction of active groups' lanes hit a node
+// returns new number of active groups
+RT_FORCE_INLINE Uint32 ReorderRaysIfSparse(RenderingContext& context, Uint32 numGroups, Uint32 numRays, Float threshold)
+{
+    if (numGroups > 1 && static_cast<Float>(numRays) < threshold * static_cast<Float>(numGroups * RayPacket::RaysPerGroup))
+    {
+        return ReorderRays(context, numGroups);
+    }
+
+    return numGroups;
+}
+
+// octant of ray groups with rays pointing to different octants
+constexpr Uint32 MixedRayOctant = 8;
+
+// test all alive groups in a packet agains a BVH node's box
+// if all the rays share the same direction octant, specialized box test is used
+RT_FORCE_NOINLINE Uint32 TestRayPacket(RayPacket& packet, Uint32 numGroups, const math::Box_Simd8& box, RenderingContext& context, Uint32 traversalDepth,
+                                       Uint32 rayOctant = MixedRayOctant);
+
+// result of a box test against all rays of a packet at once
+enum class FrustumTestResult : Uint8
+{
+    Unknown,    // groups must be tested separately
+    AllMiss,    // no ray can hit the box
+    AllHit,     // all the rays start inside the box
+};
+
+// bounds of rays origins and reciprocal directions of a whole packet (interval arithmetic "frustum")
+// built once per traversal for groups sharing the direction octant, so directions never change sign
+struct RT_ALIGN(16) RayPacketFrustum
+{
+    // packet frustum is not worth building for few groups
+    static constexpr Uint32 MinNumGroups = 4;
+
+    math::Vector4 originMin;
+    math::Vector4 originMax;
+    math::Vector4 invDirMin;
+    math::Vector4 invDirMax;
+    Float maxDistance;
+    bool isValid;
+
+    // conservative test: may return Unknown even if all rays miss (or hit) the box
+    RT_FORCE_INLINE FrustumTestResult Test(const math::Box& box) const
+    {
+        if (!isValid)
+        {
+            return FrustumTestResult::Unknown;
+        }
+
+        // all the rays start inside the box
+        if (((originMin >= box.min).GetMask() & (originMax <= box.max).GetMask() & 0x7) == 0x7)
+        {
+            return FrustumTestResult::AllHit;
+        }
+
+        // bounds of distances to the box planes (the products are bilinear, so extremes lie in corners)
+        const math::Vector4 minPlaneA = (box.min - originMax) * invDirMin;
+        const math::Vector4 minPlaneB = (box.min - originMax) * invDirMax;
+        const math::Vector4 minPlaneC = (box.min - originMin) * invDirMin;
+        const math::Vector4 minPlaneD = (box.min - originMin) * invDirMax;
+        const math::Vector4 maxPlaneA = (box.max - originMax) * invDirMin;
+        const math::Vector4 maxPlaneB = (box.max - originMax) * invDirMax;
+        const math::Vector4 maxPlaneC = (box.max - originMin) * invDirMin;
+        const math::Vector4 maxPlaneD = (box.max - originMin) * invDirMax;
+
+        const math::Vector4 nearDist = math::Vector4::Min(math::Vector4::Min(math::Vector4::Min(minPlaneA, minPlaneB), math::Vector4::Min(minPlaneC, minPlaneD)),
+                                                          math::Vector4::Min(math::Vector4::Min(maxPlaneA, maxPlaneB), math::Vector4::Min(maxPlaneC, maxPlaneD)));
+        const math::Vector4 farDist = math::Vector4::Max(math::Vector4::Max(math::Vector4::Max(minPlaneA, minPlaneB), math::Vector4::Max(minPlaneC, minPlaneD)),
+                                                         math::Vector4::Max(math::Vector4::Max(maxPlaneA, maxPlaneB), math::Vector4::Max(maxPlaneC, maxPlaneD)));
+
+        // margin for rounding errors of the per-ray test
+        const math::Vector4 invDirAbsMax = math::Vector4::Max(math::Vector4::Abs(invDirMin), math::Vector4::Abs(invDirMax));
+        const math::Vector4 originAbsMax = math::Vector4::Max(math::Vector4::Abs(originMin), math::Vector4::Abs(originMax));
+        const math::Vector4 boxAbsMax = math::Vector4::Max(math::Vector4::Abs(box.min), math::Vector4::Abs(box.max));
+        const math::Vector4 margin = (boxAbsMax + originAbsMax) * invDirAbsMax * 1.0e-6f;
+
+        const math::Vector4 lowerNear = nearDist - margin;
+        const math::Vector4 upperFar = farDist + margin;
+        const Float minNearDist = std::max(std::max(lowerNear[0], lowerNear[1]), lowerNear[2]);
+        const Float maxFarDist = std::min(std::min(upperFar[0], upperFar[1]), upperFar[2]);
+
+        if (maxFarDist <= 0.0f || minNearDist > maxFarDist || minNearDist > maxDistance)
+        {
+            return FrustumTestResult::AllMiss;
+        }
+
+        return FrustumTestResult::Unknown;
+    }
+};
+
+// calculate frustum of active groups
+// the frustum is marked invalid for mixed octants, small packets and infinite reciprocal directions
+RT_FORCE_NOINLINE void BuildRayPacketFrustum(const RenderingContext& context, const RayPacket& packet, Uint32 numGroups, Uint32 traversalDepth, Uint32 rayOctant,
+                                             RayPacketFrustum& outFrustum);
+
+// test active groups against a node's box, whole packet is tested with its frustum first
+// returns number of rays that hit the box (all active rays if the frustum test accepted the box)
+RT_FORCE_INLINE Uint32 TestRayPacket(const PacketTraversalContext& context, const RayPacketFrustum& frustum, Uint32 numGroups, Uint32 numActiveRays,
+                                     const math::Box& box, const math::Box_Simd8& boxSimd8, Uint32 traversalDepth, Uint32 rayOctant)
+{
+    const FrustumTestResult frustumResult = frustum.Test(box);
+    if (frustumResult == FrustumTestResult::AllMiss)
+    {
+        return 0;
+    }
+    if (frustumResult == FrustumTestResult::AllHit)
+    {
+        return numActiveRays;
+    }
+
+    const Uint32 raysHit = TestRayPacket(context.ray, numGroups, boxSimd8, context.context, traversalDepth, rayOctant);
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+    context.context.localCounters.numRayBoxTests += 8 * numGroups;
+    context.context.localCounters.numPassedRayBoxTests += raysHit;
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+    return raysHit;
+}
+
+// sort active groups by direction octant of their rays, groups with mixed octants go last
+// groups of octant 'i' are stored in outSortedIndices, starting at outOctantOffsets[i] and ending at outOctantOffsets[i + 1]
+RT_FORCE_NOINLINE void SortGroupsByOctant(const RenderingContext& context, const RayPacket& packet, Uint32 numGroups, Uint32 traversalDepth,
+                                          Uint16* outSortedIndices, Uint32* outOctantOffsets);
+
+// split active groups by direction octant and traverse each subset separately, so the traversal order
+// is exact for all the rays (see MixedRayOctant)
+// the callback takes number of groups (moved to the front of active groups list) and their octant,
+// it returns false if the traversal can be terminated
+template <typename OctantTraversal>
+void TraverseByOctant(const PacketTraversalContext& context, Uint32 numActiveGroups, Uint32 traversalDepth, const OctantTraversal& traverse)
+{
+    Uint16 sortedIndices[RayPacket::MaxNumGroups];
+    Uint32 octantOffsets[MixedRayOctant + 2];
+    SortGroupsByOctant(context.context, context.ray, numActiveGroups, traversalDepth, sortedIndices, octantOffsets);
+
+    Uint16* groupsIndices = context.context.activeGroupsIndices;
+
+    for (Uint32 octant = 0; octant <= MixedRayOctant; ++octant)
+    {
+        const Uint32 numGroups = octantOffsets[octant + 1] - octantOffsets[octant];
+        if (numGroups == 0)
+        {
+            continue;
+        }
+
+        memcpy(groupsIndices, sortedIndices + octantOffsets[octant], sizeof(Uint16) * numGroups);
+        if (!traverse(numGroups, octant))
+        {
+            break;
+        }
+    }
+
+    // callers expect the same set of active groups
+    memcpy(groupsIndices, sortedIndices, sizeof(Uint16) * numActiveGroups);
+}
+
+// octant used for traversal order of a subset of groups
+template <Uint32 traversalDepth>
+RT_FORCE_INLINE Uint32 GetTraversalOctant(const PacketTraversalContext& context, Uint32 rayOctant)
+{
+    if (rayOctant != MixedRayOctant)
+    {
+        return rayOctant;
+    }
+
+    // mixed directions - guess using the first ray
+    const math::Ray_Simd8& rays = context.ray.groups[context.context.activeGroupsIndices[0]].rays[traversalDepth];
+    return (rays.dir.x.GetSignMask() & 1) | ((rays.dir.y.GetSignMask() & 1) << 1) | ((rays.dir.z.GetSignMask() & 1) << 2);
+}
+
+// intersect BVH leaf with a packet: finds closest hits or (for shadow traversal) any hits
+template <bool Shadow>
+struct PacketLeafTraversal
+{
+    template <typename ObjectType>
+    RT_FORCE_INLINE static void Traverse(const PacketTraversalContext& context, const Uint32 objectID, const ObjectType* object, const BVH::Node& node, Uint32 numActiveGroups)
+    {
+        object->Traverse_Leaf_Packet(context, objectID, node, numActiveGroups);
+    }
+};
+
+template <>
+struct PacketLeafTraversal<true>
+{
+    template <typename ObjectType>
+    RT_FORCE_INLINE static void Traverse(const PacketTraversalContext& context, const Uint32 objectID, const ObjectType* object, const BVH::Node& node, Uint32 numActiveGroups)
+    {
+        RT_UNUSED(objectID);
+        object->Traverse_Leaf_Shadow_Packet(context, node, numActiveGroups);
+    }
+};
+
+// traverse a subtree with each active ray group separately, used when a packet lost its coherence
+// leaves are intersected with a single group moved to the front of active groups list
+// returns false if the traversal can be terminated (all shadow rays are occluded)
+template <bool Shadow, typename ObjectType, typename SubtreeTraversal>
+bool TraverseGroupsSeparately(const PacketTraversalContext& context, const Uint32 objectID, const ObjectType* object, Uint32 numGroups,
+                              const SubtreeTraversal& traverseSubtree)
+{
+    Uint16* groupsIndices = context.context.activeGroupsIndices;
+
+    const auto traverseLeaf = [&](const BVH::Node& leaf)
+    {
+        PacketLeafTraversal<Shadow>::Traverse(context, objectID, object, leaf, 1);
+        return !(Shadow && context.context.numActiveShadowRays == 0);
+    };
+
+    for (Uint32 i = 0; i < numGroups; ++i)
+    {
+        std::swap(groupsIndices[0], groupsIndices[i]);
+
+        const RayGroup& group = context.ray.groups[groupsIndices[0]];
+        if (!traverseSubtree(group, traverseLeaf))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// packet traversal of a binary BVH for groups sharing the direction octant
+template <typename ObjectType, Uint32 traversalDepth, bool Shadow = false>
+void GenericTraverse_Packet_Octant(const PacketTraversalContext& context, const Uint32 objectID, const ObjectType* object, Uint32 numActiveGroups, Uint32 rayOctant)
 {
     // all nodes
     const BVH::Node* __restrict nodes = object->GetBVH().GetNodes();
@@ -45,13 +282,15 @@ void GenericTraverse_Packet(const PacketTraversalContext& context, const Uint32
     Uint32 stackSize = 1;
     stack[0].node = nodes;
     stack[0].numActiveGroups = numActiveGroups;
-    stack[0].numActiveRays = context.ray.numRays; // all rays are active at the beginning
+    stack[0].numActiveRays = numActiveGroups * RayPacket::RaysPerGroup; // all rays are active at the beginning
+
+    const Uint32 traversalOctant = GetTraversalOctant<traversalDepth>(context, rayOctant);
 
-    // TODO packets should be octant-sorted
-    Uint32 rayOctant = 0;
-    rayOctant = context.ray.groups[0].rays[traversalDepth].dir.x[0] < 0.0f ? 1 : 0;
-    rayOctant |= context.ray.groups[0].rays[traversalDepth].dir.y[0] < 0.0f ? 2 : 0;
-    rayOctant |= context.ray.groups[0].rays[traversalDepth].dir.z[0] < 0.0f ? 4 : 0;
+    RayPacketFrustum frustum;
+    BuildRayPacketFrustum(context.context, context.ray, numActiveGroups, traversalDepth, rayOctant, frustum);
+
+    const Float reorderingThreshold = GetRayReorderingThreshold(context.context);
+    const Uint32 simdTraversalMaxGroups = GetSimdTraversalMaxGroups(context.context);
 
     // BVH traversal
     while (stackSize > 0)
@@ -60,11 +299,10 @@ void GenericTraverse_Packet(const PacketTraversalContext& context, const Uint32
         const StackFrame& frame = stack[--stackSize];
 
         Uint32 numGroups = frame.numActiveGroups;
-        Uint32 raysHit = TestRayPacket(context.ray, numGroups, *frame.node, context.context, traversalDepth);
+        Uint32 raysHit = TestRayPacket(context, frustum, numGroups, frame.numActiveRays, frame.node->GetBox(), frame.node->GetBox_Simd8(), traversalDepth, rayOctant);
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
-        context.context.localCounters.numRayBoxTests += 8 * numGroups;
-        context.context.localCounters.numPassedRayBoxTests += raysHit;
+        context.context.localCounters.numTraversedNodes++;
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
 
         if (raysHit == 0)
@@ -78,29 +316,270 @@ void GenericTraverse_Packet(const PacketTraversalContext& context, const Uint32
         {
             numGroups = RemoveMissedGroups(context.context, numGroups);
 
-#ifndef RT_NO_RAY_REORDERING
-            // reorder rays to restore coherency
-            if ((numGroups > 1) && ((4 * numGroups) >= raysHit)) // 50% utilization
+            // restore groups utilization
+            numGroups = ReorderRaysIfSparse(context.context, numGroups, raysHit, reorderingThreshold);
+        }
+
+        if (frame.node->IsLeaf())
+        {
+            PacketLeafTraversal<Shadow>::Traverse(context, objectID, object, *frame.node, numGroups);
+
+            if (Shadow && context.context.numActiveShadowRays == 0)
             {
-                ReorderRays(context.context, numGroups);
-                numGroups = (raysHit + 7) / 8;
+                // all rays are occluded
+                return;
             }
-#endif // RT_NO_RAY_REORDERING
         }
+        else if (numGroups <= simdTraversalMaxGroups)
+        {
+            // too few groups left to amortize packet bookkeeping
+            const auto traverseSubtree = [&](const RayGroup& group, const auto& traverseLeaf)
+            {
+                return TraverseSubtree_Simd8(nodes, frame.node, group.rays[traversalDepth], group.maxDistances, context.context, traverseLeaf);
+            };
 
-        // TODO switching to Simd traversal if only one group left
+            if (!TraverseGroupsSeparately<Shadow>(context, objectID, object, numGroups, traverseSubtree))
+            {
+                return;
+            }
+        }
+        else
+        {
+            const BVH::Node* __restrict children = nodes + frame.node->childIndex;
+            RT_PREFETCH_L1(children);
+
+            // stored split axis trick: pust stack elements based on current node's split axis
+            const Uint32 firstIndex = (traversalOctant >> frame.node->GetSplitAxis()) & 1u;
+            const Uint32 secondIndex = firstIndex ^ 1u;
+
+            stack[stackSize].node = children + secondIndex;
+            stack[stackSize].numActiveGroups = numGroups;
+            stack[stackSize].numActiveRays = raysHit;
+            stackSize++;
+
+            stack[stackSize].node = children + firstIndex;
+            stack[stackSize].numActiveGroups = numGroups;
+            stack[stackSize].numActiveRays = raysHit;
+            stackSize++;
+        }
+    }
+}
+
+// packet traversal of a wide BVH for groups sharing the direction octant
+// child boxes are tested one by one against whole packet, but all of them come from a single node fetch
+template <typename ObjectType, Uint32 Width, Uint32 traversalDepth, bool Shadow = false>
+void GenericTraverse_Wide_Packet_Octant(const PacketTraversalContext& context, const Uint32 objectID, const ObjectType* object, Uint32 numActiveGroups, Uint32 rayOctant)
+{
+    using BVHType = typename std::decay<decltype(object->GetWideBVH())>::type;
+    using NodeType = typename BVHType::Node;
+    static_assert(BVHType::NumChildren == Width, "Invalid BVH width");
+
+    const BVHType& bvh = object->GetWideBVH();
+    if (bvh.GetNumNodes() == 0)
+    {
+        // tree is empty
+        return;
+    }
+
+    // all nodes
+    const NodeType* __restrict nodes = bvh.GetNodes();
+
+    struct StackFrame
+    {
+        const NodeType* node;
+        Uint32 childSlot;
+        Uint32 numActiveGroups;
+        Uint32 numActiveRays;
+    };
+
+    StackFrame stack[BVH::MaxDepth * Width];
+    Uint32 stackSize = 0;
+
+    // children are visited in order of their centers projected on the direction of the first ray
+    const math::Ray_Simd8& firstRays = context.ray.groups[context.context.activeGroupsIndices[0]].rays[traversalDepth];
+    const math::Vector3x8 rayDir(math::Vector8(firstRays.dir.x[0]), math::Vector8(firstRays.dir.y[0]), math::Vector8(firstRays.dir.z[0]));
+
+    RayPacketFrustum frustum;
+    BuildRayPacketFrustum(context.context, context.ray, numActiveGroups, traversalDepth, rayOctant, frustum);
+
+    const Float reorderingThreshold = GetRayReorderingThreshold(context.context);
+    const Uint32 simdTraversalMaxGroups = GetSimdTraversalMaxGroups(context.context);
+
+    const auto pushChildren = [&](const NodeType* node, Uint32 numGroups, Uint32 numRays)
+    {
+        const math::Box_Simd8 boxes = node->GetChildBoxes_Simd8();
+        const math::Vector3x8 centers = boxes.min + boxes.max;
+        const math::Vector8 projections = math::Vector8::MulAndAdd(centers.x, rayDir.x,
+                                          math::Vector8::MulAndAdd(centers.y, rayDir.y, centers.z * rayDir.z));
+
+        // sort by decreasing projection, so the closest child is on top of the stack
+        const Uint32 firstFrame = stackSize;
+        for (Uint32 slot = 0; slot < Width && node->IsChildValid(slot); ++slot)
+        {
+            Uint32 i = stackSize++;
+            for (; i > firstFrame && projections[stack[i - 1].childSlot] < projections[slot]; --i)
+            {
+                stack[i] = stack[i - 1];
+            }
+            stack[i] = { node, slot, numGroups, numRays };
+        }
+    };
+
+    // push root's children, all rays are active at the beginning
+    pushChildren(nodes, numActiveGroups, numActiveGroups * RayPacket::RaysPerGroup);
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+    context.context.localCounters.numTraversedNodes++;
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+    // BVH traversal
+    while (stackSize > 0)
+    {
+        // pop element from stack
+        const StackFrame frame = stack[--stackSize];
+
+        Uint32 numGroups = frame.numActiveGroups;
+        const Uint32 raysHit = TestRayPacket(context, frustum, numGroups, frame.numActiveRays,
+                                             frame.node->GetChildBox(frame.childSlot), frame.node->GetChildBox_Simd8(frame.childSlot), traversalDepth, rayOctant);
+
+        if (raysHit == 0)
+        {
+            // all rays missed the node - skip it
+            continue;
+        }
+
+        // remove missed groups from the list
+        if (raysHit < frame.numActiveRays)
+        {
+            numGroups = RemoveMissedGroups(context.context, numGroups);
+
+            // restore groups utilization
+            numGroups = ReorderRaysIfSparse(context.context, numGroups, raysHit, reorderingThreshold);
+        }
+
+        if (frame.node->IsChildLeaf(frame.childSlot))
+        {
+            const BVH::Node leaf = BVHType::MakeLeaf(frame.node->childIndex[frame.childSlot], frame.node->childNumLeaves[frame.childSlot]);
+            PacketLeafTraversal<Shadow>::Traverse(context, objectID, object, leaf, numGroups);
+
+            if (Shadow && context.context.numActiveShadowRays == 0)
+            {
+                // all rays are occluded
+                return;
+            }
+        }
+        else if (numGroups <= simdTraversalMaxGroups)
+        {
+            // too few groups left to amortize packet bookkeeping
+            const NodeType* childNode = nodes + frame.node->childIndex[frame.childSlot];
+            const auto traverseSubtree = [&](const RayGroup& group, const auto& traverseLeaf)
+            {
+                return TraverseWideSubtree_Simd8<BVHType>(nodes, childNode, group.rays[traversalDepth], group.maxDistances, context.context, traverseLeaf);
+            };
+
+            if (!TraverseGroupsSeparately<Shadow>(context, objectID, object, numGroups, traverseSubtree))
+            {
+                return;
+            }
+        }
+        else
+        {
+            const NodeType* childNode = nodes + frame.node->childIndex[frame.childSlot];
+            RT_PREFETCH_L1(childNode);
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+            context.context.localCounters.numTraversedNodes++;
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+            pushChildren(childNode, numGroups, raysHit);
+        }
+    }
+}
+
+// packet traversal of a motion BVH for groups sharing the direction octant
+// all rays in a packet share the same time, so node boxes are interpolated once per node
+template <typename ObjectType, Uint32 traversalDepth, bool Shadow = false>
+void GenericTraverse_Motion_Packet_Octant(const PacketTraversalContext& context, const Uint32 objectID, const ObjectType* object, Uint32 numActiveGroups, Uint32 rayOctant)
+{
+    if (object->GetMotionBVH().GetNumNodes() == 0)
+    {
+        // tree is empty
+        return;
+    }
+
+    const float time = context.context.time;
+
+    // all nodes
+    const MotionBVH::Node* __restrict nodes = object->GetMotionBVH().GetNodes();
+
+    struct StackFrame
+    {
+        const MotionBVH::Node* node;
+        Uint32 numActiveGroups;
+        Uint32 numActiveRays;
+    };
+
+    StackFrame stack[BVH::MaxDepth];
+
+    // push root
+    Uint32 stackSize = 1;
+    stack[0].node = nodes;
+    stack[0].numActiveGroups = numActiveGroups;
+    stack[0].numActiveRays = numActiveGroups * RayPacket::RaysPerGroup; // all rays are active at the beginning
+
+    const Uint32 traversalOctant = GetTraversalOctant<traversalDepth>(context, rayOctant);
+
+    RayPacketFrustum frustum;
+    BuildRayPacketFrustum(context.context, context.ray, numActiveGroups, traversalDepth, rayOctant, frustum);
+
+    const Float reorderingThreshold = GetRayReorderingThreshold(context.context);
+
+    // BVH traversal
+    while (stackSize > 0)
+    {
+        // pop element from stack
+        const StackFrame& frame = stack[--stackSize];
+
+        Uint32 numGroups = frame.numActiveGroups;
+        const math::Box box = frame.node->GetBox(time);
+        Uint32 raysHit = TestRayPacket(context, frustum, numGroups, frame.numActiveRays, box, math::Box_Simd8(box), traversalDepth, rayOctant);
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        context.context.localCounters.numTraversedNodes++;
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+        if (raysHit == 0)
+        {
+            // all rays missed the node - skip it
+            continue;
+        }
+
+        // remove missed groups from the list
+        if (raysHit < frame.numActiveRays)
+        {
+            numGroups = RemoveMissedGroups(context.context, numGroups);
+
+            // restore groups utilization
+            numGroups = ReorderRaysIfSparse(context.context, numGroups, raysHit, reorderingThreshold);
+        }
 
         if (frame.node->IsLeaf())
         {
-            object->Traverse_Leaf_Packet(context, objectID, *frame.node, numGroups);
+            PacketLeafTraversal<Shadow>::Traverse(context, objectID, object, frame.node->start, numGroups);
+
+            if (Shadow && context.context.numActiveShadowRays == 0)
+            {
+                // all rays are occluded
+                return;
+            }
         }
         else
         {
-            const BVH::Node* __restrict children = nodes + frame.node->childIndex;
+            const MotionBVH::Node* __restrict children = nodes + frame.node->start.childIndex;
             RT_PREFETCH_L1(children);
 
-            // stored split axis trick: pust stack elements based on current node's split axis
-            const Uint32 firstIndex = (rayOctant >> frame.node->GetSplitAxis()) & 1u;
+            // stored split axis trick: push stack elements based on current node's split axis
+            const Uint32 firstIndex = (traversalOctant >> frame.node->GetSplitAxis()) & 1u;
             const Uint32 secondIndex = firstIndex ^ 1u;
 
             stack[stackSize].node = children + secondIndex;
@@ -116,4 +595,57 @@ void GenericTraverse_Packet(const PacketTraversalContext& context, const Uint32
     }
 }
 
+// packet traversal of a binary BVH
+template <typename ObjectType, Uint32 traversalDepth, bool Shadow = false>
+void GenericTraverse_Packet(const PacketTraversalContext& context, const Uint32 objectID, const ObjectType* object, Uint32 numActiveGroups)
+{
+    TraverseByOctant(context, numActiveGroups, traversalDepth, [&](Uint32 numGroups, Uint32 rayOctant)
+    {
+        GenericTraverse_Packet_Octant<ObjectType, traversalDepth, Shadow>(context, objectID, object, numGroups, rayOctant);
+        return !(Shadow && context.context.numActiveShadowRays == 0);
+    });
+}
+
+// packet traversal of a wide BVH
+template <typename ObjectType, Uint32 Width, Uint32 traversalDepth, bool Shadow = false>
+void GenericTraverse_Wide_Packet(const PacketTraversalContext& context, const Uint32 objectID, const ObjectType* object, Uint32 numActiveGroups)
+{
+    TraverseByOctant(context, numActiveGroups, traversalDepth, [&](Uint32 numGroups, Uint32 rayOctant)
+    {
+        GenericTraverse_Wide_Packet_Octant<ObjectType, Width, traversalDepth, Shadow>(context, objectID, object, numGroups, rayOctant);
+        return !(Shadow && context.context.numActiveShadowRays == 0);
+    });
+}
+
+// packet traversal of a motion BVH
+template <typename ObjectType, Uint32 traversalDepth, bool Shadow = false>
+void GenericTraverse_Motion_Packet(const PacketTraversalContext& context, const Uint32 objectID, const ObjectType* object, Uint32 numActiveGroups)
+{
+    TraverseByOctant(context, numActiveGroups, traversalDepth, [&](Uint32 numGroups, Uint32 rayOctant)
+    {
+        GenericTraverse_Motion_Packet_Octant<ObjectType, traversalDepth, Shadow>(context, objectID, object, numGroups, rayOctant);
+        return !(Shadow && context.context.numActiveShadowRays == 0);
+    });
+}
+
+// packet traversal of shadow rays
+// rays are retired as soon as any hit closer than their max distance is found
+template <typename ObjectType, Uint32 traversalDepth>
+RT_FORCE_INLINE void GenericTraverse_Shadow_Packet(const PacketTraversalContext& context, const ObjectType* object, Uint32 numActiveGroups)
+{
+    GenericTraverse_Packet<ObjectType, traversalDepth, true>(context, 0, object, numActiveGroups);
+}
+
+template <typename ObjectType, Uint32 Width, Uint32 traversalDepth>
+RT_FORCE_INLINE void GenericTraverse_Wide_Shadow_Packet(const PacketTraversalContext& context, const ObjectType* object, Uint32 numActiveGroups)
+{
+    GenericTraverse_Wide_Packet<ObjectType, Width, traversalDepth, true>(context, 0, object, numActiveGroups);
+}
+
+template <typename ObjectType, Uint32 traversalDepth>
+RT_FORCE_INLINE void GenericTraverse_Motion_Shadow_Packet(const PacketTraversalContext& context, const ObjectType* object, Uint32 numActiveGroups)
+{
+    GenericTraverse_Motion_Packet<ObjectType, traversalDepth, true>(context, 0, object, numActiveGroups);
+}
+
 } // namespace rt
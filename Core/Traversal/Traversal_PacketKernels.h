@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Traversal_Packet.h"
+
+// Packet box test kernels. Compiled once for the baseline and once per additional instruction set
+// (see Traversal_Packet_AVX2.cpp and Traversal_Packet_AVX512.cpp), so all the functions here must be inlined or static.
+// Global vector constants (e.g. VECTOR8_ONE) are not available here either (see RT_KERNEL_TRANSLATION_UNIT).
+
+namespace rt {
+
+template <Uint32 Octant>
+RT_FORCE_INLINE static const math::Vector8 IntersectBoxRayGroup(const math::Ray_Simd8& rays, const math::Box_Simd8& box, const math::Vector8& maxDistances)
+{
+    math::Vector8 distance;
+    const math::Vector3x8 rayOriginDivDir = rays.origin * rays.invDir;
+    return math::Intersect_BoxRay_Simd8_Octant<Octant>(rays.invDir, rayOriginDivDir, box, maxDistances, distance);
+}
+
+template <>
+RT_FORCE_INLINE const math::Vector8 IntersectBoxRayGroup<MixedRayOctant>(const math::Ray_Simd8& rays, const math::Box_Simd8& box, const math::Vector8& maxDistances)
+{
+    math::Vector8 distance;
+    const math::Vector3x8 rayOriginDivDir = rays.origin * rays.invDir;
+    return math::Intersect_BoxRay_Simd8(rays.invDir, rayOriginDivDir, box, maxDistances, distance);
+}
+
+template <Uint32 Octant>
+RT_FORCE_INLINE static Uint32 TestRayPacket_Octant(RayPacket& packet, Uint32 numGroups, const math::Box_Simd8& box, RenderingContext& context, Uint32 traversalDepth)
+{
+    Uint32 raysHit = 0;
+    Uint32 i = 0;
+
+    // unrolled version of the loop below
+    while (i + 4 <= numGroups)
+    {
+        const RayGroup& rayGroupA = packet.groups[context.activeGroupsIndices[i + 0]];
+        const RayGroup& rayGroupB = packet.groups[context.activeGroupsIndices[i + 1]];
+        const RayGroup& rayGroupC = packet.groups[context.activeGroupsIndices[i + 2]];
+        const RayGroup& rayGroupD = packet.groups[context.activeGroupsIndices[i + 3]];
+
+        const math::Vector8 maskA = IntersectBoxRayGroup<Octant>(rayGroupA.rays[traversalDepth], box, rayGroupA.maxDistances);
+        const math::Vector8 maskB = IntersectBoxRayGroup<Octant>(rayGroupB.rays[traversalDepth], box, rayGroupB.maxDistances);
+        const math::Vector8 maskC = IntersectBoxRayGroup<Octant>(rayGroupC.rays[traversalDepth], box, rayGroupC.maxDistances);
+        const math::Vector8 maskD = IntersectBoxRayGroup<Octant>(rayGroupD.rays[traversalDepth], box, rayGroupD.maxDistances);
+
+        const Uint32 intMaskA = maskA.GetSignMask();
+        const Uint32 intMaskB = maskB.GetSignMask();
+        const Uint32 intMaskC = maskC.GetSignMask();
+        const Uint32 intMaskD = maskD.GetSignMask();
+
+        const Uint32 intMaskCombined = (intMaskA | (intMaskB << 8u)) | ((intMaskC << 16u) | (intMaskD << 24u));
+        *reinterpret_cast<Uint32*>(context.activeRaysMask + i) = intMaskCombined;
+        raysHit += math::PopCount(intMaskCombined);
+
+        i += 4;
+    }
+
+    for (; i < numGroups; ++i)
+    {
+        const RayGroup& rayGroup = packet.groups[context.activeGroupsIndices[i]];
+
+        const math::Vector8 mask = IntersectBoxRayGroup<Octant>(rayGroup.rays[traversalDepth], box, rayGroup.maxDistances);
+        const Uint32 intMask = mask.GetSignMask();
+        context.activeRaysMask[i] = (Uint8)intMask;
+        raysHit += math::PopCount(intMask);
+    }
+
+    return raysHit;
+}
+
+RT_FORCE_INLINE static Uint32 TestRayPacket_Generic(RayPacket& packet, Uint32 numGroups, const math::Box_Simd8& box, RenderingContext& context, Uint32 traversalDepth, Uint32 rayOctant)
+{
+    switch (rayOctant)
+    {
+    case 0: return TestRayPacket_Octant<0>(packet, numGroups, box, context, traversalDepth);
+    case 1: return TestRayPacket_Octant<1>(packet, numGroups, box, context, traversalDepth);
+    case 2: return TestRayPacket_Octant<2>(packet, numGroups, box, context, traversalDepth);
+    case 3: return TestRayPacket_Octant<3>(packet, numGroups, box, context, traversalDepth);
+    case 4: return TestRayPacket_Octant<4>(packet, numGroups, box, context, traversalDepth);
+    case 5: return TestRayPacket_Octant<5>(packet, numGroups, box, context, traversalDepth);
+    case 6: return TestRayPacket_Octant<6>(packet, numGroups, box, context, traversalDepth);
+    case 7: return TestRayPacket_Octant<7>(packet, numGroups, box, context, traversalDepth);
+    }
+
+    return TestRayPacket_Octant<MixedRayOctant>(packet, numGroups, box, context, traversalDepth);
+}
+
+// variants compiled for additional instruction sets, selected at runtime (see GetKernelInstructionSet)
+Uint32 TestRayPacket_AVX2(RayPacket& packet, Uint32 numGroups, const math::Box_Simd8& box, RenderingContext& context, Uint32 traversalDepth, Uint32 rayOctant);
+
+#ifdef RT_ENABLE_AVX512_KERNELS
+Uint32 TestRayPacket_AVX512(RayPacket& packet, Uint32 numGroups, const math::Box_Simd8& box, RenderingContext& context, Uint32 traversalDepth, Uint32 rayOctant);
+#endif // RT_ENABLE_AVX512_KERNELS
+
+} // namespace rt
@@ -0,0 +1,16 @@
+#define RT_KERNEL_TRANSLATION_UNIT
+#include "PCH.h"
+#include "Traversal_PacketKernels.h"
+
+#ifndef RT_USE_AVX2
+#error "This file must be compiled with AVX2 enabled"
+#endif // RT_USE_AVX2
+
+namespace rt {
+
+Uint32 TestRayPacket_AVX2(RayPacket& packet, Uint32 numGroups, const math::Box_Simd8& box, RenderingContext& context, Uint32 traversalDepth, Uint32 rayOctant)
+{
+    return TestRayPacket_Generic(packet, numGroups, box, context, traversalDepth, rayOctant);
+}
+
+} // namespace rt
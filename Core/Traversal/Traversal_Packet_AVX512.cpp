@@ -0,0 +1,110 @@
+#define RT_KERNEL_TRANSLATION_UNIT
+#include "PCH.h"
+#include "Traversal_PacketKernels.h"
+#include "Math/Simd16Geometry.h"
+
+#ifdef RT_ENABLE_AVX512_KERNELS
+
+#ifndef __AVX512F__
+#error "This file must be compiled with AVX-512 enabled"
+#endif // __AVX512F__
+
+namespace rt {
+
+using namespace math;
+
+// test two ray groups at once
+template <Uint32 Octant>
+RT_FORCE_INLINE_AVX512 static const VectorBool16 IntersectBoxRayGroups_Simd16(const Ray_Simd8& raysA, const Ray_Simd8& raysB, const Box_Simd16& box,
+                                                                              const Vector8& maxDistancesA, const Vector8& maxDistancesB)
+{
+    Vector16 distance;
+    const Vector3x16 rayInvDir(raysA.invDir, raysB.invDir);
+    const Vector3x16 rayOriginDivDir = Vector3x16(raysA.origin, raysB.origin) * rayInvDir;
+    return Intersect_BoxRay_Simd16_Octant<Octant>(rayInvDir, rayOriginDivDir, box, Vector16(maxDistancesA, maxDistancesB), distance);
+}
+
+template <>
+RT_FORCE_INLINE_AVX512 const VectorBool16 IntersectBoxRayGroups_Simd16<MixedRayOctant>(const Ray_Simd8& raysA, const Ray_Simd8& raysB, const Box_Simd16& box,
+                                                                                       const Vector8& maxDistancesA, const Vector8& maxDistancesB)
+{
+    Vector16 distance;
+    const Vector3x16 rayInvDir(raysA.invDir, raysB.invDir);
+    const Vector3x16 rayOriginDivDir = Vector3x16(raysA.origin, raysB.origin) * rayInvDir;
+    return Intersect_BoxRay_Simd16(rayInvDir, rayOriginDivDir, box, Vector16(maxDistancesA, maxDistancesB), distance);
+}
+
+// 16-wide version of TestRayPacket_Octant, pairs of 8-ray groups are tested together
+template <Uint32 Octant>
+RT_FORCE_INLINE_AVX512 static Uint32 TestRayPacket_Octant_Simd16(RayPacket& packet, Uint32 numGroups, const math::Box_Simd8& box, RenderingContext& context, Uint32 traversalDepth)
+{
+    const Box_Simd16 box16(box);
+
+    Uint32 raysHit = 0;
+    Uint32 i = 0;
+
+    // unrolled version of the loop below
+    while (i + 4 <= numGroups)
+    {
+        const RayGroup& rayGroupA = packet.groups[context.activeGroupsIndices[i + 0]];
+        const RayGroup& rayGroupB = packet.groups[context.activeGroupsIndices[i + 1]];
+        const RayGroup& rayGroupC = packet.groups[context.activeGroupsIndices[i + 2]];
+        const RayGroup& rayGroupD = packet.groups[context.activeGroupsIndices[i + 3]];
+
+        const VectorBool16 maskAB = IntersectBoxRayGroups_Simd16<Octant>(rayGroupA.rays[traversalDepth], rayGroupB.rays[traversalDepth], box16,
+                                                                         rayGroupA.maxDistances, rayGroupB.maxDistances);
+        const VectorBool16 maskCD = IntersectBoxRayGroups_Simd16<Octant>(rayGroupC.rays[traversalDepth], rayGroupD.rays[traversalDepth], box16,
+                                                                         rayGroupC.maxDistances, rayGroupD.maxDistances);
+
+        const Uint32 intMaskCombined = static_cast<Uint32>(maskAB.GetMask()) | (static_cast<Uint32>(maskCD.GetMask()) << 16u);
+        *reinterpret_cast<Uint32*>(context.activeRaysMask + i) = intMaskCombined;
+        raysHit += PopCount(intMaskCombined);
+
+        i += 4;
+    }
+
+    for (; i + 2 <= numGroups; i += 2)
+    {
+        const RayGroup& rayGroupA = packet.groups[context.activeGroupsIndices[i + 0]];
+        const RayGroup& rayGroupB = packet.groups[context.activeGroupsIndices[i + 1]];
+
+        const VectorBool16 mask = IntersectBoxRayGroups_Simd16<Octant>(rayGroupA.rays[traversalDepth], rayGroupB.rays[traversalDepth], box16,
+                                                                       rayGroupA.maxDistances, rayGroupB.maxDistances);
+        const Uint32 intMask = static_cast<Uint32>(mask.GetMask());
+        *reinterpret_cast<Uint16*>(context.activeRaysMask + i) = (Uint16)intMask;
+        raysHit += PopCount(intMask);
+    }
+
+    if (i < numGroups)
+    {
+        const RayGroup& rayGroup = packet.groups[context.activeGroupsIndices[i]];
+
+        const Vector8 mask = IntersectBoxRayGroup<Octant>(rayGroup.rays[traversalDepth], box, rayGroup.maxDistances);
+        const Uint32 intMask = mask.GetSignMask();
+        context.activeRaysMask[i] = (Uint8)intMask;
+        raysHit += PopCount(intMask);
+    }
+
+    return raysHit;
+}
+
+Uint32 TestRayPacket_AVX512(RayPacket& packet, Uint32 numGroups, const math::Box_Simd8& box, RenderingContext& context, Uint32 traversalDepth, Uint32 rayOctant)
+{
+    switch (rayOctant)
+    {
+    case 0: return TestRayPacket_Octant_Simd16<0>(packet, numGroups, box, context, traversalDepth);
+    case 1: return TestRayPacket_Octant_Simd16<1>(packet, numGroups, box, context, traversalDepth);
+    case 2: return TestRayPacket_Octant_Simd16<2>(packet, numGroups, box, context, traversalDepth);
+    case 3: return TestRayPacket_Octant_Simd16<3>(packet, numGroups, box, context, traversalDepth);
+    case 4: return TestRayPacket_Octant_Simd16<4>(packet, numGroups, box, context, traversalDepth);
+    case 5: return TestRayPacket_Octant_Simd16<5>(packet, numGroups, box, context, traversalDepth);
+    case 6: return TestRayPacket_Octant_Simd16<6>(packet, numGroups, box, context, traversalDepth);
+    case 7: return TestRayPacket_Octant_Simd16<7>(packet, numGroups, box, context, traversalDepth);
+    }
+
+    return TestRayPacket_Octant_Simd16<MixedRayOctant>(packet, numGroups, box, context, traversalDepth);
+}
+
+} // namespace rt
+
+#endif // RT_ENABLE_AVX512_KERNELS
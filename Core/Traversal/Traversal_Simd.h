@@ -1,37 +1,46 @@
 #pragma once
 
 #include "HitPoint.h"
+#include "TraversalContext.h"
 #include "Math/Ray.h"
+#include "Math/Simd8Ray.h"
 #include "BVH/BVH.h"
 #include "Math/Geometry.h"
 #include "Math/Simd8Geometry.h"
 #include "Utils/iacaMarks.h"
 #include "Rendering/Counters.h"
+#include "Rendering/Context.h"
 
 
 namespace rt {
 
-// traverse 8 rays at a time
+// traverse binary BVH subtree with 8 rays at a time
 // no ray reordering/masking is performed
-template <typename ObjectType>
-static void GenericTraverse_Simd8(const SimdTraversalContext& context, const Uint32 objectID, const ObjectType* object)
+// max distances are read before each node test, so they may shrink when hits are found
+// leaf callback returns false if the traversal should be terminated
+// returns false if the traversal was terminated
+template <typename LeafCallback>
+bool TraverseSubtree_Simd8(const BVH::Node* __restrict nodes, const BVH::Node* rootNode, const math::Ray_Simd8& ray, const math::Vector8& maxDistances,
+                           RenderingContext& renderingContext, const LeafCallback& traverseLeaf)
 {
-    const math::Vector3x8 rayInvDir = context.ray.invDir;
-    const math::Vector3x8 rayOriginDivDir = context.ray.origin * context.ray.invDir;
+    RT_UNUSED(renderingContext);
 
-    // all nodes
-    const BVH::Node* __restrict nodes = object->GetBVH().GetNodes();
+    const math::Vector3x8 rayInvDir = ray.invDir;
+    const math::Vector3x8 rayOriginDivDir = ray.origin * ray.invDir;
 
     // "nodes to visit" stack
     Uint32 stackSize = 0;
     const BVH::Node* __restrict nodesStack[BVH::MaxDepth];
 
     // BVH traversal
-    for (const BVH::Node* __restrict currentNode = nodes;;)
+    for (const BVH::Node* __restrict currentNode = rootNode;;)
     {
         if (currentNode->IsLeaf())
         {
-            object->Traverse_Leaf_Simd8(context, objectID, *currentNode);
+            if (!traverseLeaf(*currentNode))
+            {
+                return false;
+            }
         }
         else
         {
@@ -41,24 +50,26 @@ static void GenericTraverse_Simd8(const SimdTraversalContext& context, const Uin
             RT_PREFETCH_L1(nodes + childA->childIndex);
 
             math::Vector8 distanceA;
-            const math::Vector8 maskA = Intersect_BoxRay_Simd8(rayInvDir, rayOriginDivDir, childA->GetBox_Simd8(), context.hitPoint.distance, distanceA);
+            const math::Vector8 maskA = Intersect_BoxRay_Simd8(rayInvDir, rayOriginDivDir, childA->GetBox_Simd8(), maxDistances, distanceA);
             const Int32 intMaskA = maskA.GetSignMask();
 
             // Note: according to Intel manuals, prefetch instructions should not be grouped together
             RT_PREFETCH_L1(nodes + childB->childIndex);
 
             math::Vector8 distanceB;
-            const math::Vector8 maskB = Intersect_BoxRay_Simd8(rayInvDir, rayOriginDivDir, childB->GetBox_Simd8(), context.hitPoint.distance, distanceB);
+            const math::Vector8 maskB = Intersect_BoxRay_Simd8(rayInvDir, rayOriginDivDir, childB->GetBox_Simd8(), maxDistances, distanceB);
             const Int32 intMaskB = maskB.GetSignMask();
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
-            context.context.localCounters.numRayBoxTests += 2 * 8;
-            context.context.localCounters.numPassedRayBoxTests += math::PopCount(intMaskA);
-            context.context.localCounters.numPassedRayBoxTests += math::PopCount(intMaskB);
+            renderingContext.localCounters.numTraversedNodes++;
+            renderingContext.localCounters.numRayBoxTests += 2 * 8;
+            renderingContext.localCounters.numPassedRayBoxTests += math::PopCount(intMaskA);
+            renderingContext.localCounters.numPassedRayBoxTests += math::PopCount(intMaskB);
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
 
-            if (const Int32 intMaskAB = intMaskA & intMaskB)
+            if (intMaskA && intMaskB)
             {
+                const Int32 intMaskAB = intMaskA & intMaskB;
                 const Int32 intOrderMask = (distanceA < distanceB).GetMask();
                 const Int32 orderMaskA = intOrderMask & intMaskAB;
                 const Int32 orderMaskB = (~intOrderMask) & intMaskAB;
@@ -71,8 +82,6 @@ static void GenericTraverse_Simd8(const SimdTraversalContext& context, const Uin
 
                 currentNode = childA;
                 nodesStack[stackSize++] = childB;
-
-                // TODO switching to single-ray traversal if pop count is equal to one?
                 continue;
             }
 
@@ -97,6 +106,117 @@ static void GenericTraverse_Simd8(const SimdTraversalContext& context, const Uin
         // pop a node
         currentNode = nodesStack[--stackSize];
     }
+
+    return true;
+}
+
+// traverse wide BVH subtree with 8 rays at a time
+// children are visited in order of their centers projected on the direction of the first ray
+// (see TraverseSubtree_Simd8 for the rest)
+template <typename BVHType, typename LeafCallback>
+bool TraverseWideSubtree_Simd8(const typename BVHType::Node* __restrict nodes, const typename BVHType::Node* rootNode, const math::Ray_Simd8& ray, const math::Vector8& maxDistances,
+                               RenderingContext& renderingContext, const LeafCallback& traverseLeaf)
+{
+    RT_UNUSED(renderingContext);
+
+    using NodeType = typename BVHType::Node;
+    constexpr Uint32 Width = BVHType::NumChildren;
+
+    const math::Vector3x8 rayInvDir = ray.invDir;
+    const math::Vector3x8 rayOriginDivDir = ray.origin * ray.invDir;
+    const math::Vector3x8 rayDir(math::Vector8(ray.dir.x[0]), math::Vector8(ray.dir.y[0]), math::Vector8(ray.dir.z[0]));
+
+    struct StackFrame
+    {
+        const NodeType* node;
+        Uint32 childSlot;
+    };
+
+    StackFrame stack[BVH::MaxDepth * Width];
+    Uint32 stackSize = 0;
+
+    const auto pushChildren = [&](const NodeType* node)
+    {
+        const math::Box_Simd8 boxes = node->GetChildBoxes_Simd8();
+        const math::Vector3x8 centers = boxes.min + boxes.max;
+        const math::Vector8 projections = math::Vector8::MulAndAdd(centers.x, rayDir.x,
+                                          math::Vector8::MulAndAdd(centers.y, rayDir.y, centers.z * rayDir.z));
+
+        // sort by decreasing projection, so the closest child is on top of the stack
+        const Uint32 firstFrame = stackSize;
+        for (Uint32 slot = 0; slot < Width && node->IsChildValid(slot); ++slot)
+        {
+            Uint32 i = stackSize++;
+            for (; i > firstFrame && projections[stack[i - 1].childSlot] < projections[slot]; --i)
+            {
+                stack[i] = stack[i - 1];
+            }
+            stack[i] = { node, slot };
+        }
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        renderingContext.localCounters.numTraversedNodes++;
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+    };
+
+    pushChildren(rootNode);
+
+    while (stackSize > 0)
+    {
+        const StackFrame frame = stack[--stackSize];
+
+        math::Vector8 distance;
+        const math::Vector8 mask = Intersect_BoxRay_Simd8(rayInvDir, rayOriginDivDir, frame.node->GetChildBox_Simd8(frame.childSlot), maxDistances, distance);
+        const Int32 intMask = mask.GetSignMask();
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        renderingContext.localCounters.numRayBoxTests += 8;
+        renderingContext.localCounters.numPassedRayBoxTests += math::PopCount(intMask);
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+        if (intMask == 0)
+        {
+            continue;
+        }
+
+        if (frame.node->IsChildLeaf(frame.childSlot))
+        {
+            const BVH::Node leaf = BVHType::MakeLeaf(frame.node->childIndex[frame.childSlot], frame.node->childNumLeaves[frame.childSlot]);
+            if (!traverseLeaf(leaf))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            const NodeType* childNode = nodes + frame.node->childIndex[frame.childSlot];
+            RT_PREFETCH_L1(childNode);
+            pushChildren(childNode);
+        }
+    }
+
+    return true;
+}
+
+// traverse 8 rays at a time
+template <typename ObjectType>
+void GenericTraverse_Simd8(const SimdTraversalContext& context, const Uint32 objectID, const ObjectType* object)
+{
+    if (object->GetBVH().GetNumNodes() == 0)
+    {
+        // tree is empty
+        return;
+    }
+
+    const BVH::Node* __restrict nodes = object->GetBVH().GetNodes();
+
+    const auto traverseLeaf = [&](const BVH::Node& node)
+    {
+        object->Traverse_Leaf_Simd8(context, objectID, node);
+        return true;
+    };
+
+    TraverseSubtree_Simd8(nodes, nodes, context.ray, context.hitPoint.distance, context.context, traverseLeaf);
 }
 
 } // namespace rt
@@ -4,9 +4,13 @@
 #include "TraversalContext.h"
 #include "Math/Ray.h"
 #include "BVH/BVH.h"
+#include "BVH/WideBVH.h"
+#include "BVH/MotionBVH.h"
 #include "Math/Geometry.h"
+#include "Math/Simd8Geometry.h"
 #include "Utils/iacaMarks.h"
 #include "Rendering/Counters.h"
+#include "Rendering/Context.h"
 
 
 namespace rt {
@@ -42,6 +46,10 @@ void GenericTraverse_Single(const SingleTraversalContext& context, const Uint32
             const BVH::Node* __restrict childA = nodes + currentNode->childIndex;
             const BVH::Node* __restrict childB = childA + 1;
 
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+            context.context.localCounters.numTraversedNodes++;
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
             // prefetch grand-children
             RT_PREFETCH_L1(nodes + childA->childIndex);
 
@@ -128,6 +136,10 @@ bool GenericTraverse_Shadow_Single(const SingleTraversalContext& context, const
             const BVH::Node* __restrict childA = nodes + currentNode->childIndex;
             const BVH::Node* __restrict childB = childA + 1;
 
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+            context.context.localCounters.numTraversedNodes++;
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
             // prefetch grand-children
             RT_PREFETCH_L1(nodes + childA->childIndex);
 
@@ -178,4 +190,324 @@ bool GenericTraverse_Shadow_Single(const SingleTraversalContext& context, const
     return false;
 }
 
+// single-ray traversal of a wide BVH
+// all children of a node are tested at once, hit children are visited in front-to-back order
+template <typename ObjectType, Uint32 Width>
+void GenericTraverse_Wide_Single(const SingleTraversalContext& context, const Uint32 objectID, const ObjectType* object)
+{
+    using BVHType = typename std::decay<decltype(object->GetWideBVH())>::type;
+    using NodeType = typename BVHType::Node;
+    static_assert(BVHType::NumChildren == Width, "Invalid BVH width");
+
+    struct StackEntry
+    {
+        Uint32 index;       // node index or first leaf index
+        Uint32 numLeaves;   // 0 for inner nodes
+        float distance;     // distance to the node's box
+    };
+
+    const BVHType& bvh = object->GetWideBVH();
+    if (bvh.GetNumNodes() == 0)
+    {
+        // tree is empty
+        return;
+    }
+
+    // all nodes
+    const NodeType* __restrict nodes = bvh.GetNodes();
+
+    const math::Vector3x8 rayInvDir(context.ray.invDir);
+    const math::Vector3x8 rayOriginDivDir(context.ray.originDivDir);
+
+    // "nodes to visit" stack
+    Uint32 stackSize = 1;
+    StackEntry nodesStack[BVH::MaxDepth * Width];
+    nodesStack[0] = { 0, 0, 0.0f };
+
+    // BVH traversal
+    while (stackSize > 0)
+    {
+        // pop a node
+        const StackEntry entry = nodesStack[--stackSize];
+
+        // box occlusion (closer hit was found after the node was pushed)
+        if (entry.distance > context.hitPoint.distance)
+        {
+            continue;
+        }
+
+        if (entry.numLeaves > 0)
+        {
+            object->Traverse_Leaf_Single(context, objectID, BVHType::MakeLeaf(entry.index, entry.numLeaves));
+            continue;
+        }
+
+        const NodeType& node = nodes[entry.index];
+
+        math::Vector8 distances;
+        const math::Vector8 hitMask = math::Intersect_BoxRay_Simd8(rayInvDir, rayOriginDivDir, node.GetChildBoxes_Simd8(),
+                                                                   math::Vector8(context.hitPoint.distance), distances);
+        Uint32 mask = hitMask.GetSignMask() & node.GetValidChildrenMask();
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        context.context.localCounters.numTraversedNodes++;
+        context.context.localCounters.numRayBoxTests += Width;
+        context.context.localCounters.numPassedRayBoxTests += math::PopCount(mask);
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+        // push hit children sorted by distance, so the closest one is on top of the stack
+        const Uint32 firstEntry = stackSize;
+        for (Uint32 slot = 0; mask != 0; ++slot, mask >>= 1)
+        {
+            if (mask & 1)
+            {
+                const StackEntry childEntry = { node.childIndex[slot], node.childNumLeaves[slot], distances[slot] };
+
+                Uint32 i = stackSize++;
+                for (; i > firstEntry && nodesStack[i - 1].distance < childEntry.distance; --i)
+                {
+                    nodesStack[i] = nodesStack[i - 1];
+                }
+                nodesStack[i] = childEntry;
+            }
+        }
+    }
+}
+
+template <typename ObjectType, Uint32 Width>
+bool GenericTraverse_Wide_Shadow_Single(const SingleTraversalContext& context, const ObjectType* object)
+{
+    using BVHType = typename std::decay<decltype(object->GetWideBVH())>::type;
+    using NodeType = typename BVHType::Node;
+    static_assert(BVHType::NumChildren == Width, "Invalid BVH width");
+
+    const BVHType& bvh = object->GetWideBVH();
+    if (bvh.GetNumNodes() == 0)
+    {
+        // tree is empty
+        return false;
+    }
+
+    // all nodes
+    const NodeType* __restrict nodes = bvh.GetNodes();
+
+    const math::Vector3x8 rayInvDir(context.ray.invDir);
+    const math::Vector3x8 rayOriginDivDir(context.ray.originDivDir);
+    const math::Vector8 maxDistance(context.hitPoint.distance);
+
+    // "nodes to visit" stack
+    Uint32 stackSize = 0;
+    const NodeType* __restrict nodesStack[BVH::MaxDepth * Width];
+
+    // BVH traversal
+    for (const NodeType* __restrict currentNode = nodes;;)
+    {
+        math::Vector8 distances;
+        const math::Vector8 hitMask = math::Intersect_BoxRay_Simd8(rayInvDir, rayOriginDivDir, currentNode->GetChildBoxes_Simd8(), maxDistance, distances);
+        Uint32 mask = hitMask.GetSignMask() & currentNode->GetValidChildrenMask();
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        context.context.localCounters.numTraversedNodes++;
+        context.context.localCounters.numRayBoxTests += Width;
+        context.context.localCounters.numPassedRayBoxTests += math::PopCount(mask);
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+        // any hit terminates the traversal, so there's no need for sorting
+        for (Uint32 slot = 0; mask != 0; ++slot, mask >>= 1)
+        {
+            if (mask & 1)
+            {
+                if (currentNode->IsChildLeaf(slot))
+                {
+                    const BVH::Node leaf = BVHType::MakeLeaf(currentNode->childIndex[slot], currentNode->childNumLeaves[slot]);
+                    if (object->Traverse_Leaf_Shadow_Single(context, leaf))
+                    {
+                        return true;
+                    }
+                }
+                else
+                {
+                    nodesStack[stackSize++] = nodes + currentNode->childIndex[slot];
+                }
+            }
+        }
+
+        if (stackSize == 0)
+        {
+            break;
+        }
+
+        // pop a node
+        currentNode = nodesStack[--stackSize];
+    }
+
+    return false;
+}
+
+// single-ray traversal of a motion BVH
+// node boxes are interpolated for the ray's time
+template <typename ObjectType>
+void GenericTraverse_Motion_Single(const SingleTraversalContext& context, const Uint32 objectID, const ObjectType* object)
+{
+    float distanceA, distanceB;
+
+    if (object->GetMotionBVH().GetNumNodes() == 0)
+    {
+        // tree is empty
+        return;
+    }
+
+    const float time = context.context.time;
+
+    // all nodes
+    const MotionBVH::Node* __restrict nodes = object->GetMotionBVH().GetNodes();
+
+    // "nodes to visit" stack
+    Uint32 stackSize = 0;
+    const MotionBVH::Node* __restrict nodesStack[BVH::MaxDepth];
+
+    // BVH traversal
+    for (const MotionBVH::Node* __restrict currentNode = nodes;;)
+    {
+        if (currentNode->IsLeaf())
+        {
+            object->Traverse_Leaf_Single(context, objectID, currentNode->start);
+        }
+        else
+        {
+            const MotionBVH::Node* __restrict childA = nodes + currentNode->start.childIndex;
+            const MotionBVH::Node* __restrict childB = childA + 1;
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+            context.context.localCounters.numTraversedNodes++;
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+            bool hitA = Intersect_BoxRay(context.ray, childA->GetBox(time), distanceA);
+            bool hitB = Intersect_BoxRay(context.ray, childB->GetBox(time), distanceB);
+
+            // box occlusion
+            hitA &= (distanceA < context.hitPoint.distance);
+            hitB &= (distanceB < context.hitPoint.distance);
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+            context.context.localCounters.numRayBoxTests += 2;
+            context.context.localCounters.numPassedRayBoxTests += hitA ? 1 : 0;
+            context.context.localCounters.numPassedRayBoxTests += hitB ? 1 : 0;
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+            if (hitA && hitB)
+            {
+                // will push [childA, childB] or [childB, childA] depending on distances
+                if (distanceB < distanceA)
+                {
+                    std::swap(childA, childB);
+                }
+                nodesStack[stackSize++] = childB;
+                currentNode = childA;
+                continue;
+            }
+            if (hitA)
+            {
+                currentNode = childA;
+                continue;
+            }
+            if (hitB)
+            {
+                currentNode = childB;
+                continue;
+            }
+        }
+
+        if (stackSize == 0)
+        {
+            break;
+        }
+
+        // pop a node
+        currentNode = nodesStack[--stackSize];
+    }
+}
+
+template <typename ObjectType>
+bool GenericTraverse_Motion_Shadow_Single(const SingleTraversalContext& context, const ObjectType* object)
+{
+    float distanceA, distanceB;
+
+    if (object->GetMotionBVH().GetNumNodes() == 0)
+    {
+        // tree is empty
+        return false;
+    }
+
+    const float time = context.context.time;
+
+    // all nodes
+    const MotionBVH::Node* __restrict nodes = object->GetMotionBVH().GetNodes();
+
+    // "nodes to visit" stack
+    Uint32 stackSize = 0;
+    const MotionBVH::Node* __restrict nodesStack[BVH::MaxDepth];
+
+    // BVH traversal
+    for (const MotionBVH::Node* __restrict currentNode = nodes;;)
+    {
+        if (currentNode->IsLeaf())
+        {
+            if (object->Traverse_Leaf_Shadow_Single(context, currentNode->start))
+            {
+                return true;
+            }
+        }
+        else
+        {
+            const MotionBVH::Node* __restrict childA = nodes + currentNode->start.childIndex;
+            const MotionBVH::Node* __restrict childB = childA + 1;
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+            context.context.localCounters.numTraversedNodes++;
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+            bool hitA = Intersect_BoxRay(context.ray, childA->GetBox(time), distanceA);
+            bool hitB = Intersect_BoxRay(context.ray, childB->GetBox(time), distanceB);
+
+            // box occlusion
+            hitA &= (distanceA < context.hitPoint.distance);
+            hitB &= (distanceB < context.hitPoint.distance);
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+            context.context.localCounters.numRayBoxTests += 2;
+            context.context.localCounters.numPassedRayBoxTests += hitA ? 1 : 0;
+            context.context.localCounters.numPassedRayBoxTests += hitB ? 1 : 0;
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+            if (hitA && hitB)
+            {
+                nodesStack[stackSize++] = childB;
+                currentNode = childA;
+                continue;
+            }
+            if (hitA)
+            {
+                currentNode = childA;
+                continue;
+            }
+            if (hitB)
+            {
+                currentNode = childB;
+                continue;
+            }
+        }
+
+        if (stackSize == 0)
+        {
+            break;
+        }
+
+        // pop a node
+        currentNode = nodesStack[--stackSize];
+    }
+
+    return false;
+}
+
 } // namespace rt
@@ -4,6 +4,7 @@
 
 #include <stdlib.h>
 #include <malloc.h>
+#include <utility>
 
 RT_INLINE void* AlignedMalloc(size_t size, size_t alignment)
 {
@@ -107,9 +108,11 @@ public:
         AlignedFree(p);
     }
 
-    void construct(pointer p, const value_type & wert)
+    // forwarding, so move-only types can be stored too
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args)
     {
-        new (p) value_type(wert);
+        new (p) U(std::forward<Args>(args)...);
     }
 
     void destroy(pointer p)
@@ -0,0 +1,209 @@
+#include "PCH.h"
+#include "CpuFeatures.h"
+#include "Logger.h"
+
+#if defined(WIN32)
+#include <intrin.h>
+#elif defined(__LINUX__) | defined(__linux__)
+#include <cpuid.h>
+#endif // defined(WIN32)
+
+namespace rt {
+
+namespace {
+
+struct CpuidResult
+{
+    Uint32 eax;
+    Uint32 ebx;
+    Uint32 ecx;
+    Uint32 edx;
+};
+
+CpuidResult Cpuid(Uint32 leaf, Uint32 subleaf)
+{
+    CpuidResult result;
+#if defined(WIN32)
+    int regs[4];
+    __cpuidex(regs, static_cast<int>(leaf), static_cast<int>(subleaf));
+    result.eax = static_cast<Uint32>(regs[0]);
+    result.ebx = static_cast<Uint32>(regs[1]);
+    result.ecx = static_cast<Uint32>(regs[2]);
+    result.edx = static_cast<Uint32>(regs[3]);
+#elif defined(__LINUX__) | defined(__linux__)
+    __cpuid_count(leaf, subleaf, result.eax, result.ebx, result.ecx, result.edx);
+#endif // defined(WIN32)
+    return result;
+}
+
+// extended control register (register state enabled by the operating system)
+Uint64 GetXCR0()
+{
+#if defined(WIN32)
+    return _xgetbv(0);
+#elif defined(__LINUX__) | defined(__linux__)
+    Uint32 eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<Uint64>(edx) << 32u) | eax;
+#endif // defined(WIN32)
+}
+
+RT_FORCE_INLINE bool HasBit(Uint32 value, Uint32 bit)
+{
+    return (value & (1u << bit)) != 0;
+}
+
+CpuFeatures DetectCpuFeatures()
+{
+    CpuFeatures features;
+
+    const Uint32 maxLeaf = Cpuid(0, 0).eax;
+    if (maxLeaf < 1)
+    {
+        return features;
+    }
+
+    const CpuidResult leaf1 = Cpuid(1, 0);
+    features.sse42 = HasBit(leaf1.ecx, 20);
+
+    // AVX registers must be enabled by the OS (XMM and YMM state)
+    const bool osxsave = HasBit(leaf1.ecx, 27);
+    const Uint64 xcr0 = osxsave ? GetXCR0() : 0;
+    const bool osAvx = (xcr0 & 0x6) == 0x6;
+    const bool osAvx512 = (xcr0 & 0xE6) == 0xE6; // + opmask, upper ZMM and high ZMM state
+
+    features.avx = osAvx && HasBit(leaf1.ecx, 28);
+    features.fma = features.avx && HasBit(leaf1.ecx, 12);
+    features.f16c = features.avx && HasBit(leaf1.ecx, 29);
+
+    if (maxLeaf >= 7)
+    {
+        const CpuidResult leaf7 = Cpuid(7, 0);
+        features.avx2 = features.avx && HasBit(leaf7.ebx, 5);
+        features.avx512f = osAvx512 && HasBit(leaf7.ebx, 16);
+        features.avx512dq = osAvx512 && HasBit(leaf7.ebx, 17);
+        features.avx512bw = osAvx512 && HasBit(leaf7.ebx, 30);
+        features.avx512vl = osAvx512 && HasBit(leaf7.ebx, 31);
+    }
+
+    return features;
+}
+
+bool IsKernelInstructionSetCompiled(InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+    case InstructionSet::SSE42:
+    case InstructionSet::AVX2:
+        return true;
+#ifdef RT_ENABLE_AVX512_KERNELS
+    case InstructionSet::AVX512:
+        return true;
+#endif // RT_ENABLE_AVX512_KERNELS
+    }
+
+    return false;
+}
+
+InstructionSet SelectKernelInstructionSet()
+{
+    const InstructionSet supported = GetCpuFeatures().GetInstructionSet();
+    if (supported == InstructionSet::AVX512 && IsKernelInstructionSetCompiled(InstructionSet::AVX512))
+    {
+        return InstructionSet::AVX512;
+    }
+
+    if (supported >= InstructionSet::AVX2)
+    {
+        return InstructionSet::AVX2;
+    }
+
+    return GetBaselineInstructionSet();
+}
+
+} // namespace
+
+InstructionSet gKernelInstructionSet = SelectKernelInstructionSet();
+
+InstructionSet CpuFeatures::GetInstructionSet() const
+{
+    if (avx512f && avx512dq && avx512bw && avx512vl && avx2 && fma && f16c)
+    {
+        return InstructionSet::AVX512;
+    }
+
+    if (avx2 && fma && f16c)
+    {
+        return InstructionSet::AVX2;
+    }
+
+    return InstructionSet::SSE42;
+}
+
+const CpuFeatures& GetCpuFeatures()
+{
+    static const CpuFeatures features = DetectCpuFeatures();
+    return features;
+}
+
+const char* GetInstructionSetName(InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+    case InstructionSet::SSE42:     return "SSE4.2";
+    case InstructionSet::AVX2:      return "AVX2";
+    case InstructionSet::AVX512:    return "AVX-512";
+    }
+
+    return "unknown";
+}
+
+InstructionSet GetBaselineInstructionSet()
+{
+#if defined(RT_USE_AVX2) && defined(RT_USE_FMA) && defined(RT_USE_FP16C)
+    return InstructionSet::AVX2;
+#else
+    return InstructionSet::SSE42;
+#endif // defined(RT_USE_AVX2) && defined(RT_USE_FMA) && defined(RT_USE_FP16C)
+}
+
+bool SetKernelInstructionSet(InstructionSet instructionSet)
+{
+    if (instructionSet < GetBaselineInstructionSet() || !IsKernelInstructionSetCompiled(instructionSet))
+    {
+        RT_LOG_ERROR("Kernels are not compiled for %s instruction set", GetInstructionSetName(instructionSet));
+        return false;
+    }
+
+    if (instructionSet > GetCpuFeatures().GetInstructionSet())
+    {
+        RT_LOG_ERROR("%s instruction set is not supported by the CPU", GetInstructionSetName(instructionSet));
+        return false;
+    }
+
+    gKernelInstructionSet = instructionSet;
+    return true;
+}
+
+bool InitializeCpuFeatures()
+{
+    const CpuFeatures& features = GetCpuFeatures();
+
+    RT_LOG_INFO("CPU features: SSE4.2=%u, AVX=%u, AVX2=%u, FMA=%u, F16C=%u, AVX-512 (F=%u, DQ=%u, BW=%u, VL=%u)",
+                features.sse42, features.avx, features.avx2, features.fma, features.f16c,
+                features.avx512f, features.avx512dq, features.avx512bw, features.avx512vl);
+
+    if (features.GetInstructionSet() < GetBaselineInstructionSet())
+    {
+        RT_LOG_ERROR("The library requires %s instruction set, but the CPU supports only %s",
+                     GetInstructionSetName(GetBaselineInstructionSet()), GetInstructionSetName(features.GetInstructionSet()));
+        return false;
+    }
+
+    gKernelInstructionSet = SelectKernelInstructionSet();
+    RT_LOG_INFO("Using %s kernels (baseline: %s)", GetInstructionSetName(gKernelInstructionSet), GetInstructionSetName(GetBaselineInstructionSet()));
+
+    return true;
+}
+
+} // namespace rt
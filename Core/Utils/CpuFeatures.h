@@ -0,0 +1,56 @@
+#pragma once
+
+#include "../RayLib.h"
+
+
+namespace rt {
+
+// instruction set levels of SIMD kernels
+enum class InstructionSet : Uint8
+{
+    SSE42,
+    AVX2,       // AVX2 + FMA + F16C
+    AVX512,     // AVX-512 F + DQ + BW + VL
+};
+
+// instruction set extensions supported by both the CPU and the operating system
+struct CpuFeatures
+{
+    bool sse42 = false;
+    bool avx = false;
+    bool avx2 = false;
+    bool fma = false;
+    bool f16c = false;
+    bool avx512f = false;
+    bool avx512dq = false;
+    bool avx512bw = false;
+    bool avx512vl = false;
+
+    // best instruction set level supported
+    InstructionSet GetInstructionSet() const;
+};
+
+RAYLIB_API const CpuFeatures& GetCpuFeatures();
+
+RAYLIB_API const char* GetInstructionSetName(InstructionSet instructionSet);
+
+// instruction set the whole library is compiled for (required to run at all)
+RAYLIB_API InstructionSet GetBaselineInstructionSet();
+
+// select variant of SIMD kernels, fails if the CPU does not support the instruction set
+// or the kernels were not compiled for it
+RAYLIB_API bool SetKernelInstructionSet(InstructionSet instructionSet);
+
+// detect CPU features and select the best kernels, the chosen path is logged
+// should be called at application startup, fails if the CPU can't run the library
+RAYLIB_API bool InitializeCpuFeatures();
+
+// instruction set of runtime-dispatched kernels (selected at library load, see InitializeCpuFeatures)
+extern RAYLIB_API InstructionSet gKernelInstructionSet;
+
+RT_FORCE_INLINE InstructionSet GetKernelInstructionSet()
+{
+    return gKernelInstructionSet;
+}
+
+} // namespace rt
@@ -0,0 +1,148 @@
+#include "PCH.h"
+#include "FileMapping.h"
+#include "Logger.h"
+
+#if defined(__LINUX__) | defined(__linux__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif // defined(__LINUX__) | defined(__linux__)
+
+
+namespace rt {
+
+FileMapping::FileMapping()
+#if defined(WIN32)
+    : mFile(INVALID_HANDLE_VALUE)
+    , mMapping(nullptr)
+#elif defined(__LINUX__) | defined(__linux__)
+    : mFile(-1)
+#endif // defined(WIN32)
+    , mData(nullptr)
+    , mSize(0)
+{ }
+
+FileMapping::~FileMapping()
+{
+    Close();
+}
+
+bool FileMapping::Open(const std::string& filePath)
+{
+    Close();
+
+#if defined(WIN32)
+
+    mFile = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (mFile == INVALID_HANDLE_VALUE)
+    {
+        RT_LOG_ERROR("Failed to open file '%s' for mapping. Error code: %u", filePath.c_str(), GetLastError());
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(mFile, &fileSize))
+    {
+        RT_LOG_ERROR("Failed to obtain size of file '%s'. Error code: %u", filePath.c_str(), GetLastError());
+        Close();
+        return false;
+    }
+    mSize = static_cast<size_t>(fileSize.QuadPart);
+
+    if (mSize > 0)
+    {
+        mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mMapping)
+        {
+            RT_LOG_ERROR("Failed to create mapping of file '%s'. Error code: %u", filePath.c_str(), GetLastError());
+            Close();
+            return false;
+        }
+
+        mData = MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+        if (!mData)
+        {
+            RT_LOG_ERROR("Failed to map file '%s'. Error code: %u", filePath.c_str(), GetLastError());
+            Close();
+            return false;
+        }
+    }
+
+#elif defined(__LINUX__) | defined(__linux__)
+
+    mFile = open(filePath.c_str(), O_RDONLY);
+    if (mFile == -1)
+    {
+        RT_LOG_ERROR("Failed to open file '%s' for mapping. Error code: %i", filePath.c_str(), errno);
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(mFile, &fileStat) != 0)
+    {
+        RT_LOG_ERROR("Failed to obtain size of file '%s'. Error code: %i", filePath.c_str(), errno);
+        Close();
+        return false;
+    }
+    mSize = static_cast<size_t>(fileStat.st_size);
+
+    if (mSize > 0)
+    {
+        void* data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, mFile, 0);
+        if (data == MAP_FAILED)
+        {
+            RT_LOG_ERROR("Failed to map file '%s'. Error code: %i", filePath.c_str(), errno);
+            mSize = 0;
+            Close();
+            return false;
+        }
+        mData = data;
+    }
+
+#endif // defined(WIN32)
+
+    return true;
+}
+
+void FileMapping::Close()
+{
+#if defined(WIN32)
+
+    if (mData)
+    {
+        UnmapViewOfFile(mData);
+    }
+
+    if (mMapping)
+    {
+        CloseHandle(mMapping);
+        mMapping = nullptr;
+    }
+
+    if (mFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(mFile);
+        mFile = INVALID_HANDLE_VALUE;
+    }
+
+#elif defined(__LINUX__) | defined(__linux__)
+
+    if (mData)
+    {
+        munmap(const_cast<void*>(mData), mSize);
+    }
+
+    if (mFile != -1)
+    {
+        close(mFile);
+        mFile = -1;
+    }
+
+#endif // defined(WIN32)
+
+    mData = nullptr;
+    mSize = 0;
+}
+
+} // namespace rt
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "../RayLib.h"
+
+#include <string>
+
+
+namespace rt {
+
+/**
+ * Read-only memory mapped file.
+ */
+class RAYLIB_API FileMapping
+{
+public:
+    FileMapping();
+    ~FileMapping();
+
+    FileMapping(const FileMapping&) = delete;
+    FileMapping& operator = (const FileMapping&) = delete;
+
+    // map whole file into memory
+    bool Open(const std::string& filePath);
+
+    // unmap the file
+    void Close();
+
+    RT_FORCE_INLINE const void* GetData() const { return mData; }
+    RT_FORCE_INLINE size_t GetSize() const { return mSize; }
+
+private:
+#if defined(WIN32)
+    void* mFile;
+    void* mMapping;
+#elif defined(__LINUX__) | defined(__linux__)
+    int mFile;
+#endif // defined(WIN32)
+
+    const void* mData;
+    size_t mSize;
+};
+
+} // namespace rt
@@ -0,0 +1,48 @@
+#include "PCH.h"
+#include "Hash.h"
+
+
+namespace rt {
+
+Uint64 Hash64(const void* data, size_t size, Uint64 seed)
+{
+    const Uint64 m = 0xc6a4a7935bd1e995ull;
+    const int r = 47;
+
+    Uint64 h = seed ^ (size * m);
+
+    const Uint8* bytes = static_cast<const Uint8*>(data);
+    const size_t numBlocks = size / 8;
+
+    for (size_t i = 0; i < numBlocks; ++i)
+    {
+        Uint64 k;
+        memcpy(&k, bytes + 8 * i, sizeof(k));
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        h ^= k;
+        h *= m;
+    }
+
+    const Uint8* tail = bytes + 8 * numBlocks;
+    const size_t tailSize = size & 7;
+    if (tailSize > 0)
+    {
+        for (size_t i = tailSize; i-- > 0; )
+        {
+            h ^= Uint64(tail[i]) << (8 * i);
+        }
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+
+    return h;
+}
+
+} // namespace rt
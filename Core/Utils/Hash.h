@@ -0,0 +1,12 @@
+#pragma once
+
+#include "../RayLib.h"
+
+
+namespace rt {
+
+// 64-bit non-cryptographic hash of a memory block (MurmurHash64A)
+// NOTE: the result depends on the platform's endianness
+Uint64 RAYLIB_API Hash64(const void* data, size_t size, Uint64 seed = 0);
+
+} // namespace rt
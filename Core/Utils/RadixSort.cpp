@@ -0,0 +1,110 @@
+#include "PCH.h"
+#include "RadixSort.h"
+#include "ThreadPool.h"
+
+
+namespace rt {
+
+namespace {
+
+const Uint32 RadixBits = 8;
+const Uint32 NumBuckets = 1u << RadixBits;
+
+// chunks smaller than this are not worth a separate task
+const size_t MinKeysPerChunk = 16 * 1024;
+
+} // namespace
+
+void RadixSort(std::vector<Uint64>& keys, std::vector<Uint32>& values, Uint32 numKeyBits, ThreadPool* threadPool)
+{
+    RT_ASSERT(keys.size() == values.size());
+    RT_ASSERT(numKeyBits <= 64);
+
+    const size_t numKeys = keys.size();
+    if (numKeys < 2)
+    {
+        return;
+    }
+
+    const size_t maxNumChunks = threadPool ? threadPool->GetNumThreads() : 1;
+    const Uint32 numChunks = static_cast<Uint32>(std::max<size_t>(1, std::min(maxNumChunks, numKeys / MinKeysPerChunk)));
+    const size_t keysPerChunk = (numKeys + numChunks - 1) / numChunks;
+
+    std::vector<Uint64> tempKeys(numKeys);
+    std::vector<Uint32> tempValues(numKeys);
+
+    // per chunk histograms, turned into scatter offsets in place
+    std::vector<size_t> offsets(numChunks * NumBuckets);
+
+    const auto runChunks = [&](const ParallelTask& task)
+    {
+        if (numChunks > 1)
+        {
+            threadPool->RunParallelTask(task, numChunks);
+        }
+        else
+        {
+            task(0, 0);
+        }
+    };
+
+    for (Uint32 shift = 0; shift < numKeyBits; shift += RadixBits)
+    {
+        runChunks([&](Uint32 chunk, Uint32)
+        {
+            size_t* histogram = offsets.data() + chunk * NumBuckets;
+            std::fill_n(histogram, NumBuckets, 0);
+
+            const size_t end = std::min(numKeys, (chunk + 1) * keysPerChunk);
+            for (size_t i = chunk * keysPerChunk; i < end; ++i)
+            {
+                histogram[(keys[i] >> shift) & (NumBuckets - 1)]++;
+            }
+        });
+
+        // all the keys fall into a single bucket, nothing to do in this pass
+        {
+            size_t bucketSize = 0;
+            const size_t bucket = (keys.front() >> shift) & (NumBuckets - 1);
+            for (Uint32 chunk = 0; chunk < numChunks; ++chunk)
+            {
+                bucketSize += offsets[chunk * NumBuckets + bucket];
+            }
+
+            if (bucketSize == numKeys)
+            {
+                continue;
+            }
+        }
+
+        // buckets are laid out one after another, each chunk writes its part of a bucket after the previous chunks
+        size_t offset = 0;
+        for (Uint32 bucket = 0; bucket < NumBuckets; ++bucket)
+        {
+            for (Uint32 chunk = 0; chunk < numChunks; ++chunk)
+            {
+                const size_t count = offsets[chunk * NumBuckets + bucket];
+                offsets[chunk * NumBuckets + bucket] = offset;
+                offset += count;
+            }
+        }
+
+        runChunks([&](Uint32 chunk, Uint32)
+        {
+            size_t* chunkOffsets = offsets.data() + chunk * NumBuckets;
+
+            const size_t end = std::min(numKeys, (chunk + 1) * keysPerChunk);
+            for (size_t i = chunk * keysPerChunk; i < end; ++i)
+            {
+                const size_t target = chunkOffsets[(keys[i] >> shift) & (NumBuckets - 1)]++;
+                tempKeys[target] = keys[i];
+                tempValues[target] = values[i];
+            }
+        });
+
+        keys.swap(tempKeys);
+        values.swap(tempValues);
+    }
+}
+
+} // namespace rt
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "../RayLib.h"
+
+#include <vector>
+
+
+namespace rt {
+
+class ThreadPool;
+
+// stable LSD radix sort of keys along with values (8 bits per pass)
+// only the given number of the lowest key bits is sorted, passes over digits shared by all the keys are skipped
+// keys are split into chunks processed in parallel if the thread pool is provided
+void RAYLIB_API RadixSort(std::vector<Uint64>& keys, std::vector<Uint32>& values, Uint32 numKeyBits, ThreadPool* threadPool = nullptr);
+
+} // namespace rt
@@ -79,9 +79,11 @@ void ThreadPool::ThreadCallback(Uint32 threadID)
 
         mTask(taskID, threadID);
 
+        if (--mTasksLeft == 0)
         {
-            if (--mTasksLeft == 0)
-                mTileFinishedCV.notify_all();
+            // notify under the lock, so the waiting thread can't miss it
+            Lock lock(mMutex);
+            mTileFinishedCV.notify_all();
         }
     }
 }
@@ -107,7 +109,8 @@ void ThreadPool::RunParallelTask(const ParallelTask& task, Uint32 num)
 
         mNewTaskCV.notify_all();
 
-        mTileFinishedCV.wait(lock);
+        while (mTasksLeft > 0)
+            mTileFinishedCV.wait(lock);
     }
 }
 
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "../Common.h"
+#include "../RayLib.h"
 
 #include <functional>
 #include <thread>
@@ -13,7 +13,7 @@ namespace rt {
 
 using ParallelTask = std::function<void(Uint32 taskID, Uint32 threadID)>;
 
-class ThreadPool
+class RAYLIB_API ThreadPool
 {
 public:
     struct TaskCoords
@@ -27,6 +27,7 @@ DemoWindow::DemoWindow()
     , mCameraSpeed(1.0f)
     , mSelectedMaterial(nullptr)
     , mSelectedObject(nullptr)
+    , mSelectedObjectID(UINT32_MAX)
 {
     ResetFrame();
     ResetCounters();
@@ -140,6 +141,7 @@ void DemoWindow::SwitchScene(const SceneInitCallback& initFunction)
 
     mSelectedMaterial = nullptr;
     mSelectedObject = nullptr;
+    mSelectedObjectID = UINT32_MAX;
 
     mRenderer = std::make_unique<PathTracer>(*mScene);
     mDebugRenderer = std::make_unique<DebugRenderer>(*mScene);
@@ -241,7 +243,8 @@ void DemoWindow::OnMouseDown(MouseButton button, int x, int y)
         if (mPathDebugData.data[0].hitPoint.objectId != UINT32_MAX)
         {
             mSelectedMaterial = const_cast<Material*>(mPathDebugData.data[0].shadingData.material);
-            mSelectedObject = const_cast<ISceneObject*>(mScene->GetObjects()[mPathDebugData.data[0].hitPoint.objectId].get());
+            mSelectedObjectID = mPathDebugData.data[0].hitPoint.objectId;
+            mSelectedObject = const_cast<ISceneObject*>(mScene->GetObjects()[mSelectedObjectID].get());
         }
     }
 }
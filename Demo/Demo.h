@@ -99,6 +99,7 @@ private:
     rt::PathDebugData mPathDebugData;
     rt::Material* mSelectedMaterial;
     rt::ISceneObject* mSelectedObject;
+    Uint32 mSelectedObjectID;
     bool mFocalDistancePicking = false;
 
     void InitializeUI();
@@ -51,6 +51,9 @@ void DemoWindow::RenderUI_Stats()
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
     const RayTracingCounters& counters = mViewport->GetCounters();
     ImGui::Separator();
+    ImGui::Text("Traversed BVH nodes"); ImGui::NextColumn();
+    ImGui::Text("%.2fM", (float)counters.numTraversedNodes / 1000000.0f); ImGui::NextColumn();
+
     ImGui::Text("Ray-box tests (total)"); ImGui::NextColumn();
     ImGui::Text("%.2fM", (float)counters.numRayBoxTests / 1000000.0f); ImGui::NextColumn();
 
@@ -464,7 +467,7 @@ bool DemoWindow::RenderUI_Settings_Object()
 
     if (positionChanged)
     {
-        mScene->BuildBVH();
+        mScene->UpdateObject(mSelectedObjectID);
     }
 
     return positionChanged;
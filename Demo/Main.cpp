@@ -3,6 +3,7 @@
 
 #include "../External/cxxopts.hpp"
 #include "../Core/Utils/Logger.h"
+#include "../Core/Utils/CpuFeatures.h"
 
 bool ParseOptions(int argc, char** argv, Options& outOptions)
 {
@@ -59,6 +60,11 @@ int main(int argc, char* argv[])
 {
     rt::math::SetFlushDenormalsToZero();
 
+    if (!rt::InitializeCpuFeatures())
+    {
+        return 1;
+    }
+
     if (!ParseOptions(argc, argv, gOptions))
     {
         return 1;
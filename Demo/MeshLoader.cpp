@@ -271,6 +271,11 @@ MeshPtr LoadMesh(const std::string& filePath, MaterialsList& outMaterials, const
 
     MeshDesc meshDesc;
     meshDesc.path = filePath;
+    meshDesc.useSpatialSplits = true;
+
+    // keep BVH cache next to the mesh file
+    const size_t lastSlash = filePath.find_last_of("/\\");
+    meshDesc.bvhCacheDirectory = lastSlash != std::string::npos ? filePath.substr(0, lastSlash) : ".";
     meshDesc.vertexBufferDesc.numTriangles = static_cast<Uint32>(vertexIndices.size() / 3);
     meshDesc.vertexBufferDesc.numVertices = static_cast<Uint32>(vertexPositions.size() / 3);
     meshDesc.vertexBufferDesc.numMaterials = static_cast<Uint32>(materialPointers.size());
@@ -0,0 +1,1840 @@
+#include "PCH.h"
+#include "../Core/BVH/BVHBuilder.h"
+#include "../Core/BVH/BVHUpdater.h"
+#include "../Core/BVH/WideBVH.h"
+#include "../Core/BVH/MotionBVH.h"
+#include "../Core/Math/Random.h"
+#include "../Core/Utils/ThreadPool.h"
+#include "../External/rapidjson/document.h"
+
+#include "gtest/gtest.h"
+
+using namespace rt;
+using namespace math;
+
+namespace {
+
+using Boxes = std::vector<Box, AlignmentAllocator<Box>>;
+
+Boxes GenerateRandomBoxes(Uint32 numBoxes)
+{
+    Random random;
+
+    Boxes boxes;
+    boxes.reserve(numBoxes);
+    for (Uint32 i = 0; i < numBoxes; ++i)
+    {
+        const Vector4 center = random.GetVector4Bipolar() * 100.0f;
+        const Vector4 size = random.GetVector4() * 2.0f;
+        boxes.push_back(Box(center - size, center + size));
+    }
+
+    return boxes;
+}
+
+using Triangles = std::vector<Triangle, AlignmentAllocator<Triangle>>;
+
+// small triangles mixed with long, thin ones (their bounding boxes overlap most of the scene)
+Triangles GenerateThinTriangles(Uint32 numTriangles)
+{
+    Random random;
+
+    Triangles triangles;
+    triangles.reserve(numTriangles);
+    for (Uint32 i = 0; i < numTriangles; ++i)
+    {
+        const Vector4 center = random.GetVector4Bipolar() * 100.0f;
+        const Vector4 offset = random.GetVector4Bipolar();
+        const Vector4 direction = (i % 20 == 0) ? random.GetVector4Bipolar() * 100.0f : random.GetVector4Bipolar();
+        triangles.push_back(Triangle(center - direction, center + direction, center + offset));
+    }
+
+    return triangles;
+}
+
+Boxes CalculateTriangleBoxes(const Triangles& triangles)
+{
+    Boxes boxes;
+    boxes.reserve(triangles.size());
+    for (const Triangle& triangle : triangles)
+    {
+        boxes.push_back(Box(triangle.v0, triangle.v1, triangle.v2));
+    }
+
+    return boxes;
+}
+
+bool BoxContains(const BVH::Node& parent, const BVH::Node& child)
+{
+    return parent.min.x <= child.min.x && parent.min.y <= child.min.y && parent.min.z <= child.min.z &&
+           parent.max.x >= child.max.x && parent.max.y >= child.max.y && parent.max.z >= child.max.z;
+}
+
+bool BoxContains(const Box& parent, const Box& child)
+{
+    return parent.min.x <= child.min.x && parent.min.y <= child.min.y && parent.min.z <= child.min.z &&
+           parent.max.x >= child.max.x && parent.max.y >= child.max.y && parent.max.z >= child.max.z;
+}
+
+// spatial splits can reference a leaf multiple times
+void ValidateBVH(const BVH& bvh, const BVHBuilder::Indices& leavesOrder, Uint32 numLeaves, bool allowDuplicates = false)
+{
+    if (allowDuplicates)
+    {
+        ASSERT_LE(numLeaves, (Uint32)leavesOrder.size());
+    }
+    else
+    {
+        ASSERT_EQ(numLeaves, (Uint32)leavesOrder.size());
+    }
+
+    std::vector<Uint32> leafReferences(numLeaves, 0);
+    for (const Uint32 leafIndex : leavesOrder)
+    {
+        ASSERT_LT(leafIndex, numLeaves);
+        leafReferences[leafIndex]++;
+    }
+
+    for (Uint32 i = 0; i < numLeaves; ++i)
+    {
+        if (allowDuplicates)
+        {
+            EXPECT_LE(1u, leafReferences[i]);
+        }
+        else
+        {
+            EXPECT_EQ(1u, leafReferences[i]);
+        }
+    }
+
+    Uint32 numLeavesInTree = 0;
+    std::vector<Uint32> stack = { 0 };
+    while (!stack.empty())
+    {
+        const BVH::Node& node = bvh.GetNodes()[stack.back()];
+        stack.pop_back();
+
+        if (node.IsLeaf())
+        {
+            EXPECT_EQ(numLeavesInTree, node.childIndex);
+            numLeavesInTree += node.numLeaves;
+            continue;
+        }
+
+        ASSERT_LT(node.childIndex + 1, bvh.GetNumNodes());
+
+        const BVH::Node& childA = bvh.GetNodes()[node.childIndex];
+        const BVH::Node& childB = bvh.GetNodes()[node.childIndex + 1];
+        EXPECT_TRUE(BoxContains(node, childA));
+        EXPECT_TRUE(BoxContains(node, childB));
+
+        // visit left child first, so leaves are visited in order
+        stack.push_back(node.childIndex + 1);
+        stack.push_back(node.childIndex);
+    }
+
+    EXPECT_EQ((Uint32)leavesOrder.size(), numLeavesInTree);
+}
+
+// check if leaf nodes tightly enclose their leaves
+void ValidateLeafBoxes(const BVH& bvh, const Boxes& leafBoxes, const BVHBuilder::Indices& leavesOrder)
+{
+    for (Uint32 i = 0; i < bvh.GetNumNodes(); ++i)
+    {
+        const BVH::Node& node = bvh.GetNodes()[i];
+        if (!node.IsLeaf())
+        {
+            continue;
+        }
+
+        Box box = Box::Empty();
+        for (Uint32 j = 0; j < node.numLeaves; ++j)
+        {
+            box = Box(box, leafBoxes[leavesOrder[node.childIndex + j]]);
+        }
+
+        EXPECT_EQ(box.min.x, node.min.x);
+        EXPECT_EQ(box.min.y, node.min.y);
+        EXPECT_EQ(box.min.z, node.min.z);
+        EXPECT_EQ(box.max.x, node.max.x);
+        EXPECT_EQ(box.max.y, node.max.y);
+        EXPECT_EQ(box.max.z, node.max.z);
+    }
+}
+
+} // namespace
+
+TEST(BVHTest, Build_Empty)
+{
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(nullptr, 0, params, leavesOrder));
+    EXPECT_EQ(0u, bvh.GetNumNodes());
+    EXPECT_TRUE(leavesOrder.empty());
+}
+
+TEST(BVHTest, Build_Single)
+{
+    const Boxes boxes = GenerateRandomBoxes(1);
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(boxes.data(), 1, params, leavesOrder));
+    ASSERT_LE(1u, bvh.GetNumNodes());
+    EXPECT_TRUE(bvh.GetNodes()[0].IsLeaf());
+    ValidateBVH(bvh, leavesOrder, 1);
+}
+
+TEST(BVHTest, Build_LeafCost)
+{
+    const auto buildRow = [](Uint32 numLeaves, Float spacing, BVHBuilder::SplitAlgorithm algorithm, BVH& bvh)
+    {
+        Boxes boxes;
+        for (Uint32 i = 0; i < numLeaves; ++i)
+        {
+            const Vector4 min(spacing * static_cast<Float>(i), 0.0f, 0.0f, 0.0f);
+            boxes.push_back(Box(min, min + Vector4(1.0f, 1.0f, 1.0f, 0.0f)));
+        }
+
+        BVHBuilder::Indices leavesOrder;
+        BVHBuilder::BuildingParams params;
+        params.splitAlgorithm = algorithm;
+
+        BVHBuilder builder(bvh);
+        ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+        ValidateBVH(bvh, leavesOrder, numLeaves);
+    };
+
+    const BVHBuilder::SplitAlgorithm algorithms[] =
+    {
+        BVHBuilder::SplitAlgorithm::Sweep,
+        BVHBuilder::SplitAlgorithm::Binned,
+        BVHBuilder::SplitAlgorithm::Linear,
+    };
+
+    for (const BVHBuilder::SplitAlgorithm algorithm : algorithms)
+    {
+        // overlapping objects are not worth splitting
+        {
+            BVH bvh;
+            buildRow(8, 0.01f, algorithm, bvh);
+            ASSERT_LE(1u, bvh.GetNumNodes());
+            EXPECT_EQ(8u, bvh.GetNodes()[0].numLeaves);
+        }
+
+        // unless there are too many of them
+        {
+            BVH bvh;
+            buildRow(16, 0.01f, algorithm, bvh);
+            ASSERT_LE(1u, bvh.GetNumNodes());
+            EXPECT_FALSE(bvh.GetNodes()[0].IsLeaf());
+        }
+
+        // distant objects are always separated
+        {
+            BVH bvh;
+            buildRow(8, 10.0f, algorithm, bvh);
+
+            BVH::Stats stats;
+            bvh.CalculateStats(stats);
+            EXPECT_EQ(8u, stats.numLeafNodes);
+        }
+    }
+}
+
+TEST(BVHTest, Build_Sweep)
+{
+    const Uint32 numLeaves = 5000;
+    const Boxes boxes = GenerateRandomBoxes(numLeaves);
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+    params.splitAlgorithm = BVHBuilder::SplitAlgorithm::Sweep;
+    params.numThreads = 1;
+
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+    ValidateBVH(bvh, leavesOrder, numLeaves);
+}
+
+TEST(BVHTest, Build_Binned)
+{
+    const Uint32 numLeaves = 5000;
+    const Boxes boxes = GenerateRandomBoxes(numLeaves);
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+    params.splitAlgorithm = BVHBuilder::SplitAlgorithm::Binned;
+    params.numThreads = 1;
+
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+    ValidateBVH(bvh, leavesOrder, numLeaves);
+}
+
+TEST(BVHTest, Build_BinnedDegenerate)
+{
+    // all the leaves have the same center, so no bin split is possible
+    const Uint32 numLeaves = 100;
+    const Boxes boxes(numLeaves, Box(Vector4(-1.0f, -1.0f, -1.0f, 0.0f), Vector4(1.0f, 1.0f, 1.0f, 0.0f)));
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+    params.splitAlgorithm = BVHBuilder::SplitAlgorithm::Binned;
+
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+    ValidateBVH(bvh, leavesOrder, numLeaves);
+}
+
+TEST(BVHTest, Build_BinnedQuality)
+{
+    const Uint32 numLeaves = 20000;
+    const Boxes boxes = GenerateRandomBoxes(numLeaves);
+
+    BVH::Stats sweepStats, binnedStats;
+
+    for (const BVHBuilder::SplitAlgorithm algorithm : { BVHBuilder::SplitAlgorithm::Sweep, BVHBuilder::SplitAlgorithm::Binned })
+    {
+        BVH bvh;
+        BVHBuilder::Indices leavesOrder;
+        BVHBuilder::BuildingParams params;
+        params.splitAlgorithm = algorithm;
+
+        BVHBuilder builder(bvh);
+        ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+        bvh.CalculateStats(algorithm == BVHBuilder::SplitAlgorithm::Sweep ? sweepStats : binnedStats);
+    }
+
+    EXPECT_LT(0.0, sweepStats.sahCost);
+    EXPECT_LT(binnedStats.sahCost, sweepStats.sahCost * 1.1);
+}
+
+TEST(BVHTest, Build_Linear)
+{
+    const Uint32 numLeaves = 5000;
+    const Boxes boxes = GenerateRandomBoxes(numLeaves);
+
+    for (const Uint32 treeletSize : { 0u, 64u })
+    {
+        BVH bvh;
+        BVHBuilder::Indices leavesOrder;
+        BVHBuilder::BuildingParams params;
+        params.splitAlgorithm = BVHBuilder::SplitAlgorithm::Linear;
+        params.agglomerativeTreeletSize = treeletSize;
+        params.numThreads = 1;
+
+        BVHBuilder builder(bvh);
+        ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+        ValidateBVH(bvh, leavesOrder, numLeaves);
+        ValidateLeafBoxes(bvh, boxes, leavesOrder);
+    }
+}
+
+TEST(BVHTest, Build_LinearDegenerate)
+{
+    // all the leaves have the same Morton code
+    const Uint32 numLeaves = 100;
+    const Boxes boxes(numLeaves, Box(Vector4(-1.0f, -1.0f, -1.0f, 0.0f), Vector4(1.0f, 1.0f, 1.0f, 0.0f)));
+
+    for (const Uint32 treeletSize : { 0u, 64u })
+    {
+        BVH bvh;
+        BVHBuilder::Indices leavesOrder;
+        BVHBuilder::BuildingParams params;
+        params.splitAlgorithm = BVHBuilder::SplitAlgorithm::Linear;
+        params.agglomerativeTreeletSize = treeletSize;
+
+        BVHBuilder builder(bvh);
+        ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+        ValidateBVH(bvh, leavesOrder, numLeaves);
+    }
+}
+
+TEST(BVHTest, Build_LinearQuality)
+{
+    const Uint32 numLeaves = 20000;
+    const Boxes boxes = GenerateRandomBoxes(numLeaves);
+
+    const auto calculateCost = [&](BVHBuilder::SplitAlgorithm algorithm, Uint32 treeletSize)
+    {
+        BVH bvh;
+        BVHBuilder::Indices leavesOrder;
+        BVHBuilder::BuildingParams params;
+        params.splitAlgorithm = algorithm;
+        params.agglomerativeTreeletSize = treeletSize;
+
+        BVHBuilder builder(bvh);
+        EXPECT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+
+        BVH::Stats stats;
+        bvh.CalculateStats(stats);
+        return stats.sahCost;
+    };
+
+    const Double binnedCost = calculateCost(BVHBuilder::SplitAlgorithm::Binned, 0);
+    const Double linearCost = calculateCost(BVHBuilder::SplitAlgorithm::Linear, 0);
+    const Double agglomerativeCost = calculateCost(BVHBuilder::SplitAlgorithm::Linear, 64);
+
+    EXPECT_LT(binnedCost, linearCost);
+    EXPECT_LT(agglomerativeCost, linearCost);
+    EXPECT_LT(agglomerativeCost, binnedCost * 1.2);
+}
+
+TEST(BVHTest, Build_Optimized)
+{
+    const Uint32 numLeaves = 20000;
+    const Boxes boxes = GenerateRandomBoxes(numLeaves);
+
+    BVH::Stats unoptimizedStats;
+    {
+        BVH bvh;
+        BVHBuilder::Indices leavesOrder;
+        BVHBuilder::BuildingParams params;
+        params.splitAlgorithm = BVHBuilder::SplitAlgorithm::Linear;
+
+        BVHBuilder builder(bvh);
+        ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+        bvh.CalculateStats(unoptimizedStats);
+        EXPECT_EQ(unoptimizedStats.sahCost, unoptimizedStats.sahCostBeforeOptimization);
+    }
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+    params.splitAlgorithm = BVHBuilder::SplitAlgorithm::Linear;
+    params.optimizationPasses = 2;
+
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+    ValidateBVH(bvh, leavesOrder, numLeaves);
+    ValidateLeafBoxes(bvh, boxes, leavesOrder);
+
+    BVH::Stats stats;
+    bvh.CalculateStats(stats);
+    EXPECT_DOUBLE_EQ(unoptimizedStats.sahCost, stats.sahCostBeforeOptimization);
+    EXPECT_LT(stats.sahCost, stats.sahCostBeforeOptimization * 0.98);
+    EXPECT_LT(stats.maxDepth, (Uint32)BVH::MaxDepth);
+}
+
+namespace {
+
+// compare topology and boxes of two trees (node indices may differ)
+void ExpectEquivalentSubtrees(const BVH& a, Uint32 nodeA, const BVH& b, Uint32 nodeB)
+{
+    const BVH::Node& na = a.GetNodes()[nodeA];
+    const BVH::Node& nb = b.GetNodes()[nodeB];
+    ASSERT_EQ(0, memcmp(&na.min, &nb.min, sizeof(Float3)));
+    ASSERT_EQ(0, memcmp(&na.max, &nb.max, sizeof(Float3)));
+    ASSERT_EQ(na.numLeaves, nb.numLeaves);
+
+    if (na.IsLeaf())
+    {
+        ASSERT_EQ(na.childIndex, nb.childIndex);
+        return;
+    }
+
+    ExpectEquivalentSubtrees(a, na.childIndex, b, nb.childIndex);
+    ExpectEquivalentSubtrees(a, na.childIndex + 1, b, nb.childIndex + 1);
+}
+
+// average number of distinct memory blocks touched on a root-to-leaf path
+Double CalculateAverageBlocksPerPath(const BVH& bvh, Uint32 nodesPerBlock)
+{
+    Uint64 totalBlocks = 0;
+    Uint32 numPaths = 0;
+
+    struct StackFrame
+    {
+        Uint32 node;
+        Uint32 lastBlock;
+        Uint32 numBlocks;
+    };
+
+    std::vector<StackFrame> stack = { { 0, 0, 1 } };
+    while (!stack.empty())
+    {
+        const StackFrame frame = stack.back();
+        stack.pop_back();
+
+        const BVH::Node& node = bvh.GetNodes()[frame.node];
+        if (node.IsLeaf())
+        {
+            totalBlocks += frame.numBlocks;
+            numPaths++;
+            continue;
+        }
+
+        // both children share a block
+        const Uint32 block = node.childIndex / nodesPerBlock;
+        const Uint32 numBlocks = frame.numBlocks + (block != frame.lastBlock ? 1 : 0);
+        stack.push_back({ node.childIndex, block, numBlocks });
+        stack.push_back({ node.childIndex + 1, block, numBlocks });
+    }
+
+    return static_cast<Double>(totalBlocks) / static_cast<Double>(numPaths);
+}
+
+} // namespace
+
+TEST(BVHTest, Build_VanEmdeBoasLayout)
+{
+    const Uint32 numLeaves = 20000;
+    const Boxes boxes = GenerateRandomBoxes(numLeaves);
+
+    BVH depthFirstBVH;
+    BVHBuilder::Indices depthFirstLeavesOrder;
+    {
+        BVHBuilder::BuildingParams params;
+        BVHBuilder builder(depthFirstBVH);
+        ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, depthFirstLeavesOrder));
+    }
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    {
+        BVHBuilder::BuildingParams params;
+        params.nodesLayout = BVHBuilder::NodesLayout::VanEmdeBoas;
+        BVHBuilder builder(bvh);
+        ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+    }
+
+    ValidateBVH(bvh, leavesOrder, numLeaves);
+    EXPECT_EQ(depthFirstLeavesOrder, leavesOrder);
+    ASSERT_EQ(depthFirstBVH.GetNumNodes(), bvh.GetNumNodes());
+    ExpectEquivalentSubtrees(depthFirstBVH, 0, bvh, 0);
+
+    // children are still placed after their parent
+    for (Uint32 i = 0; i < bvh.GetNumNodes(); ++i)
+    {
+        const BVH::Node& node = bvh.GetNodes()[i];
+        if (i != 1 && !node.IsLeaf())
+        {
+            EXPECT_LT(i, node.childIndex);
+        }
+    }
+
+    // paths should touch fewer pages (4KB)
+    const Uint32 nodesPerPage = 4096 / sizeof(BVH::Node);
+    EXPECT_LT(CalculateAverageBlocksPerPath(bvh, nodesPerPage), CalculateAverageBlocksPerPath(depthFirstBVH, nodesPerPage));
+}
+
+TEST(BVHTest, Build_Spatial)
+{
+    const Uint32 numLeaves = 5000;
+    const Triangles triangles = GenerateThinTriangles(numLeaves);
+    const Boxes boxes = CalculateTriangleBoxes(triangles);
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+    params.splitAlgorithm = BVHBuilder::SplitAlgorithm::Spatial;
+    params.maxDuplicatedReferences = 0.5f;
+    params.numThreads = 1;
+
+    BVHBuilder builder(bvh);
+    builder.SetLeafTriangles(triangles.data());
+    ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+    ValidateBVH(bvh, leavesOrder, numLeaves, true);
+
+    // memory cap must be respected
+    EXPECT_LT(numLeaves, (Uint32)leavesOrder.size());
+    EXPECT_GE(numLeaves + numLeaves / 2, (Uint32)leavesOrder.size());
+}
+
+TEST(BVHTest, Build_SpatialWithoutDuplicates)
+{
+    const Uint32 numLeaves = 5000;
+    const Triangles triangles = GenerateThinTriangles(numLeaves);
+    const Boxes boxes = CalculateTriangleBoxes(triangles);
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+    params.splitAlgorithm = BVHBuilder::SplitAlgorithm::Spatial;
+    params.maxDuplicatedReferences = 0.0f;
+
+    BVHBuilder builder(bvh);
+    builder.SetLeafTriangles(triangles.data());
+    ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+    ValidateBVH(bvh, leavesOrder, numLeaves);
+}
+
+TEST(BVHTest, Build_SpatialWithoutTriangles)
+{
+    const Boxes boxes = GenerateRandomBoxes(100);
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+    params.splitAlgorithm = BVHBuilder::SplitAlgorithm::Spatial;
+
+    BVHBuilder builder(bvh);
+    EXPECT_FALSE(builder.Build(boxes.data(), 100, params, leavesOrder));
+}
+
+TEST(BVHTest, Build_SpatialQuality)
+{
+    const Uint32 numLeaves = 20000;
+    const Triangles triangles = GenerateThinTriangles(numLeaves);
+    const Boxes boxes = CalculateTriangleBoxes(triangles);
+
+    BVH::Stats binnedStats, spatialStats;
+
+    for (const BVHBuilder::SplitAlgorithm algorithm : { BVHBuilder::SplitAlgorithm::Binned, BVHBuilder::SplitAlgorithm::Spatial })
+    {
+        BVH bvh;
+        BVHBuilder::Indices leavesOrder;
+        BVHBuilder::BuildingParams params;
+        params.splitAlgorithm = algorithm;
+
+        BVHBuilder builder(bvh);
+        builder.SetLeafTriangles(triangles.data());
+        ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+        bvh.CalculateStats(algorithm == BVHBuilder::SplitAlgorithm::Binned ? binnedStats : spatialStats);
+    }
+
+    EXPECT_LT(spatialStats.sahCost, binnedStats.sahCost * 0.9);
+}
+
+TEST(BVHTest, Build_EarlySplit)
+{
+    const Uint32 numLeaves = 20000;
+    const Triangles triangles = GenerateThinTriangles(numLeaves);
+    const Boxes boxes = CalculateTriangleBoxes(triangles);
+
+    BVH::Stats binnedStats, earlySplitStats;
+
+    for (const Float earlySplitBudget : { 0.0f, 0.3f })
+    {
+        BVH bvh;
+        BVHBuilder::Indices leavesOrder;
+        BVHBuilder::BuildingParams params;
+        params.earlySplitBudget = earlySplitBudget;
+
+        BVHBuilder builder(bvh);
+        builder.SetLeafTriangles(triangles.data());
+        ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+        ValidateBVH(bvh, leavesOrder, numLeaves, earlySplitBudget > 0.0f);
+        bvh.CalculateStats(earlySplitBudget > 0.0f ? earlySplitStats : binnedStats);
+
+        // memory cap must be respected
+        EXPECT_GE(numLeaves + static_cast<Uint32>(earlySplitBudget * numLeaves), (Uint32)leavesOrder.size());
+        if (earlySplitBudget > 0.0f)
+        {
+            EXPECT_LT(numLeaves, (Uint32)leavesOrder.size());
+        }
+    }
+
+    EXPECT_LT(earlySplitStats.sahCost, binnedStats.sahCost);
+
+    // triangles are required
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+    params.earlySplitBudget = 0.3f;
+    BVHBuilder builder(bvh);
+    EXPECT_FALSE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+}
+
+TEST(BVHTest, Build_MemoryStats)
+{
+    const BVHBuilder::SplitAlgorithm algorithms[] =
+    {
+        BVHBuilder::SplitAlgorithm::Sweep,
+        BVHBuilder::SplitAlgorithm::Binned,
+        BVHBuilder::SplitAlgorithm::Spatial,
+        BVHBuilder::SplitAlgorithm::Linear,
+    };
+
+    for (const BVHBuilder::SplitAlgorithm algorithm : algorithms)
+    {
+        BVHBuilder::BuildStats buildStats[2];
+        const Uint32 numLeaves[2] = { 1000, 20000 };
+
+        for (Uint32 i = 0; i < 2; ++i)
+        {
+            const Triangles triangles = GenerateThinTriangles(numLeaves[i]);
+            const Boxes boxes = CalculateTriangleBoxes(triangles);
+
+            BVH bvh;
+            BVHBuilder::Indices leavesOrder;
+            BVHBuilder::BuildingParams params;
+            params.splitAlgorithm = algorithm;
+            params.agglomerativeTreeletSize = 64;
+            params.numThreads = 1;
+
+            BVHBuilder builder(bvh);
+            builder.SetLeafTriangles(triangles.data());
+            ASSERT_TRUE(builder.Build(boxes.data(), numLeaves[i], params, leavesOrder));
+            buildStats[i] = builder.GetBuildStats();
+
+            // at least the temporary nodes are needed
+            EXPECT_LE(Uint64(2 * numLeaves[i] - 1) * sizeof(BVH::Node), buildStats[i].peakMemory);
+        }
+
+        // the number of allocations must not depend on the tree size
+        EXPECT_EQ(buildStats[0].numAllocations, buildStats[1].numAllocations);
+        EXPECT_GT(20u, buildStats[1].numAllocations);
+    }
+}
+
+namespace {
+
+void TestParallelMatchesSerial(BVHBuilder::SplitAlgorithm algorithm, Uint32 optimizationPasses = 0)
+{
+    const Uint32 numLeaves = 20000;
+    const Triangles triangles = GenerateThinTriangles(numLeaves);
+    const Boxes boxes = CalculateTriangleBoxes(triangles);
+    const bool spatialSplits = algorithm == BVHBuilder::SplitAlgorithm::Spatial;
+
+    BVH serialBVH;
+    BVHBuilder::Indices serialLeavesOrder;
+    {
+        BVHBuilder::BuildingParams params;
+        params.splitAlgorithm = algorithm;
+        params.optimizationPasses = optimizationPasses;
+        params.numThreads = 1;
+
+        BVHBuilder builder(serialBVH);
+        builder.SetLeafTriangles(triangles.data());
+        ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, serialLeavesOrder));
+    }
+
+    BVH parallelBVH;
+    BVHBuilder::Indices parallelLeavesOrder;
+    {
+        BVHBuilder::BuildingParams params;
+        params.splitAlgorithm = algorithm;
+        params.optimizationPasses = optimizationPasses;
+        params.numThreads = 4;
+        params.minLeavesPerTask = 64;
+
+        BVHBuilder builder(parallelBVH);
+        builder.SetLeafTriangles(triangles.data());
+        ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, parallelLeavesOrder));
+    }
+
+    ValidateBVH(parallelBVH, parallelLeavesOrder, numLeaves, spatialSplits);
+
+    ASSERT_EQ(serialBVH.GetNumNodes(), parallelBVH.GetNumNodes());
+    EXPECT_EQ(serialLeavesOrder, parallelLeavesOrder);
+
+    // skip the unused padding node (index 1)
+    EXPECT_EQ(0, memcmp(serialBVH.GetNodes(), parallelBVH.GetNodes(), sizeof(BVH::Node)));
+    EXPECT_EQ(0, memcmp(serialBVH.GetNodes() + 2, parallelBVH.GetNodes() + 2, sizeof(BVH::Node) * (serialBVH.GetNumNodes() - 2)));
+}
+
+} // namespace
+
+TEST(BVHTest, Build_ParallelMatchesSerial_Sweep)
+{
+    TestParallelMatchesSerial(BVHBuilder::SplitAlgorithm::Sweep);
+}
+
+TEST(BVHTest, Build_ParallelMatchesSerial_Binned)
+{
+    TestParallelMatchesSerial(BVHBuilder::SplitAlgorithm::Binned);
+}
+
+TEST(BVHTest, Build_ParallelMatchesSerial_Spatial)
+{
+    TestParallelMatchesSerial(BVHBuilder::SplitAlgorithm::Spatial);
+}
+
+TEST(BVHTest, Build_ParallelMatchesSerial_Linear)
+{
+    TestParallelMatchesSerial(BVHBuilder::SplitAlgorithm::Linear);
+}
+
+TEST(BVHTest, Build_ParallelMatchesSerial_Optimized)
+{
+    TestParallelMatchesSerial(BVHBuilder::SplitAlgorithm::Binned, 1);
+}
+
+namespace {
+
+// move each leaf box by a random offset (boxes are returned in the leaves order)
+Boxes MoveLeafBoxes(const Boxes& boxes, const BVHBuilder::Indices& leavesOrder, Float maxOffset)
+{
+    Random random;
+
+    Boxes movedBoxes;
+    movedBoxes.reserve(leavesOrder.size());
+    for (const Uint32 index : leavesOrder)
+    {
+        const Vector4 offset = (random.GetVector4Bipolar() * maxOffset) & Vector4::MakeMask<1, 1, 1, 0>();
+        movedBoxes.push_back(Box(boxes[index].min + offset, boxes[index].max + offset));
+    }
+
+    return movedBoxes;
+}
+
+} // namespace
+
+TEST(BVHTest, Refit)
+{
+    const Uint32 numLeaves = 20000;
+    const Boxes boxes = GenerateRandomBoxes(numLeaves);
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+
+    const Boxes movedBoxes = MoveLeafBoxes(boxes, leavesOrder, 10.0f);
+
+    BVH parallelBVH;
+    BVHBuilder parallelBuilder(parallelBVH);
+    ASSERT_TRUE(parallelBuilder.Build(boxes.data(), numLeaves, params, leavesOrder));
+
+    bvh.Refit(movedBoxes.data());
+    ValidateBVH(bvh, leavesOrder, numLeaves);
+
+    // moved boxes are already in the leaves order
+    BVHBuilder::Indices identityOrder(numLeaves);
+    for (Uint32 i = 0; i < numLeaves; ++i)
+    {
+        identityOrder[i] = i;
+    }
+    ValidateLeafBoxes(bvh, movedBoxes, identityOrder);
+
+    ThreadPool threadPool;
+    threadPool.SetNumThreads(4);
+    parallelBVH.Refit(movedBoxes.data(), &threadPool);
+
+    ASSERT_EQ(bvh.GetNumNodes(), parallelBVH.GetNumNodes());
+    EXPECT_EQ(0, memcmp(bvh.GetNodes(), parallelBVH.GetNodes(), sizeof(BVH::Node) * bvh.GetNumNodes()));
+}
+
+TEST(BVHTest, RebuildSubtrees)
+{
+    const Uint32 numLeaves = 10000;
+    const Boxes boxes = GenerateRandomBoxes(numLeaves);
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+
+    // heavy movement degrades the refitted tree
+    const Boxes movedBoxes = MoveLeafBoxes(boxes, leavesOrder, 100.0f);
+    bvh.Refit(movedBoxes.data());
+
+    BVH::Stats refittedStats;
+    bvh.CalculateStats(refittedStats);
+
+    std::vector<Float> costs;
+    bvh.CalculateNodeCosts(costs);
+    EXPECT_NEAR(refittedStats.sahCost, costs[0], refittedStats.sahCost * 1.0e-4);
+
+    // rebuild the root's grandchildren subtrees
+    const BVH::Node* nodes = bvh.GetNodes();
+    std::vector<Uint32> subtreeRoots;
+    for (Uint32 i = 0; i < 2; ++i)
+    {
+        const BVH::Node& child = nodes[nodes[0].childIndex + i];
+        ASSERT_FALSE(child.IsLeaf());
+        subtreeRoots.push_back(child.childIndex);
+        subtreeRoots.push_back(child.childIndex + 1);
+    }
+
+    BVHBuilder::Indices newLeavesOrder;
+    ASSERT_TRUE(builder.RebuildSubtrees(subtreeRoots, movedBoxes.data(), numLeaves, params, newLeavesOrder));
+    ValidateBVH(bvh, newLeavesOrder, numLeaves);
+
+    ValidateLeafBoxes(bvh, movedBoxes, newLeavesOrder);
+
+    BVH::Stats rebuiltStats;
+    bvh.CalculateStats(rebuiltStats);
+    EXPECT_LT(rebuiltStats.sahCost, refittedStats.sahCost);
+
+    // the same rebuild with van Emde Boas layout must produce the same tree with reordered nodes
+    BVH vebBVH;
+    BVHBuilder::Indices vebLeavesOrder;
+    BVHBuilder vebBuilder(vebBVH);
+    ASSERT_TRUE(vebBuilder.Build(boxes.data(), numLeaves, params, vebLeavesOrder));
+    ASSERT_EQ(leavesOrder, vebLeavesOrder);
+    vebBVH.Refit(movedBoxes.data());
+
+    BVHBuilder::BuildingParams vebParams = params;
+    vebParams.nodesLayout = BVHBuilder::NodesLayout::VanEmdeBoas;
+    ASSERT_TRUE(vebBuilder.RebuildSubtrees(subtreeRoots, movedBoxes.data(), numLeaves, vebParams, vebLeavesOrder));
+    ValidateBVH(vebBVH, vebLeavesOrder, numLeaves);
+    EXPECT_EQ(newLeavesOrder, vebLeavesOrder);
+    ASSERT_EQ(bvh.GetNumNodes(), vebBVH.GetNumNodes());
+    ExpectEquivalentSubtrees(bvh, 0, vebBVH, 0);
+
+    const Uint32 nodesPerPage = 4096 / sizeof(BVH::Node);
+    EXPECT_LT(CalculateAverageBlocksPerPath(vebBVH, nodesPerPage), CalculateAverageBlocksPerPath(bvh, nodesPerPage));
+}
+
+namespace {
+
+// copy a file, overwriting a 32-bit value at given offset (to simulate corrupted data)
+void CopyFileWithPatch(const std::string& sourcePath, const std::string& targetPath, size_t offset, Uint32 value)
+{
+    FILE* file = fopen(sourcePath.c_str(), "rb");
+    ASSERT_NE(nullptr, file);
+    std::vector<Uint8> data;
+    Uint8 buffer[4096];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        data.insert(data.end(), buffer, buffer + size);
+    }
+    fclose(file);
+
+    ASSERT_LE(offset + sizeof(value), data.size());
+    memcpy(data.data() + offset, &value, sizeof(value));
+
+    file = fopen(targetPath.c_str(), "wb");
+    ASSERT_NE(nullptr, file);
+    EXPECT_EQ(data.size(), fwrite(data.data(), 1, data.size(), file));
+    fclose(file);
+}
+
+} // namespace
+
+TEST(BVHTest, SaveLoad)
+{
+    const Uint32 numLeaves = 1000;
+    const Boxes boxes = GenerateRandomBoxes(numLeaves);
+    const std::string filePath = "BVHTest_SaveLoad.bvh";
+    const Uint64 contentHash = 0x123456789ABCDEFull;
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+    ASSERT_TRUE(bvh.SaveToFile(filePath, contentHash, leavesOrder));
+
+    {
+        BVH loadedBVH;
+        std::vector<Uint32> loadedLeavesOrder;
+        ASSERT_TRUE(loadedBVH.LoadFromFile(filePath, contentHash, &loadedLeavesOrder));
+
+        ASSERT_EQ(bvh.GetNumNodes(), loadedBVH.GetNumNodes());
+        EXPECT_EQ(0, memcmp(bvh.GetNodes(), loadedBVH.GetNodes(), sizeof(BVH::Node) * bvh.GetNumNodes()));
+        EXPECT_EQ(leavesOrder, loadedLeavesOrder);
+        ValidateBVH(loadedBVH, loadedLeavesOrder, numLeaves);
+
+        // stale file must be rejected
+        BVH staleBVH;
+        EXPECT_FALSE(staleBVH.LoadFromFile(filePath, contentHash + 1));
+        EXPECT_EQ(0u, staleBVH.GetNumNodes());
+    }
+
+    // files with a matching header, but with out-of-range nodes or leaves must be rejected too
+    // (nodes are placed at cache line boundary)
+    const std::string corruptedFilePath = "BVHTest_SaveLoad_Corrupted.bvh";
+    const auto childIndexOffset = [&](Uint32 nodeIndex)
+    {
+        return RT_CACHE_LINE_SIZE + sizeof(BVH::Node) * nodeIndex + offsetof(BVH::Node, childIndex);
+    };
+
+    Uint32 leafNodeIndex = 0;
+    while (!bvh.GetNodes()[leafNodeIndex].IsLeaf())
+    {
+        leafNodeIndex = bvh.GetNodes()[leafNodeIndex].childIndex;
+    }
+
+    const std::pair<Uint32, Uint32> patches[] =
+    {
+        { 0, bvh.GetNumNodes() },           // root's children out of the nodes array
+        { 0, 0 },                           // root referencing itself
+        { leafNodeIndex, numLeaves },       // leaf range out of the leaves order
+    };
+
+    for (const auto& patch : patches)
+    {
+        CopyFileWithPatch(filePath, corruptedFilePath, childIndexOffset(patch.first), patch.second);
+
+        BVH corruptedBVH;
+        EXPECT_FALSE(corruptedBVH.LoadFromFile(corruptedFilePath, contentHash));
+        EXPECT_EQ(0u, corruptedBVH.GetNumNodes());
+    }
+
+    EXPECT_EQ(0, remove(corruptedFilePath.c_str()));
+    EXPECT_EQ(0, remove(filePath.c_str()));
+}
+
+TEST(BVHTest, Stats_NoOverlap)
+{
+    // boxes placed in a row with gaps, so neither siblings nor leaves can overlap
+    const Uint32 numLeaves = 8;
+    Boxes boxes;
+    for (Uint32 i = 0; i < numLeaves; ++i)
+    {
+        const Vector4 min(3.0f * static_cast<Float>(i), 0.0f, 0.0f, 0.0f);
+        boxes.push_back(Box(min, min + Vector4(1.0f, 1.0f, 1.0f, 0.0f)));
+    }
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+    params.maxLeafNodeSize = 1;
+
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+
+    BVH::CostParams costParams;
+    costParams.calculateEPO = true;
+
+    BVH::Stats stats;
+    bvh.CalculateStats(stats, costParams);
+    EXPECT_EQ(2 * numLeaves - 1, stats.numNodes);
+    EXPECT_EQ(numLeaves, stats.numLeafNodes);
+    EXPECT_EQ(4u, stats.maxDepth);
+    EXPECT_EQ(0.0, stats.epo);
+    EXPECT_EQ(0.0, stats.siblingOverlap);
+}
+
+TEST(BVHTest, Stats)
+{
+    const Uint32 numLeaves = 20000;
+    const Boxes boxes = GenerateRandomBoxes(numLeaves);
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+
+    BVH::Stats statsWithoutEPO;
+    bvh.CalculateStats(statsWithoutEPO);
+    EXPECT_EQ(0.0, statsWithoutEPO.epo);
+
+    BVH::CostParams costParams;
+    costParams.calculateEPO = true;
+
+    BVH::Stats stats;
+    bvh.CalculateStats(stats, costParams);
+    EXPECT_DOUBLE_EQ(statsWithoutEPO.sahCost, stats.sahCost);
+    EXPECT_NEAR(stats.sahCost, bvh.CalculateSahCost(), 1.0e-6 * stats.sahCost);
+
+    // padding node is not counted
+    EXPECT_EQ(bvh.GetNumNodes() - 1, stats.numNodes);
+    EXPECT_EQ(bvh.GetNumNodes() * sizeof(BVH::Node), stats.nodesMemorySize);
+    EXPECT_EQ(stats.numNodes - stats.numLeafNodes, stats.leavesCountHistogram[0]);
+    EXPECT_LT(0.0, stats.epo);
+    EXPECT_LT(0.0, stats.siblingOverlap);
+    EXPECT_GT(1.0, stats.siblingOverlap);
+
+    // traversal and intersection costs scale the inner and leaf nodes parts independently
+    BVH::Stats scaledStats;
+    BVH::CostParams scaledCostParams = costParams;
+    scaledCostParams.traversalCost = 2.0f;
+    scaledCostParams.intersectionCost = 2.0f;
+    bvh.CalculateStats(scaledStats, scaledCostParams);
+    EXPECT_NEAR(2.0 * stats.sahCost, scaledStats.sahCost, 1.0e-6 * stats.sahCost);
+    EXPECT_NEAR(2.0 * stats.epo, scaledStats.epo, 1.0e-6 * stats.epo);
+
+    ThreadPool threadPool;
+    BVH::Stats parallelStats;
+    bvh.CalculateStats(parallelStats, costParams, &threadPool);
+    EXPECT_EQ(stats.ToJSON(), parallelStats.ToJSON());
+
+    rapidjson::Document document;
+    document.Parse(stats.ToJSON().c_str());
+    ASSERT_FALSE(document.HasParseError());
+    EXPECT_EQ(stats.numNodes, document["numNodes"].GetUint());
+    EXPECT_DOUBLE_EQ(stats.sahCost, document["sahCost"].GetDouble());
+    EXPECT_DOUBLE_EQ(stats.epo, document["epo"].GetDouble());
+    EXPECT_DOUBLE_EQ(stats.siblingOverlap, document["siblingOverlap"].GetDouble());
+    EXPECT_EQ(stats.leavesCountHistogram.size(), document["leavesCountHistogram"].Size());
+}
+
+namespace {
+
+template <Uint32 Width>
+void TestWideBVH(Uint32 numLeaves)
+{
+    const Boxes boxes = GenerateRandomBoxes(numLeaves);
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+    params.maxLeafNodeSize = 4;
+
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+
+    WideBVH<Width> wideBVH;
+    ASSERT_TRUE(wideBVH.Build(bvh));
+    ASSERT_LE(1u, wideBVH.GetNumNodes());
+    EXPECT_LT(wideBVH.GetNumNodes(), bvh.GetNumNodes() / 2 + 1);
+
+    // all the leaves must be reachable exactly once
+    std::vector<std::pair<Uint32, Uint32>> leafRanges;
+    std::vector<Uint32> stack = { 0 };
+    while (!stack.empty())
+    {
+        const typename WideBVH<Width>::Node& node = wideBVH.GetNodes()[stack.back()];
+        stack.pop_back();
+
+        Uint32 numChildren = 0;
+        while (numChildren < Width && node.IsChildValid(numChildren))
+        {
+            numChildren++;
+        }
+
+        EXPECT_EQ((1u << numChildren) - 1u, node.GetValidChildrenMask());
+
+        // remaining slots must be empty
+        for (Uint32 i = numChildren; i < Width; ++i)
+        {
+            EXPECT_FALSE(node.IsChildValid(i));
+            EXPECT_GT(node.childMinX[i], node.childMaxX[i]);
+        }
+
+        for (Uint32 i = 0; i < numChildren; ++i)
+        {
+            if (node.IsChildLeaf(i))
+            {
+                leafRanges.emplace_back(node.childIndex[i], node.childNumLeaves[i]);
+                continue;
+            }
+
+            ASSERT_LT(node.childIndex[i], wideBVH.GetNumNodes());
+
+            // child node's boxes must be contained in the parent's slot box
+            const typename WideBVH<Width>::Node& child = wideBVH.GetNodes()[node.childIndex[i]];
+            for (Uint32 j = 0; j < Width && child.IsChildValid(j); ++j)
+            {
+                EXPECT_LE(node.childMinX[i], child.childMinX[j]);
+                EXPECT_LE(node.childMinY[i], child.childMinY[j]);
+                EXPECT_LE(node.childMinZ[i], child.childMinZ[j]);
+                EXPECT_GE(node.childMaxX[i], child.childMaxX[j]);
+                EXPECT_GE(node.childMaxY[i], child.childMaxY[j]);
+                EXPECT_GE(node.childMaxZ[i], child.childMaxZ[j]);
+            }
+
+            stack.push_back(node.childIndex[i]);
+        }
+    }
+
+    std::sort(leafRanges.begin(), leafRanges.end());
+
+    Uint32 numLeavesInTree = 0;
+    for (const auto& range : leafRanges)
+    {
+        EXPECT_EQ(numLeavesInTree, range.first);
+        numLeavesInTree += range.second;
+    }
+
+    EXPECT_EQ(numLeaves, numLeavesInTree);
+}
+
+} // namespace
+
+TEST(BVHTest, WideBVH4_Collapse)
+{
+    TestWideBVH<4>(5000);
+}
+
+TEST(BVHTest, WideBVH8_Collapse)
+{
+    TestWideBVH<8>(5000);
+}
+
+TEST(BVHTest, WideBVH8_CollapseSingleLeaf)
+{
+    TestWideBVH<8>(1);
+}
+
+namespace {
+
+template <Uint32 Width, bool Quantized>
+void TestWideBVHSaveLoad()
+{
+    using WideBVHType = WideBVH<Width, Quantized>;
+
+    const Uint32 numLeaves = 5000;
+    const Boxes boxes = GenerateRandomBoxes(numLeaves);
+    const std::string filePath = "BVHTest_WideSaveLoad.bvh";
+    const Uint64 contentHash = 0x123456789ABCDEFull;
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+    params.maxLeafNodeSize = 4;
+
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+
+    WideBVHType wideBVH;
+    ASSERT_TRUE(wideBVH.Build(bvh));
+    ASSERT_TRUE(wideBVH.SaveToFile(filePath, contentHash));
+
+    WideBVHType loadedBVH;
+    ASSERT_TRUE(loadedBVH.LoadFromFile(filePath, contentHash, numLeaves));
+    ASSERT_EQ(wideBVH.GetNumNodes(), loadedBVH.GetNumNodes());
+    EXPECT_EQ(0, memcmp(wideBVH.GetNodes(), loadedBVH.GetNodes(), sizeof(typename WideBVHType::Node) * wideBVH.GetNumNodes()));
+
+    // stale file, leaves out of range and different node format must be rejected
+    WideBVHType rejectedBVH;
+    EXPECT_FALSE(rejectedBVH.LoadFromFile(filePath, contentHash + 1, numLeaves));
+    EXPECT_FALSE(rejectedBVH.LoadFromFile(filePath, contentHash, numLeaves / 2));
+    EXPECT_EQ(0u, rejectedBVH.GetNumNodes());
+
+    WideBVH<Width, !Quantized> otherFormatBVH;
+    EXPECT_FALSE(otherFormatBVH.LoadFromFile(filePath, contentHash, numLeaves));
+
+    EXPECT_EQ(0, remove(filePath.c_str()));
+}
+
+} // namespace
+
+TEST(BVHTest, WideBVH4_SaveLoad)
+{
+    TestWideBVHSaveLoad<4, false>();
+}
+
+TEST(BVHTest, QuantizedBVH8_SaveLoad)
+{
+    TestWideBVHSaveLoad<8, true>();
+}
+
+namespace {
+
+template <Uint32 Width>
+void TestQuantizedWideBVH(Uint32 numLeaves)
+{
+    const Boxes boxes = GenerateRandomBoxes(numLeaves);
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+    params.maxLeafNodeSize = 4;
+
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, params, leavesOrder));
+
+    WideBVH<Width, false> wideBVH;
+    ASSERT_TRUE(wideBVH.Build(bvh));
+
+    WideBVH<Width, true> quantizedBVH;
+    ASSERT_TRUE(quantizedBVH.Build(bvh));
+    ASSERT_EQ(wideBVH.GetNumNodes(), quantizedBVH.GetNumNodes());
+
+    Double totalArea = 0.0;
+    Double totalQuantizedArea = 0.0;
+
+    // both trees have the same topology, quantized boxes must be conservative
+    for (Uint32 i = 0; i < wideBVH.GetNumNodes(); ++i)
+    {
+        const auto& node = wideBVH.GetNodes()[i];
+        const auto& quantizedNode = quantizedBVH.GetNodes()[i];
+
+        EXPECT_EQ(node.GetValidChildrenMask(), quantizedNode.GetValidChildrenMask());
+
+        for (Uint32 slot = 0; slot < Width; ++slot)
+        {
+            EXPECT_EQ(node.childIndex[slot], quantizedNode.childIndex[slot]);
+            EXPECT_EQ(node.childNumLeaves[slot], (Uint32)quantizedNode.childNumLeaves[slot]);
+
+            if (!node.IsChildValid(slot))
+            {
+                continue;
+            }
+
+            const Box box = node.GetChildBox(slot);
+            const Box quantizedBox = quantizedNode.GetChildBox(slot);
+            for (Uint32 axis = 0; axis < 3; ++axis)
+            {
+                EXPECT_LE(quantizedBox.min[axis], box.min[axis]);
+                EXPECT_GE(quantizedBox.max[axis], box.max[axis]);
+            }
+
+            // SIMD decoding must match the scalar one
+            const Box_Simd8 boxes_Simd8 = quantizedNode.GetChildBoxes_Simd8();
+            EXPECT_EQ(quantizedBox.min.x, boxes_Simd8.min.x[slot]);
+            EXPECT_EQ(quantizedBox.min.y, boxes_Simd8.min.y[slot]);
+            EXPECT_EQ(quantizedBox.min.z, boxes_Simd8.min.z[slot]);
+            EXPECT_EQ(quantizedBox.max.x, boxes_Simd8.max.x[slot]);
+            EXPECT_EQ(quantizedBox.max.y, boxes_Simd8.max.y[slot]);
+            EXPECT_EQ(quantizedBox.max.z, boxes_Simd8.max.z[slot]);
+
+            totalArea += box.SurfaceArea();
+            totalQuantizedArea += quantizedBox.SurfaceArea();
+        }
+    }
+
+    // quantization should not make the boxes much looser
+    EXPECT_LT(totalQuantizedArea, totalArea * 1.2);
+}
+
+} // namespace
+
+TEST(BVHTest, QuantizedBVH4_Conservative)
+{
+    TestQuantizedWideBVH<4>(5000);
+}
+
+TEST(BVHTest, QuantizedBVH8_Conservative)
+{
+    TestQuantizedWideBVH<8>(5000);
+}
+
+TEST(BVHTest, MotionBVH_Conservative)
+{
+    const Uint32 numLeaves = 5000;
+    const Boxes boxes = GenerateRandomBoxes(numLeaves);
+
+    Random random;
+    Boxes startBoxes, endBoxes, motionBoxes;
+    for (const Box& box : boxes)
+    {
+        const Vector4 velocity = random.GetVector4Bipolar() * 10.0f;
+        startBoxes.push_back(box);
+        endBoxes.push_back(box + (velocity & Vector4::MakeMask<1, 1, 1, 0>()));
+        motionBoxes.push_back(Box(startBoxes.back(), endBoxes.back()));
+    }
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(motionBoxes.data(), numLeaves, BVHBuilder::BuildingParams(), leavesOrder));
+
+    Boxes orderedStartBoxes, orderedEndBoxes;
+    for (const Uint32 index : leavesOrder)
+    {
+        orderedStartBoxes.push_back(startBoxes[index]);
+        orderedEndBoxes.push_back(endBoxes[index]);
+    }
+
+    MotionBVH motionBVH;
+    ASSERT_TRUE(motionBVH.Build(bvh, orderedStartBoxes.data(), orderedEndBoxes.data()));
+    ASSERT_EQ(bvh.GetNumNodes(), motionBVH.GetNumNodes());
+
+    const MotionBVH::Node* nodes = motionBVH.GetNodes();
+    const auto expectContains = [](const Box& parent, const Box& child)
+    {
+        const float epsilon = 1.0e-4f;
+        EXPECT_LE(parent.min.x, child.min.x + epsilon);
+        EXPECT_LE(parent.min.y, child.min.y + epsilon);
+        EXPECT_LE(parent.min.z, child.min.z + epsilon);
+        EXPECT_GE(parent.max.x, child.max.x - epsilon);
+        EXPECT_GE(parent.max.y, child.max.y - epsilon);
+        EXPECT_GE(parent.max.z, child.max.z - epsilon);
+    };
+
+    Double staticArea = 0.0;
+    for (Uint32 i = 0; i < bvh.GetNumNodes(); ++i)
+    {
+        // skip unused padding node
+        if (i != 1)
+        {
+            staticArea += bvh.GetNodes()[i].GetBox().SurfaceArea();
+        }
+    }
+
+    for (const float time : { 0.0f, 0.3f, 0.5f, 1.0f })
+    {
+        const Vector4 weight(time);
+
+        Double motionArea = 0.0;
+        for (Uint32 i = 0; i < motionBVH.GetNumNodes(); ++i)
+        {
+            if (i == 1)
+            {
+                continue;
+            }
+
+            const MotionBVH::Node& node = nodes[i];
+            const Box box = node.GetBox(time);
+            motionArea += box.SurfaceArea();
+
+            if (node.IsLeaf())
+            {
+                for (Uint32 j = 0; j < node.start.numLeaves; ++j)
+                {
+                    const Box& start = orderedStartBoxes[node.start.childIndex + j];
+                    const Box& end = orderedEndBoxes[node.start.childIndex + j];
+                    expectContains(box, Box(Vector4::Lerp(start.min, end.min, weight), Vector4::Lerp(start.max, end.max, weight)));
+                }
+            }
+            else
+            {
+                expectContains(box, nodes[node.start.childIndex].GetBox(time));
+                expectContains(box, nodes[node.start.childIndex + 1].GetBox(time));
+            }
+        }
+
+        // interpolated bounds should be much tighter than bounds of the whole motion
+        EXPECT_LT(motionArea, staticArea * 0.8);
+    }
+}
+
+namespace {
+
+// every leaf in the tree must be referenced exactly once and enclosed by all its ancestors
+void ValidateUpdatedBVH(const BVH& bvh, const BVHUpdater& updater, const Boxes& boxes, const std::vector<bool>& isInTree)
+{
+    const Uint32 numLeaves = static_cast<Uint32>(boxes.size());
+
+    std::vector<Uint32> leafReferences(numLeaves, 0);
+    std::vector<std::pair<Uint32, Box>> stack = { { 0, bvh.GetNodes()[0].GetBox() } };
+    while (!stack.empty())
+    {
+        const Uint32 nodeIndex = stack.back().first;
+        const Box parentBox = stack.back().second;
+        stack.pop_back();
+
+        const BVH::Node& node = bvh.GetNodes()[nodeIndex];
+        const Box box = node.GetBox();
+        EXPECT_TRUE(BoxContains(parentBox, box));
+
+        if (node.IsLeaf())
+        {
+            for (Uint32 i = 0; i < node.numLeaves; ++i)
+            {
+                const Uint32 leafID = updater.GetLeavesOrder()[node.childIndex + i];
+                ASSERT_LT(leafID, numLeaves);
+                leafReferences[leafID]++;
+
+                const Box& leafBox = boxes[leafID];
+                EXPECT_TRUE(BoxContains(box, leafBox));
+            }
+            continue;
+        }
+
+        // children must follow their parent
+        ASSERT_GT(node.childIndex, nodeIndex);
+        ASSERT_LT(node.childIndex + 1, bvh.GetNumNodes());
+        stack.push_back({ node.childIndex, box });
+        stack.push_back({ node.childIndex + 1, box });
+    }
+
+    for (Uint32 i = 0; i < numLeaves; ++i)
+    {
+        EXPECT_EQ(isInTree[i] ? 1u : 0u, leafReferences[i]);
+        EXPECT_EQ(isInTree[i], updater.ContainsLeaf(i));
+    }
+}
+
+} // namespace
+
+TEST(BVHTest, Updater_InsertRemoveMove)
+{
+    const Uint32 numLeaves = 2000;
+    Boxes boxes = GenerateRandomBoxes(numLeaves);
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, BVHBuilder::BuildingParams(), leavesOrder));
+
+    Boxes orderedBoxes;
+    for (const Uint32 index : leavesOrder)
+    {
+        orderedBoxes.push_back(boxes[index]);
+    }
+
+    BVHUpdater updater;
+    updater.Initialize(bvh, leavesOrder, orderedBoxes.data());
+
+    BVH::Stats initialStats;
+    bvh.CalculateStats(initialStats);
+
+    // move, remove and insert random leaves
+    Random random;
+    std::vector<bool> isInTree(numLeaves, true);
+    for (Uint32 i = 0; i < 3000; ++i)
+    {
+        const Uint32 leafID = random.GetInt() % numLeaves;
+        const Vector4 center = random.GetVector4Bipolar() * 100.0f;
+        const Vector4 size = random.GetVector4() * 2.0f;
+        boxes[leafID] = Box(center - size, center + size);
+
+        if (!isInTree[leafID])
+        {
+            ASSERT_TRUE(updater.InsertLeaf(bvh, leafID, boxes[leafID]));
+            isInTree[leafID] = true;
+        }
+        else if (i % 4 == 0)
+        {
+            updater.RemoveLeaf(bvh, leafID);
+            isInTree[leafID] = false;
+        }
+        else
+        {
+            ASSERT_TRUE(updater.UpdateLeaf(bvh, leafID, boxes[leafID]));
+        }
+    }
+
+    ValidateUpdatedBVH(bvh, updater, boxes, isInTree);
+
+    // unused nodes are reused, so the tree should not grow much
+    BVH::Stats stats;
+    bvh.CalculateStats(stats);
+    EXPECT_GT((Uint32)BVH::MaxDepth, stats.maxDepth);
+    EXPECT_LT(bvh.GetNumNodes(), 2 * initialStats.numNodes);
+
+    // freed nodes must not contribute to the cost
+    EXPECT_NEAR(stats.sahCost, bvh.CalculateSahCost(), 1.0e-6 * stats.sahCost);
+}
+
+TEST(BVHTest, Updater_RemoveInsertChurn)
+{
+    const Uint32 numLeaves = 2000;
+    Boxes boxes = GenerateRandomBoxes(numLeaves);
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, BVHBuilder::BuildingParams(), leavesOrder));
+
+    Boxes orderedBoxes;
+    for (const Uint32 index : leavesOrder)
+    {
+        orderedBoxes.push_back(boxes[index]);
+    }
+
+    BVHUpdater updater;
+    updater.Initialize(bvh, leavesOrder, orderedBoxes.data());
+    const Uint32 initialNumNodes = bvh.GetNumNodes();
+
+    // remove a half of the leaves and insert them back at different places, many times
+    Random random;
+    std::vector<bool> isInTree(numLeaves, true);
+    std::vector<Uint32> removedLeaves;
+    for (Uint32 round = 0; round < 50; ++round)
+    {
+        for (Uint32 leafID = 0; leafID < numLeaves; ++leafID)
+        {
+            if (random.GetInt() % 2 == 0)
+            {
+                updater.RemoveLeaf(bvh, leafID);
+                isInTree[leafID] = false;
+                removedLeaves.push_back(leafID);
+            }
+        }
+
+        for (const Uint32 leafID : removedLeaves)
+        {
+            const Vector4 center = random.GetVector4Bipolar() * 100.0f;
+            const Vector4 size = random.GetVector4() * 2.0f;
+            boxes[leafID] = Box(center - size, center + size);
+
+            ASSERT_TRUE(updater.InsertLeaf(bvh, leafID, boxes[leafID]));
+            isInTree[leafID] = true;
+        }
+        removedLeaves.clear();
+
+        // unused leaves order entries and nodes are reused
+        ASSERT_EQ(numLeaves, (Uint32)updater.GetLeavesOrder().size());
+        ASSERT_LT(bvh.GetNumNodes(), 2 * initialNumNodes);
+    }
+
+    ValidateUpdatedBVH(bvh, updater, boxes, isInTree);
+}
+
+TEST(BVHTest, Updater_TooDeep)
+{
+    // identical boxes are always inserted next to the same leaf, so they form a chain
+    const Uint32 numLeaves = 2 * BVH::MaxDepth;
+    const Box chainBox(Vector4(-1.0f, -1.0f, -1.0f, 0.0f), Vector4(1.0f, 1.0f, 1.0f, 0.0f));
+    Boxes boxes(numLeaves, chainBox);
+    boxes[1] = chainBox + Vector4(100.0f, 0.0f, 0.0f, 0.0f);
+    boxes[2] = chainBox + Vector4(103.0f, 0.0f, 0.0f, 0.0f);
+
+    // far leaves are placed in a separate subtree, so moving one of them doesn't make the chain shorter
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+    params.maxLeafNodeSize = 1;
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(boxes.data(), 3, params, leavesOrder));
+
+    Boxes orderedBoxes;
+    for (const Uint32 index : leavesOrder)
+    {
+        orderedBoxes.push_back(boxes[index]);
+    }
+
+    BVHUpdater updater;
+    updater.Initialize(bvh, leavesOrder, orderedBoxes.data());
+
+    std::vector<bool> isInTree(numLeaves, false);
+    isInTree[0] = isInTree[1] = isInTree[2] = true;
+
+    Uint32 leafID = 3;
+    for (; leafID < numLeaves; ++leafID)
+    {
+        if (!updater.InsertLeaf(bvh, leafID, boxes[leafID]))
+        {
+            break;
+        }
+        isInTree[leafID] = true;
+    }
+
+    // failed insertion must not leave the leaf in the updater
+    ASSERT_LT(leafID, numLeaves);
+    EXPECT_FALSE(updater.ContainsLeaf(leafID));
+    ValidateUpdatedBVH(bvh, updater, boxes, isInTree);
+
+    // the far leaf can't be moved into the chain, it must stay at its old place (with the new box)
+    boxes[1] = chainBox;
+    EXPECT_FALSE(updater.UpdateLeaf(bvh, 1, boxes[1]));
+    EXPECT_TRUE(updater.ContainsLeaf(1));
+    ValidateUpdatedBVH(bvh, updater, boxes, isInTree);
+
+    // the chain can still be modified
+    updater.RemoveLeaf(bvh, 0);
+    isInTree[0] = false;
+    ValidateUpdatedBVH(bvh, updater, boxes, isInTree);
+}
+
+TEST(BVHTest, Updater_TooDeep_InnerSibling)
+{
+    const Uint32 numLeaves = 2 * BVH::MaxDepth;
+    const Box chainBox(Vector4(-1.0f, -1.0f, -1.0f, 0.0f), Vector4(1.0f, 1.0f, 1.0f, 0.0f));
+    Boxes boxes(numLeaves, chainBox);
+    boxes[1] = chainBox + Vector4(100.0f, 0.0f, 0.0f, 0.0f);
+    boxes[2] = chainBox + Vector4(103.0f, 0.0f, 0.0f, 0.0f);
+    boxes[3] = chainBox + Vector4(200.0f, 0.0f, 0.0f, 0.0f);
+
+    // the far subtree is split into { 1, 2 } and { 3 }, so the sibling of the leaf 3 is an inner node
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder::BuildingParams params;
+    params.maxLeafNodeSize = 1;
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(boxes.data(), 4, params, leavesOrder));
+
+    Boxes orderedBoxes;
+    for (const Uint32 index : leavesOrder)
+    {
+        orderedBoxes.push_back(boxes[index]);
+    }
+
+    BVHUpdater updater;
+    updater.Initialize(bvh, leavesOrder, orderedBoxes.data());
+
+    std::vector<bool> isInTree(numLeaves, false);
+    isInTree[0] = isInTree[1] = isInTree[2] = isInTree[3] = true;
+
+    Uint32 leafID = 4;
+    for (; leafID < numLeaves; ++leafID)
+    {
+        if (!updater.InsertLeaf(bvh, leafID, boxes[leafID]))
+        {
+            break;
+        }
+        isInTree[leafID] = true;
+    }
+    ASSERT_LT(leafID, numLeaves);
+
+    // the far leaf stays next to the inner node
+    boxes[3] = chainBox;
+    EXPECT_FALSE(updater.UpdateLeaf(bvh, 3, boxes[3]));
+    ValidateUpdatedBVH(bvh, updater, boxes, isInTree);
+
+    BVH::Stats stats;
+    bvh.CalculateStats(stats);
+    EXPECT_LE(stats.maxDepth, static_cast<Uint32>(BVH::MaxDepth));
+
+    // parent links of the inner node's subtree must be valid, leaves below it are refitted up to the root
+    boxes[1] = chainBox + Vector4(300.0f, 0.0f, 0.0f, 0.0f);
+    EXPECT_TRUE(updater.UpdateLeaf(bvh, 1, boxes[1]));
+    ValidateUpdatedBVH(bvh, updater, boxes, isInTree);
+
+    updater.RemoveLeaf(bvh, 2);
+    isInTree[2] = false;
+    ValidateUpdatedBVH(bvh, updater, boxes, isInTree);
+
+    updater.RemoveLeaf(bvh, 3);
+    isInTree[3] = false;
+    ValidateUpdatedBVH(bvh, updater, boxes, isInTree);
+}
+
+namespace {
+
+// wide BVH must reference the same leaf nodes as the binary one and each of its nodes must be reachable once
+template <Uint32 Width>
+void ValidateUpdatedWideBVH(const WideBVH<Width>& wideBVH, const BVH& bvh)
+{
+    using WideNode = typename WideBVH<Width>::Node;
+
+    std::vector<std::pair<Uint32, Uint32>> expectedLeafRanges;
+    std::vector<Box> expectedLeafBoxes(bvh.GetNumNodes() > 0 ? bvh.GetNumNodes() : 1);
+    if (bvh.GetNumNodes() > 0)
+    {
+        std::vector<Uint32> stack = { 0 };
+        while (!stack.empty())
+        {
+            const BVH::Node& node = bvh.GetNodes()[stack.back()];
+            stack.pop_back();
+
+            if (node.IsLeaf())
+            {
+                expectedLeafRanges.emplace_back(node.childIndex, node.numLeaves);
+                continue;
+            }
+
+            stack.push_back(node.childIndex);
+            stack.push_back(node.childIndex + 1);
+        }
+    }
+
+    std::vector<std::pair<Uint32, Uint32>> leafRanges;
+    std::vector<Uint32> numVisits(wideBVH.GetNumNodes(), 0);
+    if (wideBVH.GetNumNodes() > 0)
+    {
+        std::vector<Uint32> stack = { 0 };
+        while (!stack.empty())
+        {
+            const Uint32 nodeIndex = stack.back();
+            stack.pop_back();
+
+            ASSERT_EQ(0u, numVisits[nodeIndex]++);
+            const WideNode& node = wideBVH.GetNodes()[nodeIndex];
+            ASSERT_NE(0u, node.GetValidChildrenMask());
+
+            for (Uint32 i = 0; i < Width; ++i)
+            {
+                if (!node.IsChildValid(i))
+                {
+                    continue;
+                }
+
+                if (node.IsChildLeaf(i))
+                {
+                    leafRanges.emplace_back(node.childIndex[i], node.childNumLeaves[i]);
+                    continue;
+                }
+
+                ASSERT_LT(node.childIndex[i], wideBVH.GetNumNodes());
+
+                const WideNode& child = wideBVH.GetNodes()[node.childIndex[i]];
+                for (Uint32 j = 0; j < Width; ++j)
+                {
+                    if (child.IsChildValid(j))
+                    {
+                        EXPECT_TRUE(BoxContains(node.GetChildBox(i), child.GetChildBox(j)));
+                    }
+                }
+
+                stack.push_back(node.childIndex[i]);
+            }
+        }
+    }
+
+    std::sort(expectedLeafRanges.begin(), expectedLeafRanges.end());
+    std::sort(leafRanges.begin(), leafRanges.end());
+    EXPECT_EQ(expectedLeafRanges, leafRanges);
+}
+
+template <Uint32 Width>
+void TestWideBVHUpdate()
+{
+    const Uint32 numLeaves = 2000;
+    Boxes boxes = GenerateRandomBoxes(numLeaves);
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(boxes.data(), numLeaves, BVHBuilder::BuildingParams(), leavesOrder));
+
+    Boxes orderedBoxes;
+    for (const Uint32 index : leavesOrder)
+    {
+        orderedBoxes.push_back(boxes[index]);
+    }
+
+    BVHUpdater updater;
+    updater.Initialize(bvh, leavesOrder, orderedBoxes.data());
+
+    WideBVH<Width> wideBVH;
+    ASSERT_TRUE(wideBVH.Build(bvh, true));
+    const Uint32 initialNumNodes = wideBVH.GetNumNodes();
+
+    // move, remove and insert random leaves
+    Random random;
+    std::vector<bool> isInTree(numLeaves, true);
+    for (Uint32 i = 0; i < 3000; ++i)
+    {
+        const Uint32 leafID = random.GetInt() % numLeaves;
+        const Vector4 center = random.GetVector4Bipolar() * 100.0f;
+        const Vector4 size = random.GetVector4() * 2.0f;
+        boxes[leafID] = Box(center - size, center + size);
+
+        if (!isInTree[leafID])
+        {
+            ASSERT_TRUE(updater.InsertLeaf(bvh, leafID, boxes[leafID]));
+            isInTree[leafID] = true;
+        }
+        else if (i % 4 == 0)
+        {
+            updater.RemoveLeaf(bvh, leafID);
+            isInTree[leafID] = false;
+        }
+        else
+        {
+            ASSERT_TRUE(updater.UpdateLeaf(bvh, leafID, boxes[leafID]));
+        }
+
+        ASSERT_TRUE(wideBVH.Update(bvh, updater.GetModifiedNodes()));
+        updater.ClearModifiedNodes();
+
+        if (i % 500 == 0)
+        {
+            ValidateUpdatedWideBVH(wideBVH, bvh);
+        }
+    }
+
+    ValidateUpdatedWideBVH(wideBVH, bvh);
+
+    // unused nodes are reused
+    EXPECT_LT(wideBVH.GetNumNodes(), 2 * initialNumNodes);
+
+    // remove all the leaves and insert some of them back
+    for (Uint32 leafID = 0; leafID < numLeaves; ++leafID)
+    {
+        if (isInTree[leafID])
+        {
+            updater.RemoveLeaf(bvh, leafID);
+            ASSERT_TRUE(wideBVH.Update(bvh, updater.GetModifiedNodes()));
+            updater.ClearModifiedNodes();
+        }
+    }
+    EXPECT_EQ(0u, wideBVH.GetNumNodes());
+
+    for (Uint32 leafID = 0; leafID < 100; ++leafID)
+    {
+        ASSERT_TRUE(updater.InsertLeaf(bvh, leafID, boxes[leafID]));
+        ASSERT_TRUE(wideBVH.Update(bvh, updater.GetModifiedNodes()));
+        updater.ClearModifiedNodes();
+    }
+    ValidateUpdatedWideBVH(wideBVH, bvh);
+}
+
+} // namespace
+
+TEST(BVHTest, WideBVH4_Update)
+{
+    TestWideBVHUpdate<4>();
+}
+
+TEST(BVHTest, WideBVH8_Update)
+{
+    TestWideBVHUpdate<8>();
+}
@@ -1,11 +1,17 @@
 #include "PCH.h"
 #include "../Core/Math/Math.h"
+#include "../Core/Utils/CpuFeatures.h"
 #include "gtest/gtest.h"
 
 int main(int argc, char **argv)
 {
     rt::math::SetFlushDenormalsToZero();
 
+    if (!rt::InitializeCpuFeatures())
+    {
+        return 1;
+    }
+
     testing::InitGoogleTest(&argc, argv);
     const int result = RUN_ALL_TESTS();
 
@@ -0,0 +1,185 @@
+#include "PCH.h"
+#include "../Core/Math/Vector16.h"
+#include "../Core/Math/Simd8Geometry.h"
+#include "../Core/Math/Simd16Geometry.h"
+#include "../Core/Math/Random.h"
+#include "../Core/Utils/CpuFeatures.h"
+
+#include "gtest/gtest.h"
+
+#ifdef RT_ENABLE_AVX512_KERNELS
+
+using namespace rt;
+using namespace rt::math;
+
+namespace {
+
+// AVX-512 types can be only used in functions compiled for AVX-512, so test bodies are moved to helper functions
+
+bool IsAVX512Supported()
+{
+    return GetCpuFeatures().GetInstructionSet() >= InstructionSet::AVX512;
+}
+
+const Vector8 GetVector8(Random& random)
+{
+    return random.GetVector8Bipolar() * 10.0f;
+}
+
+const Vector3x8 GetVector3x8(Random& random)
+{
+    return { GetVector8(random), GetVector8(random), GetVector8(random) };
+}
+
+void ExpectEqual(const Vector8& expected, const Vector8& actual)
+{
+    for (Uint32 i = 0; i < 8; ++i)
+    {
+        EXPECT_EQ(expected[i], actual[i]);
+    }
+}
+
+RT_TARGET_AVX512 void TestVector16_Constructor()
+{
+    const Vector8 lo(1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f);
+    const Vector8 hi(9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f, 16.0f);
+
+    const Vector16 v(lo, hi);
+    for (Uint32 i = 0; i < 16; ++i)
+    {
+        EXPECT_EQ(static_cast<Float>(i + 1), v[i]);
+    }
+
+    const Vector16 splat(lo);
+    for (Uint32 i = 0; i < 16; ++i)
+    {
+        EXPECT_EQ(static_cast<Float>(i % 8 + 1), splat[i]);
+    }
+
+    ExpectEqual(lo, v.Low());
+    ExpectEqual(hi, v.High());
+}
+
+RT_TARGET_AVX512 void TestVector16_CompareAndSelect()
+{
+    const Vector16 a(Vector8(1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f), Vector8(-1.0f, -2.0f, -3.0f, -4.0f, -5.0f, -6.0f, -7.0f, -8.0f));
+    const Vector16 b(4.5f);
+
+    const VectorBool16 less = a < b;
+    EXPECT_EQ(0xFF0F, less.GetMask());
+    EXPECT_EQ(0x0F, less.Low().GetMask());
+    EXPECT_EQ(0xFF, less.High().GetMask());
+    EXPECT_EQ(0xFF00, a.GetSignMask().GetMask());
+
+    const Vector16 selected = Vector16::Select(a, b, less);
+    for (Uint32 i = 0; i < 16; ++i)
+    {
+        EXPECT_EQ(a[i] < 4.5f ? 4.5f : a[i], selected[i]);
+    }
+}
+
+RT_TARGET_AVX512 void TestVector16_IntersectBoxRay()
+{
+    Random random;
+
+    for (Uint32 iteration = 0; iteration < 1000; ++iteration)
+    {
+        Ray_Simd8 raysLo, raysHi;
+        raysLo.origin = GetVector3x8(random);
+        raysLo.invDir = GetVector3x8(random);
+        raysHi.origin = GetVector3x8(random);
+        raysHi.invDir = GetVector3x8(random);
+
+        Box_Simd8 box;
+        box.min = GetVector3x8(random);
+        box.max = box.min + Vector3x8(random.GetVector8() * 5.0f, random.GetVector8() * 5.0f, random.GetVector8() * 5.0f);
+
+        const Vector8 maxDistanceLo = random.GetVector8() * 20.0f;
+        const Vector8 maxDistanceHi = random.GetVector8() * 20.0f;
+
+        Vector8 distanceLo, distanceHi;
+        const Vector8 maskLo = Intersect_BoxRay_Simd8(raysLo.invDir, raysLo.origin * raysLo.invDir, box, maxDistanceLo, distanceLo);
+        const Vector8 maskHi = Intersect_BoxRay_Simd8(raysHi.invDir, raysHi.origin * raysHi.invDir, box, maxDistanceHi, distanceHi);
+
+        const Ray_Simd16 rays(raysLo, raysHi);
+        Vector16 distance;
+        const VectorBool16 mask = Intersect_BoxRay_Simd16(rays.invDir, rays.origin * rays.invDir, Box_Simd16(box), Vector16(maxDistanceLo, maxDistanceHi), distance);
+
+        EXPECT_EQ(maskLo.GetSignMask() | (maskHi.GetSignMask() << 8), mask.GetMask());
+        ExpectEqual(distanceLo, distance.Low());
+        ExpectEqual(distanceHi, distance.High());
+    }
+}
+
+RT_TARGET_AVX512 void TestVector16_IntersectTriangleRay()
+{
+    Random random;
+
+    Uint32 numHits = 0;
+    for (Uint32 iteration = 0; iteration < 1000; ++iteration)
+    {
+        const Vector3x8 originLo = GetVector3x8(random);
+        const Vector3x8 originHi = GetVector3x8(random);
+        const Vector3x8 dirLo = GetVector3x8(random).Normalized();
+        const Vector3x8 dirHi = GetVector3x8(random).Normalized();
+
+        Triangle_Simd8 tri;
+        tri.v0 = GetVector3x8(random);
+        tri.edge1 = GetVector3x8(random);
+        tri.edge2 = GetVector3x8(random);
+
+        const Vector8 maxDistanceLo = random.GetVector8() * 20.0f;
+        const Vector8 maxDistanceHi = random.GetVector8() * 20.0f;
+
+        Vector8 uLo, vLo, distanceLo, uHi, vHi, distanceHi;
+        const VectorBool8 maskLo = Intersect_TriangleRay_Simd8(dirLo, originLo, tri, maxDistanceLo, uLo, vLo, distanceLo);
+        const VectorBool8 maskHi = Intersect_TriangleRay_Simd8(dirHi, originHi, tri, maxDistanceHi, uHi, vHi, distanceHi);
+
+        Vector16 u, v, distance;
+        const VectorBool16 mask = Intersect_TriangleRay_Simd16(Vector3x16(dirLo, dirHi), Vector3x16(originLo, originHi), Triangle_Simd16(tri),
+                                                               Vector16(maxDistanceLo, maxDistanceHi), u, v, distance);
+
+        EXPECT_EQ(maskLo.GetMask() | (maskHi.GetMask() << 8), mask.GetMask());
+        ExpectEqual(distanceLo, distance.Low());
+        ExpectEqual(distanceHi, distance.High());
+        numHits += PopCount(static_cast<Uint32>(mask.GetMask()));
+    }
+
+    EXPECT_LT(0u, numHits);
+}
+
+} // namespace
+
+TEST(MathTest, Vector16_Constructor)
+{
+    if (IsAVX512Supported())
+    {
+        TestVector16_Constructor();
+    }
+}
+
+TEST(MathTest, Vector16_CompareAndSelect)
+{
+    if (IsAVX512Supported())
+    {
+        TestVector16_CompareAndSelect();
+    }
+}
+
+TEST(MathTest, Vector16_IntersectBoxRay_MatchesSimd8)
+{
+    if (IsAVX512Supported())
+    {
+        TestVector16_IntersectBoxRay();
+    }
+}
+
+TEST(MathTest, Vector16_IntersectTriangleRay_MatchesSimd8)
+{
+    if (IsAVX512Supported())
+    {
+        TestVector16_IntersectTriangleRay();
+    }
+}
+
+#endif // RT_ENABLE_AVX512_KERNELS
@@ -0,0 +1,1352 @@
+#include "PCH.h"
+#include "../Core/BVH/BVHBuilder.h"
+#include "../Core/BVH/WideBVH.h"
+#include "../Core/BVH/MotionBVH.h"
+#include "../Core/Traversal/Traversal_Single.h"
+#include "../Core/Traversal/Traversal_Packet.h"
+#include "../Core/Traversal/Traversal_Simd.h"
+#include "../Core/Traversal/RayStream.h"
+#include "../Core/Rendering/Context.h"
+#include "../Core/Mesh/Mesh.h"
+#include "../Core/Scene/Scene.h"
+#include "../Core/Scene/Object/SceneObject_Sphere.h"
+#include "../Core/Scene/Object/SceneObject_Box.h"
+#include "../Core/Scene/Object/SceneObject_Mesh.h"
+#include "../Core/Scene/Light/BackgroundLight.h"
+#include "../Core/Scene/Camera.h"
+#include "../Core/Rendering/PathTracer.h"
+#include "../Core/Rendering/Viewport.h"
+#include "../Core/Material/Material.h"
+#include "../Core/Math/Random.h"
+#include "../Core/Utils/ThreadPool.h"
+#include "../Core/Utils/CpuFeatures.h"
+
+#include "gtest/gtest.h"
+
+using namespace rt;
+using namespace math;
+
+namespace {
+
+// minimal traversable object: a set of boxes
+template <Uint32 Width, bool Quantized = false>
+class BoxesObject
+{
+public:
+    BoxesObject(Uint32 numBoxes)
+    {
+        Random random;
+
+        std::vector<Box, AlignmentAllocator<Box>> boxes;
+        for (Uint32 i = 0; i < numBoxes; ++i)
+        {
+            const Vector4 center = random.GetVector4Bipolar() * 10.0f;
+            const Vector4 size = random.GetVector4() * 0.5f;
+            boxes.push_back(Box(center - size, center + size));
+        }
+
+        BVHBuilder::BuildingParams params;
+        params.maxLeafNodeSize = 4;
+
+        BVHBuilder::Indices leavesOrder;
+        BVHBuilder builder(mBVH);
+        builder.Build(boxes.data(), numBoxes, params, leavesOrder);
+
+        for (const Uint32 index : leavesOrder)
+        {
+            mBoxes.push_back(boxes[index]);
+        }
+
+        mWideBVH.Build(mBVH);
+    }
+
+    const BVH& GetBVH() const { return mBVH; }
+    const WideBVH<Width, Quantized>& GetWideBVH() const { return mWideBVH; }
+
+    void Traverse_Leaf_Single(const SingleTraversalContext& context, const Uint32 objectID, const BVH::Node& node) const
+    {
+        for (Uint32 i = 0; i < node.numLeaves; ++i)
+        {
+            float distance;
+            const Uint32 boxIndex = node.childIndex + i;
+            if (Intersect_BoxRay(context.ray, mBoxes[boxIndex], distance) && distance < context.hitPoint.distance)
+            {
+                context.hitPoint.distance = distance;
+                context.hitPoint.objectId = objectID;
+                context.hitPoint.subObjectId = boxIndex;
+            }
+        }
+    }
+
+    bool Traverse_Leaf_Shadow_Single(const SingleTraversalContext& context, const BVH::Node& node) const
+    {
+        for (Uint32 i = 0; i < node.numLeaves; ++i)
+        {
+            float distance;
+            if (Intersect_BoxRay(context.ray, mBoxes[node.childIndex + i], distance) && distance < context.hitPoint.distance)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void Traverse_Leaf_Packet(const PacketTraversalContext& context, const Uint32 objectID, const BVH::Node& node, const Uint32 numActiveGroups) const
+    {
+        for (Uint32 i = 0; i < node.numLeaves; ++i)
+        {
+            const Uint32 boxIndex = node.childIndex + i;
+            const Box_Simd8 box(mBoxes[boxIndex]);
+
+            for (Uint32 j = 0; j < numActiveGroups; ++j)
+            {
+                RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[j]];
+
+                Vector8 distance;
+                const Vector3x8 rayOriginDivDir = rayGroup.rays[0].origin * rayGroup.rays[0].invDir;
+                const Vector8 mask = Intersect_BoxRay_Simd8(rayGroup.rays[0].invDir, rayOriginDivDir, box, rayGroup.maxDistances, distance);
+
+                context.StoreIntersection(rayGroup, distance, VectorBool8(mask), objectID, boxIndex);
+            }
+        }
+    }
+
+private:
+    BVH mBVH;
+    WideBVH<Width, Quantized> mWideBVH;
+    std::vector<Box, AlignmentAllocator<Box>> mBoxes;
+};
+
+// set of linearly moving boxes
+class MovingBoxesObject
+{
+public:
+    MovingBoxesObject(Uint32 numBoxes)
+    {
+        Random random;
+
+        std::vector<Box, AlignmentAllocator<Box>> boxes;
+        for (Uint32 i = 0; i < numBoxes; ++i)
+        {
+            const Vector4 center = random.GetVector4Bipolar() * 10.0f;
+            const Vector4 size = random.GetVector4() * 0.5f;
+            const Vector4 velocity = random.GetVector4Bipolar() & Vector4::MakeMask<1, 1, 1, 0>();
+
+            mStartBoxes.push_back(Box(center - size, center + size));
+            mEndBoxes.push_back(mStartBoxes.back() + velocity * 4.0f);
+            boxes.push_back(Box(mStartBoxes.back(), mEndBoxes.back()));
+        }
+
+        BVHBuilder::BuildingParams params;
+        params.maxLeafNodeSize = 4;
+
+        BVHBuilder::Indices leavesOrder;
+        BVHBuilder builder(mBVH);
+        builder.Build(boxes.data(), numBoxes, params, leavesOrder);
+
+        std::vector<Box, AlignmentAllocator<Box>> startBoxes, endBoxes;
+        for (const Uint32 index : leavesOrder)
+        {
+            startBoxes.push_back(mStartBoxes[index]);
+            endBoxes.push_back(mEndBoxes[index]);
+        }
+        mStartBoxes = std::move(startBoxes);
+        mEndBoxes = std::move(endBoxes);
+
+        mMotionBVH.Build(mBVH, mStartBoxes.data(), mEndBoxes.data());
+    }
+
+    const MotionBVH& GetMotionBVH() const { return mMotionBVH; }
+    Uint32 GetNumBoxes() const { return static_cast<Uint32>(mStartBoxes.size()); }
+
+    Box GetBox(Uint32 index, float time) const
+    {
+        const Vector4 weight(time);
+        return Box(Vector4::Lerp(mStartBoxes[index].min, mEndBoxes[index].min, weight),
+                   Vector4::Lerp(mStartBoxes[index].max, mEndBoxes[index].max, weight));
+    }
+
+    void Traverse_Leaf_Single(const SingleTraversalContext& context, const Uint32 objectID, const BVH::Node& node) const
+    {
+        for (Uint32 i = 0; i < node.numLeaves; ++i)
+        {
+            float distance;
+            const Uint32 boxIndex = node.childIndex + i;
+            if (Intersect_BoxRay(context.ray, GetBox(boxIndex, context.context.time), distance) && distance < context.hitPoint.distance)
+            {
+                context.hitPoint.distance = distance;
+                context.hitPoint.objectId = objectID;
+                context.hitPoint.subObjectId = boxIndex;
+            }
+        }
+    }
+
+    bool Traverse_Leaf_Shadow_Single(const SingleTraversalContext& context, const BVH::Node& node) const
+    {
+        for (Uint32 i = 0; i < node.numLeaves; ++i)
+        {
+            float distance;
+            if (Intersect_BoxRay(context.ray, GetBox(node.childIndex + i, context.context.time), distance) && distance < context.hitPoint.distance)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    BVH mBVH;
+    MotionBVH mMotionBVH;
+    std::vector<Box, AlignmentAllocator<Box>> mStartBoxes;
+    std::vector<Box, AlignmentAllocator<Box>> mEndBoxes;
+};
+
+std::vector<Ray> GenerateRandomRays(Uint32 numRays)
+{
+    Random random;
+
+    std::vector<Ray> rays;
+    for (Uint32 i = 0; i < numRays; ++i)
+    {
+        const Vector4 origin = random.GetVector4Bipolar() * 15.0f;
+        const Vector4 dir = random.GetVector4Bipolar();
+        rays.push_back(Ray(origin & Vector4::MakeMask<1, 1, 1, 0>(), dir & Vector4::MakeMask<1, 1, 1, 0>()));
+    }
+
+    return rays;
+}
+
+template <Uint32 Width, bool Quantized = false>
+void TestWideSingleTraversal()
+{
+    using ObjectType = BoxesObject<Width, Quantized>;
+    const ObjectType object(2000);
+    const std::vector<Ray> rays = GenerateRandomRays(2000);
+
+    std::unique_ptr<RenderingContext> context(new RenderingContext);
+
+    Uint32 numHits = 0;
+    for (const Ray& ray : rays)
+    {
+        HitPoint binaryHitPoint;
+        GenericTraverse_Single(SingleTraversalContext{ ray, binaryHitPoint, *context }, 0, &object);
+
+        HitPoint wideHitPoint;
+        GenericTraverse_Wide_Single<ObjectType, Width>(SingleTraversalContext{ ray, wideHitPoint, *context }, 0, &object);
+
+        EXPECT_EQ(binaryHitPoint.distance, wideHitPoint.distance);
+        if (binaryHitPoint.distance < FLT_MAX)
+        {
+            EXPECT_EQ(binaryHitPoint.subObjectId, wideHitPoint.subObjectId);
+            numHits++;
+        }
+
+        HitPoint shadowHitPoint;
+        const bool shadowHit = GenericTraverse_Wide_Shadow_Single<ObjectType, Width>(SingleTraversalContext{ ray, shadowHitPoint, *context }, &object);
+        EXPECT_EQ(binaryHitPoint.distance < FLT_MAX, shadowHit);
+    }
+
+    // make sure the test is meaningful
+    EXPECT_LT(0u, numHits);
+    EXPECT_GT(rays.size(), numHits);
+}
+
+template <Uint32 Width, bool Quantized = false>
+void TestWidePacketTraversal()
+{
+    using ObjectType = BoxesObject<Width, Quantized>;
+    const ObjectType object(2000);
+    const std::vector<Ray> rays = GenerateRandomRays(1024);
+
+    std::unique_ptr<RenderingContext> context(new RenderingContext);
+
+    std::vector<HitPoint> hitPoints[2];
+
+    for (Uint32 mode = 0; mode < 2; ++mode)
+    {
+        RayPacket& packet = context->rayPacket;
+        packet.Clear();
+        for (const Ray& ray : rays)
+        {
+            packet.PushRay(ray, Vector4::Zero(), ImageLocationInfo(0, 0));
+        }
+
+        const Uint32 numGroups = packet.GetNumGroups();
+        for (Uint32 i = 0; i < numGroups; ++i)
+        {
+            packet.groups[i].maxDistances = VECTOR8_MAX;
+            context->activeGroupsIndices[i] = (Uint16)i;
+        }
+
+        for (Uint32 i = 0; i < packet.numRays; ++i)
+        {
+            context->hitPoints[i].distance = FLT_MAX;
+            context->hitPoints[i].objectId = UINT32_MAX;
+        }
+
+        const PacketTraversalContext packetContext = { packet, *context };
+        if (mode == 0)
+        {
+            GenericTraverse_Packet<ObjectType, 0>(packetContext, 0, &object, numGroups);
+        }
+        else
+        {
+            GenericTraverse_Wide_Packet<ObjectType, Width, 0>(packetContext, 0, &object, numGroups);
+        }
+
+        hitPoints[mode].assign(context->hitPoints, context->hitPoints + packet.numRays);
+    }
+
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        EXPECT_EQ(hitPoints[0][i].distance, hitPoints[1][i].distance);
+        EXPECT_EQ(hitPoints[0][i].objectId, hitPoints[1][i].objectId);
+        if (hitPoints[0][i].distance < FLT_MAX)
+        {
+            EXPECT_EQ(hitPoints[0][i].subObjectId, hitPoints[1][i].subObjectId);
+        }
+    }
+}
+
+Uint32 GetRayOctant(const Vector4& dir)
+{
+    return (dir.x < 0.0f ? 1u : 0u) | (dir.y < 0.0f ? 2u : 0u) | (dir.z < 0.0f ? 4u : 0u);
+}
+
+// small triangles mixed with long, thin ones
+struct ThinTrianglesData
+{
+    std::vector<Float3> positions, normals, tangents;
+    std::vector<Uint32> indices, materialIndices;
+
+    ThinTrianglesData(Uint32 numTriangles)
+    {
+        Random random;
+
+        for (Uint32 i = 0; i < numTriangles; ++i)
+        {
+            const Vector4 center = random.GetVector4Bipolar() * 10.0f;
+            const Vector4 offset = random.GetVector4Bipolar() * 0.1f;
+            const Vector4 direction = (i % 20 == 0) ? random.GetVector4Bipolar() * 10.0f : random.GetVector4Bipolar() * 0.1f;
+
+            for (const Vector4& vertex : { center - direction, center + direction, center + offset })
+            {
+                indices.push_back(static_cast<Uint32>(positions.size()));
+                positions.push_back(vertex.ToFloat3());
+                normals.push_back(Float3(0.0f, 0.0f, 1.0f));
+                tangents.push_back(Float3(1.0f, 0.0f, 0.0f));
+            }
+            materialIndices.push_back(UINT32_MAX);
+        }
+    }
+
+    MeshDesc GetMeshDesc() const
+    {
+        MeshDesc meshDesc;
+        meshDesc.vertexBufferDesc.numTriangles = static_cast<Uint32>(materialIndices.size());
+        meshDesc.vertexBufferDesc.numVertices = static_cast<Uint32>(positions.size());
+        meshDesc.vertexBufferDesc.vertexIndexBuffer = indices.data();
+        meshDesc.vertexBufferDesc.materialIndexBuffer = materialIndices.data();
+        meshDesc.vertexBufferDesc.positions = &positions.front().x;
+        meshDesc.vertexBufferDesc.normals = &normals.front().x;
+        meshDesc.vertexBufferDesc.tangents = &tangents.front().x;
+        return meshDesc;
+    }
+};
+
+// initialize meshes made of the same triangles, with BVH built without and with spatial splits
+bool InitializeThinTrianglesMeshes(Uint32 numTriangles, Mesh& objectSplitsMesh, Mesh& spatialSplitsMesh)
+{
+    const ThinTrianglesData data(numTriangles);
+    MeshDesc meshDesc = data.GetMeshDesc();
+
+    meshDesc.useSpatialSplits = false;
+    if (!objectSplitsMesh.Initialize(meshDesc))
+    {
+        return false;
+    }
+
+    meshDesc.useSpatialSplits = true;
+    return spatialSplitsMesh.Initialize(meshDesc);
+}
+
+} // namespace
+
+TEST(TraversalTest, SpatialSplits_MatchObjectSplits)
+{
+    const std::unique_ptr<Mesh> objectSplitsMesh(new Mesh);
+    const std::unique_ptr<Mesh> spatialSplitsMesh(new Mesh);
+    ASSERT_TRUE(InitializeThinTrianglesMeshes(5000, *objectSplitsMesh, *spatialSplitsMesh));
+
+    const std::vector<Ray> rays = GenerateRandomRays(2000);
+
+    std::unique_ptr<RenderingContext> context(new RenderingContext);
+
+    Uint32 numHits = 0;
+    for (const Ray& ray : rays)
+    {
+        HitPoint referenceHitPoint;
+        GenericTraverse_Single(SingleTraversalContext{ ray, referenceHitPoint, *context }, 0, objectSplitsMesh.get());
+
+        HitPoint hitPoint;
+        GenericTraverse_Single(SingleTraversalContext{ ray, hitPoint, *context }, 0, spatialSplitsMesh.get());
+        EXPECT_EQ(referenceHitPoint.distance, hitPoint.distance);
+
+#if RT_BVH_WIDTH > 2
+        HitPoint wideHitPoint;
+        GenericTraverse_Wide_Single<Mesh, RT_BVH_WIDTH>(SingleTraversalContext{ ray, wideHitPoint, *context }, 0, spatialSplitsMesh.get());
+        EXPECT_EQ(referenceHitPoint.distance, wideHitPoint.distance);
+#endif // RT_BVH_WIDTH > 2
+
+        if (referenceHitPoint.distance < FLT_MAX)
+        {
+            numHits++;
+        }
+    }
+
+    EXPECT_LT(0u, numHits);
+}
+
+TEST(TraversalTest, EarlySplits_MatchObjectSplits)
+{
+    const ThinTrianglesData data(5000);
+    MeshDesc meshDesc = data.GetMeshDesc();
+    meshDesc.useSpatialSplits = false;
+
+    const std::unique_ptr<Mesh> objectSplitsMesh(new Mesh);
+    ASSERT_TRUE(objectSplitsMesh->Initialize(meshDesc));
+
+    meshDesc.earlySplitBudget = 0.5f;
+    const std::unique_ptr<Mesh> earlySplitsMesh(new Mesh);
+    ASSERT_TRUE(earlySplitsMesh->Initialize(meshDesc));
+
+    const std::vector<Ray> rays = GenerateRandomRays(2000);
+
+    std::unique_ptr<RenderingContext> context(new RenderingContext);
+
+    Uint32 numHits = 0;
+    for (const Ray& ray : rays)
+    {
+        HitPoint referenceHitPoint;
+        GenericTraverse_Single(SingleTraversalContext{ ray, referenceHitPoint, *context }, 0, objectSplitsMesh.get());
+
+        HitPoint hitPoint;
+        GenericTraverse_Single(SingleTraversalContext{ ray, hitPoint, *context }, 0, earlySplitsMesh.get());
+        EXPECT_EQ(referenceHitPoint.distance, hitPoint.distance);
+
+        if (referenceHitPoint.distance < FLT_MAX)
+        {
+            numHits++;
+        }
+    }
+
+    EXPECT_LT(0u, numHits);
+}
+
+TEST(TraversalTest, UpdatePositions_MatchesInitialize)
+{
+    ThinTrianglesData data(5000);
+
+    const std::unique_ptr<Mesh> refittedMesh(new Mesh);
+    const std::unique_ptr<Mesh> rebuiltMesh(new Mesh);
+    ASSERT_TRUE(refittedMesh->Initialize(data.GetMeshDesc()));
+    ASSERT_TRUE(rebuiltMesh->Initialize(data.GetMeshDesc()));
+
+    // twist the mesh around Z axis
+    for (Float3& position : data.positions)
+    {
+        const float angle = 0.2f * position.z;
+        const float x = position.x * cosf(angle) - position.y * sinf(angle);
+        const float y = position.x * sinf(angle) + position.y * cosf(angle);
+        position = Float3(x, y, position.z);
+    }
+
+    ThreadPool threadPool;
+    ASSERT_TRUE(refittedMesh->UpdatePositions(&data.positions.front().x, 0.0f, &threadPool));
+    ASSERT_TRUE(rebuiltMesh->UpdatePositions(&data.positions.front().x, 0.1f));
+
+    const std::unique_ptr<Mesh> referenceMesh(new Mesh);
+    ASSERT_TRUE(referenceMesh->Initialize(data.GetMeshDesc()));
+
+    const std::vector<Ray> rays = GenerateRandomRays(2000);
+
+    std::unique_ptr<RenderingContext> context(new RenderingContext);
+
+    Uint32 numHits = 0;
+    for (const Ray& ray : rays)
+    {
+        HitPoint referenceHitPoint;
+        GenericTraverse_Single(SingleTraversalContext{ ray, referenceHitPoint, *context }, 0, referenceMesh.get());
+
+        for (const Mesh* mesh : { refittedMesh.get(), rebuiltMesh.get() })
+        {
+            HitPoint hitPoint;
+            GenericTraverse_Single(SingleTraversalContext{ ray, hitPoint, *context }, 0, mesh);
+            EXPECT_EQ(referenceHitPoint.distance, hitPoint.distance);
+
+#if RT_BVH_WIDTH > 2
+            HitPoint wideHitPoint;
+            GenericTraverse_Wide_Single<Mesh, RT_BVH_WIDTH>(SingleTraversalContext{ ray, wideHitPoint, *context }, 0, mesh);
+            EXPECT_EQ(referenceHitPoint.distance, wideHitPoint.distance);
+#endif // RT_BVH_WIDTH > 2
+        }
+
+        if (referenceHitPoint.distance < FLT_MAX)
+        {
+            numHits++;
+        }
+    }
+
+    EXPECT_LT(0u, numHits);
+
+    // rebuilding must restore the tree quality
+    BVH::Stats refittedStats, rebuiltStats;
+    refittedMesh->GetBVH().CalculateStats(refittedStats);
+    rebuiltMesh->GetBVH().CalculateStats(rebuiltStats);
+    EXPECT_LT(rebuiltStats.sahCost, refittedStats.sahCost);
+}
+
+TEST(TraversalTest, WideSingle4_MatchesBinary)
+{
+    TestWideSingleTraversal<4>();
+}
+
+TEST(TraversalTest, WideSingle8_MatchesBinary)
+{
+    TestWideSingleTraversal<8>();
+}
+
+TEST(TraversalTest, RayStream_PacketsMatchSingle)
+{
+    using ObjectType = BoxesObject<4>;
+    const ObjectType object(2000);
+    const std::vector<Ray> rays = GenerateRandomRays(3001);
+
+    std::unique_ptr<RayStream> stream(new RayStream);
+    for (Uint32 i = 0; i < rays.size(); ++i)
+    {
+        stream->PushRay(rays[i], Vector4(1.0f), ImageLocationInfo(i % 1024, i / 1024));
+    }
+    stream->Sort();
+    EXPECT_EQ((Uint32)rays.size(), stream->GetNumRays());
+
+    std::unique_ptr<RenderingContext> context(new RenderingContext);
+    RayPacket& packet = context->rayPacket;
+
+    std::vector<Uint32> numPopped(rays.size(), 0);
+    Uint32 numPackets = 0;
+    Uint32 numHits = 0;
+
+    while (stream->PopPacket(packet))
+    {
+        numPackets++;
+        ASSERT_LT(0u, packet.numRays);
+
+        const Uint32 numGroups = packet.GetNumGroups();
+        for (Uint32 i = 0; i < numGroups; ++i)
+        {
+            packet.groups[i].maxDistances = VECTOR8_MAX;
+            context->activeGroupsIndices[i] = (Uint16)i;
+        }
+
+        for (Uint32 i = 0; i < numGroups * RayPacket::RaysPerGroup; ++i)
+        {
+            context->hitPoints[i].distance = FLT_MAX;
+            context->hitPoints[i].objectId = UINT32_MAX;
+        }
+
+        GenericTraverse_Packet<ObjectType, 0>(PacketTraversalContext{ packet, *context }, 0, &object, numGroups);
+
+        const Vector3x8& firstDirs = packet.groups[0].rays[0].dir;
+        const Vector4 firstDir(firstDirs.x[0], firstDirs.y[0], firstDirs.z[0], 0.0f);
+        for (Uint32 i = 0; i < packet.numRays; ++i)
+        {
+            const ImageLocationInfo& location = packet.imageLocations[i];
+            const Uint32 rayIndex = location.y * 1024 + location.x;
+            ASSERT_LT(rayIndex, (Uint32)rays.size());
+            numPopped[rayIndex]++;
+
+            // packets must not mix direction octants
+            const Ray& ray = rays[rayIndex];
+            EXPECT_EQ(GetRayOctant(firstDir), GetRayOctant(ray.dir));
+
+            HitPoint hitPoint;
+            GenericTraverse_Single(SingleTraversalContext{ Ray(Vector4(ray.origin.ToFloat3()), Vector4(ray.dir.ToFloat3())), hitPoint, *context }, 0, &object);
+            EXPECT_EQ(hitPoint.distance, context->hitPoints[i].distance);
+
+            if (hitPoint.distance < FLT_MAX)
+            {
+                numHits++;
+            }
+        }
+    }
+
+    EXPECT_EQ(0u, stream->GetNumRays());
+    EXPECT_LE(8u, numPackets);
+    EXPECT_LT(0u, numHits);
+    for (const Uint32 count : numPopped)
+    {
+        EXPECT_EQ(1u, count);
+    }
+}
+
+TEST(TraversalTest, RaySorter_SortsByOctant)
+{
+    const std::vector<Ray> rays = GenerateRandomRays(3001);
+
+    RaySorter sorter;
+    const std::vector<Uint32>& order = sorter.Sort(static_cast<Uint32>(rays.size()), [&rays](Uint32 i) -> const Ray& { return rays[i]; });
+    ASSERT_EQ(rays.size(), order.size());
+
+    std::vector<Uint32> numSorted(rays.size(), 0);
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        ASSERT_LT(order[i], (Uint32)rays.size());
+        numSorted[order[i]]++;
+
+        if (i > 0)
+        {
+            EXPECT_LE(rays[order[i - 1]].GetOctant(), rays[order[i]].GetOctant());
+        }
+    }
+
+    for (const Uint32 count : numSorted)
+    {
+        EXPECT_EQ(1u, count);
+    }
+}
+
+TEST(TraversalTest, OctantSortedPacket_MatchesSingle)
+{
+    using ObjectType = BoxesObject<8>;
+    const ObjectType object(2000);
+
+    // most groups share the direction octant, the ones on octant boundaries do not
+    std::vector<Ray> rays = GenerateRandomRays(1001);
+    std::stable_sort(rays.begin(), rays.end(), [](const Ray& a, const Ray& b) { return a.GetOctant() < b.GetOctant(); });
+
+    std::unique_ptr<RenderingContext> context(new RenderingContext);
+    RayPacket& packet = context->rayPacket;
+
+    for (Uint32 mode = 0; mode < 2; ++mode)
+    {
+        packet.Clear();
+        for (const Ray& ray : rays)
+        {
+            packet.PushRay(ray, Vector4::Zero(), ImageLocationInfo(0, 0));
+        }
+        packet.FillLastGroup();
+
+        const Uint32 numGroups = packet.GetNumGroups();
+        for (Uint32 i = 0; i < numGroups; ++i)
+        {
+            context->activeGroupsIndices[i] = (Uint16)i;
+        }
+
+        for (Uint32 i = 0; i < numGroups * RayPacket::RaysPerGroup; ++i)
+        {
+            context->hitPoints[i].distance = FLT_MAX;
+            context->hitPoints[i].objectId = UINT32_MAX;
+        }
+
+        Uint16 sortedIndices[RayPacket::MaxNumGroups];
+        Uint32 octantOffsets[MixedRayOctant + 2];
+        SortGroupsByOctant(*context, packet, numGroups, 0, sortedIndices, octantOffsets);
+        EXPECT_EQ(numGroups, octantOffsets[MixedRayOctant + 1]);
+        EXPECT_GE(7u, octantOffsets[MixedRayOctant + 1] - octantOffsets[MixedRayOctant]);
+
+        const PacketTraversalContext packetContext = { packet, *context };
+        if (mode == 0)
+        {
+            GenericTraverse_Packet<ObjectType, 0>(packetContext, 0, &object, numGroups);
+        }
+        else
+        {
+            GenericTraverse_Wide_Packet<ObjectType, 8, 0>(packetContext, 0, &object, numGroups);
+        }
+
+        Uint32 numHits = 0;
+        for (Uint32 i = 0; i < packet.numRays; ++i)
+        {
+            HitPoint hitPoint;
+            GenericTraverse_Single(SingleTraversalContext{ rays[i], hitPoint, *context }, 0, &object);
+            EXPECT_EQ(hitPoint.distance, context->hitPoints[i].distance);
+            if (hitPoint.distance < FLT_MAX)
+            {
+                EXPECT_EQ(hitPoint.subObjectId, context->hitPoints[i].subObjectId);
+                numHits++;
+            }
+        }
+
+        EXPECT_LT(0u, numHits);
+    }
+}
+
+TEST(TraversalTest, PacketFrustum_MatchesSingle)
+{
+    using ObjectType = BoxesObject<8>;
+    const ObjectType object(2000);
+
+    Random random;
+
+    // coherent primary rays of a lens camera, all pointing to the same octant
+    std::vector<Ray> rays;
+    for (Uint32 y = 0; y < 32; ++y)
+    {
+        for (Uint32 x = 0; x < 32; ++x)
+        {
+            const Vector4 origin = Vector4(-5.0f, -5.0f, -30.0f, 0.0f) + (random.GetVector4Bipolar() & Vector4::MakeMask<1, 1, 0, 0>()) * 0.1f;
+            const Vector4 dir(0.01f + 0.01f * static_cast<Float>(x), 0.01f + 0.01f * static_cast<Float>(y), 1.0f, 0.0f);
+            rays.push_back(Ray(origin, dir.Normalized3()));
+        }
+    }
+
+    std::unique_ptr<RenderingContext> context(new RenderingContext);
+    RayPacket& packet = context->rayPacket;
+
+    const auto resetPacket = [&]()
+    {
+        packet.Clear();
+        for (const Ray& ray : rays)
+        {
+            packet.PushRay(ray, Vector4::Zero(), ImageLocationInfo(0, 0));
+        }
+
+        for (Uint32 i = 0; i < packet.GetNumGroups(); ++i)
+        {
+            context->activeGroupsIndices[i] = (Uint16)i;
+        }
+
+        for (Uint32 i = 0; i < packet.numRays; ++i)
+        {
+            context->hitPoints[i].distance = FLT_MAX;
+            context->hitPoints[i].objectId = UINT32_MAX;
+        }
+    };
+
+    // frustum test must agree with per-ray tests whenever it is conclusive
+    {
+        resetPacket();
+        const Uint32 numGroups = packet.GetNumGroups();
+
+        RayPacketFrustum frustum;
+        BuildRayPacketFrustum(*context, packet, numGroups, 0, 0, frustum);
+        ASSERT_TRUE(frustum.isValid);
+
+        Uint32 numConclusiveTests = 0;
+        for (Uint32 i = 0; i < 1000; ++i)
+        {
+            const Vector4 center = random.GetVector4Bipolar() * 40.0f;
+            const Vector4 size = random.GetVector4() * 5.0f;
+            const Box box(center - size, center + size);
+
+            const FrustumTestResult result = frustum.Test(box);
+            if (result == FrustumTestResult::Unknown)
+            {
+                continue;
+            }
+            numConclusiveTests++;
+
+            const Uint32 raysHit = TestRayPacket(packet, numGroups, Box_Simd8(box), *context, 0);
+            EXPECT_EQ(result == FrustumTestResult::AllMiss ? 0u : packet.numRays, raysHit);
+        }
+
+        EXPECT_LT(0u, numConclusiveTests);
+        EXPECT_EQ(FrustumTestResult::AllHit, frustum.Test(Box(Vector4(-6.0f, -6.0f, -31.0f, 0.0f), Vector4(6.0f, 6.0f, 0.0f, 0.0f))));
+    }
+
+    for (Uint32 mode = 0; mode < 2; ++mode)
+    {
+        resetPacket();
+
+        const PacketTraversalContext packetContext = { packet, *context };
+        if (mode == 0)
+        {
+            GenericTraverse_Packet<ObjectType, 0>(packetContext, 0, &object, packet.GetNumGroups());
+        }
+        else
+        {
+            GenericTraverse_Wide_Packet<ObjectType, 8, 0>(packetContext, 0, &object, packet.GetNumGroups());
+        }
+
+        Uint32 numHits = 0;
+        for (Uint32 i = 0; i < packet.numRays; ++i)
+        {
+            HitPoint hitPoint;
+            GenericTraverse_Single(SingleTraversalContext{ rays[i], hitPoint, *context }, 0, &object);
+            EXPECT_EQ(hitPoint.distance, context->hitPoints[i].distance);
+            if (hitPoint.distance < FLT_MAX)
+            {
+                EXPECT_EQ(hitPoint.subObjectId, context->hitPoints[i].subObjectId);
+                numHits++;
+            }
+        }
+
+        EXPECT_LT(0u, numHits);
+    }
+}
+
+TEST(TraversalTest, WidePacket4_MatchesBinary)
+{
+    TestWidePacketTraversal<4>();
+}
+
+TEST(TraversalTest, WidePacket8_MatchesBinary)
+{
+    TestWidePacketTraversal<8>();
+}
+
+TEST(TraversalTest, QuantizedWideSingle4_MatchesBinary)
+{
+    TestWideSingleTraversal<4, true>();
+}
+
+TEST(TraversalTest, QuantizedWideSingle8_MatchesBinary)
+{
+    TestWideSingleTraversal<8, true>();
+}
+
+TEST(TraversalTest, QuantizedWidePacket4_MatchesBinary)
+{
+    TestWidePacketTraversal<4, true>();
+}
+
+TEST(TraversalTest, QuantizedWidePacket8_MatchesBinary)
+{
+    TestWidePacketTraversal<8, true>();
+}
+
+TEST(TraversalTest, MotionSingle_MatchesBruteForce)
+{
+    const MovingBoxesObject object(2000);
+    const std::vector<Ray> rays = GenerateRandomRays(2000);
+
+    std::unique_ptr<RenderingContext> context(new RenderingContext);
+    Random random;
+
+    Uint32 numHits = 0;
+    for (const Ray& ray : rays)
+    {
+        context->time = random.GetFloat();
+
+        HitPoint referenceHitPoint;
+        for (Uint32 i = 0; i < object.GetNumBoxes(); ++i)
+        {
+            float distance;
+            if (Intersect_BoxRay(ray, object.GetBox(i, context->time), distance) && distance < referenceHitPoint.distance)
+            {
+                referenceHitPoint.distance = distance;
+            }
+        }
+
+        HitPoint hitPoint;
+        GenericTraverse_Motion_Single(SingleTraversalContext{ ray, hitPoint, *context }, 0, &object);
+        EXPECT_EQ(referenceHitPoint.distance, hitPoint.distance);
+
+        HitPoint shadowHitPoint;
+        const bool shadowHit = GenericTraverse_Motion_Shadow_Single(SingleTraversalContext{ ray, shadowHitPoint, *context }, &object);
+        EXPECT_EQ(referenceHitPoint.distance < FLT_MAX, shadowHit);
+
+        if (referenceHitPoint.distance < FLT_MAX)
+        {
+            numHits++;
+        }
+    }
+
+    // make sure the test is meaningful
+    EXPECT_LT(0u, numHits);
+    EXPECT_GT(rays.size(), numHits);
+}
+
+void TestSceneIncrementalUpdates(bool movingObjects)
+{
+    Random random;
+
+    const auto randomPosition = [&random]()
+    {
+        return (random.GetVector4Bipolar() * 10.0f) & Vector4::MakeMask<1, 1, 1, 0>();
+    };
+
+    const auto randomVelocity = [&random, movingObjects]()
+    {
+        return movingObjects ? (random.GetVector4Bipolar() & Vector4::MakeMask<1, 1, 1, 0>()) : Vector4::Zero();
+    };
+
+    const auto createSphere = [](const Vector4& position, const Vector4& velocity)
+    {
+        std::unique_ptr<SphereSceneObject> sphere(new SphereSceneObject(0.5f));
+        sphere->mTransform.SetTranslation(position);
+        sphere->mLinearVelocity = velocity;
+        return sphere;
+    };
+
+    Scene scene;
+    std::vector<Uint32> objectIDs;
+    for (Uint32 i = 0; i < 500; ++i)
+    {
+        objectIDs.push_back(scene.AddObject(createSphere(randomPosition(), randomVelocity())));
+    }
+    ASSERT_TRUE(scene.BuildBVH());
+
+    // move, remove and add objects
+    for (Uint32 i = 0; i < 300; ++i)
+    {
+        const Uint32 index = random.GetInt() % static_cast<Uint32>(objectIDs.size());
+        const Uint32 objectID = objectIDs[index];
+
+        if (i % 3 == 0)
+        {
+            scene.RemoveObject(objectID);
+            objectIDs[index] = scene.AddObject(createSphere(randomPosition(), randomVelocity()));
+        }
+        else
+        {
+            ISceneObject* object = scene.GetObjects()[objectID].get();
+            object->mTransform.SetTranslation(randomPosition());
+            object->mLinearVelocity = randomVelocity();
+            ASSERT_TRUE(scene.UpdateObject(objectID));
+        }
+    }
+
+    // objects which were not removed keep their IDs
+    EXPECT_LT(objectIDs.size(), scene.GetObjects().size());
+
+    // derived BVHs are kept up to date
+#if RT_BVH_WIDTH > 2
+    EXPECT_LT(0u, scene.GetWideBVH().GetNumNodes());
+#endif // RT_BVH_WIDTH > 2
+    EXPECT_EQ(movingObjects, scene.GetMotionBVH().GetNumNodes() > 0);
+
+    Scene referenceScene;
+    for (const Uint32 objectID : objectIDs)
+    {
+        const ISceneObject* object = scene.GetObjects()[objectID].get();
+        referenceScene.AddObject(createSphere(object->mTransform.GetTranslation(), object->mLinearVelocity));
+    }
+    ASSERT_TRUE(referenceScene.BuildBVH());
+
+    const std::vector<Ray> rays = GenerateRandomRays(2000);
+    std::unique_ptr<RenderingContext> context(new RenderingContext);
+
+    Uint32 numHits = 0;
+    for (const Ray& ray : rays)
+    {
+        if (movingObjects)
+        {
+            context->time = random.GetFloat();
+        }
+
+        HitPoint referenceHitPoint;
+        referenceScene.Traverse_Single(SingleTraversalContext{ ray, referenceHitPoint, *context });
+
+        HitPoint hitPoint;
+        scene.Traverse_Single(SingleTraversalContext{ ray, hitPoint, *context });
+        EXPECT_EQ(referenceHitPoint.distance, hitPoint.distance);
+
+        HitPoint shadowHitPoint;
+        const bool shadowHit = scene.Traverse_Shadow_Single(SingleTraversalContext{ ray, shadowHitPoint, *context });
+        EXPECT_EQ(referenceHitPoint.distance < FLT_MAX, shadowHit);
+
+        if (referenceHitPoint.distance < FLT_MAX)
+        {
+            const Vector4 position = scene.GetObjects()[hitPoint.objectId]->mTransform.GetTranslation();
+            const Vector4 referencePosition = referenceScene.GetObjects()[referenceHitPoint.objectId]->mTransform.GetTranslation();
+            EXPECT_TRUE((position == referencePosition).All());
+            numHits++;
+        }
+    }
+
+    EXPECT_LT(0u, numHits);
+}
+
+TEST(TraversalTest, SceneIncrementalUpdates_MatchRebuild)
+{
+    TestSceneIncrementalUpdates(false);
+}
+
+TEST(TraversalTest, SceneIncrementalUpdates_Moving_MatchRebuild)
+{
+    TestSceneIncrementalUpdates(true);
+}
+
+TEST(TraversalTest, ShadowPacket_MatchesSingle)
+{
+    Random random;
+
+    const ThinTrianglesData data(2000);
+    const MeshPtr mesh(new Mesh);
+    ASSERT_TRUE(mesh->Initialize(data.GetMeshDesc()));
+
+    Scene scene;
+    {
+        std::unique_ptr<MeshSceneObject> meshObject(new MeshSceneObject(mesh));
+        meshObject->mTransform.SetTranslation(Vector4(1.0f, 2.0f, 0.0f, 0.0f));
+        scene.AddObject(std::move(meshObject));
+    }
+    for (Uint32 i = 0; i < 20; ++i)
+    {
+        std::unique_ptr<ISceneObject> object;
+        if (i % 2 == 0)
+        {
+            object.reset(new SphereSceneObject(1.0f));
+        }
+        else
+        {
+            object.reset(new BoxSceneObject(Vector4(1.0f, 0.5f, 2.0f, 0.0f)));
+        }
+        object->mTransform.SetTranslation((random.GetVector4Bipolar() * 10.0f) & Vector4::MakeMask<1, 1, 1, 0>());
+        scene.AddObject(std::move(object));
+    }
+    ASSERT_TRUE(scene.BuildBVH());
+
+    // not a multiple of the group size
+    const std::vector<Ray> rays = GenerateRandomRays(2001);
+    std::vector<Float> maxDistances;
+
+    std::unique_ptr<RenderingContext> context(new RenderingContext);
+    RayPacket& packet = context->rayPacket;
+    packet.Clear();
+    for (const Ray& ray : rays)
+    {
+        maxDistances.push_back(random.GetFloat() * 30.0f);
+        packet.PushRay(ray, Vector4::Zero(), ImageLocationInfo(), maxDistances.back());
+    }
+    packet.FillLastGroup();
+
+    scene.Traverse_Shadow_Packet({ packet, *context });
+
+    Uint32 numOccluded = 0;
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        HitPoint referenceHitPoint;
+        referenceHitPoint.distance = maxDistances[i];
+        const bool referenceOccluded = scene.Traverse_Shadow_Single(SingleTraversalContext{ rays[i], referenceHitPoint, *context });
+
+        const HitPoint& hitPoint = context->hitPoints[i];
+        EXPECT_EQ(referenceOccluded, hitPoint.distance < FLT_MAX);
+        if (hitPoint.distance < FLT_MAX)
+        {
+            EXPECT_LT(hitPoint.distance, maxDistances[i]);
+            numOccluded++;
+        }
+    }
+
+    EXPECT_LT(0u, numOccluded);
+    EXPECT_LT(numOccluded, static_cast<Uint32>(rays.size()));
+}
+
+TEST(TraversalTest, Simd8_MatchesBruteForce)
+{
+    const ThinTrianglesData data(2000);
+    MeshDesc meshDesc = data.GetMeshDesc();
+    meshDesc.useSpatialSplits = false; // no duplicated triangles
+    Mesh mesh;
+    ASSERT_TRUE(mesh.Initialize(meshDesc));
+
+    // all triangles in a single leaf
+    BVH::Node allTriangles;
+    allTriangles.childIndex = 0;
+    allTriangles.numLeaves = meshDesc.vertexBufferDesc.numTriangles;
+
+    const std::vector<Ray> rays = GenerateRandomRays(2000);
+
+    std::unique_ptr<RenderingContext> context(new RenderingContext);
+
+    Uint32 numHits = 0;
+    for (size_t i = 0; i < rays.size(); i += 8)
+    {
+        const Ray_Simd8 simdRay(rays[i + 0], rays[i + 1], rays[i + 2], rays[i + 3], rays[i + 4], rays[i + 5], rays[i + 6], rays[i + 7]);
+
+        HitPoint_Simd8 hitPoint;
+        GenericTraverse_Simd8(SimdTraversalContext{ simdRay, hitPoint, *context }, 0, &mesh);
+
+        HitPoint_Simd8 referenceHitPoint;
+        mesh.Traverse_Leaf_Simd8(SimdTraversalContext{ simdRay, referenceHitPoint, *context }, 0, allTriangles);
+
+        for (Uint32 j = 0; j < 8; ++j)
+        {
+            EXPECT_EQ(referenceHitPoint.distance[j], hitPoint.distance[j]);
+            if (referenceHitPoint.distance[j] < FLT_MAX)
+            {
+                EXPECT_EQ(referenceHitPoint.subObjectId[j], hitPoint.subObjectId[j]);
+                EXPECT_EQ(referenceHitPoint.u[j], hitPoint.u[j]);
+                EXPECT_EQ(referenceHitPoint.v[j], hitPoint.v[j]);
+                numHits++;
+            }
+        }
+    }
+
+    // make sure the test is meaningful
+    EXPECT_LT(0u, numHits);
+    EXPECT_GT(rays.size(), numHits);
+}
+
+namespace {
+
+// compare scene packet traversal results (closest and shadow hits) in two traversal modes
+template <typename ModeSetup>
+void TestScenePacketTraversalModes(const ModeSetup& setupMode)
+{
+    Random random;
+
+    // no duplicated triangles, so hit triangles do not depend on traversal order
+    const ThinTrianglesData data(2000);
+    MeshDesc meshDesc = data.GetMeshDesc();
+    meshDesc.useSpatialSplits = false;
+    const MeshPtr mesh(new Mesh);
+    ASSERT_TRUE(mesh->Initialize(meshDesc));
+
+    Scene scene;
+    for (Uint32 i = 0; i < 20; ++i)
+    {
+        std::unique_ptr<ISceneObject> object;
+        if (i % 4 == 0)
+        {
+            object.reset(new MeshSceneObject(mesh));
+        }
+        else
+        {
+            object.reset(new SphereSceneObject(1.0f));
+        }
+        object->mTransform.SetTranslation((random.GetVector4Bipolar() * 10.0f) & Vector4::MakeMask<1, 1, 1, 0>());
+        scene.AddObject(std::move(object));
+    }
+    ASSERT_TRUE(scene.BuildBVH());
+
+    const std::vector<Ray> rays = GenerateRandomRays(2001);
+    std::vector<Float> maxDistances;
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        maxDistances.push_back(random.GetFloat() * 30.0f);
+    }
+
+    std::unique_ptr<RenderingContext> context(new RenderingContext);
+
+    std::vector<HitPoint> hitPoints[2], shadowHitPoints[2];
+    for (Uint32 mode = 0; mode < 2; ++mode)
+    {
+        setupMode(*context, mode);
+
+        for (Uint32 shadow = 0; shadow < 2; ++shadow)
+        {
+            RayPacket& packet = context->rayPacket;
+            packet.Clear();
+            for (size_t i = 0; i < rays.size(); ++i)
+            {
+                packet.PushRay(rays[i], Vector4::Zero(), ImageLocationInfo(), shadow ? maxDistances[i] : FLT_MAX);
+            }
+            packet.FillLastGroup();
+
+            if (shadow)
+            {
+                scene.Traverse_Shadow_Packet({ packet, *context });
+                shadowHitPoints[mode].assign(context->hitPoints, context->hitPoints + rays.size());
+            }
+            else
+            {
+                scene.Traverse_Packet({ packet, *context });
+                hitPoints[mode].assign(context->hitPoints, context->hitPoints + rays.size());
+            }
+        }
+    }
+
+    Uint32 numHits = 0;
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        EXPECT_EQ(hitPoints[0][i].distance, hitPoints[1][i].distance);
+        EXPECT_EQ(hitPoints[0][i].objectId, hitPoints[1][i].objectId);
+        if (hitPoints[0][i].distance < FLT_MAX)
+        {
+            EXPECT_EQ(hitPoints[0][i].subObjectId, hitPoints[1][i].subObjectId);
+            numHits++;
+        }
+
+        EXPECT_EQ(shadowHitPoints[0][i].distance < FLT_MAX, shadowHitPoints[1][i].distance < FLT_MAX);
+    }
+
+    EXPECT_LT(0u, numHits);
+    EXPECT_GT(rays.size(), numHits);
+}
+
+} // namespace
+
+TEST(TraversalTest, PacketSimdFallback_MatchesPacket)
+{
+    RenderingParams params[2];
+    params[0].simdTraversalMaxGroups = 0;
+    params[1].simdTraversalMaxGroups = RayPacket::MaxNumGroups;
+
+    // packet traversal only vs. switching to 8-ray traversal as soon as possible
+    TestScenePacketTraversalModes([&](RenderingContext& context, Uint32 mode)
+    {
+        context.params = &params[mode];
+    });
+}
+
+TEST(TraversalTest, ReorderedPacket_MatchesPacket)
+{
+    RenderingParams params[2];
+    params[0].rayReorderingThreshold = 0.0f;
+    params[1].rayReorderingThreshold = 1.0f;
+    params[0].simdTraversalMaxGroups = 0;
+    params[1].simdTraversalMaxGroups = 0;
+
+    // no reordering vs. reordering whenever any lane is inactive
+    TestScenePacketTraversalModes([&](RenderingContext& context, Uint32 mode)
+    {
+        context.params = &params[mode];
+    });
+}
+
+TEST(TraversalTest, KernelInstructionSets_MatchBaseline)
+{
+    const InstructionSet kernelInstructionSet = GetKernelInstructionSet();
+
+    RenderingParams params;
+    params.simdTraversalMaxGroups = 0;
+
+    std::vector<InstructionSet> instructionSets = { InstructionSet::AVX2 };
+#ifdef RT_ENABLE_AVX512_KERNELS
+    instructionSets.push_back(InstructionSet::AVX512);
+#endif // RT_ENABLE_AVX512_KERNELS
+
+    // baseline kernels vs. each variant supported by the CPU (results must be exactly the same)
+    for (const InstructionSet instructionSet : instructionSets)
+    {
+        if (instructionSet <= GetBaselineInstructionSet() || instructionSet > GetCpuFeatures().GetInstructionSet())
+        {
+            continue;
+        }
+
+        TestScenePacketTraversalModes([&](RenderingContext& context, Uint32 mode)
+        {
+            context.params = &params;
+            ASSERT_TRUE(SetKernelInstructionSet(mode == 0 ? GetBaselineInstructionSet() : instructionSet));
+        });
+    }
+
+    ASSERT_TRUE(SetKernelInstructionSet(kernelInstructionSet));
+}
+
+TEST(TraversalTest, ReorderRays_CompactsActiveRays)
+{
+    Random random;
+
+    std::unique_ptr<RenderingContext> context(new RenderingContext);
+    RayPacket& packet = context->rayPacket;
+
+    for (Uint32 iteration = 0; iteration < 20; ++iteration)
+    {
+        // ray data of each lane encodes its offset
+        packet.Clear();
+        const Uint32 numRays = 8 * (1 + random.GetInt() % 64);
+        for (Uint32 i = 0; i < numRays; ++i)
+        {
+            const Float value = static_cast<Float>(i);
+            packet.PushRay(Ray(Vector4(value, 0.0f, 0.0f, 0.0f), Vector4(0.0f, 0.0f, 1.0f, 0.0f)), Vector4(value), ImageLocationInfo(), value);
+        }
+
+        const Uint32 numGroups = packet.GetNumGroups();
+        std::vector<bool> isActive(numRays, false);
+        Uint32 numActiveRays = 0;
+        for (Uint32 i = 0; i < numGroups; ++i)
+        {
+            context->activeGroupsIndices[i] = (Uint16)(numGroups - 1 - i);
+            context->activeRaysMask[i] = (Uint8)(iteration % 2 ? random.GetInt() : (random.GetInt() & random.GetInt() & random.GetInt()));
+            for (Uint32 j = 0; j < RayPacket::RaysPerGroup; ++j)
+            {
+                if (context->activeRaysMask[i] & (1 << j))
+                {
+                    isActive[RayPacket::RaysPerGroup * context->activeGroupsIndices[i] + j] = true;
+                    numActiveRays++;
+                }
+            }
+        }
+
+        const Uint32 numActiveGroups = ReorderRays(*context, numGroups);
+        EXPECT_EQ((numActiveRays + 7) / 8, numActiveGroups);
+
+        std::vector<bool> visited(numRays, false);
+        for (Uint32 i = 0; i < numGroups; ++i)
+        {
+            const Uint32 groupIndex = context->activeGroupsIndices[i];
+            const RayGroup& group = packet.groups[groupIndex];
+            for (Uint32 j = 0; j < RayPacket::RaysPerGroup; ++j)
+            {
+                const Uint32 rayOffset = group.rayOffsets[j];
+                ASSERT_GT(numRays, rayOffset);
+                EXPECT_FALSE(visited[rayOffset]);
+                visited[rayOffset] = true;
+
+                const Float value = static_cast<Float>(rayOffset);
+                EXPECT_EQ(value, group.rays[0].origin.x[j]);
+                EXPECT_EQ(value, group.maxDistances[j]);
+                EXPECT_EQ(value, packet.rayWeights[groupIndex].y[j]);
+
+                // active rays are packed in the front groups
+                const Uint32 position = RayPacket::RaysPerGroup * i + j;
+                EXPECT_EQ(position < numActiveRays, isActive[rayOffset]);
+            }
+        }
+    }
+}
+
+TEST(TraversalTest, PathTracerPacket_MatchesSingle)
+{
+    const MaterialPtr material = Material::Create();
+    material->baseColor = Vector4(0.8f, 0.6f, 0.4f, 0.0f);
+    material->Compile();
+
+    Scene scene;
+    for (Uint32 i = 0; i < 3; ++i)
+    {
+        std::unique_ptr<SphereSceneObject> sphere(new SphereSceneObject(1.0f));
+        sphere->mTransform.SetTranslation(Vector4(2.2f * i - 2.2f, 0.0f, 0.0f, 0.0f));
+        sphere->mDefaultMaterial = material;
+        scene.AddObject(std::move(sphere));
+    }
+    scene.SetBackgroundLight(std::make_unique<BackgroundLight>(Vector4(1.0f, 0.9f, 0.8f, 0.0f)));
+    ASSERT_TRUE(scene.BuildBVH());
+
+    Camera camera;
+    camera.SetPerspective(Transform(Vector4(0.0f, 0.0f, -6.0f, 0.0f)), 1.0f, RT_PI * 0.4f);
+
+    const PathTracer pathTracer(scene);
+
+    const Uint32 imageSize = 32;
+    const Uint32 numPasses = 64;
+
+    // average pixel color of a converged image
+    const auto renderImage = [&](TraversalMode traversalMode)
+    {
+        RenderingParams params;
+        params.traversalMode = traversalMode;
+
+        Viewport viewport;
+        EXPECT_TRUE(viewport.Resize(imageSize, imageSize));
+        EXPECT_TRUE(viewport.SetRenderingParams(params));
+        for (Uint32 i = 0; i < numPasses; ++i)
+        {
+            EXPECT_TRUE(viewport.Render(pathTracer, camera));
+        }
+
+        Vector4 sum = Vector4::Zero();
+        const Float3* pixels = viewport.GetSumBuffer().GetDataAs<Float3>();
+        for (Uint32 i = 0; i < imageSize * imageSize; ++i)
+        {
+            sum += Vector4(pixels[i]);
+        }
+        return sum / static_cast<Float>(imageSize * imageSize * numPasses);
+    };
+
+    const Vector4 singleColor = renderImage(TraversalMode::Single);
+    const Vector4 packetColor = renderImage(TraversalMode::Packet);
+
+    for (Uint32 i = 0; i < 3; ++i)
+    {
+        EXPECT_GT(singleColor[i], 0.1f);
+        EXPECT_NEAR(singleColor[i], packetColor[i], 0.02f * singleColor[i]);
+    }
+}